@@ -99,3 +99,6 @@ if(WITH_JPEG AND JPEG_VERSION)
 endif()
 
 status("")
+status("TSDF: " IF WITH_TSDF "YES" ELSE "NO")
+
+status("")
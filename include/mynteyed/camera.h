@@ -24,13 +24,17 @@
 
 #include "mynteyed/device/device_info.h"
 #include "mynteyed/device/image.h"
+#include "mynteyed/device/image_stats.h"
 #include "mynteyed/device/open_params.h"
 #include "mynteyed/device/stream_info.h"
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/imgproc/change_gate.h"
 #include "mynteyed/types.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
 class CameraPrivate;
+class StereoMatcher;
 
 class MYNTEYE_API Camera {
  public:
@@ -173,6 +177,133 @@ class MYNTEYE_API Camera {
   /** Set motion data callback. */
   void SetMotionCallback(motion_callback_t callback, bool async = true);
 
+  /**
+   * Add a filter to depth stream.
+   *
+   * The enabled filters run in place on DEPTH_RAW before the depth stream data
+   * is delivered, in ascending order of location. Filters with the same
+   * location run in the order they are added.
+   *
+   * Return false if the name or filter is already added.
+   */
+  bool AddDepthFilter(const std::string& name,
+      std::shared_ptr<BaseFilter> filter, std::size_t location = 0);
+  /** Delete a filter from depth stream by name. */
+  bool DeleteDepthFilter(const std::string& name);
+  /** Delete a filter from depth stream. */
+  bool DeleteDepthFilter(std::shared_ptr<BaseFilter> filter);
+  /** Get the time costs of depth filters, in the order they run. */
+  std::vector<FilterCost> GetDepthFilterCosts() const;
+  /**
+   * Enable filtering depth on a dedicated thread, default disabled.
+   *
+   * Then frame N could be filtered while frame N+1 is captured. Frames are
+   * filtered in order by one thread. max_queued is the depth of the queue
+   * in front of it: the oldest waiting frame is dropped if max_queued frames
+   * are waiting. The waiting ones are still delivered when disabled.
+   */
+  void EnableDepthFilterAsync(std::size_t max_queued = 2);
+  /** Disable filtering depth on a dedicated thread. */
+  void DisableDepthFilterAsync();
+  /** Whethor filtering depth on a dedicated thread or not */
+  bool IsDepthFilterAsyncEnabled() const;
+  /** Get the latency from depth captured to delivered, by the filters. */
+  FilterCost GetDepthFilterLatency() const;
+
+  /**
+   * Enable the image pyramids of color stream data, default disabled.
+   *
+   * The pyramid is built on the capture thread and delivered as
+   * StreamData::pyramid: level 0 is the color converted into format, then
+   * levels of the half size each. format is IMAGE_GRAY_8, COLOR_BGR or
+   * COLOR_RGB.
+   */
+  void EnableImagePyramid(int levels = 3,
+      const ImageFormat& format = ImageFormat::IMAGE_GRAY_8);
+  /** Disable the image pyramids of color stream data. */
+  void DisableImagePyramid();
+  /** Whethor building the image pyramids or not */
+  bool IsImagePyramidEnabled() const;
+
+  /**
+   * Enable the validity masks of depth stream data, default disabled.
+   *
+   * The mask is packed by the depth filters in their pass, and delivered as
+   * StreamData::mask: 1 bit per pixel of DEPTH_RAW, and the edge and temporal
+   * stability confidences of EdgeFilter and TemporalFilter if confidence.
+   */
+  void EnableDepthMask(bool confidence = false);
+  /** Disable the validity masks of depth stream data. */
+  void DisableDepthMask();
+  /** Whethor packing the validity masks or not */
+  bool IsDepthMaskEnabled() const;
+
+  /**
+   * Enable the luma statistics of color stream data, default disabled.
+   *
+   * The histogram, mean, saturated ratio and optional tile means are
+   * accumulated in the pass which already reads the color, and delivered as
+   * StreamData::stats, of each side if dual: the capture copy of YUYV, or
+   * Image::To() of MJPG, then the stats are of the converted image.
+   */
+  void EnableImageStats(const ImageStatsParams& params = ImageStatsParams());
+  /** Disable the luma statistics of color stream data. */
+  void DisableImageStats();
+  /** Whethor accumulating the luma statistics or not */
+  bool IsImageStatsEnabled() const;
+
+  /**
+   * Enable the change gates of color and depth stream data, default
+   * disabled, e.g. for the static scenes.
+   *
+   * Each frame is sampled each step, and compared with the last changed one
+   * by the tiles, before the filters, pyramids, stats and depth matching.
+   * The unchanged frames are not processed, but delivered with
+   * StreamData::unchanged: the data of the last changed, which share its
+   * memory, with the frame id and timestamp of this. So the consumers could
+   * skip them too.
+   */
+  void EnableChangeGate(const ChangeGateParams& params = ChangeGateParams());
+  /** Disable the change gates of stream data. */
+  void DisableChangeGate();
+  /** Whethor gating the unchanged stream data or not */
+  bool IsChangeGateEnabled() const;
+
+  /**
+   * Enable the rectified color of stream data, default disabled, e.g. for
+   * ColorMode::COLOR_RAW to keep the depth raw too.
+   *
+   * The color is rectified by Rectification on the capture thread and
+   * delivered as StreamData::rectified, of format IMAGE_GRAY_8, COLOR_BGR or
+   * COLOR_RGB, and width x height, 0 means of the color. The maps are built
+   * by the stream intrinsics, when opened, once per stream mode. The pyramid
+   * is still of the raw color.
+   */
+  bool EnableRectification(
+      const ImageFormat& format = ImageFormat::COLOR_BGR,
+      int width = 0, int height = 0);
+  /** Disable the rectified color of stream data. */
+  void DisableRectification();
+  /** Whethor rectifying the color or not */
+  bool IsRectificationEnabled() const;
+
+  /**
+   * Enable the depth matched on host from the left and right color, default
+   * disabled, e.g. for DeviceMode::DEVICE_COLOR.
+   *
+   * Must be opened with the stream mode of left and right color. The color
+   * pair is rectified into gray of width x height, 0 means the half of color,
+   * then matched by StereoMatcher. The depth is DEPTH_RAW of the size, as the
+   * depth stream data instead of the one of device.
+   */
+  bool EnableHostDepth(int width = 0, int height = 0);
+  /** Disable the depth matched on host. */
+  void DisableHostDepth();
+  /** Whethor matching the depth on host or not */
+  bool IsHostDepthEnabled() const;
+  /** Get the matcher of the depth on host, to tune it, nullptr if disabled. */
+  std::shared_ptr<StereoMatcher> GetHostDepthMatcher() const;
+
   /** Close the camera */
   void Close();
 
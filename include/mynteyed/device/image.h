@@ -29,6 +29,10 @@
 #include "mynteyed/stubs/global.h"
 
 MYNTEYE_BEGIN_NAMESPACE
+
+struct ImageStats;
+struct ImageStatsParams;
+
 struct ImageProfile {
   size_t width;
   size_t height;
@@ -94,6 +98,14 @@ class MYNTEYE_API Image {
     frame_id_ = frame_id;
   }
 
+  std::uint64_t timestamp() const {
+    return timestamp_;
+  }
+
+  void set_timestamp(std::uint64_t timestamp) {
+    timestamp_ = timestamp;
+  }
+
   bool is_dual() const {
     return is_dual_;
   }
@@ -121,6 +133,38 @@ class MYNTEYE_API Image {
   // will resize data if larger then data size
   void set_valid_size(std::size_t valid_size);
 
+  // change size and keep data, only if not larger then data size
+  bool Reshape(int width, int height);
+
+  /**
+   * Set the params to accumulate the luma statistics in the pixel passes of
+   * Clone() and To(), nullptr means none.
+   */
+  void set_stats_params(
+      const std::shared_ptr<const ImageStatsParams>& params) {
+    stats_params_ = params;
+  }
+
+  std::shared_ptr<const ImageStatsParams> stats_params() const {
+    return stats_params_;
+  }
+
+  /** The luma statistics, of the side of type if dual, nullptr if none. */
+  std::shared_ptr<ImageStats> stats() const {
+    return stats_;
+  }
+
+  void set_stats(const std::shared_ptr<ImageStats>& stats) {
+    stats_ = stats;
+  }
+
+  /**
+   * Accumulate the stats in a read pass, if requested and not yet, e.g. the
+   * capture not copied. False if none, or of MJPG, whose stats are only
+   * accumulated while decoding by To().
+   */
+  bool AccumulateStats();
+
   virtual pointer To(const ImageFormat& format) = 0;
 
   ImageProfile get_image_profile() {
@@ -158,6 +202,10 @@ class MYNTEYE_API Image {
   bool ResetBuffer();
 
  protected:
+  // set the stats of the left and right if dual
+  void set_stats_sides(const std::shared_ptr<ImageStats>& left,
+      const std::shared_ptr<ImageStats>& right);
+
   ImageType type_;
   ImageFormat format_;
   int width_;
@@ -168,6 +216,8 @@ class MYNTEYE_API Image {
 
   // Frame id
   int frame_id_;
+  // Timestamp of image info, 0 if not synced
+  std::uint64_t timestamp_;
   // Special state for dual data
   bool is_dual_;
 
@@ -175,6 +225,13 @@ class MYNTEYE_API Image {
   // The real valid size of some compress format or other cases.
   std::size_t valid_size_;
 
+  std::shared_ptr<const ImageStatsParams> stats_params_;
+  // The stats of this, of its side if dual
+  std::shared_ptr<ImageStats> stats_;
+  // The stats of the left and right if dual
+  std::shared_ptr<ImageStats> stats_left_;
+  std::shared_ptr<ImageStats> stats_right_;
+
   MYNTEYE_DISABLE_COPY(Image)
   MYNTEYE_DISABLE_MOVE(Image)
 };
@@ -0,0 +1,63 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEVICE_IMAGE_STATS_H_
+#define MYNTEYE_DEVICE_IMAGE_STATS_H_
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "mynteyed/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * The params of the luma statistics of color.
+ */
+struct MYNTEYE_API ImageStatsParams {
+  /** The tiles of the tile means, 0 means no tiles */
+  int tiles_x = 0;
+  int tiles_y = 0;
+  /** The luma at or above which the pixels are saturated */
+  std::uint8_t saturation = 250;
+};
+
+/**
+ * @ingroup datatypes
+ * The luma statistics of one color frame, or of its side if dual.
+ */
+struct MYNTEYE_API ImageStats {
+  /** The luma histogram */
+  std::array<std::uint32_t, 256> histogram;
+  /** The count of pixels */
+  std::uint32_t count = 0;
+  /** The mean luma */
+  float mean = 0;
+  /** The ratio of the saturated pixels, 0 ~ 1 */
+  float saturated = 0;
+  /** The tiles, 0 if no tiles */
+  int tiles_x = 0;
+  int tiles_y = 0;
+  /** The mean luma of tiles, tiles_y rows of tiles_x, empty if no tiles */
+  std::vector<float> tile_means;
+  /** The frame id and timestamp of color */
+  int frame_id = 0;
+  std::uint64_t timestamp = 0;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEVICE_IMAGE_STATS_H_
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #pragma once
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <iostream>
@@ -21,8 +22,33 @@
 
 #define MAX_CONFIG_LENGTH 256
 
+// The raw depth value which means no depth, besides 0
+#define DEPTH_RAW_INVALID 4096
+
 MYNTEYE_BEGIN_NAMESPACE
 
+class DepthMask;
+
+/** Whethor the raw depth value is valid or not, 0 and 4096 mean no depth. */
+inline bool is_depth_valid(const std::uint16_t& depth) {
+  return depth != 0 && depth != DEPTH_RAW_INVALID;
+}
+
+/**
+ * @ingroup datatypes
+ * Time cost of one filter in the depth filter chain.
+ */
+struct MYNTEYE_API FilterCost {
+  /** Filter name */
+  std::string name;
+  /** Processed frame count */
+  std::uint64_t count;
+  /** Time cost of the last frame, in milliseconds */
+  double last_ms;
+  /** Average time cost, in milliseconds */
+  double avg_ms;
+};
+
 class MYNTEYE_API BaseFilter : public std::enable_shared_from_this<BaseFilter> {
  protected:
   BaseFilter();
@@ -31,6 +57,16 @@ class MYNTEYE_API BaseFilter : public std::enable_shared_from_this<BaseFilter> {
   virtual bool ProcessFrame(
       std::shared_ptr<Image> out,
       const std::shared_ptr<Image> in) = 0; // NOLINT
+  /**
+   * Process frame, and write into mask the confidence of this filter if it
+   * has one and mask->has_confidence(), and the validity bits of out if
+   * pack_bits. The default packs the bits in another pass, the filters
+   * which could do it in their own pass.
+   */
+  virtual bool ProcessFrameMask(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in,
+      DepthMask* mask, bool pack_bits);
   virtual bool LoadConfig(void* data);
   inline bool TurnOn() {
     return Enable(true);
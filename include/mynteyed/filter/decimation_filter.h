@@ -0,0 +1,72 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup enumerations
+ * @brief How a block of depth is reduced to one pixel.
+ */
+enum class DecimationMode : std::uint8_t {
+  /** Median of the valid pixels in block */
+  DECIMATION_MEDIAN = 0,
+  /** Min of the valid pixels in block, the nearest obstacle is kept */
+  DECIMATION_MIN = 1,
+};
+
+/**
+ * Downsample DEPTH_RAW by 2x, 3x or 4x.
+ *
+ * The output is (width / scale) x (height / scale). If out is in, the image is
+ * reshaped in place; otherwise, out must be of the reduced size.
+ */
+class MYNTEYE_API DecimationFilter : public BaseFilter {
+ public:
+  explicit DecimationFilter(std::uint8_t scale = 2,
+      DecimationMode mode = DecimationMode::DECIMATION_MEDIAN);
+  /** data: scale(uint8), mode(uint8) */
+  bool LoadConfig(void* data) override;
+  bool ProcessFrame(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in) override;
+
+  std::uint8_t scale() const { return _scale; }
+  DecimationMode mode() const { return _mode; }
+
+  /** Scale the intrinsics to the reduced image. */
+  CameraIntrinsics ScaleIntrinsics(const CameraIntrinsics& in) const;
+
+ private:
+  void process_frame(const std::uint16_t* src, std::uint16_t* dst,
+      size_t width, size_t height);
+  void reduce_row_min(const std::uint16_t* src, size_t width,
+      std::uint16_t* dst, size_t out_width);
+  void reduce_row_median(const std::uint16_t* src, size_t width,
+      std::uint16_t* dst, size_t out_width);
+
+  std::uint8_t            _scale;
+  DecimationMode          _mode;
+  // one reduced row, as output may overlap input rows in place
+  std::vector<uint16_t>   _row;
+  std::vector<uint16_t>   _col_min;
+  std::mutex _mutex;
+};
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,108 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_FILTER_DEPTH_MASK_H_
+#define MYNTEYE_FILTER_DEPTH_MASK_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * The validity of a DEPTH_RAW frame, 1 bit per pixel, and the optional
+ * confidences of the filters.
+ *
+ * Each row starts at a 64-bit word, bit x % 64 of word x / 64 is set if pixel
+ * x is valid by is_depth_valid(), the bits after the width are 0. So 64
+ * pixels are skipped by one test of their word.
+ */
+class MYNTEYE_API DepthMask {
+ public:
+  /** confidence: whether the filters compute their confidences. */
+  explicit DepthMask(bool confidence = false);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  /** The 64-bit words of each row. */
+  std::size_t words() const { return words_; }
+
+  std::uint64_t* row(int y) { return bits_.data() + y * words_; }
+  const std::uint64_t* row(int y) const {
+    return bits_.data() + y * words_;
+  }
+  bool is_valid(int x, int y) const {
+    return (row(y)[x >> 6] >> (x & 63)) & 1;
+  }
+  /** The count of the valid pixels. */
+  std::size_t CountValid() const;
+
+  bool has_confidence() const { return confidence_; }
+  /**
+   * The edge confidence of pixels, by EdgeFilter: 255, 191, 127 or 63 as the
+   * largest step to its valid 4-neighbours is within 1/4, 1/2 or 1 of its
+   * edge threshold or more, 0 if invalid. Empty if not computed.
+   */
+  std::vector<std::uint8_t>& edge() { return edge_; }
+  const std::vector<std::uint8_t>& edge() const { return edge_; }
+  /**
+   * The temporal stability of pixels, by TemporalFilter: of the last 8
+   * frames, the ones the pixel is valid and consistent in, scaled to 0 ~ 255.
+   * Empty if not computed.
+   */
+  std::vector<std::uint8_t>& stability() { return stability_; }
+  const std::vector<std::uint8_t>& stability() const { return stability_; }
+
+  int frame_id() const { return frame_id_; }
+  std::uint64_t timestamp() const { return timestamp_; }
+
+  /** Clear the confidences, and set whether to compute them, per frame. */
+  void Clear(bool confidence);
+  /**
+   * Layout the bits of depth, all 0, of its size and frame. The confidences
+   * not of the size are cleared, e.g. computed before decimated.
+   */
+  void Reset(const Image& depth);
+  /**
+   * Pack the bits of depth in one pass, also copy depth into copy if given,
+   * of the same profile.
+   */
+  void Pack(const std::shared_ptr<Image>& depth,
+      const std::shared_ptr<Image>& copy = nullptr);
+  /**
+   * Pack the bits of row y of depth, after Reset(), e.g. by a filter just
+   * after the row is written, so it is read again from cache.
+   */
+  void PackRow(int y, const std::uint16_t* depth);
+
+ private:
+  bool confidence_;
+  int width_;
+  int height_;
+  std::size_t words_;
+  std::vector<std::uint64_t> bits_;
+  std::vector<std::uint8_t> edge_;
+  std::vector<std::uint8_t> stability_;
+
+  int frame_id_;
+  std::uint64_t timestamp_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_FILTER_DEPTH_MASK_H_
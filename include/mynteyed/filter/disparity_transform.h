@@ -0,0 +1,68 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Transform DEPTH_RAW between depth and disparity, with a lookup table.
+ *
+ * The disparity is in 1/subpixel pixel, disparity = focal * baseline *
+ * subpixel / depth, and the invalid pixels are 0. The image format is still
+ * DEPTH_RAW.
+ *
+ * Add one to disparity at the first location, and one to depth at the last,
+ * then the filters between run in disparity domain. Their thresholds are in
+ * disparity units, which scale as depth error over range.
+ */
+class MYNTEYE_API DisparityTransform : public BaseFilter {
+ public:
+  explicit DisparityTransform(bool to_disparity = true,
+      std::uint16_t subpixel = 32);
+  /** data: focal_length(float), baseline(float), subpixel(uint16) */
+  bool LoadConfig(void* data) override;
+  bool ProcessFrame(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in) override;
+
+  /**
+   * Set the focal length in pixels and the baseline in depth units, the
+   * transform does nothing before it's set.
+   */
+  void SetStereoParams(double focal_length, double baseline);
+  /** Set from the rectified left camera and the left to right extrinsics. */
+  void SetStereoParams(const StreamIntrinsics& intrinsics,
+      const StreamExtrinsics& extrinsics);
+
+  bool to_disparity() const { return _to_disparity; }
+  std::uint16_t subpixel() const { return _subpixel; }
+
+ private:
+  void update_lut();
+
+  bool                    _to_disparity;
+  std::uint16_t           _subpixel;
+  double                  _focal_length;
+  double                  _baseline;
+  // depth to disparity, or disparity to depth
+  std::vector<uint16_t>   _lut;
+  std::mutex _mutex;
+};
+
+MYNTEYE_END_NAMESPACE
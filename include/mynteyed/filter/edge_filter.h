@@ -0,0 +1,70 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Remove the flying pixels at depth edges of DEPTH_RAW.
+ *
+ * A valid pixel is invalidated if it is farther than one of its valid
+ * 4-neighbours by more than max(depth * ratio, min_delta). So the mixed pixels
+ * between foreground and background are removed, the foreground is kept.
+ */
+class MYNTEYE_API EdgeFilter : public BaseFilter {
+ public:
+  explicit EdgeFilter(float ratio = 0.04f, std::uint16_t min_delta = 20);
+  /** data: ratio(float), min_delta(uint16) */
+  bool LoadConfig(void* data) override;
+  bool ProcessFrame(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in) override;
+  /**
+   * Also the edge confidence in the same pass, and the bits of each row just
+   * after it is filtered.
+   */
+  bool ProcessFrameMask(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in,
+      DepthMask* mask, bool pack_bits) override;
+
+  float ratio() const { return _ratio; }
+  std::uint16_t min_delta() const { return _min_delta; }
+
+ private:
+  void process_frame(const std::uint16_t* src, std::uint16_t* dst,
+      DepthMask* mask, bool pack_bits);
+  // the confidence of the row is written if not null
+  void process_row(const std::uint16_t* up, const std::uint16_t* cur,
+      const std::uint16_t* down, std::uint16_t* dst,
+      std::uint8_t* confidence);
+
+  float                   _ratio;
+  std::uint16_t           _min_delta;
+  // ratio in 0.16 fixed point
+  std::uint16_t           _ratio_q16;
+  size_t                  _width;
+  size_t                  _height;
+  // the original rows above and current, with one invalid pixel each side,
+  // and the invalid row out of image
+  std::vector<uint16_t>   _rows[3];
+  std::mutex _mutex;
+};
+
+MYNTEYE_END_NAMESPACE
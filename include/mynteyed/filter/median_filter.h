@@ -0,0 +1,58 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+class ThreadPool;
+
+/**
+ * Median filter of DEPTH_RAW, with 3x3 or 5x5 kernel.
+ *
+ * The border is replicated, as cv::medianBlur. If ignore invalid, the median
+ * is of the valid pixels in window, and the invalid pixels are kept.
+ */
+class MYNTEYE_API MedianFilter : public BaseFilter {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit MedianFilter(std::uint8_t ksize = 3, bool ignore_invalid = true,
+      std::size_t threads = 0);
+  /** data: ksize(uint8), ignore_invalid(uint8) */
+  bool LoadConfig(void* data) override;
+  bool ProcessFrame(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in) override;
+
+  std::uint8_t ksize() const { return _ksize; }
+  bool ignore_invalid() const { return _ignore_invalid; }
+
+ private:
+  void pad_frame(const std::uint16_t* src);
+  void process_rows(std::uint16_t* dst, size_t beg, size_t end);
+
+  std::uint8_t            _ksize;
+  bool                    _ignore_invalid;
+  size_t                  _width;
+  size_t                  _height;
+  // the input with replicated border, as the output is in place
+  std::vector<uint16_t>   _padded;
+  std::shared_ptr<ThreadPool> _pool;
+  std::mutex _mutex;
+};
+
+MYNTEYE_END_NAMESPACE
@@ -0,0 +1,80 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/temporal_filter.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+class ThreadPool;
+
+/**
+ * Temporal filter for moving camera.
+ *
+ * The gyroscope is integrated between the depth frames, then the last
+ * filtered frame is warped by the rotation, before blending as
+ * TemporalFilter. The translation is not compensated.
+ *
+ * Feed it the motion datas, e.g. from Camera::SetMotionCallback. The frames are
+ * aligned to the motion datas by Image::timestamp(), if no timestamp, all
+ * motion datas since last frame are integrated.
+ */
+class MYNTEYE_API MotionTemporalFilter : public TemporalFilter {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit MotionTemporalFilter(std::size_t threads = 0);
+
+  /** Warp the last frame, then as TemporalFilter, also of ProcessFrame. */
+  bool ProcessFrameMask(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in,
+      DepthMask* mask, bool pack_bits) override;
+
+  /** Set the intrinsics of depth, the rectified left camera. */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+  /** Set the rotation from IMU to camera, identity by default. */
+  void SetMotionExtrinsics(const MotionExtrinsics& extrinsics);
+
+  /** Feed the gyroscope datas, the others are ignored. */
+  void OnMotionData(const MotionData& data);
+
+ private:
+  struct GyroSample {
+    std::uint64_t timestamp;
+    double gyro[3];  // deg/s
+  };
+
+  bool integrate_rotation(std::uint64_t timestamp, double rot[3][3]);
+  void warp_last_frame(const double rot[3][3]);
+  void warp_rows(const float h[3][3], size_t beg, size_t end);
+
+  // intrinsics, scaled to the depth size when warping
+  CameraIntrinsics        _intrinsics;
+  bool                    _has_intrinsics;
+  double                  _imu_to_camera[3][3];
+  std::deque<GyroSample>  _gyro_samples;
+  std::uint64_t           _last_timestamp;
+  bool                    _has_last_timestamp;
+  std::mutex              _motion_mutex;
+  // warped last frame and history, swapped with the last ones
+  std::vector<uint8_t>    _warped_frame;
+  std::vector<uint8_t>    _warped_history;
+  std::shared_ptr<ThreadPool> _pool;
+};
+
+MYNTEYE_END_NAMESPACE
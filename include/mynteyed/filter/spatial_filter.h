@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #pragma once
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <mutex>
 #include <vector>
 #include <memory>
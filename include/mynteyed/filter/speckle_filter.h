@@ -0,0 +1,67 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <mutex>
+#include <vector>
+#include <memory>
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Remove the speckles of DEPTH_RAW, as cv::filterSpeckles.
+ *
+ * The 4-connected pixels whose depth differ not more than max_diff are one
+ * region, the regions smaller than max_speckle_size are invalidated.
+ */
+class MYNTEYE_API SpeckleFilter : public BaseFilter {
+ public:
+  explicit SpeckleFilter(std::uint32_t max_speckle_size = 100,
+      std::uint16_t max_diff = 32);
+  /** data: max_speckle_size(uint32), max_diff(uint16) */
+  bool LoadConfig(void* data) override;
+  bool ProcessFrame(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in) override;
+
+  std::uint32_t max_speckle_size() const { return _max_speckle_size; }
+  std::uint16_t max_diff() const { return _max_diff; }
+
+ private:
+  /** The valid pixels [beg, end) of one row, in one region. */
+  struct Run {
+    std::uint32_t y;
+    std::uint32_t beg;
+    std::uint32_t end;
+  };
+
+  void process_frame(std::uint16_t* data);
+  void connect_rows(const std::uint16_t* up, const std::uint16_t* cur,
+      size_t up_beg, size_t cur_beg, size_t cur_end);
+  std::uint32_t find(std::uint32_t i);
+  void unite(std::uint32_t i, std::uint32_t j);
+
+  std::uint32_t           _max_speckle_size;
+  std::uint16_t           _max_diff;
+  size_t                  _width;
+  size_t                  _height;
+  // scratch of union-find, reused among frames
+  std::vector<Run>            _runs;
+  std::vector<std::uint32_t>  _parent;
+  std::vector<std::uint32_t>  _size;
+  std::mutex _mutex;
+};
+
+MYNTEYE_END_NAMESPACE
@@ -14,6 +14,7 @@
 
 #pragma once
 #include <stdint.h>
+#include <array>
 #include <mutex>
 #include <limits>
 #include <cmath>
@@ -41,11 +42,19 @@ class MYNTEYE_API TemporalFilter : public BaseFilter{
   bool ProcessFrame(
       std::shared_ptr<Image> out,
       const std::shared_ptr<Image> in) override;
+  /** Also the temporal stability and the bits, in the same pass. */
+  bool ProcessFrameMask(
+      std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in,
+      DepthMask* mask, bool pack_bits) override;
 
  protected:
+  // bits of words per row, and stability are written if not null
   template<typename T>
   void temp_jw_smooth(
-      void* frame_data, void * _last_frame_data, uint8_t *history) {
+      void* frame_data, void * _last_frame_data, uint8_t *history,
+      uint64_t* bits = nullptr, size_t words = 0,
+      uint8_t* stability = nullptr) {
     static_assert(
         (std::is_arithmetic<T>::value),
         "temporal filter assumes numeric types");
@@ -55,6 +64,7 @@ class MYNTEYE_API TemporalFilter : public BaseFilter{
     auto _last_frame    = reinterpret_cast<T*>(_last_frame_data);
 
     unsigned char mask = 1 << _cur_frame_index;
+    size_t x = 0;
 
     // pass one -- go through image and update all
     for (size_t i = 0; i < _current_frm_size_pixels; i++) {
@@ -89,6 +99,17 @@ class MYNTEYE_API TemporalFilter : public BaseFilter{
         }
         history[i] &= ~mask;
       }
+
+      if (bits) {
+        if (is_depth_valid(frame[i])) {
+          bits[x >> 6] |= static_cast<uint64_t>(1) << (x & 63);
+        }
+        if (++x == _width) {
+          x = 0;
+          bits += words;
+        }
+      }
+      if (stability) stability[i] = _stability_map[history[i]];
     }
     _cur_frame_index = (_cur_frame_index + 1) % 8;  // at end of cycle
 }
@@ -99,8 +120,8 @@ class MYNTEYE_API TemporalFilter : public BaseFilter{
 
   void recalc_persistence_map();
 
- private:
-  bool process_frame(void* source);
+ protected:
+  bool process_frame(void* source, DepthMask* mask, bool pack_bits);
   void UpdateConfig(const ImageProfile &in);
   uint8_t _persistence_param;
 
@@ -118,6 +139,8 @@ class MYNTEYE_API TemporalFilter : public BaseFilter{
   // encodes whether a particular 8 bit history
   // is good enough for all 8 phases of storage
   std::array<uint8_t, PRESISTENCY_LUT_SIZE> _persistence_map;
+  // the stability of a history, its frames scaled to 0 ~ 255
+  std::array<uint8_t, PRESISTENCY_LUT_SIZE> _stability_map;
   std::mutex _mutex;
   ImageProfile            last_frame_profile;
 };
@@ -0,0 +1,112 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMGPROC_CHANGE_GATE_H_
+#define MYNTEYE_IMGPROC_CHANGE_GATE_H_
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * @ingroup datatypes
+ * The params of the change gate of stream data.
+ */
+struct MYNTEYE_API ChangeGateParams {
+  /** The tiles of the frame */
+  int tiles_x = 8;
+  int tiles_y = 6;
+  /** The sampled pixels, one of each step x step */
+  int step = 4;
+  /** The mean absolute difference of a changed tile, of color luma */
+  int color_threshold = 6;
+  /** The mean absolute difference of a changed tile, of depth in mm */
+  int depth_threshold = 30;
+  /** The changed tiles of a changed frame */
+  int min_tiles = 1;
+  /** Pass a frame after these unchanged ones anyway, 0 means never */
+  int max_unchanged = 30;
+};
+
+/**
+ * Detect whether a frame changed from the last passed one, of the same
+ * stream, e.g. to skip the processing of static scenes.
+ *
+ * The pixels are sampled each step, the luma of COLOR_YUYV, the green of
+ * COLOR_BGR or COLOR_RGB, or DEPTH_RAW. A tile changed if the mean absolute
+ * difference of its samples to those of the last passed frame is above the
+ * threshold, each difference clamped to 8 times the threshold. Of depth, a
+ * sample valid in only one differs by the clamp, and the samples invalid in
+ * both are skipped. Only the samples of the last passed frame are kept, not
+ * the frame.
+ */
+class MYNTEYE_API ChangeGate {
+ public:
+  explicit ChangeGate(const ChangeGateParams& params = ChangeGateParams());
+
+  void SetParams(const ChangeGateParams& params);
+  ChangeGateParams GetParams();
+
+  /**
+   * True if image changed, or force, then its samples are the reference of
+   * the next. Also true if the format is not supported, e.g. COLOR_MJPG, or
+   * the profile changed.
+   */
+  bool Process(const Image::pointer& image, bool force = false);
+
+  /** The changed tiles of the last processed frame. */
+  int GetChangedTiles();
+
+  /** Clear the reference, so the next frame passes. */
+  void Reset();
+
+ private:
+  // layout the samples of the profile of image, and clear the reference
+  void Layout(const Image& image);
+  // sample image into samples_, false if the format not supported
+  bool Sample(const Image& image);
+  // the tiles of samples_ changed from reference_
+  int CountChangedTiles(int threshold) const;
+
+  std::mutex mutex_;
+
+  ChangeGateParams params_;
+
+  // the profile of the reference, the sampled columns and rows, and their
+  // tiles
+  ImageFormat format_;
+  int width_;
+  int height_;
+  int tiles_x_;
+  int tiles_y_;
+  std::vector<int> cols_;
+  std::vector<int> col_tiles_;
+  std::vector<int> rows_;
+  std::vector<int> row_tiles_;
+
+  std::vector<std::uint16_t> samples_;
+  std::vector<std::uint16_t> reference_;
+  bool has_reference_;
+
+  int unchanged_;
+  int changed_tiles_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMGPROC_CHANGE_GATE_H_
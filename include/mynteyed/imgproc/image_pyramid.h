@@ -0,0 +1,132 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMGPROC_IMAGE_PYRAMID_H_
+#define MYNTEYE_IMGPROC_IMAGE_PYRAMID_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * The levels of an image, level 0 of the full size, then each of the half
+ * size of the previous, as the mean of 2 x 2. All the levels are in one
+ * contiguous buffer, each row packed.
+ */
+class MYNTEYE_API ImagePyramid {
+ public:
+  ImagePyramid();
+
+  /** IMAGE_GRAY_8, COLOR_BGR or COLOR_RGB. */
+  ImageFormat format() const { return format_; }
+  /** The bytes per pixel of the format. */
+  int bpp() const { return bpp_; }
+  /** The levels, with level 0. */
+  int size() const { return static_cast<int>(widths_.size()); }
+
+  int width(int level) const { return widths_[level]; }
+  int height(int level) const { return heights_[level]; }
+  std::size_t stride(int level) const {
+    return static_cast<std::size_t>(widths_[level]) * bpp_;
+  }
+
+  std::uint8_t* data(int level) { return buffer_.data() + offsets_[level]; }
+  const std::uint8_t* data(int level) const {
+    return buffer_.data() + offsets_[level];
+  }
+
+  int frame_id() const { return frame_id_; }
+  std::uint64_t timestamp() const { return timestamp_; }
+
+ private:
+  friend class ImagePyramidBuilder;
+
+  /** Layout the levels, the buffer is reallocated only if grows. */
+  void Reset(const ImageFormat& format, int width, int height, int levels);
+
+  ImageFormat format_;
+  int bpp_;
+  std::vector<int> widths_;
+  std::vector<int> heights_;
+  std::vector<std::size_t> offsets_;
+  std::vector<std::uint8_t> buffer_;
+
+  int frame_id_;
+  std::uint64_t timestamp_;
+};
+
+/**
+ * Build the pyramids of the color images, e.g. for feature tracking.
+ *
+ * The rows are converted into level 0 and downsampled into the levels by
+ * bands of 2^levels rows, so each band is in cache while all its levels are
+ * built, and the bands in parallel. The pyramids are pooled, the one
+ * released by all is reused without allocation.
+ */
+class MYNTEYE_API ImagePyramidBuilder {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit ImagePyramidBuilder(std::size_t threads = 0);
+  ~ImagePyramidBuilder();
+
+  /**
+   * Set the half levels, after level 0, and the format of the levels,
+   * IMAGE_GRAY_8, COLOR_BGR or COLOR_RGB. The levels stop if one side would
+   * be less than 1.
+   */
+  void SetLevels(int levels, const ImageFormat& format);
+  int GetLevels();
+  ImageFormat GetFormat();
+
+  /**
+   * Build the pyramid of color, COLOR_YUYV, COLOR_MJPG, COLOR_BGR, COLOR_RGB
+   * or IMAGE_GRAY_8, or its side of dual. nullptr if not supported.
+   *
+   * The gray of YUYV is the sensor luma, the Y as is, so it differs from the
+   * gray of the BGR by To(), which is weighted from the converted channels.
+   */
+  std::shared_ptr<ImagePyramid> Process(const Image::pointer& color);
+
+ private:
+  std::shared_ptr<ImagePyramid> Acquire();
+  void ProcessBands(const std::uint8_t* src, std::size_t src_stride,
+      ImageFormat src_format, ImagePyramid* pyramid, std::size_t beg,
+      std::size_t end) const;
+
+  std::mutex mutex_;
+
+  int levels_;
+  ImageFormat format_;
+
+  // the pyramids built, reused if only held here
+  std::vector<std::shared_ptr<ImagePyramid>> pyramids_;
+
+  // the whole MJPG decoded, of the last data, as both sides of dual share it
+  std::vector<std::uint8_t> decoded_;
+  const std::uint8_t* decoded_data_;
+  int decoded_frame_id_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMGPROC_IMAGE_PYRAMID_H_
@@ -0,0 +1,98 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMGPROC_RECTIFICATION_H_
+#define MYNTEYE_IMGPROC_RECTIFICATION_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/stubs/types_calib.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * Rectify the raw color on host, e.g. of COLOR_RAW, which keeps the depth
+ * raw too.
+ *
+ * The maps are built once by the intrinsics, as 16.5 fixed-point: the source
+ * pixel, and 5 bits of each fraction. Then each frame is sampled bilinearly
+ * by them, 8 pixels a time, in parallel row bands. YUYV is converted while
+ * sampled, and resized if the output size is set, so the source is read once
+ * and no intermediate images. The pixels out of source are 0.
+ */
+class MYNTEYE_API Rectification {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit Rectification(std::size_t threads = 0);
+  ~Rectification();
+
+  /**
+   * Set the intrinsics of the camera, by Camera::GetStreamIntrinsics. The
+   * maps are rebuilt if changed, of its size, from the raw camera to its
+   * rectified projection p and rotation r.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /**
+   * Set the size of rectified, 0 means of the intrinsics. The maps are
+   * rebuilt if changed, sampled at the pixel centers, so the half size is the
+   * mean of 2 x 2 if not distorted.
+   */
+  void SetOutputSize(int width, int height);
+
+  /**
+   * Rectify color into format, COLOR_BGR, COLOR_RGB or IMAGE_GRAY_8. The color
+   * is COLOR_YUYV, COLOR_MJPG, COLOR_BGR, COLOR_RGB or IMAGE_GRAY_8, of the
+   * intrinsics size, or its side of dual. MJPG is decoded first, as a whole.
+   * rectified is reused if of the format and size, otherwise created.
+   */
+  bool Process(const Image::pointer& color, const ImageFormat& format,
+      Image::pointer* rectified);
+
+ private:
+  void UpdateMaps();
+  void BuildMaps(std::size_t beg, std::size_t end);
+  void ProcessRows(const std::uint8_t* src, std::size_t stride,
+      ImageFormat src_format, std::uint8_t* dst, ImageFormat dst_format,
+      std::size_t beg, std::size_t end) const;
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  int output_width_;
+  int output_height_;
+
+  // per output pixel: the top-left source pixel x y, and the fractions
+  // y << 5 | x, with kMapInvalid if out of source
+  int map_width_;
+  int map_height_;
+  std::vector<std::int16_t> map_xy_;
+  std::vector<std::uint16_t> map_frac_;
+
+  // per frame: the whole MJPG decoded, if any
+  std::vector<std::uint8_t> decoded_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMGPROC_RECTIFICATION_H_
@@ -0,0 +1,134 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMGPROC_STEREO_MATCHER_H_
+#define MYNTEYE_IMGPROC_STEREO_MATCHER_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/imgproc/rectification.h"
+#include "mynteyed/stubs/types_calib.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup enumerations
+ * @brief The matching cost of pixels.
+ */
+enum class StereoMatchCost : std::uint8_t {
+  /** The absolute difference of gray */
+  SAD = 0,
+  /** The hamming distance of census, robust to the exposure differences */
+  CENSUS = 1,
+};
+
+/**
+ * Match the rectified gray left and right on host, into the depth of left,
+ * e.g. for DeviceMode::DEVICE_COLOR.
+ *
+ * The costs of each disparity are aggregated in blocks by sliding sums, 8
+ * disparities a time, in parallel row bands. The best disparity is rejected
+ * if not unique, or not consistent with the one of right, otherwise refined
+ * by a parabola. The depth is DEPTH_RAW, 0 if no match.
+ */
+class MYNTEYE_API StereoMatcher {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit StereoMatcher(std::size_t threads = 0);
+  ~StereoMatcher();
+
+  /** Set the focal of the rectified in pixels, and the baseline in mm. */
+  void SetCamera(double focal, double baseline);
+
+  /**
+   * Set the params of the color pair, by Camera::GetStreamIntrinsics and
+   * GetStreamExtrinsics, to rectify it into gray of width x height, 0 means
+   * of the intrinsics. Also sets the camera of the size.
+   */
+  void SetStreamParams(const StreamIntrinsics& intrinsics,
+      const StreamExtrinsics& extrinsics, int width = 0, int height = 0);
+
+  /** Set the disparities searched, rounded up to multiple of 8, 8 ~ 256. */
+  void SetDisparities(int disparities);
+  /** Set the block size, odd of 3 ~ 11. */
+  void SetBlockSize(int block_size);
+  void SetCost(const StereoMatchCost& cost);
+  /**
+   * Set the percent the best cost should be less than the others, except
+   * its neighbours, 0 disables.
+   */
+  void SetUniqueness(int percent);
+  /** Set the max difference to the disparity of right, < 0 disables. */
+  void SetLeftRightMaxDiff(int max_diff);
+
+  /**
+   * Match left and right, IMAGE_GRAY_8 of the same size. depth is reused if
+   * DEPTH_RAW of the size, otherwise created.
+   */
+  bool Process(const Image::pointer& left, const Image::pointer& right,
+      Image::pointer* depth);
+
+  /**
+   * Rectify the dual color into gray, then match, by the params of
+   * SetStreamParams.
+   */
+  bool ProcessColor(const Image::pointer& color, Image::pointer* depth);
+
+ private:
+  bool Match(const Image::pointer& left, const Image::pointer& right,
+      Image::pointer* depth);
+  void Encode(const std::uint8_t* left, const std::uint8_t* right,
+      std::size_t beg, std::size_t end);
+  // add the costs of add_row into the column sums, and sub those of sub_row
+  // if >= 0
+  void SlideRowCosts(int add_row, int sub_row, std::uint16_t* sums) const;
+  void MatchRows(std::uint16_t* depth, std::size_t beg,
+      std::size_t end) const;
+
+  std::mutex mutex_;
+
+  double focal_;
+  double baseline_;
+  int disparities_;
+  int block_size_;
+  StereoMatchCost cost_;
+  int uniqueness_;
+  int lr_max_diff_;
+
+  // per frame: the codes of each pixel, gray or census, of left, and of right
+  // reversed in each row then padded by disparities, so the right of each
+  // disparity is contiguous
+  int width_;
+  int height_;
+  std::vector<std::uint16_t> left_codes_;
+  std::vector<std::uint16_t> right_codes_;
+
+  // the color pair rectified into gray, of ProcessColor
+  Rectification left_rectification_;
+  Rectification right_rectification_;
+  Image::pointer left_gray_;
+  Image::pointer right_gray_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMGPROC_STEREO_MATCHER_H_
@@ -0,0 +1,108 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_DEPTH_REGISTRATION_H_
+#define MYNTEYE_POINTCLOUD_DEPTH_REGISTRATION_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * Register DEPTH_RAW into a color camera.
+ *
+ * Each depth pixel is reprojected by its two corners into the color camera,
+ * then splatted to the covered color pixels with a z-buffer, the nearest
+ * wins. The color pixels not covered are 0.
+ *
+ * The depth and translation are both in millimeters. The distortion of color
+ * camera, its coeffs of pinhole, is applied within the radius it grows.
+ */
+class MYNTEYE_API DepthRegistration {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit DepthRegistration(std::size_t threads = 0);
+  ~DepthRegistration();
+
+  /**
+   * Set the intrinsics of depth and color, and the extrinsics from depth to
+   * color. The output is of the color intrinsics size.
+   *
+   * The depth intrinsics are the rectified ones if any, and scaled if depth
+   * is not of its size.
+   */
+  void SetParams(const CameraIntrinsics& depth_intrinsics,
+      const CameraIntrinsics& color_intrinsics,
+      const Extrinsics& depth_to_color);
+
+  /**
+   * Set the params to register the depth, of the rectified left camera, into
+   * the raw left color, e.g. of COLOR_RAW, by Camera::GetStreamIntrinsics.
+   * The depth is rotated back by R1^T and distorted as the left color.
+   */
+  void SetStreamParams(const StreamIntrinsics& intrinsics);
+
+  /**
+   * Register depth into color, aligned is reused if it is DEPTH_RAW of the
+   * color size, otherwise created.
+   */
+  bool Process(const Image::pointer& depth, Image::pointer* aligned);
+
+ private:
+  void UpdateTerms(int width, int height);
+  void ProjectRows(const std::uint16_t* depth, std::size_t beg,
+      std::size_t end);
+  void SplatRows(std::uint16_t* aligned, std::size_t beg, std::size_t end);
+
+  std::mutex mutex_;
+
+  CameraIntrinsics depth_intrinsics_;
+  CameraIntrinsics color_intrinsics_;
+  bool has_params_;
+  // the color is distorted, within r2_max_ of the normalized radius
+  bool distorted_;
+  double r2_max_;
+  // K_color * R and K_color * t, or R and t if distorted, as K is after
+  double kr_[3][3];
+  double kt_[3];
+
+  // per depth size: the projection terms of pixel edges, k = 0..2:
+  //   q_k = z * (col_terms_[k][u] + row_terms_[k][v]) + kt_[k]
+  int terms_width_;
+  int terms_height_;
+  std::vector<float> col_terms_[3];
+  std::vector<float> row_terms_[3];
+
+  // per depth pixel: the covered color rect x0 x1 y0 y1, inclusive, and the
+  // depth in color
+  std::vector<std::int16_t> rects_;
+  std::vector<std::uint16_t> rect_z_;
+  // per depth row: the covered color rows
+  std::vector<std::int16_t> row_y0_;
+  std::vector<std::int16_t> row_y1_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_DEPTH_REGISTRATION_H_
@@ -0,0 +1,120 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_LASER_SCAN_H_
+#define MYNTEYE_POINTCLOUD_LASER_SCAN_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup datatypes
+ * The laser scan of one depth frame, as sensor_msgs/LaserScan.
+ */
+struct MYNTEYE_API LaserScanData {
+  /**
+   * The angles in radians, counterclockwise from the camera forward, so the
+   * left of image is positive
+   */
+  float angle_min = 0;
+  float angle_max = 0;
+  float angle_increment = 0;
+  /** The range limits in meters */
+  float range_min = 0;
+  float range_max = 0;
+  /** The frame id and timestamp of depth */
+  int frame_id = 0;
+  std::uint64_t timestamp = 0;
+
+  /** The ranges in meters from angle_min, +inf if nothing in the limits */
+  std::vector<float> ranges;
+};
+
+/**
+ * Emulate a laser scan from a band of DEPTH_RAW rows.
+ *
+ * The angular bin and range factor of each depth column are precomputed. So
+ * the band is reduced to the min depth of columns, in parallel, then to the
+ * min range of bins.
+ */
+class MYNTEYE_API LaserScan {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit LaserScan(std::size_t threads = 0);
+  ~LaserScan();
+
+  /**
+   * Set the intrinsics of depth, the rectified left camera. If depth size is
+   * not the intrinsics size, e.g. decimated, the intrinsics are scaled.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /**
+   * Set the band of rows around the optical center row, shifted down by
+   * offset rows. 1 row by default.
+   */
+  void SetScanRows(int rows, int offset = 0);
+  /** Set the range limits in meters, 0.3 ~ 10 m by default. */
+  void SetRangeLimits(float range_min, float range_max);
+  /** Set the count of bins, 0 means one per depth column, by default. */
+  void SetBins(std::size_t bins);
+
+  /** Compute the scan of depth. */
+  bool Compute(const Image::pointer& depth, LaserScanData* scan);
+
+ private:
+  void UpdateColumns(int width, int height);
+  void MinColumns(const std::uint16_t* band, std::size_t width,
+      std::size_t rows, std::size_t beg, std::size_t end);
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  int scan_rows_;
+  int scan_offset_;
+  float range_min_;
+  float range_max_;
+  std::size_t bins_;
+
+  // per depth size: the first row of band, and the angles
+  int columns_width_;
+  int columns_height_;
+  int first_row_;
+  float angle_min_;
+  float angle_max_;
+  float angle_increment_;
+  // per depth column: the bin, the meters of one depth unit, and the min
+  // depth of range_min
+  std::vector<std::uint32_t> col_bins_;
+  std::vector<float> col_factors_;
+  std::vector<std::uint16_t> col_min_depths_;
+  // per frame: the min depth of columns, 0 if none
+  std::vector<std::uint16_t> col_mins_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_LASER_SCAN_H_
@@ -0,0 +1,102 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_NORMAL_ESTIMATION_H_
+#define MYNTEYE_POINTCLOUD_NORMAL_ESTIMATION_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup datatypes
+ * The normals of one depth frame, reused among frames.
+ */
+struct MYNTEYE_API NormalMap {
+  /** The depth size */
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  /** The frame id and timestamp of depth */
+  int frame_id = 0;
+  std::uint64_t timestamp = 0;
+
+  /**
+   * The unit normals nx ny nz of pixels, towards the camera. NaN if the
+   * neighborhood is invalid or across a depth edge, also the borders.
+   */
+  std::vector<float> normals;
+};
+
+/**
+ * Estimate the surface normals from DEPTH_RAW.
+ *
+ * The normal of a pixel is the cross product of the central differences of
+ * points along the image rows and columns, by the precomputed rays. So no
+ * point cloud is needed, and the rows run in parallel.
+ */
+class MYNTEYE_API NormalEstimation {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit NormalEstimation(std::size_t threads = 0);
+  ~NormalEstimation();
+
+  /**
+   * Set the intrinsics of depth, the rectified left camera. If depth size is
+   * not the intrinsics size, e.g. decimated, the intrinsics are scaled.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /** Set the pixels from the center to the differenced, 2 by default. */
+  void SetRadius(int radius);
+  /**
+   * Set the max depth change of one pixel step, relative to the center depth,
+   * 0.02 by default. The neighbors beyond are of other surfaces.
+   */
+  void SetMaxDepthChange(float factor);
+
+  /** Compute the normals of depth. */
+  bool Compute(const Image::pointer& depth, NormalMap* normals);
+
+ private:
+  void UpdateRays(int width, int height);
+  void ComputeRows(const std::uint16_t* depth, float* normals,
+      std::size_t beg, std::size_t end);
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  int radius_;
+  float max_depth_change_;
+
+  // the rays x = (u - cx) / fx, y = (v - cy) / fy, per depth size
+  int rays_width_;
+  int rays_height_;
+  std::vector<float> rays_x_;
+  std::vector<float> rays_y_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_NORMAL_ESTIMATION_H_
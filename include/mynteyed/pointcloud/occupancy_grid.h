@@ -0,0 +1,151 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_OCCUPANCY_GRID_H_
+#define MYNTEYE_POINTCLOUD_OCCUPANCY_GRID_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+// The cell values, the same as nav_msgs/OccupancyGrid if read as int8
+#define MYNTEYE_OCCUPANCY_FREE 0
+#define MYNTEYE_OCCUPANCY_OCCUPIED 100
+#define MYNTEYE_OCCUPANCY_UNKNOWN 255
+
+/**
+ * @ingroup datatypes
+ * The 2D occupancy grid of one depth frame, reused among frames.
+ */
+struct MYNTEYE_API OccupancyGridData {
+  /** The cells along x and y of base */
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  /** The meters of one cell */
+  float resolution = 0;
+  /** The meters of the cell (0, 0) corner in base */
+  float origin_x = 0;
+  float origin_y = 0;
+  /** The frame id and timestamp of depth */
+  int frame_id = 0;
+  std::uint64_t timestamp = 0;
+
+  /** The MYNTEYE_OCCUPANCY_* values, cell (x, y) at y * width + x */
+  std::vector<std::uint8_t> cells;
+};
+
+/**
+ * Project DEPTH_RAW into a 2D occupancy grid on the ground, e.g. for
+ * navigation.
+ *
+ * The base frame is x forward, y left and z up. Each depth pixel is
+ * transformed into base and binned into its cell in one pass, no point cloud
+ * is generated. The points of the height range are counted as obstacles, the
+ * ones below as the floor. A cell is occupied if the obstacles are enough,
+ * free if only seen, otherwise unknown. The rows run in parallel.
+ */
+class MYNTEYE_API OccupancyGrid {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit OccupancyGrid(std::size_t threads = 0);
+  ~OccupancyGrid();
+
+  /**
+   * Set the intrinsics of depth, the rectified left camera. If depth size is
+   * not the intrinsics size, e.g. decimated, the intrinsics are scaled.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /**
+   * Set the pose of camera in base, the translation is in millimeters. The
+   * camera is level at the base origin by default.
+   */
+  void SetMountPose(const Extrinsics& camera_to_base);
+
+  /**
+   * Set the grid: the meters of one cell, the cells along x and y, and the
+   * meters of the cell (0, 0) corner. 0.05 m, 100 x 100 cells from (0, -2.5)
+   * by default, that is 5 m ahead and 2.5 m to each side.
+   */
+  void SetGrid(float resolution, std::uint32_t width, std::uint32_t height,
+      float origin_x, float origin_y);
+
+  /** Set the height range of obstacles in base, 0.1 ~ 1.5 m by default. */
+  void SetHeightRange(float min_height, float max_height);
+  /** Set the min points of an occupied cell, 3 by default. */
+  void SetMinPoints(std::uint32_t min_points);
+
+  /**
+   * Align the base z to the gravity by the accelerometer, then only the yaw
+   * of mount pose is used. Feed it the motion datas if enabled.
+   */
+  void SetGravityAligned(bool enabled);
+  /** Set the rotation from IMU to camera, identity by default. */
+  void SetMotionExtrinsics(const MotionExtrinsics& extrinsics);
+  /** Feed the accelerometer datas, the others are ignored. */
+  void OnMotionData(const MotionData& data);
+
+  /** Project depth into the grid. */
+  bool Compute(const Image::pointer& depth, OccupancyGridData* grid);
+
+ private:
+  void UpdateTerms(int width, int height);
+  void CountRows(const std::uint16_t* depth, std::uint32_t* counts,
+      std::size_t beg, std::size_t end);
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  double camera_to_base_[3][3];
+  double translation_[3];  // meters
+
+  float resolution_;
+  std::uint32_t grid_width_;
+  std::uint32_t grid_height_;
+  float origin_x_;
+  float origin_y_;
+  float min_height_;
+  float max_height_;
+  std::uint32_t min_points_;
+
+  bool gravity_aligned_;
+  double imu_to_camera_[3][3];
+  // the low-passed accelerometer, in IMU
+  double accel_[3];
+  bool has_accel_;
+  std::mutex motion_mutex_;
+
+  // per frame: the point in base of depth d at pixel (u, v), k = 0..2:
+  //   p_k = d * (col_terms_[k][u] + row_terms_[k][v]) + translation_[k]
+  std::vector<float> col_terms_[3];
+  std::vector<float> row_terms_[3];
+
+  // the counts of floor and obstacles of cells, per chunk of rows
+  std::vector<std::uint32_t> counts_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_OCCUPANCY_GRID_H_
@@ -0,0 +1,166 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_POINT_CLOUD_H_
+#define MYNTEYE_POINTCLOUD_POINT_CLOUD_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/types.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup enumerations
+ * @brief The memory layout of points.
+ */
+enum class PointCloudLayout : std::uint8_t {
+  /** x0 y0 z0 x1 y1 z1 ... */
+  INTERLEAVED = 0,
+  /** x0 x1 ... y0 y1 ... z0 z1 ..., structure of arrays */
+  PLANAR = 1,
+  /**
+   * x0 y0 z0 rgb0 x1 ..., the rgb is packed in float as PCL and ROS, 0 if no
+   * color
+   */
+  XYZRGB = 2,
+};
+
+/**
+ * @ingroup datatypes
+ * The points of one depth frame, reused among frames.
+ */
+struct MYNTEYE_API PointCloudData {
+  /** Organized: the depth size; compacted: count x 1 */
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  /** Organized or not, the invalid points are NaN if organized */
+  bool organized = true;
+  PointCloudLayout layout = PointCloudLayout::INTERLEAVED;
+  /** The count of points */
+  std::size_t count = 0;
+  /** The frame id and timestamp of depth */
+  int frame_id = 0;
+  std::uint64_t timestamp = 0;
+
+  /** The coordinates in meters, in layout */
+  std::vector<float> xyz;
+  /** The colors r g b of points, empty if no color or XYZRGB */
+  std::vector<std::uint8_t> rgb;
+  /** The pixel index (y * depth width + x) of points, if compacted */
+  std::vector<std::uint32_t> indices;
+
+  bool has_color() const { return !rgb.empty(); }
+
+  /** The stride of one coordinate array, in floats. */
+  std::size_t stride() const {
+    return layout == PointCloudLayout::PLANAR ? 1 :
+        (layout == PointCloudLayout::XYZRGB ? 4 : 3);
+  }
+  const float* x() const { return xyz.data(); }
+  const float* y() const {
+    return xyz.data() + (layout == PointCloudLayout::PLANAR ? count : 1);
+  }
+  const float* z() const {
+    return xyz.data() + (layout == PointCloudLayout::PLANAR ? 2 * count : 2);
+  }
+};
+
+/**
+ * Generate point clouds from DEPTH_RAW.
+ *
+ * The rays of pixels are precomputed from the intrinsics, per depth size. So
+ * one point is only two muls, without division. The rows run in parallel.
+ */
+class MYNTEYE_API PointCloud {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit PointCloud(std::size_t threads = 0);
+  ~PointCloud();
+
+  /**
+   * Set the intrinsics of depth, the rectified left camera. If depth size is
+   * not the intrinsics size, e.g. decimated, the intrinsics are scaled.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /** Set the meters of one depth unit, 0.001 by default. */
+  void SetDepthScale(float scale);
+  void SetLayout(const PointCloudLayout& layout);
+  /** Set organized or compacted, organized by default. */
+  void SetOrganized(bool organized);
+
+  /**
+   * Generate points from depth, with color if given.
+   *
+   * The color should be aligned to depth and of the same size, in any color
+   * format.
+   */
+  bool Generate(const Image::pointer& depth, PointCloudData* points,
+      const Image::pointer& color = nullptr);
+
+  /**
+   * Generate points into data directly, e.g. the buffer of a message, without
+   * copies. data should hold the points of the whole depth size, in layout,
+   * so do indices if compacted and given. The color is only of XYZRGB.
+   *
+   * @param count the count of points generated.
+   */
+  bool Generate(const Image::pointer& depth, float* data, std::size_t* count,
+      const Image::pointer& color = nullptr,
+      std::uint32_t* indices = nullptr);
+
+ private:
+  struct Output {
+    float* xyz;
+    std::uint8_t* rgb;
+    std::uint32_t* indices;
+    std::size_t count;
+  };
+
+  bool Prepare(const Image::pointer& depth, const Image::pointer& color,
+      Image::pointer* rgb_image, bool* bgr, std::size_t* count);
+  void UpdateRays(int width, int height);
+  void GenerateRows(const std::uint16_t* depth, const std::uint8_t* color,
+      bool bgr, const Output& out, std::size_t beg, std::size_t end);
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  float depth_scale_;
+  PointCloudLayout layout_;
+  bool organized_;
+
+  // the rays x = (u - cx) / fx, y = (v - cy) / fy, per depth size
+  int rays_width_;
+  int rays_height_;
+  std::vector<float> rays_x_;
+  std::vector<float> rays_y_;
+
+  // the first point of each row, if compacted
+  std::vector<std::uint32_t> row_offsets_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_POINT_CLOUD_H_
@@ -0,0 +1,74 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_POINT_CLOUD_CODEC_H_
+#define MYNTEYE_POINTCLOUD_POINT_CLOUD_CODEC_H_
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Encode points compactly for transport and storage, 6 bytes per point, 8
+ * with color, instead of 16 of XYZRGB floats.
+ *
+ * The coordinates are 16-bit fixed-point relative to the center of the
+ * bounding box, in the unit of its half extent / 32767. So the error is half
+ * unit at most, e.g. 0.08 mm of 10 m extent. The colors are RGB565. The
+ * invalid points of organized are not stored, but the run lengths of each
+ * row, alternate invalid and valid, starting with invalid. So organized
+ * points are 65535 wide at most.
+ *
+ * The encoded bytes, little-endian:
+ *   - header: "MPC1", width, height, count, runs, flags (1 organized,
+ *     2 color), frame_id, timestamp, origin xyz and scale, 56 bytes
+ *   - uint16 run lengths, if organized
+ *   - int16 x y z of the valid points
+ *   - uint16 RGB565 of the valid points, if color
+ */
+class MYNTEYE_API PointCloudCodec {
+ public:
+  PointCloudCodec();
+  ~PointCloudCodec();
+
+  /** Encode the colors if any, true by default. */
+  void SetColor(bool enabled);
+
+  /** Encode points of any layout, bytes are reused. */
+  bool Encode(const PointCloudData& points, std::vector<std::uint8_t>* bytes);
+
+  /**
+   * Decode bytes into points, interleaved. The invalid points are NaN if
+   * organized. The colors are in rgb if any. False if the bytes are not of
+   * the size in header or the runs not of width x height.
+   */
+  bool Decode(const std::uint8_t* data, std::size_t size,
+      PointCloudData* points);
+  bool Decode(const std::vector<std::uint8_t>& bytes, PointCloudData* points) {
+    return Decode(bytes.data(), bytes.size(), points);
+  }
+
+ private:
+  bool color_;
+
+  // per frame: the run lengths of rows, if organized
+  std::vector<std::uint16_t> runs_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_POINT_CLOUD_CODEC_H_
@@ -0,0 +1,90 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_POINT_CLOUD_WRITER_H_
+#define MYNTEYE_POINTCLOUD_POINT_CLOUD_WRITER_H_
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * Record points into binary PLY or PCD files, by a background thread.
+ *
+ * The points are queued without copy, the thread writes them by large
+ * buffered writes, then keeps them for Acquire() to reuse. If the queue is
+ * full, the points pushed are dropped, so never stalls the caller.
+ *
+ * The format is by the extension, ".ply" or ".pcd". PLY has x y z, and red
+ * green blue if color, of the valid points only. PCD has x y z, and rgb if
+ * color, of all the points, so keeps organized with NaN.
+ */
+class MYNTEYE_API PointCloudWriter {
+ public:
+  /** max_queue: the points queued at most, 0 means no limit. */
+  explicit PointCloudWriter(std::size_t max_queue = 8);
+  /** Write the queued, then stop. */
+  ~PointCloudWriter();
+
+  /** Write points into the file now, in the caller thread. */
+  static bool Write(const std::string& path, const PointCloudData& points);
+
+  /** Get the points to generate into, the written if any to reuse. */
+  PointCloudData Acquire();
+
+  /** Queue points to write into the file, false if dropped. */
+  bool Push(const std::string& path, PointCloudData&& points);
+
+  /** Block until the queued are written. */
+  void Flush();
+
+  /** The counts of points written, failed to write and dropped. */
+  std::size_t GetWrittenCount();
+  std::size_t GetFailedCount();
+  std::size_t GetDroppedCount();
+
+ private:
+  void Run();
+
+  std::size_t max_queue_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  // notified when the queue is empty and not writing
+  std::condition_variable flushed_;
+
+  bool running_;
+  bool writing_;
+  std::thread thread_;
+
+  std::deque<std::pair<std::string, PointCloudData>> queue_;
+  // the written, kept for reuse
+  std::vector<PointCloudData> free_;
+
+  std::size_t written_count_;
+  std::size_t failed_count_;
+  std::size_t dropped_count_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_POINT_CLOUD_WRITER_H_
@@ -0,0 +1,194 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_TSDF_VOLUME_H_
+#define MYNTEYE_POINTCLOUD_TSDF_VOLUME_H_
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/pointcloud/point_cloud.h"
+#include "mynteyed/types.h"
+
+#if !defined(MYNTEYE_WITH_TSDF)
+# error "TsdfVolume is not built, please rebuild mynteyed with WITH_TSDF=ON"
+#endif
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup datatypes
+ * The triangle mesh extracted from a TSDF volume, in world meters.
+ */
+struct MYNTEYE_API TsdfMesh {
+  /** The x y z of vertices, shared among triangles */
+  std::vector<float> vertices;
+  /** The 3 vertex indices of triangles, counterclockwise seen from outside */
+  std::vector<std::uint32_t> triangles;
+};
+
+/**
+ * Fuse DEPTH_RAW frames into a truncated signed distance volume, e.g. for
+ * local 3D maps.
+ *
+ * The voxels are allocated by blocks of 8 x 8 x 8 in a hash map, only around
+ * the observed surfaces. Each frame allocates the blocks of its truncation
+ * band, then integrates them in parallel, projecting 4 voxels a time. If the
+ * blocks exceed the max, the least recently seen ones are evicted, the
+ * farthest first. The blocks of the frame are never evicted, so if they alone
+ * exceed the max, the farthest new ones are not allocated. The points or mesh
+ * of surfaces are extracted on demand.
+ *
+ * The world frame is of the first pose, the camera frame by default. The pose
+ * is set by the caller, or propagated by the gyroscope between frames.
+ */
+class MYNTEYE_API TsdfVolume {
+ public:
+  /** threads: 0 means the hardware concurrency. */
+  explicit TsdfVolume(std::size_t threads = 0);
+  ~TsdfVolume();
+
+  /**
+   * Set the intrinsics of depth, the rectified left camera. If depth size is
+   * not the intrinsics size, e.g. decimated, the intrinsics are scaled.
+   */
+  void SetIntrinsics(const CameraIntrinsics& intrinsics);
+
+  /**
+   * Set the meters of one voxel, and of the truncation, 0 means 4 voxels.
+   * 0.02 m by default. The volume is reset if changed.
+   */
+  void SetVoxelSize(float voxel_size, float truncation = 0);
+  /** Set the depth range integrated in meters, 0.3 ~ 4 m by default. */
+  void SetDepthRange(float min_depth, float max_depth);
+  /** Set the max weight of voxels, 64 by default, smaller adapts faster. */
+  void SetMaxWeight(float max_weight);
+  /** Set the max blocks kept, 16384 by default, about 4 KB each. */
+  void SetMaxBlocks(std::size_t max_blocks);
+
+  /** Set the pose of camera in world, the translation is in millimeters. */
+  void SetPose(const Extrinsics& camera_to_world);
+  /** Get the pose of camera in world, propagated if any. */
+  Extrinsics GetPose();
+
+  /** Set the rotation from IMU to camera, identity by default. */
+  void SetMotionExtrinsics(const MotionExtrinsics& extrinsics);
+  /**
+   * Feed the gyroscope datas to propagate the rotation of pose till next
+   * frame, the others are ignored.
+   */
+  void OnMotionData(const MotionData& data);
+
+  /** Integrate depth at the pose, then the pose is kept. */
+  bool Integrate(const Image::pointer& depth,
+      const Extrinsics& camera_to_world);
+  /** Integrate depth at the current pose, propagated if any. */
+  bool Integrate(const Image::pointer& depth);
+
+  /** Clear all blocks, the pose is kept. */
+  void Reset();
+  /** The count of blocks allocated. */
+  std::size_t GetBlockCount();
+
+  /** Extract the surface points, unorganized and interleaved. */
+  bool ExtractPoints(PointCloudData* points);
+  /** Extract the surface mesh, by marching tetrahedra. */
+  bool ExtractMesh(TsdfMesh* mesh);
+
+ private:
+  struct Block {
+    // the signed distance of voxels, normalized by truncation, x fastest
+    float tsdf[512];
+    float weight[512];
+    std::int32_t coord[3];
+    std::uint32_t last_frame;  // the frame last seen
+  };
+
+  // the vertex of one mesh edge, the key is of the edge
+  struct EdgeVertex {
+    std::uint64_t key;
+    float p[3];
+  };
+
+  bool IntegrateFrame(const Image::pointer& depth);
+  void UpdateIntrinsics(int width, int height);
+  void PropagatePose();
+  void CollectKeys(const std::uint16_t* depth, std::size_t chunk,
+      std::size_t beg, std::size_t end);
+  void AllocateBlocks();
+  void EvictBlocks(std::size_t count);
+  void IntegrateBlock(const std::uint16_t* depth, Block* block);
+  const Block* FindBlock(std::int32_t x, std::int32_t y, std::int32_t z) const;
+  void ExtractBlockPoints(const Block& block, std::vector<float>* xyz) const;
+  void ExtractBlockMesh(const Block& block,
+      std::vector<EdgeVertex>* vertices) const;
+
+  std::mutex mutex_;
+
+  CameraIntrinsics intrinsics_;
+  bool has_intrinsics_;
+  float voxel_size_;
+  float truncation_;
+  float min_depth_;
+  float max_depth_;
+  float max_weight_;
+  std::size_t max_blocks_;
+
+  // the pose of camera in world, translation in meters
+  double rotation_[3][3];
+  double translation_[3];
+
+  double imu_to_camera_[3][3];
+  // the rotation of camera since the pose, by the gyroscope
+  double delta_[3][3];
+  std::uint64_t gyro_timestamp_;
+  bool has_gyro_;
+  std::mutex motion_mutex_;
+
+  // per frame: the pose of camera in world, and its inverse, as [R|t]
+  float camera_to_world_[3][4];
+  float world_to_camera_[3][4];
+  int frame_id_;
+  std::uint64_t timestamp_;
+
+  // per depth size: the scaled intrinsics
+  int depth_width_;
+  int depth_height_;
+  float fx_, fy_, cx_, cy_;
+
+  // the blocks, indexed by their packed coords; the freed are reused. The
+  // deque keeps them in place while growing
+  std::deque<Block> blocks_;
+  std::vector<std::uint32_t> free_blocks_;
+  std::unordered_map<std::uint64_t, std::uint32_t> block_map_;
+  std::uint32_t frame_count_;
+
+  // per frame: the block keys of chunks, then the blocks seen
+  std::vector<std::vector<std::uint64_t>> chunk_keys_;
+  std::vector<std::uint64_t> keys_;
+  std::vector<std::uint32_t> visible_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_TSDF_VOLUME_H_
@@ -0,0 +1,112 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_POINTCLOUD_VOXEL_GRID_H_
+#define MYNTEYE_POINTCLOUD_VOXEL_GRID_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class ThreadPool;
+
+/**
+ * @ingroup enumerations
+ * @brief The point kept of one voxel.
+ */
+enum class VoxelSelection : std::uint8_t {
+  /** The centroid of points, also the mean color */
+  CENTROID = 0,
+  /** The first point, in the order of points */
+  FIRST = 1,
+};
+
+/**
+ * Downsample points by a voxel grid, one point per occupied voxel.
+ *
+ * The points are split into chunks, each hashes its quantized coordinates
+ * into a partial grid in parallel, then the grids are merged. The voxels are
+ * output in the order of their first points, so the result is stable.
+ */
+class MYNTEYE_API VoxelGrid {
+ public:
+  /** leaf_size: the voxel size in meters; threads: 0 means the hardware
+   * concurrency. */
+  explicit VoxelGrid(float leaf_size = 0.05f,
+      const VoxelSelection& selection = VoxelSelection::CENTROID,
+      std::size_t threads = 0);
+  ~VoxelGrid();
+
+  void SetLeafSize(float leaf_size);
+  void SetSelection(const VoxelSelection& selection);
+
+  /**
+   * Downsample in to out, of the same layout and compacted. The indices of out
+   * are of the first points, if in has indices or is organized.
+   */
+  bool Filter(const PointCloudData& in, PointCloudData* out);
+
+  /**
+   * Downsample in into data directly, e.g. the buffer of a message. data
+   * should hold in.count points of in layout.
+   *
+   * @param count the count of points output.
+   */
+  bool Filter(const PointCloudData& in, float* data, std::size_t* count);
+
+ private:
+  struct Voxel {
+    std::uint64_t key;
+    float sum[3];
+    std::uint32_t rgb_sum[3];
+    std::uint32_t count;
+    std::uint32_t first;  // the index of first point
+  };
+
+  // open addressing, the slots are the indices of voxels
+  struct Grid {
+    std::vector<std::int32_t> slots;
+    std::vector<Voxel> voxels;
+    std::uint32_t mask;
+
+    void Reset(std::size_t capacity);
+    Voxel* Find(std::uint64_t key, bool* inserted);
+  };
+
+  bool Build(const PointCloudData& in);
+  void BuildChunk(const PointCloudData& in, Grid* grid, std::size_t beg,
+      std::size_t end);
+  void Output(const PointCloudData& in, float* data, std::uint8_t* rgb,
+      std::uint32_t* indices);
+
+  std::mutex mutex_;
+
+  float leaf_size_;
+  VoxelSelection selection_;
+
+  // the partial grids of chunks, and the merged
+  std::vector<Grid> grids_;
+  Grid merged_;
+
+  std::shared_ptr<ThreadPool> pool_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_POINTCLOUD_VOXEL_GRID_H_
@@ -20,6 +20,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "mynteyed/device/image.h"
@@ -27,6 +28,10 @@
 
 MYNTEYE_BEGIN_NAMESPACE
 
+class DepthMask;
+class ImagePyramid;
+struct ImageStats;
+
 /**
  * @ingroup datatypes
  * @brief Image information
@@ -147,6 +152,31 @@ struct MYNTEYE_API StreamData {
   std::shared_ptr<Image> img;
   /** Image information */
   std::shared_ptr<ImgInfo> img_info;
+  /** Image pyramid of color, if enabled */
+  std::shared_ptr<ImagePyramid> pyramid;
+  /** Validity mask of depth, if enabled */
+  std::shared_ptr<DepthMask> mask;
+  /** Luma statistics of color, if enabled */
+  std::shared_ptr<ImageStats> stats;
+  /**
+   * Whether unchanged by the change gate, if enabled. Then the data are of
+   * the last changed frame, with the frame id and timestamp of this.
+   */
+  bool unchanged;
+  /** Rectified color, if enabled */
+  std::shared_ptr<Image> rectified;
+
+  StreamData(std::shared_ptr<Image> img = nullptr,
+      std::shared_ptr<ImgInfo> img_info = nullptr,
+      std::shared_ptr<ImagePyramid> pyramid = nullptr,
+      std::shared_ptr<DepthMask> mask = nullptr,
+      std::shared_ptr<ImageStats> stats = nullptr,
+      bool unchanged = false,
+      std::shared_ptr<Image> rectified = nullptr)
+    : img(std::move(img)), img_info(std::move(img_info)),
+      pyramid(std::move(pyramid)), mask(std::move(mask)),
+      stats(std::move(stats)), unchanged(unchanged),
+      rectified(std::move(rectified)) {}
 
   bool operator==(const StreamData& other) const {
     if (img_info && other.img_info) {
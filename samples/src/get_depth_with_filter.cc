@@ -13,6 +13,7 @@
 // limitations under the License.
 #include <iostream>
 #include <functional>
+#include <memory>
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
@@ -74,8 +75,8 @@ int main(int argc, char const* argv[]) {
   }
   util::print_stream_infos(cam, dev_info.index);
 
-  SpatialFilter spat_filter;
-  TemporalFilter temp_filter;
+  auto spat_filter = std::make_shared<SpatialFilter>();
+  auto temp_filter = std::make_shared<TemporalFilter>();
 
   cout << "Open device: " << dev_info.index << ", "
       << dev_info.name << endl << endl;
@@ -109,6 +110,12 @@ int main(int argc, char const* argv[]) {
     params.ir_intensity = 4;
   }
 
+  // Filters run in place on the depth stream, spatial then temporal
+  cam.AddDepthFilter("spatial", spat_filter, 0);
+  cam.AddDepthFilter("temporal", temp_filter, 1);
+  // Filter frame N on a dedicated thread while frame N+1 is captured
+  cam.EnableDepthFilterAsync(2);
+
   cam.Open(params);
 
   cout << endl;
@@ -119,6 +126,8 @@ int main(int argc, char const* argv[]) {
   cout << "Open device success" << endl << endl;
 
   cout << "Press ESC/Q on Windows to terminate" << endl;
+  cout << "Press F on Windows to turn filters on/off" << endl;
+  cout << "Press C on Windows to print time costs of filters" << endl;
 
   DepthRegion depth_region(3);
 
@@ -133,16 +142,6 @@ int main(int argc, char const* argv[]) {
       cv::Mat depth = image_depth.img->To(ImageFormat::DEPTH_RAW)->ToMat();
       // Note: DrawRect will change some depth values to show the rect.
       depth_region.DrawRect(depth);
-      cv::Mat res_org;
-      cv::normalize(depth, res_org, 0, 255, cv::NORM_MINMAX, CV_8UC1);
-#ifdef WITH_OPENCV3
-      // ColormapTypes
-      //   http://docs.opencv.org/master/d3/d50/group__imgproc__colormap.html#ga9a805d8262bcbe273f16be9ea2055a65
-      cv::applyColorMap(res_org, res_org, cv::COLORMAP_JET);
-#endif
-      cv::imshow("depth_before_filter", res_org);
-      spat_filter.ProcessFrame(image_depth.img, image_depth.img);
-      temp_filter.ProcessFrame(image_depth.img, image_depth.img);
       cv::Mat res;
       cv::normalize(depth, res, 0, 255, cv::NORM_MINMAX, CV_8UC1);
 #ifdef WITH_OPENCV3
@@ -150,12 +149,26 @@ int main(int argc, char const* argv[]) {
       //   http://docs.opencv.org/master/d3/d50/group__imgproc__colormap.html#ga9a805d8262bcbe273f16be9ea2055a65
       cv::applyColorMap(res, res, cv::COLORMAP_JET);
 #endif
-      cv::imshow("depth_after_filter", res);
+      cv::imshow(spat_filter->IsEnable() ? "depth_after_filter" :
+          "depth_before_filter", res);
     }
 
     char key = static_cast<char>(cv::waitKey(1));
     if (key == 27 || key == 'q' || key == 'Q') {  // ESC/Q
       break;
+    } else if (key == 'f' || key == 'F') {
+      bool enable = !spat_filter->IsEnable();
+      spat_filter->Enable(enable);
+      temp_filter->Enable(enable);
+      cv::destroyAllWindows();
+    } else if (key == 'c' || key == 'C') {
+      for (auto&& cost : cam.GetDepthFilterCosts()) {
+        cout << cost.name << ": last " << cost.last_ms << " ms, avg "
+            << cost.avg_ms << " ms, count " << cost.count << endl;
+      }
+      auto&& latency = cam.GetDepthFilterLatency();
+      cout << latency.name << ": last " << latency.last_ms << " ms, avg "
+          << latency.avg_ms << " ms, count " << latency.count << endl;
     }
   }
 
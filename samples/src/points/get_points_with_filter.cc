@@ -44,6 +44,12 @@ int main(int argc, char const* argv[]) {
   params.stream_mode = StreamMode::STREAM_1280x720;
   params.ir_intensity = 4;
 
+  // Filters run in place on the depth stream, before the points are generated
+  auto spat_sptr = std::make_shared<SpatialFilter>();
+  auto temp_sptr = std::make_shared<TemporalFilter>();
+  cam.AddDepthFilter("spatial", spat_sptr, 0);
+  cam.AddDepthFilter("temporal", temp_sptr, 1);
+
   cam.Open(params);
 
   std::cout << std::endl;
@@ -52,16 +58,11 @@ int main(int argc, char const* argv[]) {
     return 1;
   }
   std::cout << "Open device success" << std::endl;
-  auto spat_sptr = std::make_shared<SpatialFilter>();
-  auto temp_sptr = std::make_shared<TemporalFilter>();
-  std::vector<std::shared_ptr<BaseFilter>> vec;
-  vec.push_back(spat_sptr);
-  vec.push_back(temp_sptr);
 
   Rate rate(params.framerate);
   util::PCViewer viewer(1280, 720);
   for (;;) {
-    auto cloud = util::get_point_cloud(&cam, CAMERA_FACTOR, vec);
+    auto cloud = util::get_point_cloud(&cam, CAMERA_FACTOR);
     if (cloud) viewer.Update(cloud);
     if (viewer.WasStopped()) break;
     rate.Sleep();
@@ -28,50 +28,64 @@ CameraIntrinsics get_camera_intrinsics(const Camera &camera) {
   return camera.GetStreamIntrinsics(stream_mode).left;
 }
 
+pcl::PointCloud<pcl::PointXYZRGBA>::Ptr to_pcl_point_cloud(
+    const PointCloudData& points) {
+  pcl::PointCloud<pcl::PointXYZRGBA>::Ptr cloud(
+      new pcl::PointCloud<pcl::PointXYZRGBA>);
+  cloud->points.resize(points.count);
+  const float* x = points.x();
+  const float* y = points.y();
+  const float* z = points.z();
+  std::size_t stride = points.stride();
+  for (std::size_t i = 0; i < points.count; i++) {
+    auto&& p = cloud->points[i];
+    p.x = x[i * stride];
+    p.y = y[i * stride];
+    p.z = z[i * stride];
+    if (points.has_color()) {
+      p.r = points.rgb[3 * i];
+      p.g = points.rgb[3 * i + 1];
+      p.b = points.rgb[3 * i + 2];
+    }
+  }
+  cloud->width = points.width;
+  cloud->height = points.height;
+  cloud->is_dense = !points.organized;
+  return cloud;
+}
+
 pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
     Camera *camera, float cam_factor,
     std::vector<std::shared_ptr<BaseFilter>> filters) {
-  static auto cam_in = get_camera_intrinsics(*camera);
-
-  cv::Mat color;
-  auto image_color = camera->GetStreamData(ImageType::IMAGE_LEFT_COLOR);
-  if (image_color.img) {
-    color = image_color.img->To(ImageFormat::COLOR_BGR)->ToMat();
+  // SetIntrinsics rebuilds the rays, so only once, then they are only
+  // rebuilt if the depth size changes
+  static PointCloud generator;
+  static bool has_intrinsics = false;
+  if (!has_intrinsics) {
+    generator.SetIntrinsics(get_camera_intrinsics(*camera));
+    generator.SetOrganized(false);
+    has_intrinsics = true;
   }
+  // reused among frames, without reallocation
+  static PointCloudData points;
 
-  cv::Mat depth;
+  auto image_color = camera->GetStreamData(ImageType::IMAGE_LEFT_COLOR);
   auto image_depth = camera->GetStreamData(ImageType::IMAGE_DEPTH);
-  if (image_depth.img) {
-    depth = image_depth.img->To(ImageFormat::DEPTH_RAW)->ToMat();
-  }
+  if (!image_color.img || !image_depth.img) { return nullptr; }
 
-  if (color.empty() || depth.empty()) { return nullptr; }
+  auto depth = image_depth.img->To(ImageFormat::DEPTH_RAW);
   for (size_t i=0; i< filters.size(); i++) {
-    filters[i]->ProcessFrame(image_depth.img, image_depth.img);
+    filters[i]->ProcessFrame(depth, depth);
   }
 
-  return get_point_cloud(color, depth, cam_in, cam_factor);
+  generator.SetDepthScale(1.f / cam_factor);
+  if (!generator.Generate(depth, &points, image_color.img)) { return nullptr; }
+  return to_pcl_point_cloud(points);
 }
 
 pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
     Camera *camera, float cam_factor) {
-  static auto cam_in = get_camera_intrinsics(*camera);
-
-  cv::Mat color;
-  auto image_color = camera->GetStreamData(ImageType::IMAGE_LEFT_COLOR);
-  if (image_color.img) {
-    color = image_color.img->To(ImageFormat::COLOR_BGR)->ToMat();
-  }
-
-  cv::Mat depth;
-  auto image_depth = camera->GetStreamData(ImageType::IMAGE_DEPTH);
-  if (image_depth.img) {
-    depth = image_depth.img->To(ImageFormat::DEPTH_RAW)->ToMat();
-  }
-
-  if (color.empty() || depth.empty()) { return nullptr; }
-
-  return get_point_cloud(color, depth, cam_in, cam_factor);
+  return get_point_cloud(camera, cam_factor, {});
 }
 
 pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
@@ -82,7 +96,7 @@ pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
   for (int m = 0; m < depth.rows; m++) {
     for (int n = 0; n < depth.cols; n++) {
       std::uint16_t d = depth.ptr<std::uint16_t>(m)[n];
-      if (d == 0) continue;
+      if (!is_depth_valid(d)) continue;
       pcl::PointXYZRGBA p;
       p.z = static_cast<float>(d) / cam_factor;
       p.x = (n - cam_in.cx) * p.z / cam_in.fx;
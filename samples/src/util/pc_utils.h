@@ -22,6 +22,7 @@
 #include <pcl/visualization/pcl_visualizer.h>
 
 #include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/point_cloud.h"
 
 #include "mynteyed/stubs/global.h"
 #include "mynteyed/camera.h"
@@ -36,6 +37,9 @@ pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
 pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
     Camera *camera, float cam_factor = 1000);
 
+pcl::PointCloud<pcl::PointXYZRGBA>::Ptr to_pcl_point_cloud(
+    const PointCloudData& points);
+
 pcl::PointCloud<pcl::PointXYZRGBA>::Ptr get_point_cloud(
     const cv::Mat &rgb, const cv::Mat& depth,
     const CameraIntrinsics& cam_in, float cam_factor);
@@ -25,6 +25,7 @@
 #include <cmath>
 #include <string>
 
+#include "mynteyed/filter/base_filter.h"
 #include "mynteyed/util/files.h"
 #include "mynteyed/util/times.h"
 
@@ -104,13 +105,13 @@ bool PCViewer::WasStopped() const {
 
 void PCViewer::ConvertToPointCloud(
     const cv::Mat &rgb, const cv::Mat& depth, pointcloud_t::Ptr cloud) {
+  MYNTEYE_USE_NAMESPACE
   // loop the mat
   for (int m = 0; m < depth.rows; m++) {
     for (int n = 0; n < depth.cols; n++) {
       // get depth value at (m, n)
       std::uint16_t d = depth.ptr<std::uint16_t>(m)[n];
-      // when d is equal 0 or 4096 means no depth
-      if (d == 0 || d == 4096)
+      if (!is_depth_valid(d))
         continue;
 
       point_t p;
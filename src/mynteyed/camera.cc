@@ -205,6 +205,116 @@ void Camera::SetMotionCallback(motion_callback_t callback, bool async) {
   p_->SetMotionCallback(callback, async);
 }
 
+bool Camera::AddDepthFilter(const std::string& name,
+    std::shared_ptr<BaseFilter> filter, std::size_t location) {
+  return p_->AddDepthFilter(name, filter, location);
+}
+
+bool Camera::DeleteDepthFilter(const std::string& name) {
+  return p_->DeleteDepthFilter(name);
+}
+
+bool Camera::DeleteDepthFilter(std::shared_ptr<BaseFilter> filter) {
+  return p_->DeleteDepthFilter(filter);
+}
+
+std::vector<FilterCost> Camera::GetDepthFilterCosts() const {
+  return p_->GetDepthFilterCosts();
+}
+
+void Camera::EnableDepthFilterAsync(std::size_t max_queued) {
+  p_->EnableDepthFilterAsync(max_queued);
+}
+
+void Camera::DisableDepthFilterAsync() {
+  p_->DisableDepthFilterAsync();
+}
+
+bool Camera::IsDepthFilterAsyncEnabled() const {
+  return p_->IsDepthFilterAsyncEnabled();
+}
+
+FilterCost Camera::GetDepthFilterLatency() const {
+  return p_->GetDepthFilterLatency();
+}
+
+void Camera::EnableImagePyramid(int levels, const ImageFormat& format) {
+  p_->EnableImagePyramid(levels, format);
+}
+
+void Camera::DisableImagePyramid() {
+  p_->DisableImagePyramid();
+}
+
+bool Camera::IsImagePyramidEnabled() const {
+  return p_->IsImagePyramidEnabled();
+}
+
+void Camera::EnableDepthMask(bool confidence) {
+  p_->EnableDepthMask(confidence);
+}
+
+void Camera::DisableDepthMask() {
+  p_->DisableDepthMask();
+}
+
+bool Camera::IsDepthMaskEnabled() const {
+  return p_->IsDepthMaskEnabled();
+}
+
+void Camera::EnableImageStats(const ImageStatsParams& params) {
+  p_->EnableImageStats(params);
+}
+
+void Camera::DisableImageStats() {
+  p_->DisableImageStats();
+}
+
+bool Camera::IsImageStatsEnabled() const {
+  return p_->IsImageStatsEnabled();
+}
+
+void Camera::EnableChangeGate(const ChangeGateParams& params) {
+  p_->EnableChangeGate(params);
+}
+
+void Camera::DisableChangeGate() {
+  p_->DisableChangeGate();
+}
+
+bool Camera::IsChangeGateEnabled() const {
+  return p_->IsChangeGateEnabled();
+}
+
+bool Camera::EnableRectification(const ImageFormat& format, int width,
+    int height) {
+  return p_->EnableRectification(format, width, height);
+}
+
+void Camera::DisableRectification() {
+  p_->DisableRectification();
+}
+
+bool Camera::IsRectificationEnabled() const {
+  return p_->IsRectificationEnabled();
+}
+
+bool Camera::EnableHostDepth(int width, int height) {
+  return p_->EnableHostDepth(width, height);
+}
+
+void Camera::DisableHostDepth() {
+  p_->DisableHostDepth();
+}
+
+bool Camera::IsHostDepthEnabled() const {
+  return p_->IsHostDepthEnabled();
+}
+
+std::shared_ptr<StereoMatcher> Camera::GetHostDepthMatcher() const {
+  return p_->GetHostDepthMatcher();
+}
+
 void Camera::Close() {
   p_->Close();
 }
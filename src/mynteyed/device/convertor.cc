@@ -16,6 +16,7 @@
 #include <algorithm>
 
 #include "mynteyed/util/log.h"
+#include "mynteyed/device/luma_stats.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
@@ -41,7 +42,7 @@ my_error_exit(j_common_ptr cinfo) {
 #endif
 
 int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
-    unsigned char* rgb) {
+    unsigned char* rgb, LumaStats* stats) {
 #ifdef WITH_JPEG
   struct jpeg_decompress_struct cinfo;
   struct my_error_mgr jerr;
@@ -81,6 +82,9 @@ int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
     buffer_array[0] = rgb + (cinfo.output_scanline) * row_stride;
 
     jpeg_read_scanlines(&cinfo, buffer_array, 1);
+    if (stats) {
+      stats->AddColor(cinfo.output_scanline - 1, buffer_array[0], false);
+    }
   }
 
   jpeg_finish_decompress(&cinfo);
@@ -43,8 +43,11 @@ typedef struct my_error_mgr* my_error_ptr;
 
 #endif
 
+class LumaStats;
+
+/** Decode, and accumulate each scanline into stats if not null. */
 extern int MJPEG_TO_RGB_LIBJPEG(unsigned char* jpg, int nJpgSize,
-    unsigned char* rgb);
+    unsigned char* rgb, LumaStats* stats = nullptr);
 
 extern int RGB_TO_RGB_LEFT(unsigned char* orig, unsigned char* left,
     unsigned int width, unsigned int height);
@@ -15,6 +15,7 @@
 
 #include "mynteyed/device/convertor.h"
 #include "mynteyed/device/data_caches.h"
+#include "mynteyed/device/luma_stats.h"
 // #include "mynteyed/internal/image_utils.h"
 #include "mynteyed/util/log.h"
 
@@ -112,6 +113,7 @@ Image::pointer get_cache_image(const Image::pointer& image,
     const ImageFormat& format, int width, int height) {
   auto&& result = Image::Create(image->type(), format, width, height, false);
   result->set_frame_id(image->frame_id());
+  result->set_timestamp(image->timestamp());
   result->set_is_dual(image->is_dual());
   return result;
 }
@@ -121,6 +123,53 @@ Image::pointer get_cache_image(const Image::pointer& image,
   return get_cache_image(image, format, image->width(), image->height());
 }
 
+using yuyv_convert_t = int (*)(unsigned char*, unsigned char*, unsigned int,
+    unsigned int);
+
+// The stats to accumulate of color, of its side if dual, nullptr if not
+// requested or already accumulated
+std::unique_ptr<LumaStats> make_stats(const Image& color) {
+  auto&& params = color.stats_params();
+  if (!params || color.stats()) return nullptr;
+  if (!color.is_dual()) {
+    return std::unique_ptr<LumaStats>(
+        new LumaStats(*params, color.width(), color.height()));
+  }
+  const int side = color.width() / 2;
+  return std::unique_ptr<LumaStats>(new LumaStats(*params, side,
+      color.height(),
+      color.type() == ImageType::IMAGE_RIGHT_COLOR ? side : 0));
+}
+
+// Convert YUYV row by row if the stats are requested, and accumulate each
+// row while it is in cache
+void convert_yuyv(yuyv_convert_t convert, Image& yuyv, Image* dst) {
+  auto&& stats = make_stats(yuyv);
+  if (!stats) {
+    convert(yuyv.data(), dst->data(), yuyv.width(), yuyv.height());
+    dst->set_stats(yuyv.stats());
+    return;
+  }
+  const std::size_t src_stride = yuyv.width() * 2;
+  const std::size_t dst_stride = dst->width() * 3;
+  for (int y = 0; y < yuyv.height(); y++) {
+    std::uint8_t* row = yuyv.data() + y * src_stride;
+    convert(row, dst->data() + y * dst_stride, yuyv.width(), 1);
+    stats->AddLuma(y, row, 2);
+  }
+  dst->set_stats(stats->Finish(yuyv.frame_id(), yuyv.timestamp()));
+}
+
+// Decode MJPG into rgb, and accumulate the stats of the scanlines decoded if
+// requested. Returns the stats, of the side if dual
+std::shared_ptr<ImageStats> decode_mjpg(Image& mjpg, Image* rgb) {
+  auto&& stats = make_stats(mjpg);
+  MJPEG_TO_RGB_LIBJPEG(mjpg.data(), mjpg.valid_size(), rgb->data(),
+      stats.get());
+  return stats ? stats->Finish(mjpg.frame_id(), mjpg.timestamp()) :
+      mjpg.stats();
+}
+
 }  // namespace
 
 Image::Image(const ImageType& type, const ImageFormat& format,
@@ -132,6 +181,7 @@ Image::Image(const ImageType& type, const ImageFormat& format,
     is_buffer_(is_buffer),
     raw_format_(format),
     frame_id_(0),
+    timestamp_(0),
     is_dual_(false) {
   static bool is_cache_proper_sizes_set = false;
   if (!is_cache_proper_sizes_set) {
@@ -167,6 +217,18 @@ void Image::set_valid_size(std::size_t valid_size) {
   valid_size_ = valid_size;
 }
 
+bool Image::Reshape(int width, int height) {
+  std::size_t n = get_image_size(format_, width, height);
+  if (n > data_size()) {
+    LOGW("Reshape image, but it's larger then data size.");
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  valid_size_ = n;
+  return true;
+}
+
 #ifdef WITH_OPENCV
 cv::Mat Image::ToMat() {
   return cv::Mat(height_, width_, get_mat_type(format_), data());
@@ -176,8 +238,20 @@ cv::Mat Image::ToMat() {
 Image::pointer Image::Clone() const {
   auto image = Create(type_, format_, width_, height_, false);
   image->set_frame_id(frame_id_);
+  image->set_timestamp(timestamp_);
   image->set_is_dual(is_dual_);
   image->set_valid_size(valid_size_);
+  image->stats_params_ = stats_params_;
+  image->stats_ = stats_;
+  image->stats_left_ = stats_left_;
+  image->stats_right_ = stats_right_;
+  // Accumulate the stats in the copy, as the capture may not be converted
+  std::shared_ptr<ImageStats> left, right;
+  if (stats_params_ && !stats_ && copy_with_stats(*this, *stats_params_,
+      image->data(), &left, &right)) {
+    image->set_stats_sides(left, right);
+    return image;
+  }
   // The valid size of some compress format will much smaller, e.g. MJPG.
   // Therefore, we could only copy valid data to another.
   std::copy(data_->begin(), data_->begin() + valid_size_,
@@ -185,11 +259,38 @@ Image::pointer Image::Clone() const {
   return image;
 }
 
+bool Image::AccumulateStats() {
+  std::shared_ptr<ImageStats> left, right;
+  if (!stats_params_ || stats_ || !copy_with_stats(*this, *stats_params_,
+      nullptr, &left, &right)) {
+    return false;
+  }
+  set_stats_sides(left, right);
+  return true;
+}
+
+void Image::set_stats_sides(const std::shared_ptr<ImageStats>& left,
+    const std::shared_ptr<ImageStats>& right) {
+  if (is_dual_) {
+    stats_left_ = left;
+    stats_right_ = right;
+    stats_ = type_ == ImageType::IMAGE_RIGHT_COLOR ? right : left;
+  } else {
+    stats_ = left;
+  }
+}
+
 Image::pointer Image::Shadow(const ImageType& type) const {
   auto image = Create(type, format_, width_, height_, false);
   image->set_frame_id(frame_id_);
+  image->set_timestamp(timestamp_);
   image->set_is_dual(is_dual_);
   image->set_valid_size(valid_size_);
+  image->stats_params_ = stats_params_;
+  image->stats_ = !is_dual_ ? stats_ :
+      (type == ImageType::IMAGE_RIGHT_COLOR ? stats_right_ : stats_left_);
+  image->stats_left_ = stats_left_;
+  image->stats_right_ = stats_right_;
   // Set data to this
   image->data_ = data_;
   return image;
@@ -272,32 +373,34 @@ Image::pointer ImageColor::To(const ImageFormat& format) {
         auto image = get_cache_image(shared_from_this(), format,
             width_ / 2, height_);
         image->set_is_dual(false);
+        yuyv_convert_t convert;
         if (format == ImageFormat::COLOR_RGB) {
           if (type_ == ImageType::IMAGE_LEFT_COLOR) {
-            YUYV_TO_RGB_LEFT(data(), image->data(), width_, height_);
+            convert = YUYV_TO_RGB_LEFT;
           } else if (type_ == ImageType::IMAGE_RIGHT_COLOR) {
-            YUYV_TO_RGB_RIGHT(data(), image->data(), width_, height_);
+            convert = YUYV_TO_RGB_RIGHT;
           } else {
             goto to_fail;
           }
         } else if (format == ImageFormat::COLOR_BGR) {
           if (type_ == ImageType::IMAGE_LEFT_COLOR) {
-            YUYV_TO_BGR_LEFT(data(), image->data(), width_, height_);
+            convert = YUYV_TO_BGR_LEFT;
           } else if (type_ == ImageType::IMAGE_RIGHT_COLOR) {
-            YUYV_TO_BGR_RIGHT(data(), image->data(), width_, height_);
+            convert = YUYV_TO_BGR_RIGHT;
           } else {
             goto to_fail;
           }
         } else {
           goto to_fail;
         }
+        convert_yuyv(convert, *this, image.get());
         return image;
       } else {
         auto image = get_cache_image(shared_from_this(), format);
         if (format == ImageFormat::COLOR_RGB) {
-          YUYV_TO_RGB(data(), image->data(), width_, height_);
+          convert_yuyv(YUYV_TO_RGB, *this, image.get());
         } else if (format == ImageFormat::COLOR_BGR) {
-          YUYV_TO_BGR(data(), image->data(), width_, height_);
+          convert_yuyv(YUYV_TO_BGR, *this, image.get());
         } else {
           goto to_fail;
         }
@@ -308,7 +411,7 @@ Image::pointer ImageColor::To(const ImageFormat& format) {
       if (format == ImageFormat::COLOR_RGB) {
         auto image = get_cache_image(shared_from_this(),
             ImageFormat::COLOR_RGB);
-        MJPEG_TO_RGB_LIBJPEG(data(), valid_size_, image->data());
+        auto&& stats = decode_mjpg(*this, image.get());
         if (is_dual_) {
           auto half = get_cache_image(shared_from_this(),
               ImageFormat::COLOR_RGB, width_ / 2, height_);
@@ -320,14 +423,16 @@ Image::pointer ImageColor::To(const ImageFormat& format) {
           } else {
             goto to_fail;
           }
+          half->set_stats(stats);
           return half;  // left or right
         }
+        image->set_stats(stats);
         return image;  // left only
       } else if (format == ImageFormat::COLOR_BGR) {
         // return To(ImageFormat::COLOR_RGB)->To(ImageFormat::COLOR_BGR);
         auto image = get_cache_image(shared_from_this(),
             ImageFormat::COLOR_RGB);
-        MJPEG_TO_RGB_LIBJPEG(data(), valid_size_, image->data());
+        auto&& stats = decode_mjpg(*this, image.get());
         if (is_dual_) {
           auto half = get_cache_image(shared_from_this(),
               ImageFormat::COLOR_BGR, width_ / 2, height_);
@@ -340,8 +445,10 @@ Image::pointer ImageColor::To(const ImageFormat& format) {
           } else {
             goto to_fail;
           }
+          half->set_stats(stats);
           return half;  // left or right
         }
+        image->set_stats(stats);
         return image->To(ImageFormat::COLOR_BGR);  // left only
       }
       break;
@@ -0,0 +1,185 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/device/luma_stats.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mynteyed/device/image.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace {
+
+// The RGB to luma of BT.601, in Q8, as the gray of imgproc
+inline int luma_of(int r, int g, int b) {
+  return (r * 77 + g * 150 + b * 29 + 128) >> 8;
+}
+
+}  // namespace
+
+LumaStats::LumaStats(const ImageStatsParams& params, int width, int height,
+    int x_offset)
+  : width_(width), height_(height), x_offset_(x_offset),
+    saturation_(params.saturation),
+    tiles_x_(std::max(std::min(params.tiles_x, width), 0)),
+    tiles_y_(std::max(std::min(params.tiles_y, height), 0)),
+    hists_(4 * 256, 0) {
+  if (tiles_x_ == 0 || tiles_y_ == 0) {
+    tiles_x_ = tiles_y_ = 0;
+    return;
+  }
+  tile_cols_.resize(tiles_x_ + 1);
+  for (int t = 0; t <= tiles_x_; t++) {
+    tile_cols_[t] = t * width_ / tiles_x_;
+  }
+  tile_sums_.assign(tiles_x_ * tiles_y_, 0);
+  tile_rows_.assign(tiles_y_, 0);
+}
+
+template <typename Luma>
+void LumaStats::AddRow(int y, Luma luma) {
+  std::uint32_t* h = hists_.data();
+  if (tile_sums_.empty()) {
+    int x = 0;
+    for (; x + 4 <= width_; x += 4) {
+      ++h[luma(x)];
+      ++h[256 + luma(x + 1)];
+      ++h[512 + luma(x + 2)];
+      ++h[768 + luma(x + 3)];
+    }
+    for (; x < width_; x++) {
+      ++h[luma(x)];
+    }
+    return;
+  }
+  const int tile_y = y * tiles_y_ / height_;
+  std::uint64_t* sums = tile_sums_.data() + tile_y * tiles_x_;
+  ++tile_rows_[tile_y];
+  for (int t = 0; t < tiles_x_; t++) {
+    std::uint32_t sum = 0;
+    int x = tile_cols_[t];
+    const int end = tile_cols_[t + 1];
+    for (; x + 4 <= end; x += 4) {
+      const int v0 = luma(x), v1 = luma(x + 1);
+      const int v2 = luma(x + 2), v3 = luma(x + 3);
+      ++h[v0];
+      ++h[256 + v1];
+      ++h[512 + v2];
+      ++h[768 + v3];
+      sum += v0 + v1 + v2 + v3;
+    }
+    for (; x < end; x++) {
+      int v = luma(x);
+      ++h[v];
+      sum += v;
+    }
+    sums[t] += sum;
+  }
+}
+
+void LumaStats::AddLuma(int y, const std::uint8_t* row, int step) {
+  const std::uint8_t* p = row + x_offset_ * step;
+  AddRow(y, [p, step](int x) { return p[x * step]; });
+}
+
+void LumaStats::AddColor(int y, const std::uint8_t* row, bool bgr) {
+  const std::uint8_t* p = row + x_offset_ * 3;
+  if (bgr) {
+    AddRow(y, [p](int x) {
+      return luma_of(p[3 * x + 2], p[3 * x + 1], p[3 * x]);
+    });
+  } else {
+    AddRow(y, [p](int x) {
+      return luma_of(p[3 * x], p[3 * x + 1], p[3 * x + 2]);
+    });
+  }
+}
+
+std::shared_ptr<ImageStats> LumaStats::Finish(int frame_id,
+    std::uint64_t timestamp) const {
+  auto stats = std::make_shared<ImageStats>();
+  std::uint64_t count = 0, sum = 0, saturated = 0;
+  for (int i = 0; i < 256; i++) {
+    std::uint32_t n = hists_[i] + hists_[256 + i] + hists_[512 + i] +
+        hists_[768 + i];
+    stats->histogram[i] = n;
+    count += n;
+    sum += static_cast<std::uint64_t>(n) * i;
+    if (i >= saturation_) saturated += n;
+  }
+  stats->count = static_cast<std::uint32_t>(count);
+  if (count > 0) {
+    stats->mean = static_cast<float>(static_cast<double>(sum) / count);
+    stats->saturated =
+        static_cast<float>(static_cast<double>(saturated) / count);
+  }
+  stats->tiles_x = tiles_x_;
+  stats->tiles_y = tiles_y_;
+  stats->tile_means.resize(tile_sums_.size(), 0.f);
+  for (int ty = 0; ty < tiles_y_; ty++) {
+    for (int tx = 0; tx < tiles_x_; tx++) {
+      std::uint64_t n = static_cast<std::uint64_t>(tile_rows_[ty]) *
+          (tile_cols_[tx + 1] - tile_cols_[tx]);
+      if (n == 0) continue;
+      const int i = ty * tiles_x_ + tx;
+      stats->tile_means[i] = static_cast<float>(
+          static_cast<double>(tile_sums_[i]) / n);
+    }
+  }
+  stats->frame_id = frame_id;
+  stats->timestamp = timestamp;
+  return stats;
+}
+
+bool copy_with_stats(const Image& color, const ImageStatsParams& params,
+    std::uint8_t* dst, std::shared_ptr<ImageStats>* left,
+    std::shared_ptr<ImageStats>* right) {
+  const ImageFormat format = color.format();
+  int bpp;
+  if (format == ImageFormat::COLOR_YUYV) {
+    bpp = 2;
+  } else if (format == ImageFormat::COLOR_RGB ||
+      format == ImageFormat::COLOR_BGR) {
+    bpp = 3;
+  } else {
+    return false;
+  }
+  const bool dual = color.is_dual();
+  const int width = color.width();
+  const int height = color.height();
+  const int side = dual ? width / 2 : width;
+  LumaStats left_stats(params, side, height);
+  LumaStats right_stats(params, dual ? side : 0, dual ? height : 0, side);
+  const std::size_t stride = static_cast<std::size_t>(width) * bpp;
+  const bool bgr = format == ImageFormat::COLOR_BGR;
+
+  for (int y = 0; y < height; y++) {
+    const std::uint8_t* row = color.data() + y * stride;
+    if (dst) std::memcpy(dst + y * stride, row, stride);
+    if (bpp == 2) {
+      left_stats.AddLuma(y, row, 2);
+      if (dual) right_stats.AddLuma(y, row, 2);
+    } else {
+      left_stats.AddColor(y, row, bgr);
+      if (dual) right_stats.AddColor(y, row, bgr);
+    }
+  }
+  *left = left_stats.Finish(color.frame_id(), color.timestamp());
+  *right = dual ? right_stats.Finish(color.frame_id(), color.timestamp()) :
+      nullptr;
+  return true;
+}
+
+MYNTEYE_END_NAMESPACE
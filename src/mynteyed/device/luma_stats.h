@@ -0,0 +1,79 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_DEVICE_LUMA_STATS_H_
+#define MYNTEYE_DEVICE_LUMA_STATS_H_
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "mynteyed/device/image_stats.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+class Image;
+
+/**
+ * Accumulate the luma statistics of a frame row by row, in the pixel pass
+ * which has the row in cache, so no other read of the frame.
+ */
+class LumaStats {
+ public:
+  /** Of the columns [x_offset, x_offset + width) of the rows. */
+  LumaStats(const ImageStatsParams& params, int width, int height,
+      int x_offset = 0);
+
+  /** Add row y of the luma of every step bytes, e.g. 2 of YUYV. */
+  void AddLuma(int y, const std::uint8_t* row, int step);
+  /** Add row y of RGB or BGR, by its luma of BT.601. */
+  void AddColor(int y, const std::uint8_t* row, bool bgr);
+
+  std::shared_ptr<ImageStats> Finish(int frame_id,
+      std::uint64_t timestamp) const;
+
+ private:
+  template <typename Luma>
+  void AddRow(int y, Luma luma);
+
+  int width_;
+  int height_;
+  int x_offset_;
+  std::uint8_t saturation_;
+  int tiles_x_;
+  int tiles_y_;
+
+  // 4 histograms by the column, so the repeated luma of the neighbours do
+  // not wait on the same counter
+  std::vector<std::uint32_t> hists_;
+  // the first column of each tile, then width, the sums of tiles, and the
+  // rows of tile rows
+  std::vector<int> tile_cols_;
+  std::vector<std::uint64_t> tile_sums_;
+  std::vector<int> tile_rows_;
+};
+
+/**
+ * Copy the rows of color, YUYV, RGB or BGR, into dst, and accumulate the
+ * stats of the color, or of its left and right if dual, as the capture
+ * copy. dst nullptr means only accumulate. False if other formats, nothing
+ * copied.
+ */
+bool copy_with_stats(const Image& color, const ImageStatsParams& params,
+    std::uint8_t* dst, std::shared_ptr<ImageStats>* left,
+    std::shared_ptr<ImageStats>* right);
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_DEVICE_LUMA_STATS_H_
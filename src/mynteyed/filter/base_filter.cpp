@@ -13,11 +13,23 @@
 // limitations under the License.
 
 #include "mynteyed/filter/base_filter.h"
+#include "mynteyed/filter/depth_mask.h"
 
 MYNTEYE_USE_NAMESPACE
 
 BaseFilter::BaseFilter() : _is_enable(false) {}
 
+bool BaseFilter::ProcessFrameMask(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in,
+    DepthMask* mask, bool pack_bits) {
+  bool processed = ProcessFrame(out, in);
+  if (mask && pack_bits) {
+    mask->Pack(processed ? out : in);
+  }
+  return processed;
+}
+
 bool BaseFilter::LoadConfig(void* data) {
   std::cout << "config data: ";
   uint16_t *out_put_data = (uint16_t *)data;  // NOLINT
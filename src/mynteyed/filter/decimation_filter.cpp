@@ -0,0 +1,326 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "mynteyed/filter/decimation_filter.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+// The scale of downsampling
+const uint8_t scale_min_val = 2;
+const uint8_t scale_max_val = 4;
+
+// The value of invalid pixels while reducing min, larger than all depths
+const uint16_t min_invalid_val = 0x7fff;
+
+namespace {
+
+inline uint8_t clamp_scale(uint8_t scale) {
+  return std::min(std::max(scale, scale_min_val), scale_max_val);
+}
+
+inline uint16_t min_mapped(uint16_t depth) {
+  return (is_depth_valid(depth) && depth < 0x8000) ? depth : min_invalid_val;
+}
+
+#ifdef MYNTEYE_SIMD_SSE2
+// The compare-exchanges of Batcher's odd-even merge sort of n values. The
+// ones with padding beyond n are dropped, as the padding is always the max.
+std::vector<std::pair<uint8_t, uint8_t>> sort_network(size_t n) {
+  size_t m = 1;
+  while (m < n) m <<= 1;
+  std::vector<std::pair<uint8_t, uint8_t>> net;
+  for (size_t p = 1; p < m; p <<= 1) {
+    for (size_t k = p; k >= 1; k >>= 1) {
+      for (size_t j = k % p; j + k < m; j += 2 * k) {
+        for (size_t i = 0; i < k && i + j + k < n; i++) {
+          if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+            net.emplace_back(i + j, i + j + k);
+          }
+        }
+      }
+    }
+  }
+  return net;
+}
+
+inline void sort2(__m128i& a, __m128i& b) {
+  __m128i t = a;
+  a = _mm_min_epi16(t, b);
+  b = _mm_max_epi16(t, b);
+}
+
+// even and odd lanes of a and b, as signed values
+inline void deinterleave(const __m128i& a, const __m128i& b,
+    __m128i& even, __m128i& odd) {
+  even = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+      _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+  odd = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+
+// min of each pair of 16 lanes, to 8 lanes
+inline __m128i pair_min(const __m128i& a, const __m128i& b) {
+  const __m128i low = _mm_set1_epi32(0xffff);
+  __m128i ma = _mm_and_si128(
+      simd::min_u15(a, _mm_srli_epi32(a, 16)), low);
+  __m128i mb = _mm_and_si128(
+      simd::min_u15(b, _mm_srli_epi32(b, 16)), low);
+  return _mm_packs_epi32(ma, mb);
+}
+#endif
+
+}  // namespace
+
+DecimationFilter::DecimationFilter(std::uint8_t scale, DecimationMode mode)
+  : _scale(clamp_scale(scale)), _mode(mode) {
+  TurnOn();
+}
+
+bool DecimationFilter::LoadConfig(void* data) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint8_t* mem_ptr = reinterpret_cast<uint8_t*>(data);
+  _scale = clamp_scale(*mem_ptr);
+  _mode = static_cast<DecimationMode>(*(mem_ptr + 1));
+  return true;
+}
+
+CameraIntrinsics DecimationFilter::ScaleIntrinsics(
+    const CameraIntrinsics& in) const {
+  CameraIntrinsics out = in;
+  double s = 1.0 / _scale;
+  // pixel centers: (x + 0.5) / scale - 0.5
+  out.width = in.width / _scale;
+  out.height = in.height / _scale;
+  out.fx = in.fx * s;
+  out.fy = in.fy * s;
+  out.cx = (in.cx + 0.5) * s - 0.5;
+  out.cy = (in.cy + 0.5) * s - 0.5;
+  // the first two rows of 3x4 projection matrix
+  for (int i = 0; i < 8; i++) {
+    out.p[i] = in.p[i] * s;
+  }
+  out.p[2] = (in.p[2] + 0.5) * s - 0.5;
+  out.p[6] = (in.p[6] + 0.5) * s - 0.5;
+  return out;
+}
+
+void DecimationFilter::reduce_row_min(const std::uint16_t* src, size_t width,
+    std::uint16_t* dst, size_t out_width) {
+  const size_t scale = _scale;
+  uint16_t* col = _col_min.data();
+
+  // vertical min of the block rows
+  size_t x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i invalid = _mm_set1_epi16(min_invalid_val);
+  for (; x + 8 <= width; x += 8) {
+    __m128i m = invalid;
+    for (size_t k = 0; k < scale; k++) {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + k * width + x));
+      // >= 0x8000 also invalid, as signed min
+      __m128i mask = _mm_or_si128(simd::depth_invalid_mask(v),
+          _mm_cmplt_epi16(v, _mm_setzero_si128()));
+      v = simd::select(mask, invalid, v);
+      m = simd::min_u15(m, v);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(col + x), m);
+  }
+#endif
+  for (; x < width; x++) {
+    uint16_t m = min_invalid_val;
+    for (size_t k = 0; k < scale; k++) {
+      m = std::min(m, min_mapped(src[k * width + x]));
+    }
+    col[x] = m;
+  }
+
+  // horizontal min of the block columns
+  size_t ox = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i* c = reinterpret_cast<const __m128i*>(col);
+  if (scale == 2) {
+    for (; ox + 8 <= out_width; ox += 8) {
+      __m128i r = pair_min(_mm_loadu_si128(c + ox / 4),
+          _mm_loadu_si128(c + ox / 4 + 1));
+      r = _mm_andnot_si128(_mm_cmpeq_epi16(r, invalid), r);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + ox), r);
+    }
+  } else if (scale == 4) {
+    for (; ox + 8 <= out_width; ox += 8) {
+      const __m128i* b = c + ox / 2;
+      __m128i r = pair_min(
+          pair_min(_mm_loadu_si128(b), _mm_loadu_si128(b + 1)),
+          pair_min(_mm_loadu_si128(b + 2), _mm_loadu_si128(b + 3)));
+      r = _mm_andnot_si128(_mm_cmpeq_epi16(r, invalid), r);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + ox), r);
+    }
+  }
+#endif
+  for (; ox < out_width; ox++) {
+    const uint16_t* b = col + ox * scale;
+    uint16_t m = b[0];
+    for (size_t k = 1; k < scale; k++) {
+      m = std::min(m, b[k]);
+    }
+    dst[ox] = (m == min_invalid_val) ? 0 : m;
+  }
+}
+
+void DecimationFilter::reduce_row_median(const std::uint16_t* src,
+    size_t width, std::uint16_t* dst, size_t out_width) {
+  const size_t scale = _scale;
+  size_t ox = 0;
+
+#ifdef MYNTEYE_SIMD_SSE2
+  // 8 blocks in the lanes, each pixel of block in one vector. The depths are
+  // biased to be sorted as signed, and invalid ones are sorted after all.
+  static const std::vector<std::pair<uint8_t, uint8_t>> networks[] = {
+    sort_network(4), sort_network(9), sort_network(16)};
+  const auto& net = networks[scale - scale_min_val];
+  const size_t n = scale * scale;
+  const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  const __m128i ones = _mm_set1_epi16(-1);
+  const __m128i last = _mm_set1_epi16(0x7fff);
+  __m128i v[scale_max_val * scale_max_val];
+  alignas(16) uint16_t t[8];
+
+  for (; ox + 8 <= out_width; ox += 8) {
+    for (size_t k = 0; k < scale; k++) {
+      const uint16_t* p = src + k * width + ox * scale;
+      __m128i* row = v + k * scale;
+      if (scale == 2) {
+        deinterleave(
+            _mm_xor_si128(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(p)), bias),
+            _mm_xor_si128(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(p + 8)), bias),
+            row[0], row[1]);
+      } else if (scale == 4) {
+        __m128i b[4], e[2], o[2];
+        for (int i = 0; i < 4; i++) {
+          b[i] = _mm_xor_si128(_mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(p + 8 * i)), bias);
+        }
+        deinterleave(b[0], b[1], e[0], o[0]);
+        deinterleave(b[2], b[3], e[1], o[1]);
+        deinterleave(e[0], e[1], row[0], row[2]);
+        deinterleave(o[0], o[1], row[1], row[3]);
+      } else {
+        for (size_t i = 0; i < scale; i++) {
+          for (size_t l = 0; l < 8; l++) {
+            t[l] = p[l * scale + i] ^ 0x8000;
+          }
+          row[i] = _mm_load_si128(reinterpret_cast<const __m128i*>(t));
+        }
+      }
+    }
+
+    __m128i count = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i++) {
+      __m128i invalid = simd::depth_invalid_mask(_mm_xor_si128(v[i], bias));
+      count = _mm_sub_epi16(count, _mm_andnot_si128(invalid, ones));
+      v[i] = simd::select(invalid, last, v[i]);
+    }
+    for (const auto& c : net) {
+      sort2(v[c.first], v[c.second]);
+    }
+
+    // lower median at (count - 1) / 2, none matched and 0 if no valid
+    __m128i index = _mm_srli_epi16(_mm_add_epi16(count, ones), 1);
+    __m128i r = bias;
+    for (size_t i = 0; i <= (n - 1) / 2; i++) {
+      __m128i mask = _mm_cmpeq_epi16(index,
+          _mm_set1_epi16(static_cast<int16_t>(i)));
+      r = simd::select(mask, v[i], r);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + ox),
+        _mm_xor_si128(r, bias));
+  }
+#endif
+
+  uint16_t vals[scale_max_val * scale_max_val];
+  for (; ox < out_width; ox++) {
+    // insertion sort of the valid pixels in block
+    size_t n = 0;
+    for (size_t k = 0; k < scale; k++) {
+      const uint16_t* p = src + k * width + ox * scale;
+      for (size_t i = 0; i < scale; i++) {
+        uint16_t d = p[i];
+        if (!is_depth_valid(d)) continue;
+        size_t j = n++;
+        for (; j > 0 && vals[j - 1] > d; j--) {
+          vals[j] = vals[j - 1];
+        }
+        vals[j] = d;
+      }
+    }
+    // lower median, which is one real depth
+    dst[ox] = n ? vals[(n - 1) / 2] : 0;
+  }
+}
+
+void DecimationFilter::process_frame(const std::uint16_t* src,
+    std::uint16_t* dst, size_t width, size_t height) {
+  const size_t out_width = width / _scale;
+  const size_t out_height = height / _scale;
+  _row.resize(out_width);
+  _col_min.resize(width);
+
+  for (size_t oy = 0; oy < out_height; oy++) {
+    const uint16_t* rows = src + oy * _scale * width;
+    if (_mode == DecimationMode::DECIMATION_MIN) {
+      reduce_row_min(rows, width, _row.data(), out_width);
+    } else {
+      reduce_row_median(rows, width, _row.data(), out_width);
+    }
+    // the reduced row never overlaps the rows not read yet
+    std::copy(_row.begin(), _row.end(), dst + oy * out_width);
+  }
+}
+
+bool DecimationFilter::ProcessFrame(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in) {
+  if (!IsEnable() || in->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t width = in->width();
+  size_t height = in->height();
+  size_t out_width = width / _scale;
+  size_t out_height = height / _scale;
+  if (out_width == 0 || out_height == 0) {
+    return false;
+  }
+
+  auto src = reinterpret_cast<const uint16_t*>(in->data());
+  if (out == in) {
+    process_frame(src, reinterpret_cast<uint16_t*>(in->data()),
+        width, height);
+    return in->Reshape(out_width, out_height);
+  }
+  if (out->format() != ImageFormat::DEPTH_RAW ||
+      static_cast<size_t>(out->width()) != out_width ||
+      static_cast<size_t>(out->height()) != out_height) {
+    return false;
+  }
+  process_frame(src, reinterpret_cast<uint16_t*>(out->data()),
+      width, height);
+  return true;
+}
@@ -0,0 +1,120 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/filter/depth_mask.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+inline std::size_t popcount(std::uint64_t v) {
+  v = v - ((v >> 1) & 0x5555555555555555ULL);
+  v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+  v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  return static_cast<std::size_t>((v * 0x0101010101010101ULL) >> 56);
+}
+
+// pack the bits of the row of width, and copy it into dst if not null
+void pack_row(const std::uint16_t* src, std::uint16_t* dst, int width,
+    std::uint64_t* bits) {
+  int x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  for (; x + 64 <= width; x += 64) {
+    std::uint64_t word = 0;
+    for (int k = 0; k < 64; k += 16) {
+      __m128i a = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + x + k));
+      __m128i b = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + x + k + 8));
+      if (dst) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + k), a);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x + k + 8), b);
+      }
+      int invalid = _mm_movemask_epi8(_mm_packs_epi16(
+          simd::depth_invalid_mask(a), simd::depth_invalid_mask(b)));
+      word |= static_cast<std::uint64_t>(~invalid & 0xffff) << k;
+    }
+    bits[x >> 6] = word;
+  }
+#endif
+  for (; x < width; x += 64) {
+    const int n = std::min(width - x, 64);
+    std::uint64_t word = 0;
+    for (int k = 0; k < n; k++) {
+      word |= static_cast<std::uint64_t>(is_depth_valid(src[x + k])) << k;
+    }
+    if (dst) std::memcpy(dst + x, src + x, n * sizeof(std::uint16_t));
+    bits[x >> 6] = word;
+  }
+}
+
+}  // namespace
+
+DepthMask::DepthMask(bool confidence)
+  : confidence_(confidence), width_(0), height_(0), words_(0),
+    frame_id_(0), timestamp_(0) {
+}
+
+std::size_t DepthMask::CountValid() const {
+  std::size_t n = 0;
+  for (auto&& word : bits_) {
+    n += popcount(word);
+  }
+  return n;
+}
+
+void DepthMask::Clear(bool confidence) {
+  confidence_ = confidence;
+  // the capacity is kept among frames
+  edge_.clear();
+  stability_.clear();
+}
+
+void DepthMask::Reset(const Image& depth) {
+  width_ = depth.width();
+  height_ = depth.height();
+  words_ = (static_cast<std::size_t>(width_) + 63) >> 6;
+  bits_.assign(words_ * height_, 0);
+  frame_id_ = depth.frame_id();
+  timestamp_ = depth.timestamp();
+
+  const std::size_t size = static_cast<std::size_t>(width_) * height_;
+  if (edge_.size() != size) edge_.clear();
+  if (stability_.size() != size) stability_.clear();
+}
+
+void DepthMask::Pack(const std::shared_ptr<Image>& depth,
+    const std::shared_ptr<Image>& copy) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) return;
+  Reset(*depth);
+  auto src = reinterpret_cast<const std::uint16_t*>(depth->data());
+  std::uint16_t* dst = nullptr;
+  if (copy && copy != depth &&
+      copy->get_image_profile() == depth->get_image_profile()) {
+    dst = reinterpret_cast<std::uint16_t*>(copy->data());
+  }
+  for (int y = 0; y < height_; y++) {
+    const std::size_t offset = static_cast<std::size_t>(y) * width_;
+    pack_row(src + offset, dst ? dst + offset : nullptr, width_, row(y));
+  }
+}
+
+void DepthMask::PackRow(int y, const std::uint16_t* depth) {
+  pack_row(depth, nullptr, width_, row(y));
+}
@@ -0,0 +1,107 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "mynteyed/filter/disparity_transform.h"
+
+MYNTEYE_USE_NAMESPACE
+
+// The size of lookup table, all values of uint16
+const size_t lut_size = 65536;
+
+DisparityTransform::DisparityTransform(bool to_disparity,
+    std::uint16_t subpixel)
+  : _to_disparity(to_disparity),
+    _subpixel(std::max<std::uint16_t>(subpixel, 1)),
+    _focal_length(0), _baseline(0) {
+  TurnOn();
+}
+
+bool DisparityTransform::LoadConfig(void* data) {
+  float* params_ptr = reinterpret_cast<float*>(data);
+  uint8_t* mem_ptr = reinterpret_cast<uint8_t*>(data);
+  std::lock_guard<std::mutex> lock(_mutex);
+  _focal_length = params_ptr[0];
+  _baseline = params_ptr[1];
+  _subpixel = std::max<std::uint16_t>(
+      *reinterpret_cast<std::uint16_t*>(mem_ptr + 8), 1);
+  update_lut();
+  return true;
+}
+
+void DisparityTransform::SetStereoParams(double focal_length,
+    double baseline) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _focal_length = focal_length;
+  _baseline = std::fabs(baseline);
+  update_lut();
+}
+
+void DisparityTransform::SetStereoParams(const StreamIntrinsics& intrinsics,
+    const StreamExtrinsics& extrinsics) {
+  // the rectified focal length, if any
+  double focal_length = intrinsics.left.p[0] > 0 ?
+      intrinsics.left.p[0] : intrinsics.left.fx;
+  SetStereoParams(focal_length, extrinsics.translation[0]);
+}
+
+void DisparityTransform::update_lut() {
+  double scale = _focal_length * _baseline * _subpixel;
+  if (scale <= 0) {
+    _lut.clear();
+    return;
+  }
+  // depth to disparity and disparity to depth are the same reciprocal, only
+  // invalid depth are excluded
+  _lut.resize(lut_size);
+  _lut[0] = 0;
+  for (size_t i = 1; i < lut_size; i++) {
+    double v = std::round(scale / i);
+    _lut[i] = static_cast<uint16_t>(std::min(std::max(v, 1.0), 65535.0));
+  }
+  // keep the invalid value out of both domains
+  for (auto&& v : _lut) {
+    if (v == DEPTH_RAW_INVALID) v = DEPTH_RAW_INVALID - 1;
+  }
+  if (_to_disparity) {
+    _lut[DEPTH_RAW_INVALID] = 0;
+  }
+}
+
+bool DisparityTransform::ProcessFrame(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in) {
+  if (!IsEnable() || in->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  if (out != in &&
+      !(out->get_image_profile() == in->get_image_profile())) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_lut.empty()) {
+    return false;
+  }
+  // one sweep, also the copy if out is not in
+  auto src = reinterpret_cast<const uint16_t*>(in->data());
+  auto dst = reinterpret_cast<uint16_t*>(out->data());
+  const uint16_t* lut = _lut.data();
+  const size_t n = in->valid_size() / sizeof(uint16_t);
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = lut[src[i]];
+  }
+  return true;
+}
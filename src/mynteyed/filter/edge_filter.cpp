@@ -0,0 +1,217 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "mynteyed/filter/edge_filter.h"
+#include "mynteyed/filter/depth_mask.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+inline std::uint16_t to_q16(float ratio) {
+  return static_cast<std::uint16_t>(
+      std::min(std::max(std::lround(ratio * 65536.f), 0L), 65535L));
+}
+
+// Whether d is farther than the valid neighbour n by more than thr
+inline bool is_edge(std::uint16_t d, std::uint16_t n, std::uint16_t thr) {
+  return is_depth_valid(n) && d > n && d - n > thr;
+}
+
+// The step to the neighbour n, 0 if n is invalid
+inline std::uint16_t step_to(std::uint16_t d, std::uint16_t n) {
+  return is_depth_valid(n) ? (d > n ? d - n : n - d) : 0;
+}
+
+// 255, 191, 127 or 63 as step is within thr/4, thr/2, thr or more
+inline std::uint8_t edge_confidence(std::uint16_t step, std::uint16_t thr) {
+  return static_cast<std::uint8_t>(255 - 64 *
+      ((step > (thr >> 2)) + (step > (thr >> 1)) + (step > thr)));
+}
+
+#ifdef MYNTEYE_SIMD_SSE2
+// invalid is the invalid mask of n
+inline __m128i edge_mask(const __m128i& d, const __m128i& n,
+    const __m128i& invalid, const __m128i& thr) {
+  __m128i far = _mm_subs_epu16(_mm_subs_epu16(d, n), thr);
+  __m128i edge = _mm_andnot_si128(
+      _mm_cmpeq_epi16(far, _mm_setzero_si128()), _mm_set1_epi16(-1));
+  return _mm_andnot_si128(invalid, edge);
+}
+
+inline __m128i step_to(const __m128i& d, const __m128i& n,
+    const __m128i& invalid) {
+  __m128i diff = _mm_or_si128(_mm_subs_epu16(d, n), _mm_subs_epu16(n, d));
+  return _mm_andnot_si128(invalid, diff);
+}
+
+inline __m128i max_u16(const __m128i& a, const __m128i& b) {
+  return _mm_add_epi16(_mm_subs_epu16(a, b), b);
+}
+
+// minus 64 if step > t, unsigned
+inline __m128i sub_if_greater(const __m128i& c, const __m128i& step,
+    const __m128i& t) {
+  __m128i le = _mm_cmpeq_epi16(_mm_subs_epu16(step, t), _mm_setzero_si128());
+  return _mm_sub_epi16(c, _mm_andnot_si128(le, _mm_set1_epi16(64)));
+}
+
+inline __m128i edge_confidence(const __m128i& step, const __m128i& thr) {
+  __m128i c = _mm_set1_epi16(255);
+  c = sub_if_greater(c, step, _mm_srli_epi16(thr, 2));
+  c = sub_if_greater(c, step, _mm_srli_epi16(thr, 1));
+  return sub_if_greater(c, step, thr);
+}
+#endif
+
+}  // namespace
+
+EdgeFilter::EdgeFilter(float ratio, std::uint16_t min_delta)
+  : _ratio(ratio), _min_delta(min_delta), _ratio_q16(to_q16(ratio)),
+    _width(0), _height(0) {
+  TurnOn();
+}
+
+bool EdgeFilter::LoadConfig(void* data) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  float* ratio_ptr = reinterpret_cast<float*>(data);
+  uint8_t* mem_ptr = reinterpret_cast<uint8_t*>(data);
+  _ratio = *ratio_ptr;
+  _min_delta = *reinterpret_cast<std::uint16_t*>(mem_ptr + 4);
+  _ratio_q16 = to_q16(_ratio);
+  return true;
+}
+
+void EdgeFilter::process_row(const std::uint16_t* up, const std::uint16_t* cur,
+    const std::uint16_t* down, std::uint16_t* dst,
+    std::uint8_t* confidence) {
+  size_t x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i ratio = _mm_set1_epi16(static_cast<int16_t>(_ratio_q16));
+  const __m128i min_delta = _mm_set1_epi16(static_cast<int16_t>(_min_delta));
+  for (; x + 8 <= _width; x += 8) {
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+    __m128i l = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(cur + x - 1));
+    __m128i r = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(cur + x + 1));
+    __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+    __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+    // max(d * ratio, min_delta), unsigned
+    __m128i thr = _mm_mulhi_epu16(d, ratio);
+    thr = _mm_add_epi16(thr, _mm_subs_epu16(min_delta, thr));
+
+    const __m128i il = simd::depth_invalid_mask(l);
+    const __m128i ir = simd::depth_invalid_mask(r);
+    const __m128i iu = simd::depth_invalid_mask(u);
+    const __m128i iw = simd::depth_invalid_mask(w);
+    __m128i edge = edge_mask(d, l, il, thr);
+    edge = _mm_or_si128(edge, edge_mask(d, r, ir, thr));
+    edge = _mm_or_si128(edge, edge_mask(d, u, iu, thr));
+    edge = _mm_or_si128(edge, edge_mask(d, w, iw, thr));
+    __m128i o = _mm_andnot_si128(edge, d);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), o);
+
+    if (confidence) {
+      __m128i step = max_u16(max_u16(step_to(d, l, il), step_to(d, r, ir)),
+          max_u16(step_to(d, u, iu), step_to(d, w, iw)));
+      __m128i c = _mm_andnot_si128(simd::depth_invalid_mask(o),
+          edge_confidence(step, thr));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(confidence + x),
+          _mm_packus_epi16(c, c));
+    }
+  }
+#endif
+  for (; x < _width; x++) {
+    std::uint16_t d = cur[x];
+    std::uint16_t thr = std::max(static_cast<std::uint16_t>(
+        (static_cast<std::uint32_t>(d) * _ratio_q16) >> 16), _min_delta);
+    bool edge = is_edge(d, cur[x - 1], thr) || is_edge(d, cur[x + 1], thr) ||
+        is_edge(d, up[x], thr) || is_edge(d, down[x], thr);
+    std::uint16_t o = edge ? 0 : d;
+    dst[x] = o;
+    if (confidence) {
+      std::uint16_t step = std::max(
+          std::max(step_to(d, cur[x - 1]), step_to(d, cur[x + 1])),
+          std::max(step_to(d, up[x]), step_to(d, down[x])));
+      confidence[x] = is_depth_valid(o) ? edge_confidence(step, thr) : 0;
+    }
+  }
+}
+
+void EdgeFilter::process_frame(const std::uint16_t* src, std::uint16_t* dst,
+    DepthMask* mask, bool pack_bits) {
+  for (auto&& row : _rows) {
+    row.assign(_width + 2, 0);
+  }
+  // the row without padding out of image
+  const uint16_t* none = _rows[2].data() + 1;
+  uint16_t* prev = _rows[0].data() + 1;
+  uint16_t* cur = _rows[1].data() + 1;
+  std::uint8_t* confidence = nullptr;
+  if (mask && mask->has_confidence()) {
+    mask->edge().resize(_width * _height);
+    confidence = mask->edge().data();
+  }
+
+  for (size_t y = 0; y < _height; y++) {
+    // keep the original of current row, dst may be src
+    const uint16_t* row = src + y * _width;
+    std::copy(row, row + _width, cur);
+    const uint16_t* up = y > 0 ? prev : none;
+    const uint16_t* down = y + 1 < _height ? row + _width : none;
+    process_row(up, cur, down, dst + y * _width,
+        confidence ? confidence + y * _width : nullptr);
+    // the bits of the row just written, while in cache
+    if (mask && pack_bits) {
+      mask->PackRow(static_cast<int>(y), dst + y * _width);
+    }
+    std::swap(prev, cur);
+  }
+}
+
+bool EdgeFilter::ProcessFrame(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in) {
+  return ProcessFrameMask(out, in, nullptr, false);
+}
+
+bool EdgeFilter::ProcessFrameMask(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in,
+    DepthMask* mask, bool pack_bits) {
+  if (!IsEnable() || in->format() != ImageFormat::DEPTH_RAW) {
+    if (mask && pack_bits) mask->Pack(in);
+    return false;
+  }
+  if (out != in &&
+      !(out->get_image_profile() == in->get_image_profile())) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _width = in->width();
+  _height = in->height();
+  if (_width == 0 || _height == 0) {
+    return false;
+  }
+  // the bits of out are packed while filtering
+  if (mask && pack_bits) mask->Reset(*out);
+  process_frame(reinterpret_cast<const uint16_t*>(in->data()),
+      reinterpret_cast<uint16_t*>(out->data()), mask, pack_bits);
+  return true;
+}
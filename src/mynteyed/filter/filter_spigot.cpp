@@ -12,31 +12,122 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include "mynteyed/filter/filter_spigot.h"
+#include "mynteyed/filter/depth_mask.h"
 #include "mynteyed/device/image.h"
+#include "mynteyed/util/times.h"
 
 MYNTEYE_USE_NAMESPACE
 
 FilterSpigot::FilterSpigot() {}
 
 bool FilterSpigot::DeleteFilter(std::shared_ptr<BaseFilter> filter) {
-  return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = std::find_if(m_queue.begin(), m_queue.end(),
+      [&filter](const FilterEntry& entry) {
+        return entry.filter == filter;
+      });
+  if (it == m_queue.end()) return false;
+  m_queue.erase(it);
+  return true;
 }
 
 bool FilterSpigot::DeleteFilter(const std::string &fltname) {
-  return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = std::find_if(m_queue.begin(), m_queue.end(),
+      [&fltname](const FilterEntry& entry) {
+        return entry.name == fltname;
+      });
+  if (it == m_queue.end()) return false;
+  m_queue.erase(it);
+  return true;
 }
 
 bool FilterSpigot::AddFilter(
     const std::string& filtname,
     std::shared_ptr<BaseFilter> filter,
     size_t location) {
-  return false;
+  if (!filter) return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto&& entry : m_queue) {
+    if (entry.name == filtname || entry.filter == filter) return false;
+  }
+  // insert after the filters with the same location, keep them in order
+  auto it = std::upper_bound(m_queue.begin(), m_queue.end(), location,
+      [](size_t location, const FilterEntry& entry) {
+        return location < entry.location;
+      });
+  m_queue.insert(it, {filtname, filter, location, {filtname, 0, 0, 0}});
+  return true;
 }
 
-bool FilterSpigot::ProcessFrame(
-    std::shared_ptr<Image> out, const std::shared_ptr<Image> in) {
-  if (out == in) {}
+bool FilterSpigot::HasFilterEnabled() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto&& entry : m_queue) {
+    if (entry.filter->IsEnable()) return true;
+  }
   return false;
 }
 
+bool FilterSpigot::ProcessFrame(std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in, DepthMask* mask) {
+  if (!out || !in) return false;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const FilterEntry* last = nullptr;
+  for (auto&& entry : m_queue) {
+    if (entry.filter->IsEnable()) last = &entry;
+  }
+  if (out != in &&
+      !(out->get_image_profile() == in->get_image_profile())) {
+    return false;
+  }
+  if (!last) {
+    if (mask) {
+      mask->Pack(in, out);
+    } else if (out != in) {
+      std::copy(in->data(), in->data() + in->valid_size(), out->data());
+    }
+    return false;
+  }
+  if (out != in) {
+    std::copy(in->data(), in->data() + in->valid_size(), out->data());
+  }
+
+  bool processed = false;
+  for (auto&& entry : m_queue) {
+    if (!entry.filter->IsEnable()) continue;
+
+    auto&& time_beg = times::now();
+    bool ok = mask ?
+        entry.filter->ProcessFrameMask(out, out, mask, &entry == last) :
+        entry.filter->ProcessFrame(out, out);
+    if (ok) {
+      processed = true;
+    }
+    auto&& time_end = times::now();
+
+    auto&& cost = entry.cost;
+    cost.last_ms =
+        times::count<times::microseconds>(time_end - time_beg) * 0.001;
+    ++cost.count;
+    cost.avg_ms += (cost.last_ms - cost.avg_ms) / cost.count;
+  }
+  return processed;
+}
+
+std::vector<FilterCost> FilterSpigot::GetFilterCosts() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::vector<FilterCost> costs;
+  for (auto&& entry : m_queue) {
+    costs.push_back(entry.cost);
+  }
+  return costs;
+}
+
+void FilterSpigot::ResetFilterCosts() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto&& entry : m_queue) {
+    entry.cost = {entry.name, 0, 0, 0};
+  }
+}
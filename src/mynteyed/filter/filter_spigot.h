@@ -19,11 +19,19 @@
 #include <memory>
 #include "mynteyed/filter/base_filter.h"
 #include "mynteyed/types.h"
-#include "mynteyed/internal/camera_p.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 class BaseFilter;
+class CameraPrivate;
+class DepthMask;
 
+/**
+ * The filter chain of depth stream.
+ *
+ * Filters run in ascending order of their location, filters with the same
+ * location run in the order they are added. All filters run in place on one
+ * image, the disabled filters are skipped.
+ */
 class FilterSpigot  : public std::enable_shared_from_this<FilterSpigot> {
  public:
   bool DeleteFilter(std::shared_ptr<BaseFilter> filter);
@@ -32,12 +40,38 @@ class FilterSpigot  : public std::enable_shared_from_this<FilterSpigot> {
       const std::string& filtname,
       std::shared_ptr<BaseFilter> filter,
       size_t location = 0);
-  bool ProcessFrame(std::shared_ptr<Image> out, const std::shared_ptr<Image> in);  // NOLINT
+  /** Whethor has any filter enabled or not */
+  bool HasFilterEnabled();
+  /**
+   * Process frame with the enabled filters.
+   *
+   * If out is not in, in will be copied to out once, then all filters run in
+   * place on out.
+   *
+   * If mask is given, the filters write their confidences into it, and the
+   * last enabled one packs the bits of out in its pass, or the copy does if
+   * none enabled.
+   */
+  bool ProcessFrame(std::shared_ptr<Image> out,
+      const std::shared_ptr<Image> in, DepthMask* mask = nullptr);
+
+  /** Get the time costs of filters, in the order they run. */
+  std::vector<FilterCost> GetFilterCosts();
+  void ResetFilterCosts();
+
   FilterSpigot();
+
  private:
+  struct FilterEntry {
+    std::string name;
+    std::shared_ptr<BaseFilter> filter;
+    size_t location;
+    FilterCost cost;
+  };
+
   friend CameraPrivate;
-  std::vector<std::shared_ptr<BaseFilter>> m_queue;
+  std::vector<FilterEntry> m_queue;
+  std::mutex m_mutex;
 };
 
 MYNTEYE_END_NAMESPACE
-
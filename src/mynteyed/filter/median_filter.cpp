@@ -0,0 +1,231 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <mutex>
+#include "mynteyed/filter/median_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+// The rows of one band at least, smaller bands not worth a thread
+const size_t band_min_rows = 16;
+
+namespace {
+
+inline void sort2(uint16_t& a, uint16_t& b) {  // NOLINT
+  uint16_t t = std::min(a, b);
+  b = std::max(a, b);
+  a = t;
+}
+
+#ifdef MYNTEYE_SIMD_SSE2
+// the lanes are biased by 0x8000, so signed min/max order them unsigned
+inline void sort2(__m128i& a, __m128i& b) {  // NOLINT
+  __m128i t = _mm_min_epi16(a, b);
+  b = _mm_max_epi16(a, b);
+  a = t;
+}
+#endif
+
+// Median selection networks, from N. Devillard, "Fast median search: an ANSI
+// C implementation", the opt_med9 and opt_med25.
+
+template <typename T>
+inline T median9(T* p) {
+  sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+  sort2(p[0], p[1]); sort2(p[3], p[4]); sort2(p[6], p[7]);
+  sort2(p[1], p[2]); sort2(p[4], p[5]); sort2(p[7], p[8]);
+  sort2(p[0], p[3]); sort2(p[5], p[8]); sort2(p[4], p[7]);
+  sort2(p[3], p[6]); sort2(p[1], p[4]); sort2(p[2], p[5]);
+  sort2(p[4], p[7]); sort2(p[4], p[2]); sort2(p[6], p[4]);
+  sort2(p[4], p[2]);
+  return p[4];
+}
+
+template <typename T>
+inline T median25(T* p) {
+  sort2(p[0], p[1]);   sort2(p[3], p[4]);   sort2(p[2], p[4]);
+  sort2(p[2], p[3]);   sort2(p[6], p[7]);   sort2(p[5], p[7]);
+  sort2(p[5], p[6]);   sort2(p[9], p[10]);  sort2(p[8], p[10]);
+  sort2(p[8], p[9]);   sort2(p[12], p[13]); sort2(p[11], p[13]);
+  sort2(p[11], p[12]); sort2(p[15], p[16]); sort2(p[14], p[16]);
+  sort2(p[14], p[15]); sort2(p[18], p[19]); sort2(p[17], p[19]);
+  sort2(p[17], p[18]); sort2(p[21], p[22]); sort2(p[20], p[22]);
+  sort2(p[20], p[21]); sort2(p[23], p[24]); sort2(p[2], p[5]);
+  sort2(p[3], p[6]);   sort2(p[0], p[6]);   sort2(p[0], p[3]);
+  sort2(p[4], p[7]);   sort2(p[1], p[7]);   sort2(p[1], p[4]);
+  sort2(p[11], p[14]); sort2(p[8], p[14]);  sort2(p[8], p[11]);
+  sort2(p[12], p[15]); sort2(p[9], p[15]);  sort2(p[9], p[12]);
+  sort2(p[13], p[16]); sort2(p[10], p[16]); sort2(p[10], p[13]);
+  sort2(p[20], p[23]); sort2(p[17], p[23]); sort2(p[17], p[20]);
+  sort2(p[21], p[24]); sort2(p[18], p[24]); sort2(p[18], p[21]);
+  sort2(p[19], p[22]); sort2(p[8], p[17]);  sort2(p[9], p[18]);
+  sort2(p[0], p[18]);  sort2(p[0], p[9]);   sort2(p[10], p[19]);
+  sort2(p[1], p[19]);  sort2(p[1], p[10]);  sort2(p[11], p[20]);
+  sort2(p[2], p[20]);  sort2(p[2], p[11]);  sort2(p[12], p[21]);
+  sort2(p[3], p[21]);  sort2(p[3], p[12]);  sort2(p[13], p[22]);
+  sort2(p[4], p[22]);  sort2(p[4], p[13]);  sort2(p[14], p[23]);
+  sort2(p[5], p[23]);  sort2(p[5], p[14]);  sort2(p[15], p[24]);
+  sort2(p[6], p[24]);  sort2(p[6], p[15]);  sort2(p[7], p[16]);
+  sort2(p[7], p[19]);  sort2(p[13], p[21]); sort2(p[15], p[23]);
+  sort2(p[7], p[13]);  sort2(p[7], p[15]);  sort2(p[1], p[9]);
+  sort2(p[3], p[11]);  sort2(p[5], p[17]);  sort2(p[11], p[17]);
+  sort2(p[9], p[17]);  sort2(p[4], p[10]);  sort2(p[6], p[12]);
+  sort2(p[7], p[14]);  sort2(p[4], p[6]);   sort2(p[4], p[7]);
+  sort2(p[12], p[14]); sort2(p[10], p[14]); sort2(p[6], p[7]);
+  sort2(p[10], p[12]); sort2(p[6], p[10]);  sort2(p[6], p[17]);
+  sort2(p[12], p[17]); sort2(p[7], p[17]);  sort2(p[7], p[10]);
+  sort2(p[12], p[18]); sort2(p[7], p[12]);  sort2(p[10], p[18]);
+  sort2(p[12], p[20]); sort2(p[10], p[20]); sort2(p[10], p[12]);
+  return p[12];
+}
+
+// The median of one pixel, win is the top left of its window.
+//
+// If ignore invalid, the invalid pixels are replaced by min and max in turn,
+// the first by min. They are the ends of sorted window, so the middle of
+// network is the lower median of valid pixels.
+uint16_t median_pixel(const uint16_t* win, size_t stride, size_t ksize,
+    bool ignore_invalid) {
+  const size_t radius = ksize / 2;
+  if (ignore_invalid) {
+    uint16_t center = win[radius * stride + radius];
+    if (!is_depth_valid(center)) return center;
+  }
+  uint16_t p[25];
+  size_t n = 0;
+  bool to_min = true;
+  for (size_t dy = 0; dy < ksize; dy++) {
+    for (size_t dx = 0; dx < ksize; dx++) {
+      uint16_t v = win[dy * stride + dx];
+      if (ignore_invalid && !is_depth_valid(v)) {
+        v = to_min ? 0 : 0xffff;
+        to_min = !to_min;
+      }
+      p[n++] = v;
+    }
+  }
+  return ksize == 3 ? median9(p) : median25(p);
+}
+
+}  // namespace
+
+MedianFilter::MedianFilter(std::uint8_t ksize, bool ignore_invalid,
+    std::size_t threads)
+  : _ksize(ksize == 5 ? 5 : 3), _ignore_invalid(ignore_invalid),
+    _width(0), _height(0), _pool(std::make_shared<ThreadPool>(threads)) {
+  TurnOn();
+}
+
+bool MedianFilter::LoadConfig(void* data) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint8_t* mem_ptr = reinterpret_cast<uint8_t*>(data);
+  _ksize = (*mem_ptr == 5) ? 5 : 3;
+  _ignore_invalid = *(mem_ptr + 1) != 0;
+  return true;
+}
+
+void MedianFilter::pad_frame(const std::uint16_t* src) {
+  const size_t radius = _ksize / 2;
+  const size_t stride = _width + 2 * radius;
+  _padded.resize(stride * (_height + 2 * radius));
+
+  for (size_t y = 0; y < _height + 2 * radius; y++) {
+    size_t sy = std::min(std::max(y, radius), _height + radius - 1) - radius;
+    const uint16_t* s = src + sy * _width;
+    uint16_t* d = _padded.data() + y * stride;
+    std::fill(d, d + radius, s[0]);
+    std::copy(s, s + _width, d + radius);
+    std::fill(d + radius + _width, d + stride, s[_width - 1]);
+  }
+}
+
+void MedianFilter::process_rows(std::uint16_t* dst, size_t beg, size_t end) {
+  const size_t ksize = _ksize;
+  const size_t stride = _width + ksize - 1;
+
+  for (size_t y = beg; y < end; y++) {
+    const uint16_t* win = _padded.data() + y * stride;
+    uint16_t* out = dst + y * _width;
+    size_t x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128i bias = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i invalid_val = _mm_set1_epi16(DEPTH_RAW_INVALID);
+    // biased min and max
+    const __m128i lo = bias;
+    const __m128i hi = _mm_set1_epi16(0x7fff);
+    const size_t center = (ksize / 2) * (stride + 1);
+    __m128i p[25];
+    for (; x + 8 <= _width; x += 8) {
+      __m128i to_min = _mm_cmpeq_epi16(zero, zero);
+      size_t n = 0;
+      for (size_t dy = 0; dy < ksize; dy++) {
+        const uint16_t* row = win + dy * stride + x;
+        for (size_t dx = 0; dx < ksize; dx++) {
+          __m128i v = _mm_loadu_si128(
+              reinterpret_cast<const __m128i*>(row + dx));
+          p[n] = _mm_xor_si128(v, bias);
+          if (_ignore_invalid) {
+            __m128i invalid = _mm_or_si128(_mm_cmpeq_epi16(v, zero),
+                _mm_cmpeq_epi16(v, invalid_val));
+            p[n] = simd::select(invalid, simd::select(to_min, lo, hi), p[n]);
+            to_min = _mm_xor_si128(to_min, invalid);
+          }
+          ++n;
+        }
+      }
+      __m128i m = _mm_xor_si128(ksize == 3 ? median9(p) : median25(p), bias);
+      if (_ignore_invalid) {
+        // the invalid pixels are kept
+        __m128i c = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(win + center + x));
+        m = simd::select(_mm_or_si128(_mm_cmpeq_epi16(c, zero),
+            _mm_cmpeq_epi16(c, invalid_val)), c, m);
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), m);
+    }
+#endif
+    for (; x < _width; x++) {
+      out[x] = median_pixel(win + x, stride, ksize, _ignore_invalid);
+    }
+  }
+}
+
+bool MedianFilter::ProcessFrame(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in) {
+  if (!IsEnable() || in->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  if (out != in &&
+      !(out->get_image_profile() == in->get_image_profile())) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _width = in->width();
+  _height = in->height();
+  if (_width == 0 || _height == 0) {
+    return false;
+  }
+
+  pad_frame(reinterpret_cast<const uint16_t*>(in->data()));
+  uint16_t* dst = reinterpret_cast<uint16_t*>(out->data());
+  _pool->ParallelFor(_height, [this, dst](size_t beg, size_t end) {
+    process_rows(dst, beg, end);
+  }, band_min_rows);
+  return true;
+}
@@ -0,0 +1,319 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "mynteyed/filter/motion_temporal_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+// The unit of timestamps, 0.01 ms
+const double timestamp_unit_s = 0.00001;
+// The max interval of frames to warp, larger as lost, 1 s
+const std::uint32_t frame_interval_max = 100000;
+// The max count of gyro samples kept
+const size_t gyro_samples_max = 2000;
+// The min rotation to warp, about 0.01 degree
+const double rotation_angle_min = 1.7e-4;
+// The rows of one band at least
+const size_t band_min_rows = 16;
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+void mat_mul(const double a[3][3], const double b[3][3], double c[3][3]) {
+  double r[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+    }
+  }
+  std::copy(&r[0][0], &r[0][0] + 9, &c[0][0]);
+}
+
+void mat_identity(double m[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] = i == j ? 1 : 0;
+    }
+  }
+}
+
+// Rodrigues, the rotation of angular velocity w (rad/s) in dt
+void mat_exp(const double w[3], double dt, double r[3][3]) {
+  double v[3] = {w[0] * dt, w[1] * dt, w[2] * dt};
+  double theta = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  mat_identity(r);
+  if (theta < 1e-12) return;
+  double k[3] = {v[0] / theta, v[1] / theta, v[2] / theta};
+  double s = std::sin(theta), c = 1 - std::cos(theta);
+  double kx[3][3] = {{0, -k[2], k[1]}, {k[2], 0, -k[0]}, {-k[1], k[0], 0}};
+  double kx2[3][3];
+  mat_mul(kx, kx, kx2);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] += s * kx[i][j] + c * kx2[i][j];
+    }
+  }
+}
+
+double mat_angle(const double r[3][3]) {
+  double c = (r[0][0] + r[1][1] + r[2][2] - 1) * 0.5;
+  return std::acos(std::min(std::max(c, -1.0), 1.0));
+}
+
+}  // namespace
+
+MotionTemporalFilter::MotionTemporalFilter(std::size_t threads)
+  : _intrinsics(), _has_intrinsics(false), _last_timestamp(0),
+    _has_last_timestamp(false),
+    _pool(std::make_shared<ThreadPool>(threads)) {
+  mat_identity(_imu_to_camera);
+}
+
+void MotionTemporalFilter::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> lock(_motion_mutex);
+  _intrinsics = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    _intrinsics.fx = intrinsics.p[0];
+    _intrinsics.cx = intrinsics.p[2];
+    _intrinsics.fy = intrinsics.p[5];
+    _intrinsics.cy = intrinsics.p[6];
+  }
+  _has_intrinsics = _intrinsics.fx > 0 && _intrinsics.fy > 0 &&
+      _intrinsics.width > 0 && _intrinsics.height > 0;
+}
+
+void MotionTemporalFilter::SetMotionExtrinsics(
+    const MotionExtrinsics& extrinsics) {
+  std::lock_guard<std::mutex> lock(_motion_mutex);
+  std::copy(&extrinsics.rotation[0][0], &extrinsics.rotation[0][0] + 9,
+      &_imu_to_camera[0][0]);
+}
+
+void MotionTemporalFilter::OnMotionData(const MotionData& data) {
+  if (!data.imu || data.imu->flag != MYNTEYE_IMU_GYRO) return;
+  std::lock_guard<std::mutex> lock(_motion_mutex);
+  _gyro_samples.push_back({data.imu->timestamp,
+      {data.imu->gyro[0], data.imu->gyro[1], data.imu->gyro[2]}});
+  if (_gyro_samples.size() > gyro_samples_max) {
+    _gyro_samples.pop_front();
+  }
+}
+
+bool MotionTemporalFilter::integrate_rotation(std::uint64_t timestamp,
+    double rot[3][3]) {
+  std::lock_guard<std::mutex> lock(_motion_mutex);
+  mat_identity(rot);
+  // without frame timestamp, integrate to the last sample
+  if (timestamp == 0) {
+    if (_gyro_samples.empty()) return false;
+    timestamp = _gyro_samples.back().timestamp;
+  }
+  if (!_has_last_timestamp) {
+    _last_timestamp = timestamp;
+    _has_last_timestamp = true;
+    return false;
+  }
+
+  // the timestamps are uint32 on device, so diff them in uint32 as wrapped
+  const std::uint32_t t0 = static_cast<std::uint32_t>(_last_timestamp);
+  const std::uint32_t span = static_cast<std::uint32_t>(timestamp) - t0;
+  _last_timestamp = timestamp;
+  if (span == 0 || span > frame_interval_max) {
+    // drop the samples till now
+    while (!_gyro_samples.empty() && static_cast<std::uint32_t>(
+        _gyro_samples.front().timestamp) - t0 <= span) {
+      _gyro_samples.pop_front();
+    }
+    return false;
+  }
+
+  std::uint32_t t_prev = 0;
+  const double* w_prev = nullptr;
+  double w[3];
+  double step[3][3];
+  while (!_gyro_samples.empty()) {
+    const GyroSample& sample = _gyro_samples.front();
+    std::uint32_t t = static_cast<std::uint32_t>(sample.timestamp) - t0;
+    if (t > span && t <= 0x80000000u) break;  // after this frame
+    if (t <= span && t > 0) {
+      // rectangle rule, each sample holds from the last one
+      for (int i = 0; i < 3; i++) {
+        w[i] = sample.gyro[i] * kPi / 180;
+      }
+      double wc[3];
+      for (int i = 0; i < 3; i++) {
+        wc[i] = _imu_to_camera[i][0] * w[0] + _imu_to_camera[i][1] * w[1] +
+            _imu_to_camera[i][2] * w[2];
+      }
+      mat_exp(wc, (t - t_prev) * timestamp_unit_s, step);
+      mat_mul(rot, step, rot);
+      t_prev = t;
+      std::copy(wc, wc + 3, w);
+      w_prev = w;
+    }
+    _gyro_samples.pop_front();
+  }
+  // hold the last sample to the frame
+  if (w_prev && t_prev < span) {
+    mat_exp(w_prev, (span - t_prev) * timestamp_unit_s, step);
+    mat_mul(rot, step, rot);
+  }
+  return mat_angle(rot) >= rotation_angle_min;
+}
+
+void MotionTemporalFilter::warp_rows(const float h[3][3], size_t beg,
+    size_t end) {
+  auto last = reinterpret_cast<const uint16_t*>(_last_frame.data());
+  auto warped = reinterpret_cast<uint16_t*>(_warped_frame.data());
+  const uint8_t* history = _history.data();
+  uint8_t* warped_history = _warped_history.data();
+  const int width = static_cast<int>(_width);
+  const int height = static_cast<int>(_height);
+
+  // the last pixel, and the depth scale of it, for one pixel
+  auto sample = [&](size_t i, float x, float y, float w) {
+    // checked before rounding, as x / w may be out of the range of int
+    float fu = w > 0 ? x / w : -1.f;
+    float fv = w > 0 ? y / w : -1.f;
+    if (!(fu > -0.5f && fu < width - 0.5f &&
+          fv > -0.5f && fv < height - 0.5f)) {
+      warped[i] = 0;
+      warped_history[i] = 0;
+      return;
+    }
+    int u = static_cast<int>(std::lround(fu));
+    int v = static_cast<int>(std::lround(fv));
+    size_t j = static_cast<size_t>(v) * width + u;
+    // the invalid are not depth to scale, but holes
+    warped[i] = is_depth_valid(last[j]) ? static_cast<uint16_t>(std::min(
+        last[j] / w + 0.5f, 65535.f)) : 0;
+    warped_history[i] = history[j];
+  };
+
+  for (size_t y = beg; y < end; y++) {
+    float x0 = h[0][1] * y + h[0][2];
+    float y0 = h[1][1] * y + h[1][2];
+    float w0 = h[2][1] * y + h[2][2];
+    size_t i = y * _width;
+    size_t x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i size = _mm_set_epi32(0, 0, height, width);
+    const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+    const __m128 fw = _mm_set1_ps(static_cast<float>(width));
+    alignas(16) std::int32_t index[4];
+    alignas(16) std::int32_t inside[4];
+    alignas(16) float scale[4];
+    for (; x + 4 <= _width; x += 4) {
+      __m128 u = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes);
+      __m128 px = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(h[0][0])),
+          _mm_set1_ps(x0));
+      __m128 py = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(h[1][0])),
+          _mm_set1_ps(y0));
+      __m128 pw = _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(h[2][0])),
+          _mm_set1_ps(w0));
+      __m128 inv_w = _mm_div_ps(_mm_set1_ps(1.f), pw);
+      __m128i iu = _mm_cvtps_epi32(_mm_mul_ps(px, inv_w));
+      __m128i iv = _mm_cvtps_epi32(_mm_mul_ps(py, inv_w));
+      // 0 <= u < width, 0 <= v < height, w > 0
+      __m128i in = _mm_and_si128(
+          _mm_andnot_si128(_mm_cmplt_epi32(iu, zero),
+              _mm_cmplt_epi32(iu, _mm_shuffle_epi32(size, 0))),
+          _mm_andnot_si128(_mm_cmplt_epi32(iv, zero),
+              _mm_cmplt_epi32(iv, _mm_shuffle_epi32(size, 0x55))));
+      in = _mm_and_si128(in,
+          _mm_castps_si128(_mm_cmpgt_ps(pw, _mm_setzero_ps())));
+      // exact in float, as the index < 2^24
+      __m128i idx = _mm_cvtps_epi32(_mm_add_ps(
+          _mm_mul_ps(_mm_cvtepi32_ps(iv), fw), _mm_cvtepi32_ps(iu)));
+      _mm_store_si128(reinterpret_cast<__m128i*>(index), idx);
+      _mm_store_si128(reinterpret_cast<__m128i*>(inside), in);
+      _mm_store_ps(scale, inv_w);
+      for (int k = 0; k < 4; k++) {
+        if (inside[k]) {
+          const uint16_t d = last[index[k]];
+          warped[i + x + k] = is_depth_valid(d) ? static_cast<uint16_t>(
+              std::min(d * scale[k] + 0.5f, 65535.f)) : 0;
+          warped_history[i + x + k] = history[index[k]];
+        } else {
+          warped[i + x + k] = 0;
+          warped_history[i + x + k] = 0;
+        }
+      }
+    }
+#endif
+    for (; x < _width; x++) {
+      sample(i + x, h[0][0] * x + x0, h[1][0] * x + y0, h[2][0] * x + w0);
+    }
+  }
+}
+
+void MotionTemporalFilter::warp_last_frame(const double rot[3][3]) {
+  double sx, sy, fx, fy, cx, cy;
+  {
+    std::lock_guard<std::mutex> lock(_motion_mutex);
+    // the depth may be decimated
+    sx = static_cast<double>(_width) / _intrinsics.width;
+    sy = static_cast<double>(_height) / _intrinsics.height;
+    fx = _intrinsics.fx * sx;
+    fy = _intrinsics.fy * sy;
+    cx = (_intrinsics.cx + 0.5) * sx - 0.5;
+    cy = (_intrinsics.cy + 0.5) * sy - 0.5;
+  }
+
+  // H = K * R * K^-1, maps the current pixel to the last one
+  double k[3][3] = {{fx, 0, cx}, {0, fy, cy}, {0, 0, 1}};
+  double k_inv[3][3] = {{1 / fx, 0, -cx / fx}, {0, 1 / fy, -cy / fy},
+      {0, 0, 1}};
+  double hd[3][3];
+  mat_mul(k, rot, hd);
+  mat_mul(hd, k_inv, hd);
+  float h[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      h[i][j] = static_cast<float>(hd[i][j]);
+    }
+  }
+
+  _warped_frame.resize(_last_frame.size());
+  _warped_history.resize(_history.size());
+  _pool->ParallelFor(_height, [this, &h](size_t beg, size_t end) {
+    warp_rows(h, beg, end);
+  }, band_min_rows);
+  _last_frame.swap(_warped_frame);
+  _history.swap(_warped_history);
+}
+
+bool MotionTemporalFilter::ProcessFrameMask(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in,
+    DepthMask* mask, bool pack_bits) {
+  if (IsEnable() && in->format() == ImageFormat::DEPTH_RAW) {
+    double rot[3][3];
+    bool rotated = integrate_rotation(in->timestamp(), rot);
+    // warp only if the last frame is of the same profile
+    if (rotated && _has_intrinsics && !_last_frame.empty() &&
+        last_frame_profile == in->get_image_profile()) {
+      warp_last_frame(rot);
+    }
+  }
+  return TemporalFilter::ProcessFrameMask(out, in, mask, pack_bits);
+}
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <mutex>
 #include "mynteyed/filter/spatial_filter.h"
 
@@ -394,13 +395,9 @@ bool SpatialFilter::ProcessFrame(
       process_frame(in->data());
     } else {
       if (in->get_image_profile() == out->get_image_profile()) {
-        auto tmp = in->Clone();
-        process_frame(tmp->data());
-        uint8_t *out_ptr = out->data();
-        uint8_t *in_ptr = tmp->data();
-        for (size_t i = 0; i < tmp->valid_size(); i++) {
-          *out_ptr++ = *in_ptr++;
-        }
+        // copy once, then filter in place on out
+        std::copy(in->data(), in->data() + in->valid_size(), out->data());
+        process_frame(out->data());
       } else {
         out = in;
         return false;
@@ -0,0 +1,146 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <mutex>
+#include "mynteyed/filter/speckle_filter.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+inline bool is_similar(std::uint16_t a, std::uint16_t b,
+    std::uint16_t max_diff) {
+  return (a > b ? a - b : b - a) <= max_diff;
+}
+
+}  // namespace
+
+SpeckleFilter::SpeckleFilter(std::uint32_t max_speckle_size,
+    std::uint16_t max_diff)
+  : _max_speckle_size(max_speckle_size), _max_diff(max_diff),
+    _width(0), _height(0) {
+  TurnOn();
+}
+
+bool SpeckleFilter::LoadConfig(void* data) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint8_t* mem_ptr = reinterpret_cast<uint8_t*>(data);
+  _max_speckle_size = *reinterpret_cast<std::uint32_t*>(mem_ptr);
+  _max_diff = *reinterpret_cast<std::uint16_t*>(mem_ptr + 4);
+  return true;
+}
+
+std::uint32_t SpeckleFilter::find(std::uint32_t i) {
+  // path halving
+  while (_parent[i] != i) {
+    _parent[i] = _parent[_parent[i]];
+    i = _parent[i];
+  }
+  return i;
+}
+
+void SpeckleFilter::unite(std::uint32_t i, std::uint32_t j) {
+  i = find(i);
+  j = find(j);
+  if (i == j) return;
+  // union by size
+  if (_size[i] < _size[j]) std::swap(i, j);
+  _parent[j] = i;
+  _size[i] += _size[j];
+}
+
+void SpeckleFilter::connect_rows(const std::uint16_t* up,
+    const std::uint16_t* cur, size_t up_beg, size_t cur_beg, size_t cur_end) {
+  // the runs of both rows are sorted, sweep their overlaps
+  size_t i = up_beg, j = cur_beg;
+  while (i < cur_beg && j < cur_end) {
+    const Run& a = _runs[i];
+    const Run& b = _runs[j];
+    std::uint32_t beg = std::max(a.beg, b.beg);
+    std::uint32_t end = std::min(a.end, b.end);
+    for (std::uint32_t x = beg; x < end; x++) {
+      if (is_similar(up[x], cur[x], _max_diff)) {
+        unite(i, j);
+        break;
+      }
+    }
+    if (a.end < b.end) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+}
+
+void SpeckleFilter::process_frame(std::uint16_t* data) {
+  _runs.clear();
+  _parent.clear();
+  _size.clear();
+
+  // label the runs, connect them to the runs of row above
+  size_t up_beg = 0;
+  for (size_t y = 0; y < _height; y++) {
+    const std::uint16_t* row = data + y * _width;
+    size_t cur_beg = _runs.size();
+    size_t x = 0;
+    while (x < _width) {
+      if (!is_depth_valid(row[x])) {
+        ++x;
+        continue;
+      }
+      size_t beg = x++;
+      while (x < _width && is_depth_valid(row[x]) &&
+          is_similar(row[x], row[x - 1], _max_diff)) {
+        ++x;
+      }
+      std::uint32_t id = _runs.size();
+      _runs.push_back({static_cast<std::uint32_t>(y),
+          static_cast<std::uint32_t>(beg), static_cast<std::uint32_t>(x)});
+      _parent.push_back(id);
+      _size.push_back(x - beg);
+    }
+    if (y > 0) {
+      connect_rows(row - _width, row, up_beg, cur_beg, _runs.size());
+    }
+    up_beg = cur_beg;
+  }
+
+  // invalidate the small regions
+  for (std::uint32_t i = 0; i < _runs.size(); i++) {
+    if (_size[find(i)] >= _max_speckle_size) continue;
+    const Run& run = _runs[i];
+    std::uint16_t* row = data + run.y * _width;
+    std::fill(row + run.beg, row + run.end, 0);
+  }
+}
+
+bool SpeckleFilter::ProcessFrame(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in) {
+  if (!IsEnable() || in->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  if (out != in) {
+    if (!(out->get_image_profile() == in->get_image_profile())) {
+      return false;
+    }
+    std::copy(in->data(), in->data() + in->valid_size(), out->data());
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _width = in->width();
+  _height = in->height();
+  process_frame(reinterpret_cast<std::uint16_t*>(out->data()));
+  return true;
+}
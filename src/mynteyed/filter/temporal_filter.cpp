@@ -11,9 +11,11 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <algorithm>
 #include <mutex>
 #include <array>
 #include "mynteyed/filter/temporal_filter.h"
+#include "mynteyed/filter/depth_mask.h"
 
 MYNTEYE_USE_NAMESPACE
 
@@ -40,8 +42,19 @@ const uint16_t temp_delta_max = 2000;
 const uint16_t temp_delta_default = 100;
 const uint16_t temp_delta_step = 1;
 
-bool TemporalFilter::process_frame(void* source) {
-  temp_jw_smooth<uint16_t>(source, _last_frame.data(), _history.data());
+bool TemporalFilter::process_frame(void* source, DepthMask* mask,
+    bool pack_bits) {
+  uint64_t* bits = nullptr;
+  uint8_t* stability = nullptr;
+  if (mask && pack_bits) {
+    bits = mask->row(0);
+  }
+  if (mask && mask->has_confidence()) {
+    mask->stability().resize(_current_frm_size_pixels);
+    stability = mask->stability().data();
+  }
+  temp_jw_smooth<uint16_t>(source, _last_frame.data(), _history.data(),
+      bits, mask ? mask->words() : 0, stability);
   return true;
 }
 
@@ -53,6 +66,11 @@ TemporalFilter::TemporalFilter() :
     _width(0), _height(0), _stride(0), _bpp(2),
     _current_frm_size_pixels(0) {
     TurnOn();
+    for (size_t i = 0; i < _stability_map.size(); i++) {
+      int frames = 0;
+      for (size_t k = i; k; k >>= 1) frames += k & 1;
+      _stability_map[i] = static_cast<uint8_t>(frames * 255 / 8);
+    }
     on_set_persistence_control(_persistence_param);
     on_set_delta(_delta_param);
     on_set_alpha(_alpha_param);
@@ -165,32 +183,30 @@ bool TemporalFilter::LoadConfig(void* data) {
 bool TemporalFilter::ProcessFrame(
     std::shared_ptr<Image> out,
     const std::shared_ptr<Image> in) {
-  if (IsEnable()) {
-    UpdateConfig(in->get_image_profile());
-    if (out == in) {
-      process_frame(in->data());
-    } else {
-      if (in->get_image_profile() == out->get_image_profile()) {
-        auto tmp = in->Clone();
-        process_frame(tmp->data());
-        uint8_t *out_ptr = out->data();
-        uint8_t *in_ptr = tmp->data();
-        for (size_t i = 0; i < tmp->valid_size(); i++) {
-          *out_ptr++ = *in_ptr++;
-        }
-      } else {
-        out = in;
-      }
+  return ProcessFrameMask(out, in, nullptr, false);
+}
+
+bool TemporalFilter::ProcessFrameMask(
+    std::shared_ptr<Image> out,
+    const std::shared_ptr<Image> in,
+    DepthMask* mask, bool pack_bits) {
+  if (!IsEnable()) {
+    if (mask && pack_bits) mask->Pack(in);
+    return false;
+  }
+  UpdateConfig(in->get_image_profile());
+  if (out != in) {
+    if (!(in->get_image_profile() == out->get_image_profile())) {
+      if (mask && pack_bits) mask->Pack(in);
       return true;
     }
-    return true;
-  } else {
-    out = in;
-    return false;
+    // copy once, then filter in place on out
+    std::copy(in->data(), in->data() + in->valid_size(), out->data());
   }
-
-  Enable(false);
-  return false;
+  // the bits of out are packed while filtering
+  if (mask && pack_bits) mask->Reset(*out);
+  process_frame(out->data(), mask, pack_bits);
+  return true;
 }
 
 void TemporalFilter::UpdateConfig(
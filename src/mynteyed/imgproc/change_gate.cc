@@ -0,0 +1,183 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/imgproc/change_gate.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "mynteyed/filter/base_filter.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The max difference of a sample, times the threshold
+const int kDiffClamp = 8;
+
+// Sample the channel at offset of each pixel of bpp elements, of the rows
+// and cols
+template <typename T>
+void sample_rows(const T* data, std::size_t stride, int bpp, int offset,
+    const std::vector<int>& rows, const std::vector<int>& cols,
+    std::uint16_t* samples) {
+  for (int y : rows) {
+    const T* row = data + y * stride + offset;
+    for (int x : cols) {
+      *samples++ = row[x * bpp];
+    }
+  }
+}
+
+}  // namespace
+
+ChangeGate::ChangeGate(const ChangeGateParams& params)
+  : params_(params), format_(ImageFormat::IMAGE_FORMAT_LAST), width_(0),
+    height_(0), tiles_x_(0), tiles_y_(0), has_reference_(false), unchanged_(0),
+    changed_tiles_(0) {
+}
+
+void ChangeGate::SetParams(const ChangeGateParams& params) {
+  std::lock_guard<std::mutex> _(mutex_);
+  params_ = params;
+  // the samples may be of other tiles or step
+  width_ = height_ = 0;
+}
+
+ChangeGateParams ChangeGate::GetParams() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return params_;
+}
+
+bool ChangeGate::Process(const Image::pointer& image, bool force) {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!image || !Sample(*image)) {
+    changed_tiles_ = 0;
+    return true;
+  }
+  bool changed = force || !has_reference_;
+  if (changed) {
+    changed_tiles_ = tiles_x_ * tiles_y_;
+  } else {
+    changed_tiles_ = CountChangedTiles(format_ == ImageFormat::DEPTH_RAW ?
+        params_.depth_threshold : params_.color_threshold);
+    changed = changed_tiles_ >= std::max(params_.min_tiles, 1) ||
+        (params_.max_unchanged > 0 && unchanged_ >= params_.max_unchanged);
+  }
+  if (changed) {
+    // compared with the last passed, not the last processed, so the slow
+    // drifts add up
+    reference_.swap(samples_);
+    has_reference_ = true;
+    unchanged_ = 0;
+  } else {
+    ++unchanged_;
+  }
+  return changed;
+}
+
+int ChangeGate::GetChangedTiles() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return changed_tiles_;
+}
+
+void ChangeGate::Reset() {
+  std::lock_guard<std::mutex> _(mutex_);
+  has_reference_ = false;
+  unchanged_ = 0;
+}
+
+void ChangeGate::Layout(const Image& image) {
+  format_ = image.format();
+  width_ = image.width();
+  height_ = image.height();
+  const int step = std::max(params_.step, 1);
+  tiles_x_ = std::max(std::min(params_.tiles_x, width_), 1);
+  tiles_y_ = std::max(std::min(params_.tiles_y, height_), 1);
+
+  // the centers of the step x step cells
+  cols_.clear();
+  col_tiles_.clear();
+  for (int x = step / 2; x < width_; x += step) {
+    cols_.push_back(x);
+    col_tiles_.push_back(x * tiles_x_ / width_);
+  }
+  rows_.clear();
+  row_tiles_.clear();
+  for (int y = step / 2; y < height_; y += step) {
+    rows_.push_back(y);
+    row_tiles_.push_back(y * tiles_y_ / height_);
+  }
+  samples_.resize(rows_.size() * cols_.size());
+  reference_.resize(samples_.size());
+  has_reference_ = false;
+  unchanged_ = 0;
+}
+
+bool ChangeGate::Sample(const Image& image) {
+  int bpp, offset;
+  switch (image.format()) {
+    case ImageFormat::COLOR_YUYV: bpp = 2; offset = 0; break;
+    case ImageFormat::COLOR_BGR:
+    case ImageFormat::COLOR_RGB: bpp = 3; offset = 1; break;
+    case ImageFormat::IMAGE_GRAY_8: bpp = 1; offset = 0; break;
+    case ImageFormat::DEPTH_RAW: bpp = 1; offset = 0; break;
+    default: return false;
+  }
+  if (image.format() != format_ || image.width() != width_ ||
+      image.height() != height_) {
+    Layout(image);
+  }
+  if (format_ == ImageFormat::DEPTH_RAW) {
+    sample_rows(reinterpret_cast<const std::uint16_t*>(image.data()),
+        width_, bpp, offset, rows_, cols_, samples_.data());
+  } else {
+    sample_rows(image.data(), static_cast<std::size_t>(width_) * bpp, bpp,
+        offset, rows_, cols_, samples_.data());
+  }
+  return true;
+}
+
+int ChangeGate::CountChangedTiles(int threshold) const {
+  const int limit = std::max(threshold, 0);
+  // each difference clamped, so the sparse outliers, e.g. the speckles of
+  // depth, could not change a tile alone
+  const int clamp = kDiffClamp * limit;
+  // a hole of depth appearing or filled differs by clamp, and the holes of
+  // both are skipped
+  const bool depth = format_ == ImageFormat::DEPTH_RAW;
+  std::vector<std::uint32_t> sads(tiles_x_ * tiles_y_, 0);
+  std::vector<std::uint32_t> counts(sads.size(), 0);
+  const std::uint16_t* s = samples_.data();
+  const std::uint16_t* r = reference_.data();
+  for (int ty : row_tiles_) {
+    std::uint32_t* row_sads = sads.data() + ty * tiles_x_;
+    std::uint32_t* row_counts = counts.data() + ty * tiles_x_;
+    for (int tx : col_tiles_) {
+      const std::uint16_t a = *s++, b = *r++;
+      if (depth && (!is_depth_valid(a) || !is_depth_valid(b))) {
+        if (is_depth_valid(a) == is_depth_valid(b)) continue;
+        row_sads[tx] += clamp;
+      } else {
+        row_sads[tx] += std::min(std::abs(int(a) - int(b)), clamp);
+      }
+      ++row_counts[tx];
+    }
+  }
+  int changed = 0;
+  for (std::size_t t = 0; t < sads.size(); t++) {
+    // the mean above threshold, without dividing
+    if (sads[t] > limit * counts[t]) ++changed;
+  }
+  return changed;
+}
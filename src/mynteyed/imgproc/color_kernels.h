@@ -0,0 +1,118 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_IMGPROC_COLOR_KERNELS_H_
+#define MYNTEYE_IMGPROC_COLOR_KERNELS_H_
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace imgproc {
+
+/** The pixels converted a time, in 16 bits per channel. */
+const int kChunk = 8;
+
+// The YUV to RGB of the convertor, in Q16 of (value - 128) << 5
+const std::int16_t kVToR = 22458;  // 1.370705
+const std::int16_t kVToG = 11436;  // 0.698001
+const std::int16_t kUToG = 5532;   // 0.337633
+const std::int16_t kUToB = 28384;  // 1.732446
+// Then scaled by 220 / 256 as the convertor
+const std::uint16_t kRgbScale = 220;
+// The RGB to gray of BT.601, in Q8
+const std::uint16_t kRToGray = 77;
+const std::uint16_t kGToGray = 150;
+const std::uint16_t kBToGray = 29;
+
+#ifndef MYNTEYE_SIMD_SSE2
+inline int mulhi(int a, int b) {
+  return (a * b) >> 16;
+}
+
+inline std::uint16_t to_rgb(int t) {
+  t = std::min(std::max(t, 0), 255 << 3);
+  return static_cast<std::uint16_t>(((t << 5) * kRgbScale) >> 16);
+}
+#endif
+
+// The YUV of chunk pixels to RGB, in place, as the convertor
+inline void yuv_to_rgb(std::uint16_t v[3][kChunk]) {
+#ifdef MYNTEYE_SIMD_SSE2
+  auto load = [v](int k) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(v[k]));
+  };
+  const __m128i bias = _mm_set1_epi16(128);
+  // y in 3 fraction bits, the terms by the Q16 multiply
+  const __m128i y = _mm_slli_epi16(load(0), 3);
+  const __m128i du = _mm_slli_epi16(_mm_sub_epi16(load(1), bias), 5);
+  const __m128i dv = _mm_slli_epi16(_mm_sub_epi16(load(2), bias), 5);
+  __m128i r = _mm_add_epi16(y, _mm_mulhi_epi16(dv, _mm_set1_epi16(kVToR)));
+  __m128i g = _mm_sub_epi16(_mm_sub_epi16(y,
+      _mm_mulhi_epi16(dv, _mm_set1_epi16(kVToG))),
+      _mm_mulhi_epi16(du, _mm_set1_epi16(kUToG)));
+  __m128i b = _mm_add_epi16(y, _mm_mulhi_epi16(du, _mm_set1_epi16(kUToB)));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i max = _mm_set1_epi16(255 << 3);
+  const __m128i scale = _mm_set1_epi16(kRgbScale);
+  auto to_rgb = [&](__m128i t) {
+    t = _mm_min_epi16(_mm_max_epi16(t, zero), max);
+    return _mm_mulhi_epu16(_mm_slli_epi16(t, 5), scale);
+  };
+  _mm_store_si128(reinterpret_cast<__m128i*>(v[0]), to_rgb(r));
+  _mm_store_si128(reinterpret_cast<__m128i*>(v[1]), to_rgb(g));
+  _mm_store_si128(reinterpret_cast<__m128i*>(v[2]), to_rgb(b));
+#else
+  for (int i = 0; i < kChunk; i++) {
+    const int y = v[0][i] << 3;
+    const int du = (v[1][i] - 128) << 5;
+    const int dv = (v[2][i] - 128) << 5;
+    v[0][i] = to_rgb(y + mulhi(dv, kVToR));
+    v[1][i] = to_rgb(y - mulhi(dv, kVToG) - mulhi(du, kUToG));
+    v[2][i] = to_rgb(y + mulhi(du, kUToB));
+  }
+#endif
+}
+
+// The RGB of chunk pixels to gray
+inline void rgb_to_gray(const std::uint16_t r[kChunk],
+    const std::uint16_t g[kChunk], const std::uint16_t b[kChunk],
+    std::uint16_t v[kChunk]) {
+#ifdef MYNTEYE_SIMD_SSE2
+  // at most 255 * 256 + 128, so unsigned in 16 bits
+  auto load = [](const std::uint16_t* p) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(p));
+  };
+  __m128i sum = _mm_add_epi16(
+      _mm_add_epi16(_mm_mullo_epi16(load(r), _mm_set1_epi16(kRToGray)),
+          _mm_mullo_epi16(load(g), _mm_set1_epi16(kGToGray))),
+      _mm_add_epi16(_mm_mullo_epi16(load(b), _mm_set1_epi16(kBToGray)),
+          _mm_set1_epi16(128)));
+  _mm_store_si128(reinterpret_cast<__m128i*>(v), _mm_srli_epi16(sum, 8));
+#else
+  for (int i = 0; i < kChunk; i++) {
+    v[i] = static_cast<std::uint16_t>(
+        (r[i] * kRToGray + g[i] * kGToGray + b[i] * kBToGray + 128) >> 8);
+  }
+#endif
+}
+
+}  // namespace imgproc
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_IMGPROC_COLOR_KERNELS_H_
@@ -0,0 +1,333 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/imgproc/image_pyramid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mynteyed/device/convertor.h"
+#include "mynteyed/imgproc/color_kernels.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least, of level 0
+const std::size_t kBandMinRows = 16;
+// The pyramids pooled at most, the others are not reused
+const std::size_t kPoolMaxSize = 8;
+
+using imgproc::kChunk;
+
+int get_bpp(const ImageFormat& format) {
+  switch (format) {
+    case ImageFormat::COLOR_BGR:
+    case ImageFormat::COLOR_RGB: return 3;
+    case ImageFormat::COLOR_YUYV: return 2;
+    case ImageFormat::IMAGE_GRAY_8: return 1;
+    default: return 0;
+  }
+}
+
+// Convert one row of width pixels into the format of dst
+void convert_row(const std::uint8_t* src, ImageFormat src_format,
+    std::uint8_t* dst, ImageFormat dst_format, int width) {
+  const int dst_bpp = get_bpp(dst_format);
+  if (src_format == dst_format) {
+    std::memcpy(dst, src, static_cast<std::size_t>(width) * dst_bpp);
+    return;
+  }
+  int x = 0;
+  if (src_format == ImageFormat::COLOR_YUYV && dst_bpp == 1) {
+    // y only
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    for (; x + 16 <= width; x += 16) {
+      const __m128i a = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + 2 * x));
+      const __m128i b = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + 2 * x + 16));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x),
+          _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+    }
+#endif
+    for (; x < width; x++) dst[x] = src[2 * x];
+    return;
+  }
+  if (src_format == ImageFormat::IMAGE_GRAY_8) {
+    for (; x < width; x++) {
+      dst[3 * x] = dst[3 * x + 1] = dst[3 * x + 2] = src[x];
+    }
+    return;
+  }
+  const bool yuyv = src_format == ImageFormat::COLOR_YUYV;
+  // the channels out, in the order of source, or converted as RGB
+  const bool swap = (src_format == ImageFormat::COLOR_BGR) !=
+      (dst_format == ImageFormat::COLOR_BGR);
+  alignas(16) std::uint16_t v[3][kChunk] = {};
+  for (; x < width; x += kChunk) {
+    const int n = std::min(kChunk, width - x);
+    if (yuyv) {
+      for (int i = 0; i < n; i++) {
+        const int k = x + i;
+        v[0][i] = src[2 * k];
+        v[1][i] = src[4 * (k >> 1) + 1];
+        v[2][i] = src[4 * (k >> 1) + 3];
+      }
+      imgproc::yuv_to_rgb(v);
+    } else {
+      for (int i = 0; i < n; i++) {
+        const std::uint8_t* p = src + 3 * (x + i);
+        v[0][i] = p[0];
+        v[1][i] = p[1];
+        v[2][i] = p[2];
+      }
+    }
+    std::uint8_t* o = dst + x * dst_bpp;
+    if (dst_bpp == 1) {
+      const bool bgr = src_format == ImageFormat::COLOR_BGR;
+      imgproc::rgb_to_gray(v[bgr ? 2 : 0], v[1], v[bgr ? 0 : 2], v[0]);
+      for (int i = 0; i < n; i++) o[i] = static_cast<std::uint8_t>(v[0][i]);
+    } else {
+      const int c0 = swap ? 2 : 0, c2 = 2 - c0;
+      for (int i = 0; i < n; i++) {
+        o[3 * i] = static_cast<std::uint8_t>(v[c0][i]);
+        o[3 * i + 1] = static_cast<std::uint8_t>(v[1][i]);
+        o[3 * i + 2] = static_cast<std::uint8_t>(v[c2][i]);
+      }
+    }
+  }
+}
+
+// Downsample 2 rows into one of width pixels, the rounded mean of 2 x 2
+void downsample_row(const std::uint8_t* row0, const std::uint8_t* row1,
+    std::uint8_t* dst, int width, int bpp) {
+  int x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i two = _mm_set1_epi16(2);
+  if (bpp == 1) {
+    // the even and odd bytes as 16 bits, summed, of 16 pixels a time
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    auto sum = [&](const std::uint8_t* p0, const std::uint8_t* p1) {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p0));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p1));
+      const __m128i s = _mm_add_epi16(
+          _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+          _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+      return _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+    };
+    for (; x + 16 <= width; x += 16) {
+      const int k = 2 * x;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(
+          sum(row0 + k, row1 + k), sum(row0 + k + 16, row1 + k + 16)));
+    }
+  } else {
+    // the columns summed as 16 bits, then the pixel pairs, of 8 pixels a time
+    const __m128i zero = _mm_setzero_si128();
+    alignas(16) std::uint16_t s[48];
+    for (; x + 8 <= width; x += 8) {
+      const int k = 6 * x;
+      for (int j = 0; j < 3; j++) {
+        const __m128i a = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(row0 + k + 16 * j));
+        const __m128i b = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(row1 + k + 16 * j));
+        _mm_store_si128(reinterpret_cast<__m128i*>(s + 16 * j),
+            _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                _mm_unpacklo_epi8(b, zero)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(s + 16 * j + 8),
+            _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                _mm_unpackhi_epi8(b, zero)));
+      }
+      std::uint8_t* o = dst + 3 * x;
+      for (int i = 0; i < 8; i++) {
+        for (int c = 0; c < 3; c++) {
+          o[3 * i + c] = static_cast<std::uint8_t>(
+              (s[6 * i + c] + s[6 * i + 3 + c] + 2) >> 2);
+        }
+      }
+    }
+  }
+#endif
+  for (; x < width; x++) {
+    const int k = 2 * x * bpp;
+    for (int c = 0; c < bpp; c++) {
+      dst[x * bpp + c] = static_cast<std::uint8_t>((row0[k + c] +
+          row0[k + bpp + c] + row1[k + c] + row1[k + bpp + c] + 2) >> 2);
+    }
+  }
+}
+
+}  // namespace
+
+ImagePyramid::ImagePyramid()
+  : format_(ImageFormat::IMAGE_GRAY_8),
+    bpp_(1),
+    frame_id_(0),
+    timestamp_(0) {
+}
+
+void ImagePyramid::Reset(const ImageFormat& format, int width, int height,
+    int levels) {
+  format_ = format;
+  bpp_ = get_bpp(format);
+  widths_.assign(1, width);
+  heights_.assign(1, height);
+  for (int l = 0; l < levels && width > 1 && height > 1; l++) {
+    width /= 2;
+    height /= 2;
+    widths_.push_back(width);
+    heights_.push_back(height);
+  }
+  offsets_.resize(widths_.size());
+  std::size_t size = 0;
+  for (std::size_t l = 0; l < widths_.size(); l++) {
+    offsets_[l] = size;
+    size += static_cast<std::size_t>(widths_[l]) * heights_[l] * bpp_;
+  }
+  buffer_.resize(size);
+}
+
+ImagePyramidBuilder::ImagePyramidBuilder(std::size_t threads)
+  : levels_(0),
+    format_(ImageFormat::IMAGE_GRAY_8),
+    decoded_data_(nullptr),
+    decoded_frame_id_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+ImagePyramidBuilder::~ImagePyramidBuilder() {
+}
+
+void ImagePyramidBuilder::SetLevels(int levels, const ImageFormat& format) {
+  if (get_bpp(format) == 0 || format == ImageFormat::COLOR_YUYV) {
+    LOGW("%s: format %d not supported", __func__, static_cast<int>(format));
+    return;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  levels_ = std::max(levels, 0);
+  format_ = format;
+}
+
+int ImagePyramidBuilder::GetLevels() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return levels_;
+}
+
+ImageFormat ImagePyramidBuilder::GetFormat() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return format_;
+}
+
+std::shared_ptr<ImagePyramid> ImagePyramidBuilder::Process(
+    const Image::pointer& color) {
+  if (!color) return nullptr;
+  const bool mjpg = color->format() == ImageFormat::COLOR_MJPG;
+  // MJPG is converted from its decoded RGB
+  const ImageFormat src_format = mjpg ? ImageFormat::COLOR_RGB :
+      color->format();
+  const int src_bpp = get_bpp(src_format);
+  if (src_bpp == 0) {
+    LOGW("%s: format %d not supported", __func__,
+        static_cast<int>(src_format));
+    return nullptr;
+  }
+  // the side of dual, as the convertor
+  const bool dual = color->is_dual();
+  const int width = dual ? color->width() / 2 : color->width();
+  const int height = color->height();
+  if (width < 1 || height < 1) return nullptr;
+
+  std::lock_guard<std::mutex> _(mutex_);
+  const std::uint8_t* src = color->data();
+  if (mjpg) {
+    if (decoded_data_ != color->data() ||
+        decoded_frame_id_ != color->frame_id()) {
+      decoded_.resize(static_cast<std::size_t>(color->width()) * height * 3);
+      MJPEG_TO_RGB_LIBJPEG(color->data(), color->valid_size(),
+          decoded_.data());
+      decoded_data_ = color->data();
+      decoded_frame_id_ = color->frame_id();
+    }
+    src = decoded_.data();
+  }
+  if (dual && color->type() == ImageType::IMAGE_RIGHT_COLOR) {
+    src += width * src_bpp;
+  }
+  const std::size_t stride = static_cast<std::size_t>(color->width()) *
+      src_bpp;
+
+  auto pyramid = Acquire();
+  pyramid->Reset(format_, width, height, levels_);
+  pyramid->frame_id_ = color->frame_id();
+  pyramid->timestamp_ = color->timestamp();
+
+  // the bands of 2^levels rows of level 0, the last may be less
+  const int levels = pyramid->size() - 1;
+  const std::size_t bands = (height + (1 << levels) - 1) >> levels;
+  const std::size_t min_bands = std::max<std::size_t>(
+      kBandMinRows >> levels, 1);
+  ImagePyramid* p = pyramid.get();
+  pool_->ParallelFor(bands, [&](std::size_t beg, std::size_t end) {
+    ProcessBands(src, stride, src_format, p, beg, end);
+  }, min_bands);
+  return pyramid;
+}
+
+std::shared_ptr<ImagePyramid> ImagePyramidBuilder::Acquire() {
+  for (auto&& pyramid : pyramids_) {
+    // the pool holds the only one, so no others could get it now
+    if (pyramid.use_count() == 1) return pyramid;
+  }
+  auto pyramid = std::make_shared<ImagePyramid>();
+  if (pyramids_.size() < kPoolMaxSize) {
+    pyramids_.push_back(pyramid);
+  }
+  return pyramid;
+}
+
+void ImagePyramidBuilder::ProcessBands(const std::uint8_t* src,
+    std::size_t src_stride, ImageFormat src_format, ImagePyramid* pyramid,
+    std::size_t beg, std::size_t end) const {
+  const int levels = pyramid->size() - 1;
+  const ImageFormat format = pyramid->format();
+  const int bpp = pyramid->bpp();
+  for (std::size_t b = beg; b < end; b++) {
+    // level l rows of band b are [b << (levels - l), (b + 1) << ...), which
+    // only depend on the rows of the band in level l - 1
+    for (int l = 0; l <= levels; l++) {
+      const int shift = levels - l;
+      const int row_beg = static_cast<int>(b << shift);
+      const int row_end = std::min(static_cast<int>((b + 1) << shift),
+          pyramid->height(l));
+      const int width = pyramid->width(l);
+      const std::size_t stride = pyramid->stride(l);
+      std::uint8_t* dst = pyramid->data(l);
+      for (int v = row_beg; v < row_end; v++) {
+        if (l == 0) {
+          convert_row(src + v * src_stride, src_format, dst + v * stride,
+              format, width);
+        } else {
+          const std::uint8_t* prev = pyramid->data(l - 1) +
+              2 * v * pyramid->stride(l - 1);
+          downsample_row(prev, prev + pyramid->stride(l - 1),
+              dst + v * stride, width, bpp);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,338 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/imgproc/rectification.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mynteyed/device/convertor.h"
+#include "mynteyed/imgproc/color_kernels.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least
+const std::size_t kBandMinRows = 16;
+// The pixels sampled a time
+const int kChunk = imgproc::kChunk;
+
+// The bits of fractions, and the flag of pixels out of source
+const int kFracBits = 5;
+const int kFracSize = 1 << kFracBits;
+const std::uint16_t kMapInvalid = 0x8000;
+bool same_intrinsics(const CameraIntrinsics& a, const CameraIntrinsics& b) {
+  return a.width == b.width && a.height == b.height && a.fx == b.fx &&
+      a.fy == b.fy && a.cx == b.cx && a.cy == b.cy &&
+      std::equal(a.coeffs, a.coeffs + 5, b.coeffs) &&
+      std::equal(a.p, a.p + 12, b.p) && std::equal(a.r, a.r + 9, b.r);
+}
+
+int get_bpp(const ImageFormat& format) {
+  switch (format) {
+    case ImageFormat::COLOR_BGR:
+    case ImageFormat::COLOR_RGB: return 3;
+    case ImageFormat::COLOR_YUYV: return 2;
+    case ImageFormat::IMAGE_GRAY_8: return 1;
+    default: return 0;
+  }
+}
+
+// The 4 neighbours of chunk pixels, of up to 3 channels
+struct Samples {
+  alignas(16) std::uint16_t p[3][4][kChunk];
+  alignas(16) std::uint16_t frac[kChunk];
+  alignas(16) std::uint16_t v[3][kChunk];
+};
+
+// Bilinear of chunk pixels by their fractions, 0 if out of source
+void bilinear(const std::uint16_t p[4][kChunk],
+    const std::uint16_t frac[kChunk], std::uint16_t v[kChunk]) {
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i f = _mm_load_si128(reinterpret_cast<const __m128i*>(frac));
+  const __m128i size = _mm_set1_epi16(kFracSize);
+  const __m128i mask = _mm_set1_epi16(kFracSize - 1);
+  const __m128i fx = _mm_and_si128(f, mask);
+  const __m128i fy = _mm_and_si128(_mm_srli_epi16(f, kFracBits), mask);
+  const __m128i invalid = _mm_srai_epi16(f, 15);
+  const __m128i fx0 = _mm_sub_epi16(size, fx);
+  auto load = [p](int k) {
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(p[k]));
+  };
+  // the rows are at most 255 * 32, then weighted into 32 bits
+  const __m128i top = _mm_add_epi16(_mm_mullo_epi16(load(0), fx0),
+      _mm_mullo_epi16(load(1), fx));
+  const __m128i bottom = _mm_add_epi16(_mm_mullo_epi16(load(2), fx0),
+      _mm_mullo_epi16(load(3), fx));
+  const __m128i fy0 = _mm_sub_epi16(size, fy);
+  const __m128i round = _mm_set1_epi32(1 << (2 * kFracBits - 1));
+  __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(top, bottom),
+      _mm_unpacklo_epi16(fy0, fy));
+  __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(top, bottom),
+      _mm_unpackhi_epi16(fy0, fy));
+  lo = _mm_srai_epi32(_mm_add_epi32(lo, round), 2 * kFracBits);
+  hi = _mm_srai_epi32(_mm_add_epi32(hi, round), 2 * kFracBits);
+  _mm_store_si128(reinterpret_cast<__m128i*>(v),
+      _mm_andnot_si128(invalid, _mm_packs_epi32(lo, hi)));
+#else
+  for (int i = 0; i < kChunk; i++) {
+    const int fx = frac[i] & (kFracSize - 1);
+    const int fy = (frac[i] >> kFracBits) & (kFracSize - 1);
+    const int top = p[0][i] * (kFracSize - fx) + p[1][i] * fx;
+    const int bottom = p[2][i] * (kFracSize - fx) + p[3][i] * fx;
+    const int sum = top * (kFracSize - fy) + bottom * fy;
+    v[i] = (frac[i] & kMapInvalid) ? 0 : static_cast<std::uint16_t>(
+        (sum + (1 << (2 * kFracBits - 1))) >> (2 * kFracBits));
+  }
+#endif
+}
+
+}  // namespace
+
+Rectification::Rectification(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    output_width_(0),
+    output_height_(0),
+    map_width_(0),
+    map_height_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+Rectification::~Rectification() {
+}
+
+void Rectification::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (has_intrinsics_ && same_intrinsics(intrinsics, intrinsics_)) return;
+  intrinsics_ = intrinsics;
+  has_intrinsics_ = true;
+  UpdateMaps();
+}
+
+void Rectification::SetOutputSize(int width, int height) {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (width == output_width_ && height == output_height_) return;
+  output_width_ = width;
+  output_height_ = height;
+  if (has_intrinsics_) UpdateMaps();
+}
+
+void Rectification::UpdateMaps() {
+  map_width_ = output_width_ > 0 ? output_width_ : intrinsics_.width;
+  map_height_ = output_height_ > 0 ? output_height_ : intrinsics_.height;
+  const std::size_t size = static_cast<std::size_t>(map_width_) * map_height_;
+  map_xy_.resize(2 * size);
+  map_frac_.resize(size);
+  pool_->ParallelFor(map_height_, [this](std::size_t beg, std::size_t end) {
+    BuildMaps(beg, end);
+  }, kBandMinRows);
+}
+
+void Rectification::BuildMaps(std::size_t beg, std::size_t end) {
+  const CameraIntrinsics& in = intrinsics_;
+  // the rectified projection, or the raw one if not given
+  const bool has_p = in.p[0] != 0 && in.p[5] != 0;
+  const double fx1 = has_p ? in.p[0] : in.fx;
+  const double fy1 = has_p ? in.p[5] : in.fy;
+  const double cx1 = has_p ? in.p[2] : in.cx;
+  const double cy1 = has_p ? in.p[6] : in.cy;
+  // R^T, from rectified to raw, identity if not given
+  double rt[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  if (in.r[0] != 0 || in.r[4] != 0 || in.r[8] != 0) {
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) rt[3 * i + j] = in.r[3 * j + i];
+    }
+  }
+  const double k1 = in.coeffs[0], k2 = in.coeffs[1], p1 = in.coeffs[2],
+      p2 = in.coeffs[3], k3 = in.coeffs[4];
+  // the output pixel centers in rectified of the intrinsics size
+  const double scale_x = static_cast<double>(in.width) / map_width_;
+  const double scale_y = static_cast<double>(in.height) / map_height_;
+
+  for (std::size_t v = beg; v < end; v++) {
+    const double yn = ((v + 0.5) * scale_y - 0.5 - cy1) / fy1;
+    std::size_t k = v * map_width_;
+    for (int u = 0; u < map_width_; u++, k++) {
+      const double xn = ((u + 0.5) * scale_x - 0.5 - cx1) / fx1;
+      const double w = rt[6] * xn + rt[7] * yn + rt[8];
+      const double x = (rt[0] * xn + rt[1] * yn + rt[2]) / w;
+      const double y = (rt[3] * xn + rt[4] * yn + rt[5]) / w;
+      const double r2 = x * x + y * y;
+      const double radial = 1 + r2 * (k1 + r2 * (k2 + r2 * k3));
+      const double xd = x * radial + 2 * p1 * x * y + p2 * (r2 + 2 * x * x);
+      const double yd = y * radial + p1 * (r2 + 2 * y * y) + 2 * p2 * x * y;
+      // the source in 1 / 32 pixels
+      const double sx = std::floor((in.fx * xd + in.cx) * kFracSize + 0.5);
+      const double sy = std::floor((in.fy * yd + in.cy) * kFracSize + 0.5);
+      const int ix = static_cast<int>(std::max(std::min(sx, 1e9), -1e9));
+      const int iy = static_cast<int>(std::max(std::min(sy, 1e9), -1e9));
+      const int x0 = ix >> kFracBits, y0 = iy >> kFracBits;
+      // the 4 neighbours should be in source
+      if (w <= 0 || x0 < 0 || y0 < 0 || x0 >= in.width - 1 ||
+          y0 >= in.height - 1) {
+        map_xy_[2 * k] = map_xy_[2 * k + 1] = 0;
+        map_frac_[k] = kMapInvalid;
+        continue;
+      }
+      map_xy_[2 * k] = static_cast<std::int16_t>(x0);
+      map_xy_[2 * k + 1] = static_cast<std::int16_t>(y0);
+      map_frac_[k] = static_cast<std::uint16_t>(
+          ((iy & (kFracSize - 1)) << kFracBits) | (ix & (kFracSize - 1)));
+    }
+  }
+}
+
+bool Rectification::Process(const Image::pointer& color,
+    const ImageFormat& format, Image::pointer* rectified) {
+  if (!color || !rectified) return false;
+  const bool mjpg = color->format() == ImageFormat::COLOR_MJPG;
+  // MJPG is sampled as its decoded RGB
+  const ImageFormat src_format = mjpg ? ImageFormat::COLOR_RGB :
+      color->format();
+  const int src_bpp = get_bpp(src_format);
+  const int dst_bpp = get_bpp(format);
+  if (src_bpp == 0 || dst_bpp == 0 || format == ImageFormat::COLOR_YUYV) {
+    LOGW("%s: format %d to %d not supported", __func__,
+        static_cast<int>(src_format), static_cast<int>(format));
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  // the side of dual, as the convertor
+  const bool dual = color->is_dual();
+  const int width = dual ? color->width() / 2 : color->width();
+  const int height = color->height();
+  if (width != intrinsics_.width || height != intrinsics_.height ||
+      width < 2 || height < 2) {
+    LOGW("%s: size %dx%d is not of intrinsics %dx%d", __func__, width,
+        height, intrinsics_.width, intrinsics_.height);
+    return false;
+  }
+  const std::uint8_t* src = color->data();
+  if (mjpg) {
+    decoded_.resize(static_cast<std::size_t>(color->width()) * height * 3);
+    MJPEG_TO_RGB_LIBJPEG(color->data(), color->valid_size(), decoded_.data());
+    src = decoded_.data();
+  }
+  if (dual && color->type() == ImageType::IMAGE_RIGHT_COLOR) {
+    src += width * src_bpp;
+  }
+  const std::size_t stride = static_cast<std::size_t>(color->width()) *
+      src_bpp;
+
+  auto&& out = *rectified;
+  if (!out || out == color || out->format() != format ||
+      out->width() != map_width_ || out->height() != map_height_) {
+    out = Image::Create(color->type(), format, map_width_, map_height_,
+        false);
+  }
+  out->set_is_dual(false);
+  out->set_frame_id(color->frame_id());
+  out->set_timestamp(color->timestamp());
+
+  std::uint8_t* dst = out->data();
+  pool_->ParallelFor(map_height_, [&](std::size_t beg, std::size_t end) {
+    ProcessRows(src, stride, src_format, dst, format, beg, end);
+  }, kBandMinRows);
+  return true;
+}
+
+void Rectification::ProcessRows(const std::uint8_t* src, std::size_t stride,
+    ImageFormat src_format, std::uint8_t* dst, ImageFormat dst_format,
+    std::size_t beg, std::size_t end) const {
+  const bool yuyv = src_format == ImageFormat::COLOR_YUYV;
+  // y only if gray of YUYV
+  const int channels = src_format == ImageFormat::IMAGE_GRAY_8 ||
+      (yuyv && dst_format == ImageFormat::IMAGE_GRAY_8) ? 1 : 3;
+  const int src_bpp = get_bpp(src_format);
+  const int dst_bpp = get_bpp(dst_format);
+  // the channels out, in the order of source, or converted as RGB
+  const bool swap = (src_format == ImageFormat::COLOR_BGR) !=
+      (dst_format == ImageFormat::COLOR_BGR) && channels == 3;
+
+  Samples s = {};
+  for (std::size_t v = beg; v < end; v++) {
+    std::uint8_t* out = dst + v * map_width_ * dst_bpp;
+    for (int u0 = 0; u0 < map_width_; u0 += kChunk) {
+      const int n = std::min(kChunk, map_width_ - u0);
+      const std::size_t k0 = v * map_width_ + u0;
+      // gather the neighbours, out of source are of (0, 0) then masked
+      for (int i = 0; i < n; i++) {
+        const std::size_t k = k0 + i;
+        const int x = map_xy_[2 * k];
+        const std::uint8_t* row0 = src + map_xy_[2 * k + 1] * stride;
+        const std::uint8_t* row1 = row0 + stride;
+        s.frac[i] = map_frac_[k];
+        if (yuyv) {
+          // y of each pixel, u v of each pair
+          const int y0 = 2 * x, y1 = y0 + 2;
+          const int ua = 4 * (x >> 1) + 1, ub = 4 * ((x + 1) >> 1) + 1;
+          s.p[0][0][i] = row0[y0];
+          s.p[0][1][i] = row0[y1];
+          s.p[0][2][i] = row1[y0];
+          s.p[0][3][i] = row1[y1];
+          if (channels == 1) continue;
+          for (int c = 1; c < 3; c++) {
+            const int off = 2 * (c - 1);
+            s.p[c][0][i] = row0[ua + off];
+            s.p[c][1][i] = row0[ub + off];
+            s.p[c][2][i] = row1[ua + off];
+            s.p[c][3][i] = row1[ub + off];
+          }
+        } else {
+          const int x0 = x * src_bpp;
+          for (int c = 0; c < channels; c++) {
+            s.p[c][0][i] = row0[x0 + c];
+            s.p[c][1][i] = row0[x0 + src_bpp + c];
+            s.p[c][2][i] = row1[x0 + c];
+            s.p[c][3][i] = row1[x0 + src_bpp + c];
+          }
+        }
+      }
+      for (int c = 0; c < channels; c++) {
+        bilinear(s.p[c], s.frac, s.v[c]);
+      }
+
+      std::uint8_t* o = out + u0 * dst_bpp;
+      if (dst_bpp == 1) {
+        if (channels == 3) {
+          const bool bgr = src_format == ImageFormat::COLOR_BGR;
+          imgproc::rgb_to_gray(s.v[bgr ? 2 : 0], s.v[1], s.v[bgr ? 0 : 2],
+              s.v[0]);
+        }
+        for (int i = 0; i < n; i++) o[i] = static_cast<std::uint8_t>(s.v[0][i]);
+      } else if (src_bpp == 1) {
+        for (int i = 0; i < n; i++) {
+          o[3 * i] = o[3 * i + 1] = o[3 * i + 2] =
+              static_cast<std::uint8_t>(s.v[0][i]);
+        }
+      } else {
+        if (yuyv) imgproc::yuv_to_rgb(s.v);
+        const int c0 = swap ? 2 : 0, c2 = 2 - c0;
+        for (int i = 0; i < n; i++) {
+          o[3 * i] = static_cast<std::uint8_t>(s.v[c0][i]);
+          o[3 * i + 1] = static_cast<std::uint8_t>(s.v[1][i]);
+          o[3 * i + 2] = static_cast<std::uint8_t>(s.v[c2][i]);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,479 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/imgproc/stereo_matcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least, as each band sums its first block again
+const std::size_t kBandMinRows = 32;
+// The disparities a time
+const int kLanes = 8;
+// The cost of the disparities out of search, more than any block sum
+const std::uint16_t kCostMax = 0x7fff;
+// The subpixel bits of disparities
+const int kSubpixelBits = 4;
+
+// The census of 16 neighbours, every other pixel of 7 x 7 around
+const int kCensusRadius = 3;
+const int kCensusOffsets[4] = {-3, -1, 1, 3};
+
+inline int clamp(int v, int lo, int hi) {
+  return std::min(std::max(v, lo), hi);
+}
+
+inline int bit_count(unsigned int bits) {
+  int n = 0;
+  for (; bits; bits &= bits - 1) ++n;
+  return n;
+}
+
+// The census of pixel (x, y), its neighbours clamped into the image
+std::uint16_t census(const std::uint8_t* gray, int width, int height, int x,
+    int y) {
+  const std::uint8_t center = gray[y * width + x];
+  std::uint16_t code = 0;
+  int bit = 0;
+  for (int dy : kCensusOffsets) {
+    const std::uint8_t* row = gray + clamp(y + dy, 0, height - 1) * width;
+    for (int dx : kCensusOffsets) {
+      if (row[clamp(x + dx, 0, width - 1)] < center) code |= 1 << bit;
+      ++bit;
+    }
+  }
+  return code;
+}
+
+// The census of 8 pixels from (x, y), all neighbours in the image
+#ifdef MYNTEYE_SIMD_SSE2
+inline __m128i census8(const std::uint8_t* gray, int width, int x, int y) {
+  const __m128i zero = _mm_setzero_si128();
+  auto load = [&](int xx, int yy) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(gray + yy * width + xx)), zero);
+  };
+  const __m128i center = load(x, y);
+  __m128i code = zero;
+  int bit = 0;
+  for (int dy : kCensusOffsets) {
+    for (int dx : kCensusOffsets) {
+      const __m128i lt = _mm_cmplt_epi16(load(x + dx, y + dy), center);
+      code = _mm_or_si128(code,
+          _mm_and_si128(lt, _mm_set1_epi16(static_cast<short>(1 << bit))));
+      ++bit;
+    }
+  }
+  return code;
+}
+
+// The bits set of each 16-bit lane
+inline __m128i popcount16(__m128i v) {
+  v = _mm_sub_epi16(v, _mm_and_si128(_mm_srli_epi16(v, 1),
+      _mm_set1_epi16(0x5555)));
+  v = _mm_add_epi16(_mm_and_si128(v, _mm_set1_epi16(0x3333)),
+      _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi16(0x3333)));
+  v = _mm_and_si128(_mm_add_epi16(v, _mm_srli_epi16(v, 4)),
+      _mm_set1_epi16(0x0f0f));
+  return _mm_and_si128(_mm_add_epi16(v, _mm_srli_epi16(v, 8)),
+      _mm_set1_epi16(0x1f));
+}
+#endif
+
+}  // namespace
+
+StereoMatcher::StereoMatcher(std::size_t threads)
+  : focal_(0),
+    baseline_(0),
+    disparities_(64),
+    block_size_(9),
+    cost_(StereoMatchCost::CENSUS),
+    uniqueness_(10),
+    lr_max_diff_(1),
+    width_(0),
+    height_(0),
+    left_rectification_(threads),
+    right_rectification_(threads),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+StereoMatcher::~StereoMatcher() {
+}
+
+void StereoMatcher::SetCamera(double focal, double baseline) {
+  std::lock_guard<std::mutex> _(mutex_);
+  focal_ = focal;
+  baseline_ = baseline;
+}
+
+void StereoMatcher::SetStreamParams(const StreamIntrinsics& intrinsics,
+    const StreamExtrinsics& extrinsics, int width, int height) {
+  left_rectification_.SetIntrinsics(intrinsics.left);
+  left_rectification_.SetOutputSize(width, height);
+  right_rectification_.SetIntrinsics(intrinsics.right);
+  right_rectification_.SetOutputSize(width, height);
+  // the focal of the rectified projection, scaled to the size
+  const CameraIntrinsics& in = intrinsics.left;
+  const double fx = in.p[0] != 0 ? in.p[0] : in.fx;
+  const double scale = width > 0 && in.width > 0 ?
+      static_cast<double>(width) / in.width : 1;
+  const double* t = extrinsics.translation;
+  SetCamera(fx * scale, std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]));
+}
+
+void StereoMatcher::SetDisparities(int disparities) {
+  std::lock_guard<std::mutex> _(mutex_);
+  disparities_ = (clamp(disparities, kLanes, 256) + kLanes - 1) /
+      kLanes * kLanes;
+}
+
+void StereoMatcher::SetBlockSize(int block_size) {
+  std::lock_guard<std::mutex> _(mutex_);
+  // the sums of SAD are at most 255 * 11 * 11, so signed 16 bits
+  block_size_ = clamp(block_size, 3, 11) | 1;
+}
+
+void StereoMatcher::SetCost(const StereoMatchCost& cost) {
+  std::lock_guard<std::mutex> _(mutex_);
+  cost_ = cost;
+}
+
+void StereoMatcher::SetUniqueness(int percent) {
+  std::lock_guard<std::mutex> _(mutex_);
+  uniqueness_ = std::max(percent, 0);
+}
+
+void StereoMatcher::SetLeftRightMaxDiff(int max_diff) {
+  std::lock_guard<std::mutex> _(mutex_);
+  lr_max_diff_ = max_diff;
+}
+
+bool StereoMatcher::Process(const Image::pointer& left,
+    const Image::pointer& right, Image::pointer* depth) {
+  std::lock_guard<std::mutex> _(mutex_);
+  return Match(left, right, depth);
+}
+
+bool StereoMatcher::ProcessColor(const Image::pointer& color,
+    Image::pointer* depth) {
+  if (!color || !color->is_dual()) {
+    LOGW("%s: color should be dual of left and right", __func__);
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!left_rectification_.Process(color->Shadow(ImageType::IMAGE_LEFT_COLOR),
+          ImageFormat::IMAGE_GRAY_8, &left_gray_) ||
+      !right_rectification_.Process(
+          color->Shadow(ImageType::IMAGE_RIGHT_COLOR),
+          ImageFormat::IMAGE_GRAY_8, &right_gray_)) {
+    return false;
+  }
+  return Match(left_gray_, right_gray_, depth);
+}
+
+bool StereoMatcher::Match(const Image::pointer& left,
+    const Image::pointer& right, Image::pointer* depth) {
+  if (!left || !right || !depth) return false;
+  if (left->format() != ImageFormat::IMAGE_GRAY_8 ||
+      right->format() != ImageFormat::IMAGE_GRAY_8 ||
+      left->width() != right->width() || left->height() != right->height()) {
+    LOGW("%s: left and right should be gray of the same size", __func__);
+    return false;
+  }
+  if (focal_ <= 0 || baseline_ <= 0) {
+    LOGW("%s: camera not set", __func__);
+    return false;
+  }
+  width_ = left->width();
+  height_ = left->height();
+  const std::size_t size = static_cast<std::size_t>(width_) * height_;
+  left_codes_.resize(size);
+  right_codes_.resize(static_cast<std::size_t>(width_ + disparities_) *
+      height_);
+
+  auto&& out = *depth;
+  if (!out || out->format() != ImageFormat::DEPTH_RAW ||
+      out->width() != width_ || out->height() != height_) {
+    out = Image::Create(ImageType::IMAGE_DEPTH, ImageFormat::DEPTH_RAW,
+        width_, height_, false);
+  }
+  out->set_frame_id(left->frame_id());
+  out->set_timestamp(left->timestamp());
+
+  const std::uint8_t* l = left->data();
+  const std::uint8_t* r = right->data();
+  pool_->ParallelFor(height_, [&](std::size_t beg, std::size_t end) {
+    Encode(l, r, beg, end);
+  }, kBandMinRows);
+  std::uint16_t* d = reinterpret_cast<std::uint16_t*>(out->data());
+  pool_->ParallelFor(height_, [&](std::size_t beg, std::size_t end) {
+    MatchRows(d, beg, end);
+  }, kBandMinRows);
+  return true;
+}
+
+void StereoMatcher::Encode(const std::uint8_t* left,
+    const std::uint8_t* right, std::size_t beg, std::size_t end) {
+  const int w = width_, h = height_;
+  const int stride = w + disparities_;
+  for (std::size_t v = beg; v < end; v++) {
+    const int y = static_cast<int>(v);
+    std::uint16_t* lc = &left_codes_[y * w];
+    // reversed, so the right of x - d is at w - 1 - x + d
+    std::uint16_t* rc = &right_codes_[y * stride] + w - 1;
+    if (cost_ == StereoMatchCost::SAD) {
+      for (int x = 0; x < w; x++) {
+        lc[x] = left[y * w + x];
+        *(rc - x) = right[y * w + x];
+      }
+    } else {
+      int x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+      // the inner, with all neighbours in the image
+      if (y >= kCensusRadius && y < h - kCensusRadius) {
+        for (; x < kCensusRadius; x++) {
+          lc[x] = census(left, w, h, x, y);
+          *(rc - x) = census(right, w, h, x, y);
+        }
+        alignas(16) std::uint16_t codes[kLanes];
+        for (; x + kLanes + kCensusRadius <= w; x += kLanes) {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(lc + x),
+              census8(left, w, x, y));
+          _mm_store_si128(reinterpret_cast<__m128i*>(codes),
+              census8(right, w, x, y));
+          for (int i = 0; i < kLanes; i++) *(rc - x - i) = codes[i];
+        }
+      }
+#endif
+      for (; x < w; x++) {
+        lc[x] = census(left, w, h, x, y);
+        *(rc - x) = census(right, w, h, x, y);
+      }
+    }
+    // out of right, the costs there are not searched
+    std::fill(rc + 1, rc + 1 + disparities_, 0);
+  }
+}
+
+void StereoMatcher::SlideRowCosts(int add_row, int sub_row,
+    std::uint16_t* sums) const {
+  const int w = width_, n = disparities_;
+  const bool sad = cost_ == StereoMatchCost::SAD;
+  const bool sub = sub_row >= 0;
+  const std::uint16_t* lc0 = &left_codes_[add_row * w];
+  const std::uint16_t* rc0 = &right_codes_[add_row * (w + n)] + w - 1;
+  const std::uint16_t* lc1 = &left_codes_[std::max(sub_row, 0) * w];
+  const std::uint16_t* rc1 = &right_codes_[std::max(sub_row, 0) * (w + n)] +
+      w - 1;
+#ifdef MYNTEYE_SIMD_SSE2
+  auto cost = [sad](const __m128i& l, const std::uint16_t* r) {
+    const __m128i rv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r));
+    return sad ? _mm_or_si128(_mm_subs_epu16(l, rv), _mm_subs_epu16(rv, l)) :
+        popcount16(_mm_xor_si128(l, rv));
+  };
+  for (int x = 0; x < w; x++) {
+    __m128i* s = reinterpret_cast<__m128i*>(sums + x * n);
+    const __m128i l0 = _mm_set1_epi16(static_cast<short>(lc0[x]));
+    const __m128i l1 = _mm_set1_epi16(static_cast<short>(lc1[x]));
+    for (int d = 0; d < n; d += kLanes, s++) {
+      __m128i sum = _mm_add_epi16(_mm_load_si128(s), cost(l0, rc0 - x + d));
+      if (sub) sum = _mm_sub_epi16(sum, cost(l1, rc1 - x + d));
+      _mm_store_si128(s, sum);
+    }
+  }
+#else
+  auto cost = [sad](int l, int r) {
+    return sad ? std::abs(l - r) : bit_count(l ^ r);
+  };
+  for (int x = 0; x < w; x++) {
+    std::uint16_t* s = sums + x * n;
+    const std::uint16_t* r0 = rc0 - x;
+    const std::uint16_t* r1 = rc1 - x;
+    for (int d = 0; d < n; d++) {
+      int sum = s[d] + cost(lc0[x], r0[d]);
+      if (sub) sum -= cost(lc1[x], r1[d]);
+      s[d] = static_cast<std::uint16_t>(sum);
+    }
+  }
+#endif
+}
+
+void StereoMatcher::MatchRows(std::uint16_t* depth, std::size_t beg,
+    std::size_t end) const {
+  const int w = width_, h = height_, n = disparities_;
+  const int radius = block_size_ / 2;
+  // the sums of each column of the block rows, then of the block, aligned
+  std::vector<std::uint16_t> buffer((w + 1) * n + kLanes);
+  std::uint16_t* columns = reinterpret_cast<std::uint16_t*>(
+      (reinterpret_cast<std::uintptr_t>(buffer.data()) + 15) & ~15);
+  std::uint16_t* sums = columns + w * n;
+  // per row: the best of left, and of right by the costs of left
+  std::vector<int> best(w), best_sub(w);
+  std::vector<int> right_best(w);
+  std::vector<std::uint16_t> right_cost(w);
+  const float depth_scale = static_cast<float>(focal_ * baseline_ *
+      (1 << kSubpixelBits));
+
+  std::fill(columns, columns + w * n, 0);
+  for (int k = -radius; k <= radius; k++) {
+    SlideRowCosts(clamp(static_cast<int>(beg) + k, 0, h - 1), -1, columns);
+  }
+  for (std::size_t v = beg; v < end; v++) {
+    const int y = static_cast<int>(v);
+    if (v > beg) {
+      SlideRowCosts(clamp(y + radius, 0, h - 1),
+          clamp(y - radius - 1, 0, h - 1), columns);
+    }
+    std::fill(sums, sums + n, 0);
+    for (int k = -radius; k <= radius; k++) {
+      const std::uint16_t* c = columns + clamp(k, 0, w - 1) * n;
+      for (int d = 0; d < n; d++) sums[d] += c[d];
+    }
+    std::fill(right_cost.begin(), right_cost.end(), kCostMax);
+    std::fill(right_best.begin(), right_best.end(), -1);
+
+    for (int x = 0; x < w; x++) {
+      if (x > 0) {
+        const std::uint16_t* in = columns + std::min(x + radius, w - 1) * n;
+        const std::uint16_t* out = columns + std::max(x - radius - 1, 0) * n;
+#ifdef MYNTEYE_SIMD_SSE2
+        for (int d = 0; d < n; d += kLanes) {
+          auto load = [d](const std::uint16_t* p) {
+            return _mm_load_si128(reinterpret_cast<const __m128i*>(p + d));
+          };
+          _mm_store_si128(reinterpret_cast<__m128i*>(sums + d), _mm_sub_epi16(
+              _mm_add_epi16(load(sums), load(in)), load(out)));
+        }
+#else
+        for (int d = 0; d < n; d++) {
+          sums[d] = static_cast<std::uint16_t>(sums[d] + in[d] - out[d]);
+        }
+#endif
+      }
+      best[x] = -1;
+      // the right block should be in the image
+      const int limit = std::min(n, x - radius + 1);
+      if (limit < 2) continue;
+
+      int best_d = 0;
+      std::uint16_t best_cost = kCostMax;
+#ifdef MYNTEYE_SIMD_SSE2
+      const __m128i lanes = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+      const __m128i vlimit = _mm_set1_epi16(static_cast<short>(limit));
+      const __m128i vmax = _mm_set1_epi16(kCostMax);
+      __m128i vmin = vmax, vidx = _mm_setzero_si128();
+      for (int d = 0; d < n; d += kLanes) {
+        const __m128i dv = _mm_add_epi16(lanes,
+            _mm_set1_epi16(static_cast<short>(d)));
+        __m128i s = _mm_load_si128(reinterpret_cast<const __m128i*>(sums + d));
+        if (d + kLanes > limit) {
+          s = simd::select(_mm_cmplt_epi16(dv, vlimit), s, vmax);
+        }
+        const __m128i lt = _mm_cmplt_epi16(s, vmin);
+        vmin = _mm_min_epi16(s, vmin);
+        vidx = simd::select(lt, dv, vidx);
+      }
+      alignas(16) std::uint16_t mins[kLanes], idxs[kLanes];
+      _mm_store_si128(reinterpret_cast<__m128i*>(mins), vmin);
+      _mm_store_si128(reinterpret_cast<__m128i*>(idxs), vidx);
+      best_d = n;
+      for (int i = 0; i < kLanes; i++) {
+        if (mins[i] < best_cost || (mins[i] == best_cost && idxs[i] < best_d)) {
+          best_cost = mins[i];
+          best_d = idxs[i];
+        }
+      }
+#else
+      for (int d = 0; d < limit; d++) {
+        if (sums[d] < best_cost) {
+          best_cost = sums[d];
+          best_d = d;
+        }
+      }
+#endif
+      if (best_d == 0) continue;
+
+      if (uniqueness_ > 0) {
+        // any other, except the neighbours, within the ratio
+        const int threshold = std::min<int>(
+            best_cost + best_cost * uniqueness_ / 100, kCostMax - 1);
+        int count = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+        const __m128i vt = _mm_set1_epi16(static_cast<short>(threshold + 1));
+        for (int d = 0; d < limit; d += kLanes) {
+          __m128i s = _mm_load_si128(
+              reinterpret_cast<const __m128i*>(sums + d));
+          if (d + kLanes > limit) {
+            const __m128i dv = _mm_add_epi16(lanes,
+                _mm_set1_epi16(static_cast<short>(d)));
+            s = simd::select(_mm_cmplt_epi16(dv, vlimit), s, vmax);
+          }
+          count += bit_count(_mm_movemask_epi8(_mm_cmplt_epi16(s, vt))) / 2;
+        }
+#else
+        for (int d = 0; d < limit; d++) {
+          if (sums[d] <= threshold) ++count;
+        }
+#endif
+        for (int d = best_d - 1; d <= best_d + 1; d++) {
+          if (d >= 0 && d < limit && sums[d] <= threshold) --count;
+        }
+        if (count > 0) continue;
+      }
+
+      // the parabola of the neighbours, in the subpixel bits
+      int sub = best_d << kSubpixelBits;
+      if (best_d + 1 < limit) {
+        const int c0 = sums[best_d - 1], c1 = sums[best_d],
+            c2 = sums[best_d + 1];
+        const int denom = c0 + c2 - 2 * c1;
+        if (denom > 0) {
+          sub += static_cast<int>(std::floor((c0 - c2) *
+              (1 << kSubpixelBits) / (2.f * denom) + 0.5f));
+        }
+      }
+      best[x] = best_d;
+      best_sub[x] = sub;
+      const int xr = x - best_d;
+      if (best_cost < right_cost[xr]) {
+        right_cost[xr] = best_cost;
+        right_best[xr] = best_d;
+      }
+    }
+
+    std::uint16_t* out = depth + v * w;
+    for (int x = 0; x < w; x++) {
+      out[x] = 0;
+      if (best[x] < 0) continue;
+      if (lr_max_diff_ >= 0 &&
+          std::abs(right_best[x - best[x]] - best[x]) > lr_max_diff_) {
+        continue;
+      }
+      const float z = depth_scale / best_sub[x] + 0.5f;
+      if (z >= 65536.f) continue;
+      // 4096 is the invalid of the device
+      std::uint16_t value = static_cast<std::uint16_t>(z);
+      out[x] = value == DEPTH_RAW_INVALID ? value + 1 : value;
+    }
+  }
+}
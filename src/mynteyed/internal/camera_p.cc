@@ -20,6 +20,7 @@
 
 #include "mynteyed/data/channels.h"
 #include "mynteyed/device/device.h"
+#include "mynteyed/imgproc/stereo_matcher.h"
 #include "mynteyed/internal/image_utils.h"
 #include "mynteyed/internal/motions.h"
 #include "mynteyed/internal/location.h"
@@ -50,6 +51,7 @@ void CameraPrivate::Init() {
   distance_ = std::make_shared<Distance>();
   streams_ = std::make_shared<Streams>(device_);
   m_filter_manager = std::make_shared<FilterSpigot>();
+  streams_->SetDepthFilter(m_filter_manager);
 
   reconnect_times_ = 0;
 
@@ -111,6 +113,7 @@ ErrorCode CameraPrivate::Open(const OpenParams& params) {
         streams_->EnableStreamData(ImageType::IMAGE_DEPTH);
         break;
     }
+    if (streams_->IsRectificationEnabled()) UpdateRectification();
     streams_->OnCameraOpen();
 #ifdef MYNTEYE_OS_LINUX
     // control whether reconnect
@@ -391,9 +394,174 @@ void CameraPrivate::SetMotionCallback(motion_callback_t callback, bool async) {
   }
 }
 
+bool CameraPrivate::AddDepthFilter(const std::string& name,
+    std::shared_ptr<BaseFilter> filter, std::size_t location) {
+  return m_filter_manager->AddFilter(name, filter, location);
+}
+
+bool CameraPrivate::DeleteDepthFilter(const std::string& name) {
+  return m_filter_manager->DeleteFilter(name);
+}
+
+bool CameraPrivate::DeleteDepthFilter(std::shared_ptr<BaseFilter> filter) {
+  return m_filter_manager->DeleteFilter(filter);
+}
+
+std::vector<FilterCost> CameraPrivate::GetDepthFilterCosts() const {
+  return m_filter_manager->GetFilterCosts();
+}
+
+void CameraPrivate::EnableDepthFilterAsync(std::size_t max_queued) {
+  streams_->EnableDepthFilterAsync(max_queued);
+}
+
+void CameraPrivate::DisableDepthFilterAsync() {
+  streams_->DisableDepthFilterAsync();
+}
+
+bool CameraPrivate::IsDepthFilterAsyncEnabled() const {
+  return streams_->IsDepthFilterAsyncEnabled();
+}
+
+FilterCost CameraPrivate::GetDepthFilterLatency() const {
+  return streams_->GetDepthFilterLatency();
+}
+
+void CameraPrivate::EnableImagePyramid(int levels,
+    const ImageFormat& format) {
+  streams_->EnableImagePyramid(levels, format);
+}
+
+void CameraPrivate::DisableImagePyramid() {
+  streams_->DisableImagePyramid();
+}
+
+bool CameraPrivate::IsImagePyramidEnabled() const {
+  return streams_->IsImagePyramidEnabled();
+}
+
+void CameraPrivate::EnableDepthMask(bool confidence) {
+  streams_->EnableDepthMask(confidence);
+}
+
+void CameraPrivate::DisableDepthMask() {
+  streams_->DisableDepthMask();
+}
+
+bool CameraPrivate::IsDepthMaskEnabled() const {
+  return streams_->IsDepthMaskEnabled();
+}
+
+void CameraPrivate::EnableImageStats(const ImageStatsParams& params) {
+  streams_->EnableImageStats(params);
+}
+
+void CameraPrivate::DisableImageStats() {
+  streams_->DisableImageStats();
+}
+
+bool CameraPrivate::IsImageStatsEnabled() const {
+  return streams_->IsImageStatsEnabled();
+}
+
+void CameraPrivate::EnableChangeGate(const ChangeGateParams& params) {
+  streams_->EnableChangeGate(params);
+}
+
+void CameraPrivate::DisableChangeGate() {
+  streams_->DisableChangeGate();
+}
+
+bool CameraPrivate::IsChangeGateEnabled() const {
+  return streams_->IsChangeGateEnabled();
+}
+
+bool CameraPrivate::EnableRectification(const ImageFormat& format,
+    int width, int height) {
+  if (format != ImageFormat::COLOR_BGR && format != ImageFormat::COLOR_RGB &&
+      format != ImageFormat::IMAGE_GRAY_8) {
+    LOGW("%s: format %d not supported", __func__, static_cast<int>(format));
+    return false;
+  }
+  streams_->EnableRectification(format, width, height);
+  // otherwise set on open
+  if (!IsOpened()) return true;
+  return UpdateRectification();
+}
+
+void CameraPrivate::DisableRectification() {
+  streams_->DisableRectification();
+}
+
+bool CameraPrivate::IsRectificationEnabled() const {
+  return streams_->IsRectificationEnabled();
+}
+
+bool CameraPrivate::UpdateRectification() {
+  bool ok = false;
+  auto&& intrinsics = GetStreamIntrinsics(
+      device_->GetOpenParams().stream_mode, &ok);
+  if (!ok) {
+    LOGW("%s: stream calibration not found", __func__);
+    streams_->SetRectificationIntrinsics(nullptr);
+    return false;
+  }
+  streams_->SetRectificationIntrinsics(
+      std::make_shared<StreamIntrinsics>(intrinsics));
+  return true;
+}
+
+bool CameraPrivate::EnableHostDepth(int width, int height) {
+  if (!IsOpened()) {
+    LOGW("%s: camera should be opened", __func__);
+    return false;
+  }
+  auto&& stream_mode = device_->GetOpenParams().stream_mode;
+  if (!device_->IsRightColorSupported(stream_mode)) {
+    LOGW("%s: must use the stream mode of left and right color", __func__);
+    return false;
+  }
+  bool ok = false;
+  auto&& intrinsics = GetStreamIntrinsics(stream_mode, &ok);
+  StreamExtrinsics extrinsics;
+  if (ok) extrinsics = GetStreamExtrinsics(stream_mode, &ok);
+  if (!ok) {
+    LOGW("%s: stream calibration not found", __func__);
+    return false;
+  }
+  if (width <= 0 || height <= 0) {
+    width = intrinsics.left.width / 2;
+    height = intrinsics.left.height / 2;
+  }
+  auto&& matcher = std::make_shared<StereoMatcher>();
+  matcher->SetStreamParams(intrinsics, extrinsics, width, height);
+  streams_->SetStereoMatcher(matcher);
+  streams_->EnableStreamData(ImageType::IMAGE_DEPTH);
+  return true;
+}
+
+void CameraPrivate::DisableHostDepth() {
+  if (!streams_->GetStereoMatcher()) return;
+  streams_->SetStereoMatcher(nullptr);
+  // keep the depth of device, if opened
+  if (!device_->DepthDeviceOpened()) {
+    streams_->DisableStreamData(ImageType::IMAGE_DEPTH);
+  }
+}
+
+bool CameraPrivate::IsHostDepthEnabled() const {
+  return streams_->GetStereoMatcher() != nullptr;
+}
+
+std::shared_ptr<StereoMatcher> CameraPrivate::GetHostDepthMatcher() const {
+  return streams_->GetStereoMatcher();
+}
+
 void CameraPrivate::Close() {
   if (!IsOpened()) return;
   StopDataTracking();
+  // the params of matcher are of the stream mode opened
+  DisableHostDepth();
   streams_->OnCameraClose();
   device_->Close();
 }
@@ -162,6 +162,64 @@ class MYNTEYE_API CameraPrivate {
   /** Set motion data callback. */
   void SetMotionCallback(motion_callback_t callback, bool async);
 
+  /** Add a filter to depth stream. */
+  bool AddDepthFilter(const std::string& name,
+      std::shared_ptr<BaseFilter> filter, std::size_t location);
+  /** Delete a filter from depth stream. */
+  bool DeleteDepthFilter(const std::string& name);
+  /** Delete a filter from depth stream. */
+  bool DeleteDepthFilter(std::shared_ptr<BaseFilter> filter);
+  /** Get the time costs of depth filters. */
+  std::vector<FilterCost> GetDepthFilterCosts() const;
+  /** Enable filtering depth on a dedicated thread. */
+  void EnableDepthFilterAsync(std::size_t max_queued);
+  /** Disable filtering depth on a dedicated thread. */
+  void DisableDepthFilterAsync();
+  /** Whethor filtering depth on a dedicated thread or not */
+  bool IsDepthFilterAsyncEnabled() const;
+  /** Get the latency from depth captured to delivered. */
+  FilterCost GetDepthFilterLatency() const;
+  /** Enable the image pyramids of color stream data. */
+  void EnableImagePyramid(int levels, const ImageFormat& format);
+  /** Disable the image pyramids of color stream data. */
+  void DisableImagePyramid();
+  /** Whethor building the image pyramids or not */
+  bool IsImagePyramidEnabled() const;
+  /** Enable the validity masks of depth stream data. */
+  void EnableDepthMask(bool confidence);
+  /** Disable the validity masks of depth stream data. */
+  void DisableDepthMask();
+  /** Whethor packing the validity masks or not */
+  bool IsDepthMaskEnabled() const;
+
+  /** Enable the luma statistics of color stream data. */
+  void EnableImageStats(const ImageStatsParams& params);
+  /** Disable the luma statistics of color stream data. */
+  void DisableImageStats();
+  /** Whethor accumulating the luma statistics or not */
+  bool IsImageStatsEnabled() const;
+
+  /** Enable the change gates of stream data. */
+  void EnableChangeGate(const ChangeGateParams& params);
+  /** Disable the change gates of stream data. */
+  void DisableChangeGate();
+  /** Whethor gating the unchanged stream data or not */
+  bool IsChangeGateEnabled() const;
+  /** Enable the rectified color of stream data. */
+  bool EnableRectification(const ImageFormat& format, int width, int height);
+  /** Disable the rectified color of stream data. */
+  void DisableRectification();
+  /** Whethor rectifying the color or not */
+  bool IsRectificationEnabled() const;
+  /** Enable the depth matched on host from the color pair. */
+  bool EnableHostDepth(int width, int height);
+  /** Disable the depth matched on host. */
+  void DisableHostDepth();
+  /** Whethor matching the depth on host or not */
+  bool IsHostDepthEnabled() const;
+  /** Get the matcher of the depth on host. */
+  std::shared_ptr<StereoMatcher> GetHostDepthMatcher() const;
+
   /** Close the camera */
   void Close();
 
@@ -277,6 +335,9 @@ class MYNTEYE_API CameraPrivate {
 
   void NotifyDataTrackStateChanged();
 
+  /** Set the intrinsics of the stream mode opened to rectify the color */
+  bool UpdateRectification();
+
   std::shared_ptr<Device> device_;
   std::shared_ptr<Channels> channels_;
   std::shared_ptr<Motions> motions_;
@@ -13,7 +13,14 @@
 // limitations under the License.
 #include "mynteyed/internal/streams.h"
 
+#include <algorithm>
+
 #include "mynteyed/device/device.h"
+#include "mynteyed/filter/depth_mask.h"
+#include "mynteyed/filter/filter_spigot.h"
+#include "mynteyed/imgproc/image_pyramid.h"
+#include "mynteyed/imgproc/rectification.h"
+#include "mynteyed/imgproc/stereo_matcher.h"
 #include "mynteyed/util/log.h"
 #include "mynteyed/util/rate.h"
 #include "mynteyed/util/strings.h"
@@ -24,6 +31,8 @@
 #define STREAM_DATAS_MAX_SIZE 4
 #define IMG_INFO_QUEUE_MAX_SIZE 120  // 60fps, 2s
 #define IMG_INFO_SYNC_FREQUENCY 100  // 100hz
+// the depth masks held by users at the same time, more are not reused
+#define DEPTH_MASKS_MAX_SIZE 8
 
 MYNTEYE_USE_NAMESPACE
 
@@ -53,12 +62,20 @@ Streams::Streams(std::shared_ptr<Device> device)
     img_data_callbacks_({
       {ImageType::IMAGE_LEFT_COLOR, nullptr},
       {ImageType::IMAGE_RIGHT_COLOR, nullptr},
-      {ImageType::IMAGE_DEPTH, nullptr}}) {
+      {ImageType::IMAGE_DEPTH, nullptr}}),
+    is_depth_filter_async_(false),
+    depth_filter_latency_({"latency", 0, 0, 0}),
+    is_depth_mask_enabled_(false),
+    is_depth_mask_confidence_(false),
+    rectification_format_(ImageFormat::COLOR_BGR),
+    has_rectification_intrinsics_(false) {
 
     match_.reset(new Match());
 }
 
 Streams::~Streams() {
+  std::lock_guard<std::mutex> _(depth_filter_thread_mutex_);
+  StopDepthFilterThread();
 }
 
 void Streams::EnableImageInfo(bool sync) {
@@ -168,6 +185,201 @@ void Streams::SetStreamCallback(const ImageType& type,
   img_data_callbacks_[type] = callback;
 }
 
+void Streams::SetDepthFilter(std::shared_ptr<FilterSpigot> filter) {
+  depth_filter_ = filter;
+}
+
+void Streams::EnableDepthFilterAsync(std::size_t max_queued) {
+  std::lock_guard<std::mutex> _(depth_filter_thread_mutex_);
+  StopDepthFilterThread();
+  StartDepthFilterThread(std::max<std::size_t>(max_queued, 1));
+}
+
+void Streams::DisableDepthFilterAsync() {
+  std::lock_guard<std::mutex> _(depth_filter_thread_mutex_);
+  StopDepthFilterThread();
+}
+
+bool Streams::IsDepthFilterAsyncEnabled() const {
+  return is_depth_filter_async_;
+}
+
+FilterCost Streams::GetDepthFilterLatency() {
+  std::lock_guard<std::mutex> _(depth_filter_latency_mutex_);
+  return depth_filter_latency_;
+}
+
+void Streams::EnableImagePyramid(int levels, const ImageFormat& format) {
+  std::lock_guard<std::mutex> _(pyramid_builder_mutex_);
+  if (!pyramid_builder_) {
+    pyramid_builder_ = std::make_shared<ImagePyramidBuilder>();
+  }
+  pyramid_builder_->SetLevels(levels, format);
+}
+
+void Streams::DisableImagePyramid() {
+  std::lock_guard<std::mutex> _(pyramid_builder_mutex_);
+  pyramid_builder_ = nullptr;
+}
+
+bool Streams::IsImagePyramidEnabled() const {
+  std::lock_guard<std::mutex> _(pyramid_builder_mutex_);
+  return pyramid_builder_ != nullptr;
+}
+
+void Streams::EnableRectification(const ImageFormat& format, int width,
+    int height) {
+  std::lock_guard<std::mutex> _(rectification_mutex_);
+  if (!left_rectification_) {
+    left_rectification_ = std::make_shared<Rectification>();
+    right_rectification_ = std::make_shared<Rectification>();
+  }
+  left_rectification_->SetOutputSize(width, height);
+  right_rectification_->SetOutputSize(width, height);
+  rectification_format_ = format;
+}
+
+void Streams::DisableRectification() {
+  std::lock_guard<std::mutex> _(rectification_mutex_);
+  left_rectification_ = nullptr;
+  right_rectification_ = nullptr;
+  has_rectification_intrinsics_ = false;
+}
+
+bool Streams::IsRectificationEnabled() const {
+  std::lock_guard<std::mutex> _(rectification_mutex_);
+  return left_rectification_ != nullptr;
+}
+
+void Streams::SetRectificationIntrinsics(
+    const std::shared_ptr<StreamIntrinsics>& intrinsics) {
+  std::lock_guard<std::mutex> _(rectification_mutex_);
+  has_rectification_intrinsics_ = intrinsics && left_rectification_;
+  if (!has_rectification_intrinsics_) return;
+  // the maps are rebuilt only if changed, e.g. another stream mode
+  left_rectification_->SetIntrinsics(intrinsics->left);
+  right_rectification_->SetIntrinsics(intrinsics->right);
+}
+
+void Streams::EnableDepthMask(bool confidence) {
+  std::lock_guard<std::mutex> _(depth_mask_mutex_);
+  is_depth_mask_enabled_ = true;
+  is_depth_mask_confidence_ = confidence;
+}
+
+void Streams::DisableDepthMask() {
+  std::lock_guard<std::mutex> _(depth_mask_mutex_);
+  is_depth_mask_enabled_ = false;
+  depth_masks_.clear();
+}
+
+bool Streams::IsDepthMaskEnabled() const {
+  std::lock_guard<std::mutex> _(depth_mask_mutex_);
+  return is_depth_mask_enabled_;
+}
+
+void Streams::EnableImageStats(const ImageStatsParams& params) {
+  std::lock_guard<std::mutex> _(image_stats_mutex_);
+  // a new one, as the images captured still share the last
+  image_stats_params_ = std::make_shared<const ImageStatsParams>(params);
+}
+
+void Streams::DisableImageStats() {
+  std::lock_guard<std::mutex> _(image_stats_mutex_);
+  image_stats_params_ = nullptr;
+}
+
+bool Streams::IsImageStatsEnabled() const {
+  std::lock_guard<std::mutex> _(image_stats_mutex_);
+  return image_stats_params_ != nullptr;
+}
+
+void Streams::EnableChangeGate(const ChangeGateParams& params) {
+  std::lock_guard<std::mutex> _(change_gate_mutex_);
+  color_gate_ = std::make_shared<ChangeGate>(params);
+  depth_gate_ = std::make_shared<ChangeGate>(params);
+  last_datas_.clear();
+}
+
+void Streams::DisableChangeGate() {
+  std::lock_guard<std::mutex> _(change_gate_mutex_);
+  color_gate_ = nullptr;
+  depth_gate_ = nullptr;
+  last_datas_.clear();
+}
+
+bool Streams::IsChangeGateEnabled() const {
+  std::lock_guard<std::mutex> _(change_gate_mutex_);
+  return color_gate_ != nullptr;
+}
+
+std::shared_ptr<DepthMask> Streams::AcquireDepthMask() {
+  std::lock_guard<std::mutex> _(depth_mask_mutex_);
+  if (!is_depth_mask_enabled_) return nullptr;
+  std::shared_ptr<DepthMask> mask;
+  for (auto&& m : depth_masks_) {
+    // the pool holds the only one, so no others could get it now
+    if (m.use_count() == 1) {
+      mask = m;
+      break;
+    }
+  }
+  if (!mask) {
+    mask = std::make_shared<DepthMask>();
+    if (depth_masks_.size() < DEPTH_MASKS_MAX_SIZE) {
+      depth_masks_.push_back(mask);
+    }
+  }
+  mask->Clear(is_depth_mask_confidence_);
+  return mask;
+}
+
+void Streams::SetStereoMatcher(std::shared_ptr<StereoMatcher> matcher) {
+  std::lock_guard<std::mutex> _(stereo_matcher_mutex_);
+  stereo_matcher_ = matcher;
+}
+
+std::shared_ptr<StereoMatcher> Streams::GetStereoMatcher() const {
+  std::lock_guard<std::mutex> _(stereo_matcher_mutex_);
+  return stereo_matcher_;
+}
+
+void Streams::StartDepthFilterThread(std::size_t max_queued) {
+  auto queue = std::make_shared<depth_filter_queue_t>(max_queued);
+  {
+    std::lock_guard<std::mutex> _(depth_filter_queue_mutex_);
+    depth_filter_queue_ = queue;
+    is_depth_filter_async_ = true;
+  }
+  depth_filter_thread_ = std::thread([this, queue]() {
+    for (;;) {
+      auto&& job = queue->Take();
+      if (!job.depth) break;  // stop
+      DoImageDepthFiltered(job);
+    }
+  });
+}
+
+void Streams::StopDepthFilterThread() {
+  std::deque<DepthFilterJob> pending;
+  {
+    std::lock_guard<std::mutex> _(depth_filter_queue_mutex_);
+    if (!is_depth_filter_async_) return;
+    is_depth_filter_async_ = false;
+    // take the waiting ones, then wake up with an empty job, the capture
+    // thread puts no more as it checks the flag under the lock
+    pending = depth_filter_queue_->MoveAll();
+    depth_filter_queue_->Put({nullptr, nullptr, times::now(), false});
+  }
+  if (depth_filter_thread_.joinable()) {
+    depth_filter_thread_.join();
+  }
+  // deliver the waiting ones after the one being filtered, in order
+  for (auto&& job : pending) {
+    if (job.depth) DoImageDepthFiltered(job);
+  }
+}
+
 void Streams::OnCameraOpen() {
   is_right_color_supported_ = device_->IsRightColorSupported();
   match_->InitStreamKey(device_->DepthDeviceOpened());
@@ -176,6 +388,8 @@ void Streams::OnCameraOpen() {
 
 void Streams::OnCameraClose() {
   StopStreamCapturing();
+  // the intrinsics are of the stream mode opened
+  SetRectificationIntrinsics(nullptr);
 }
 
 void Streams::OnImageInfoCallback(const ImgInfoPacket& packet) {
@@ -213,11 +427,14 @@ Streams::StreamType Streams::GetStreamType(const ImageType& type) const {
 }
 
 bool Streams::IsStreamEnabled(const StreamType& type) const {
+  // the depth is matched from color, if the matcher is set
+  const bool matched = IsStreamDataEnabled(ImageType::IMAGE_DEPTH)
+      && GetStereoMatcher() != nullptr;
   if (type == STREAM_COLOR) {
     return IsStreamDataEnabled(ImageType::IMAGE_LEFT_COLOR)
-        || IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR);
+        || IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR) || matched;
   } else if (type == STREAM_DEPTH) {
-    return IsStreamDataEnabled(ImageType::IMAGE_DEPTH);
+    return IsStreamDataEnabled(ImageType::IMAGE_DEPTH) && !matched;
   }
   return false;
 }
@@ -349,6 +566,9 @@ void Streams::SyncStreamWithInfo(bool force) {
 void Streams::OnStreamSyncedInfoCaptured(const StreamType& type,
     const Image::pointer& stream,
     const img_info_ptr_t& stream_info) {
+  if (stream_info) {
+    stream->set_timestamp(stream_info->timestamp);
+  }
   if (type == StreamType::STREAM_COLOR) {
     DoImageColorCaptured(stream, stream_info);
   } else if (type == StreamType::STREAM_DEPTH) {
@@ -366,10 +586,19 @@ void Streams::CaptureStreamColor() {
   // LOGI("%s: %d", __func__, color->frame_id());
 
   color->set_is_dual(is_right_color_supported_);
+  {
+    // the stats are accumulated in the copy below, or in a pass if no copy,
+    // or in To() of MJPG
+    std::lock_guard<std::mutex> _(image_stats_mutex_);
+    color->set_stats_params(image_stats_params_);
+    color->set_stats(nullptr);
+  }
 
   // Ensure not buffer to user, as it may changed when captured again.
   if (color->is_buffer()) {
     color = color->Clone();
+  } else {
+    color->AccumulateStats();
   }
 
   if (is_image_info_sync_) {
@@ -401,6 +630,25 @@ void Streams::CaptureStreamDepth() {
 
 void Streams::DoImageColorCaptured(const Image::pointer& color,
     const img_info_ptr_t& info) {
+  std::vector<ImageType> types;
+  if (color->is_dual()) {
+    for (auto&& type : {ImageType::IMAGE_LEFT_COLOR,
+        ImageType::IMAGE_RIGHT_COLOR}) {
+      if (IsStreamDataEnabled(type)) types.push_back(type);
+    }
+  } else {
+    types.push_back(color->type());
+  }
+  auto&& matcher = color->is_dual() &&
+      IsStreamDataEnabled(ImageType::IMAGE_DEPTH) ? GetStereoMatcher() :
+      nullptr;
+  if (!PassChangeGate(STREAM_COLOR, color, types)) {
+    DoImageUnchanged(color, info, types);
+    // the depth of the last changed color, in order with it
+    if (matcher) DoImageDepthGated(color, info, true);
+    return;
+  }
+
   if (color->is_dual()) {
     // left, right may only one or both enabled
     if (IsStreamDataEnabled(ImageType::IMAGE_LEFT_COLOR)) {
@@ -409,6 +657,14 @@ void Streams::DoImageColorCaptured(const Image::pointer& color,
     if (IsStreamDataEnabled(ImageType::IMAGE_RIGHT_COLOR)) {
       DoStreamDataCaptured(color->Shadow(ImageType::IMAGE_RIGHT_COLOR), info);
     }
+    if (matcher) {
+      // a new depth each frame, as it is delivered to user, then filtered as
+      // the one of device
+      Image::pointer depth;
+      if (matcher->ProcessColor(color, &depth)) {
+        DoImageDepthGated(depth, info, false);
+      }
+    }
   } else /*if (left_enabled)*/ {
     // left must enabled if left only, as could not enable right if left only
     DoStreamDataCaptured(color, info);
@@ -417,13 +673,131 @@ void Streams::DoImageColorCaptured(const Image::pointer& color,
 
 void Streams::DoImageDepthCaptured(const Image::pointer& depth,
     const img_info_ptr_t& info) {
-  DoStreamDataCaptured(depth, info);
+  bool unchanged = !PassChangeGate(STREAM_DEPTH, depth, {depth->type()});
+  DoImageDepthGated(depth, info, unchanged);
+}
+
+void Streams::DoImageDepthGated(const Image::pointer& depth,
+    const img_info_ptr_t& info, bool unchanged) {
+  if (is_depth_filter_async_) {
+    std::lock_guard<std::mutex> _(depth_filter_queue_mutex_);
+    if (is_depth_filter_async_) {
+      // filter next frame while capturing, deliver on the filter thread, all
+      // of them, so the unchanged follow the last changed one in order
+      depth_filter_queue_->Put({depth, info, times::now(), unchanged});
+      return;
+    }
+  }
+  DoImageDepthFiltered({depth, info, times::now(), unchanged});
+}
+
+void Streams::DoImageDepthFiltered(const DepthFilterJob& job) {
+  if (job.unchanged) {
+    DoImageUnchanged(job.depth, job.info, {ImageType::IMAGE_DEPTH});
+    return;
+  }
+  if (!depth_filter_ || job.depth->format() != ImageFormat::DEPTH_RAW) {
+    DoStreamDataCaptured(job.depth, job.info);
+    return;
+  }
+  // Filters run in place, as depth is not the device buffer here, the last
+  // one packs the mask
+  auto&& mask = AcquireDepthMask();
+  depth_filter_->ProcessFrame(job.depth, job.depth, mask.get());
+  {
+    std::lock_guard<std::mutex> _(depth_filter_latency_mutex_);
+    auto&& latency = depth_filter_latency_;
+    latency.last_ms =
+        times::count<times::microseconds>(times::now() - job.time) * 0.001;
+    ++latency.count;
+    latency.avg_ms += (latency.last_ms - latency.avg_ms) / latency.count;
+  }
+  DoStreamDataCaptured(job.depth, job.info, mask);
+}
+
+bool Streams::PassChangeGate(const StreamType& stream,
+    const Image::pointer& image, const std::vector<ImageType>& types) {
+  std::shared_ptr<ChangeGate> gate;
+  bool has_lasts = true;
+  {
+    std::lock_guard<std::mutex> _(change_gate_mutex_);
+    gate = stream == STREAM_COLOR ? color_gate_ : depth_gate_;
+    if (!gate) return true;
+    for (auto&& type : types) {
+      if (last_datas_.find(type) == last_datas_.end()) has_lasts = false;
+    }
+  }
+  // pass anyway if some type has no last data, e.g. enabled now
+  return gate->Process(image, !has_lasts);
+}
+
+void Streams::DoImageUnchanged(const Image::pointer& image,
+    const img_info_ptr_t& info, const std::vector<ImageType>& types) {
+  std::vector<StreamData> lasts;
+  {
+    std::lock_guard<std::mutex> _(change_gate_mutex_);
+    for (auto&& type : types) {
+      auto&& it = last_datas_.find(type);
+      if (it != last_datas_.end()) lasts.push_back(it->second);
+    }
+  }
+  for (auto&& last : lasts) {
+    auto&& type = last.img->type();
+    // shares the data of the last, so no copy
+    auto img = last.img->Shadow(type);
+    img->set_frame_id(image->frame_id());
+    img->set_timestamp(image->timestamp());
+    StreamData data{img, info, last.pyramid, last.mask, last.stats, true,
+        last.rectified};
+    NotifyStreamData(type, data);
+    if (img_data_callbacks_[type]) {
+      img_data_callbacks_[type](data);
+    }
+  }
 }
 
 void Streams::DoStreamDataCaptured(const Image::pointer& image,
-    const img_info_ptr_t& info) {
+    const img_info_ptr_t& info, const std::shared_ptr<DepthMask>& mask) {
   auto&& type = image->type();
-  StreamData data{image, info};
+  std::shared_ptr<DepthMask> depth_mask = mask;
+  if (!depth_mask && IsStreamDepth(type) &&
+      image->format() == ImageFormat::DEPTH_RAW) {
+    // not filtered, e.g. of host, so packs in a pass
+    depth_mask = AcquireDepthMask();
+    if (depth_mask) depth_mask->Pack(image);
+  }
+  std::shared_ptr<ImagePyramid> pyramid;
+  if (IsStreamColor(type)) {
+    std::shared_ptr<ImagePyramidBuilder> builder;
+    {
+      std::lock_guard<std::mutex> _(pyramid_builder_mutex_);
+      builder = pyramid_builder_;
+    }
+    if (builder) pyramid = builder->Process(image);
+  }
+  Image::pointer rectified;
+  if (IsStreamColor(type)) {
+    std::shared_ptr<Rectification> rectification;
+    ImageFormat format;
+    {
+      std::lock_guard<std::mutex> _(rectification_mutex_);
+      if (has_rectification_intrinsics_) {
+        rectification = type == ImageType::IMAGE_LEFT_COLOR ?
+            left_rectification_ : right_rectification_;
+      }
+      format = rectification_format_;
+    }
+    // a new one each frame, as it is delivered to user
+    if (rectification && !rectification->Process(image, format, &rectified)) {
+      rectified = nullptr;
+    }
+  }
+  StreamData data{image, info, pyramid, depth_mask, image->stats(), false,
+      rectified};
+  {
+    std::lock_guard<std::mutex> _(change_gate_mutex_);
+    if (color_gate_) last_datas_[type] = data;
+  }
   NotifyStreamData(type, data);
   if (img_data_callbacks_[type]) {
     img_data_callbacks_[type](data);
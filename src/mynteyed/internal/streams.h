@@ -15,22 +15,33 @@
 #define MYNTEYE_INTERNAL_STREAMS_H_
 #pragma once
 
-// #include <atomic>
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <set>
 #include <thread>
 #include <vector>
 
 #include "mynteyed/data/types_internal.h"
+#include "mynteyed/device/image_stats.h"
+#include "mynteyed/imgproc/change_gate.h"
+#include "mynteyed/filter/base_filter.h"
 #include "mynteyed/internal/blocking_queue.h"
 #include "mynteyed/types.h"
+#include "mynteyed/util/times.h"
 
 MYNTEYE_BEGIN_NAMESPACE
 
+class ChangeGate;
+class DepthMask;
 class Device;
+class FilterSpigot;
+class ImagePyramidBuilder;
 class Match;
+class Rectification;
+class StereoMatcher;
 
 class Streams {
  public:
@@ -60,6 +71,18 @@ class Streams {
   using stream_queue_t = queue_t<Image::pointer>;
   using stream_queue_ptr_t = std::shared_ptr<stream_queue_t>;
 
+  // depth filter queue, only for async
+  struct DepthFilterJob {
+    Image::pointer depth;
+    img_info_ptr_t info;
+    times::clock::time_point time;
+    // not changed, the last depth is delivered in order, depth may be the
+    // color matched for it then
+    bool unchanged;
+  };
+  using depth_filter_queue_t = queue_t<DepthFilterJob>;
+  using depth_filter_queue_ptr_t = std::shared_ptr<depth_filter_queue_t>;
+
   explicit Streams(std::shared_ptr<Device> device);
   ~Streams();
 
@@ -97,6 +120,77 @@ class Streams {
 
   void SetStreamCallback(const ImageType& type, img_data_callback_t callback);
 
+  /** Set the filter chain of depth stream. */
+  void SetDepthFilter(std::shared_ptr<FilterSpigot> filter);
+
+  /**
+   * Enable filtering depth on a dedicated thread.
+   *
+   * max_queued is the depth of the queue in front of the one filter thread,
+   * the frames waiting besides the one being filtered, the oldest one is
+   * dropped if full. Frames are filtered in order, the waiting ones are
+   * delivered when disabled.
+   */
+  void EnableDepthFilterAsync(std::size_t max_queued);
+  void DisableDepthFilterAsync();
+  bool IsDepthFilterAsyncEnabled() const;
+
+  /** Get the latency from depth captured to delivered. */
+  FilterCost GetDepthFilterLatency();
+
+  /**
+   * Enable the pyramids of color stream data.
+   *
+   * levels is the half levels after the full size, format is IMAGE_GRAY_8,
+   * COLOR_BGR or COLOR_RGB.
+   */
+  void EnableImagePyramid(int levels, const ImageFormat& format);
+  void DisableImagePyramid();
+  bool IsImagePyramidEnabled() const;
+
+  /**
+   * Enable the validity masks of depth stream data, with the confidences of
+   * the filters if confidence.
+   */
+  void EnableDepthMask(bool confidence);
+  void DisableDepthMask();
+  bool IsDepthMaskEnabled() const;
+
+  /**
+   * Enable the luma statistics of color stream data, accumulated in the
+   * capture copy, or in the conversion if no copy.
+   */
+  void EnableImageStats(const ImageStatsParams& params);
+  void DisableImageStats();
+  bool IsImageStatsEnabled() const;
+
+  /**
+   * Enable the change gates of color and depth, the unchanged frames are not
+   * processed, but delivered as the last changed data.
+   */
+  void EnableChangeGate(const ChangeGateParams& params);
+  void DisableChangeGate();
+  bool IsChangeGateEnabled() const;
+
+  /**
+   * Enable the rectified color of stream data, into format of width x height,
+   * 0 means of the intrinsics. The maps are built by the intrinsics of the
+   * stream mode, set on open.
+   */
+  void EnableRectification(const ImageFormat& format, int width, int height);
+  void DisableRectification();
+  bool IsRectificationEnabled() const;
+  /** Set the intrinsics of the stream mode opened, nullptr means none. */
+  void SetRectificationIntrinsics(
+      const std::shared_ptr<StreamIntrinsics>& intrinsics);
+
+  /**
+   * Set the matcher of depth from the color pair, instead of the depth of
+   * device, nullptr means none.
+   */
+  void SetStereoMatcher(std::shared_ptr<StereoMatcher> matcher);
+  std::shared_ptr<StereoMatcher> GetStereoMatcher() const;
+
   void OnCameraOpen();
   void OnCameraClose();
 
@@ -142,7 +236,31 @@ class Streams {
       const img_info_ptr_t& info);
 
   void DoStreamDataCaptured(const Image::pointer& image,
-      const img_info_ptr_t& info);
+      const img_info_ptr_t& info,
+      const std::shared_ptr<DepthMask>& mask = nullptr);
+
+  // delivers the depth of device or matched, passed the change gate or not,
+  // through the filter thread if async
+  void DoImageDepthGated(const Image::pointer& depth,
+      const img_info_ptr_t& info, bool unchanged);
+  // filters DEPTH_RAW, then delivers
+  void DoImageDepthFiltered(const DepthFilterJob& job);
+
+  // true if image passes the change gate of stream, otherwise it should be
+  // delivered with DoImageUnchanged
+  bool PassChangeGate(const StreamType& stream, const Image::pointer& image,
+      const std::vector<ImageType>& types);
+
+  // delivers the last changed data of types as unchanged, the last is read
+  // now, so must be called in the order of delivering
+  void DoImageUnchanged(const Image::pointer& image,
+      const img_info_ptr_t& info, const std::vector<ImageType>& types);
+
+  // a mask of the pool, nullptr if disabled
+  std::shared_ptr<DepthMask> AcquireDepthMask();
+
+  void StartDepthFilterThread(std::size_t max_queued);
+  void StopDepthFilterThread();
 
   std::shared_ptr<Device> device_;
 
@@ -170,6 +288,51 @@ class Streams {
   std::map<ImageType, img_data_callback_t> img_data_callbacks_;
 
   std::shared_ptr<Match> match_;
+
+  std::shared_ptr<FilterSpigot> depth_filter_;
+
+  // read on the capture thread, the queue is put and swapped with the lock
+  std::atomic<bool> is_depth_filter_async_;
+  std::thread depth_filter_thread_;
+  depth_filter_queue_ptr_t depth_filter_queue_;
+  std::mutex depth_filter_queue_mutex_;
+  // serializes the start and stop of the filter thread
+  std::mutex depth_filter_thread_mutex_;
+
+  FilterCost depth_filter_latency_;
+  std::mutex depth_filter_latency_mutex_;
+
+  // the pyramids of color, built on the capture thread
+  std::shared_ptr<ImagePyramidBuilder> pyramid_builder_;
+  mutable std::mutex pyramid_builder_mutex_;
+
+  // the masks of depth, reused if only held here
+  bool is_depth_mask_enabled_;
+  bool is_depth_mask_confidence_;
+  std::vector<std::shared_ptr<DepthMask>> depth_masks_;
+  mutable std::mutex depth_mask_mutex_;
+
+  // the params of the stats of color, nullptr if disabled
+  std::shared_ptr<const ImageStatsParams> image_stats_params_;
+  mutable std::mutex image_stats_mutex_;
+
+  // the change gates, nullptr if disabled, and the last changed data
+  std::shared_ptr<ChangeGate> color_gate_;
+  std::shared_ptr<ChangeGate> depth_gate_;
+  std::map<ImageType, StreamData> last_datas_;
+  mutable std::mutex change_gate_mutex_;
+
+  // the rectifications of left and right color, nullptr if disabled, the
+  // color is not rectified until the intrinsics are set on open
+  std::shared_ptr<Rectification> left_rectification_;
+  std::shared_ptr<Rectification> right_rectification_;
+  ImageFormat rectification_format_;
+  bool has_rectification_intrinsics_;
+  mutable std::mutex rectification_mutex_;
+
+  // the depth matched from color, built on the capture thread
+  std::shared_ptr<StereoMatcher> stereo_matcher_;
+  mutable std::mutex stereo_matcher_mutex_;
 };
 
 MYNTEYE_END_NAMESPACE
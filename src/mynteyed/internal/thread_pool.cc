@@ -0,0 +1,97 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/internal/thread_pool.h"
+
+#include <algorithm>
+
+MYNTEYE_USE_NAMESPACE
+
+ThreadPool::ThreadPool(std::size_t threads)
+  : body_(nullptr), count_(0), bands_(0), next_band_(0), pending_(0),
+    generation_(0), stop_(false) {
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  for (std::size_t i = 1; i < threads; i++) {
+    workers_.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto&& worker : workers_) {
+    if (worker.joinable()) worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const body_t& body,
+    std::size_t min_band) {
+  if (count == 0) return;
+  std::size_t bands = std::min(size(), count / std::max(min_band,
+      static_cast<std::size_t>(1)));
+  if (bands <= 1) {
+    body(0, count);
+    return;
+  }
+
+  std::lock_guard<std::mutex> job_lock(job_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = &body;
+    count_ = count;
+    bands_ = bands;
+    next_band_ = 0;
+    pending_ = workers_.size();
+    ++generation_;
+  }
+  cond_.notify_all();
+
+  RunBands();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [this] { return pending_ == 0; });
+  body_ = nullptr;
+}
+
+void ThreadPool::Run() {
+  std::uint64_t generation = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this, &generation] {
+        return stop_ || generation != generation_;
+      });
+      if (stop_) return;
+      generation = generation_;
+    }
+    RunBands();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_;
+    }
+    done_cond_.notify_one();
+  }
+}
+
+void ThreadPool::RunBands() {
+  for (;;) {
+    std::size_t band = next_band_++;
+    if (band >= bands_) break;
+    (*body_)(count_ * band / bands_, count_ * (band + 1) / bands_);
+  }
+}
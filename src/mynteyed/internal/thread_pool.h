@@ -0,0 +1,78 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_INTERNAL_THREAD_POOL_H_
+#define MYNTEYE_INTERNAL_THREAD_POOL_H_
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mynteyed/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+/**
+ * The pool of workers to run the bands of one job in parallel.
+ *
+ * The caller thread also runs bands, so a pool of n threads has n - 1
+ * workers. The workers sleep while no job.
+ */
+class ThreadPool {
+ public:
+  using body_t = std::function<void(std::size_t beg, std::size_t end)>;
+
+  /** threads: 0 means the hardware concurrency. */
+  explicit ThreadPool(std::size_t threads = 0);
+  ~ThreadPool();
+
+  /** The number of threads, including the caller. */
+  std::size_t size() const { return workers_.size() + 1; }
+
+  /**
+   * Split [0, count) into bands, run body on them in parallel and block until
+   * all done. The band is not less than min_band, if given.
+   */
+  void ParallelFor(std::size_t count, const body_t& body,
+      std::size_t min_band = 1);
+
+ private:
+  void Run();
+  void RunBands();
+
+  std::vector<std::thread> workers_;
+
+  // serialize the jobs from different callers
+  std::mutex job_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::condition_variable done_cond_;
+
+  const body_t *body_;
+  std::size_t count_;
+  std::size_t bands_;
+  std::atomic<std::size_t> next_band_;
+  std::size_t pending_;
+  std::uint64_t generation_;
+  bool stop_;
+};
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_INTERNAL_THREAD_POOL_H_
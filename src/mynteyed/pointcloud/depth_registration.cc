@@ -0,0 +1,511 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/depth_registration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least
+const std::size_t kBandMinRows = 16;
+
+// The empty rect of invalid pixels
+const std::int16_t kRectMin = -32768;
+const std::int16_t kRectMax = 32767;
+// The range of rect coords, beyond it is clipped anyway
+const float kCoordLimit = 32000.f;
+
+inline std::uint16_t to_depth(float z) {
+  z = std::min(std::max(z, 1.f), 65535.f);
+  auto d = static_cast<std::uint16_t>(z + 0.5f);
+  return d == DEPTH_RAW_INVALID ? DEPTH_RAW_INVALID - 1 : d;
+}
+
+inline std::int16_t to_coord(float v) {
+  return static_cast<std::int16_t>(
+      std::min(std::max(v, -kCoordLimit), kCoordLimit));
+}
+
+// The distortion of color, k1 k2 p1 p2 k3, and its projection
+struct Distortion {
+  float k1, k2, p1, p2, k3;
+  float fx, fy, cx, cy;
+  // beyond it, the distortion is not monotonic, which folds back
+  float r2_max;
+};
+
+// distort the normalized x y into pixel, false if beyond r2_max
+inline bool distort(const Distortion& d, float* x, float* y) {
+  const float xx = *x * *x, yy = *y * *y, xy = *x * *y;
+  const float r2 = xx + yy;
+  if (r2 > d.r2_max) return false;
+  const float radial = 1 + r2 * (d.k1 + r2 * (d.k2 + r2 * d.k3));
+  const float xd = *x * radial + 2 * d.p1 * xy + d.p2 * (r2 + 2 * xx);
+  const float yd = *y * radial + d.p1 * (r2 + 2 * yy) + 2 * d.p2 * xy;
+  *x = d.fx * xd + d.cx;
+  *y = d.fy * yd + d.cy;
+  return true;
+}
+
+#ifdef MYNTEYE_SIMD_SSE2
+// ceil of 4 floats in the int32 range
+inline __m128i ceil_epi32(const __m128& v) {
+  __m128i i = _mm_cvttps_epi32(v);
+  // +1 if truncated down, the mask is -1
+  return _mm_sub_epi32(i,
+      _mm_castps_si128(_mm_cmplt_ps(_mm_cvtepi32_ps(i), v)));
+}
+
+// distort 4 normalized x y into pixel, the mask of beyond r2_max
+inline __m128 distort_ps(const Distortion& d, __m128* x, __m128* y) {
+  const __m128 two = _mm_set1_ps(2.f);
+  const __m128 xx = _mm_mul_ps(*x, *x);
+  const __m128 yy = _mm_mul_ps(*y, *y);
+  const __m128 xy = _mm_mul_ps(*x, *y);
+  const __m128 r2 = _mm_add_ps(xx, yy);
+  __m128 radial = _mm_add_ps(_mm_set1_ps(d.k2),
+      _mm_mul_ps(r2, _mm_set1_ps(d.k3)));
+  radial = _mm_add_ps(_mm_set1_ps(d.k1), _mm_mul_ps(r2, radial));
+  radial = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(r2, radial));
+  const __m128 p1 = _mm_set1_ps(d.p1), p2 = _mm_set1_ps(d.p2);
+  const __m128 xd = _mm_add_ps(_mm_mul_ps(*x, radial), _mm_add_ps(
+      _mm_mul_ps(_mm_mul_ps(two, p1), xy),
+      _mm_mul_ps(p2, _mm_add_ps(r2, _mm_mul_ps(two, xx)))));
+  const __m128 yd = _mm_add_ps(_mm_mul_ps(*y, radial), _mm_add_ps(
+      _mm_mul_ps(p1, _mm_add_ps(r2, _mm_mul_ps(two, yy))),
+      _mm_mul_ps(_mm_mul_ps(two, p2), xy)));
+  *x = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(d.fx), xd), _mm_set1_ps(d.cx));
+  *y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(d.fy), yd), _mm_set1_ps(d.cy));
+  return _mm_cmpgt_ps(r2, _mm_set1_ps(d.r2_max));
+}
+
+// store the rects x0 x1 y0 y1 of 4 pixels
+inline void store_rects(std::int16_t* dst, const __m128i& x0,
+    const __m128i& x1, const __m128i& y0, const __m128i& y1) {
+  __m128i lo = _mm_packs_epi32(x0, y0);  // x0 x0 x0 x0 y0 y0 y0 y0
+  __m128i hi = _mm_packs_epi32(x1, y1);
+  __m128i x = _mm_unpacklo_epi16(lo, hi);  // x0 x1 x0 x1 ...
+  __m128i y = _mm_unpackhi_epi16(lo, hi);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi32(x, y));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 8),
+      _mm_unpackhi_epi32(x, y));
+}
+#endif
+
+}  // namespace
+
+DepthRegistration::DepthRegistration(std::size_t threads)
+  : depth_intrinsics_(),
+    color_intrinsics_(),
+    has_params_(false),
+    distorted_(false),
+    r2_max_(0),
+    terms_width_(0),
+    terms_height_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+DepthRegistration::~DepthRegistration() {
+}
+
+void DepthRegistration::SetParams(const CameraIntrinsics& depth_intrinsics,
+    const CameraIntrinsics& color_intrinsics,
+    const Extrinsics& depth_to_color) {
+  std::lock_guard<std::mutex> _(mutex_);
+  depth_intrinsics_ = depth_intrinsics;
+  // the rectified one, if any
+  if (depth_intrinsics.p[0] > 0) {
+    depth_intrinsics_.fx = depth_intrinsics.p[0];
+    depth_intrinsics_.cx = depth_intrinsics.p[2];
+    depth_intrinsics_.fy = depth_intrinsics.p[5];
+    depth_intrinsics_.cy = depth_intrinsics.p[6];
+  }
+  color_intrinsics_ = color_intrinsics;
+
+  const CameraIntrinsics& c = color_intrinsics_;
+  distorted_ = false;
+  for (int i = 0; i < 5; i++) {
+    if (c.coeffs[i] != 0) distorted_ = true;
+  }
+  r2_max_ = 0;
+  if (distorted_) {
+    // the radius where the distorted one stops growing, up to 4
+    const double k1 = c.coeffs[0], k2 = c.coeffs[1], k3 = c.coeffs[4];
+    double last = 0;
+    for (double r = 0.001; r <= 4; r += 0.001) {
+      const double r2 = r * r;
+      const double rd = r * (1 + r2 * (k1 + r2 * (k2 + r2 * k3)));
+      if (rd <= last) break;
+      last = rd;
+      r2_max_ = r2;
+    }
+  }
+  // projected by K after distortion, if distorted
+  const double k[3][3] = {
+      {distorted_ ? 1 : c.fx, 0, distorted_ ? 0 : c.cx},
+      {0, distorted_ ? 1 : c.fy, distorted_ ? 0 : c.cy}, {0, 0, 1}};
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      kr_[i][j] = 0;
+      for (int n = 0; n < 3; n++) {
+        kr_[i][j] += k[i][n] * depth_to_color.rotation[n][j];
+      }
+    }
+    kt_[i] = 0;
+    for (int n = 0; n < 3; n++) {
+      kt_[i] += k[i][n] * depth_to_color.translation[n];
+    }
+  }
+
+  has_params_ = depth_intrinsics_.fx > 0 && depth_intrinsics_.fy > 0 &&
+      depth_intrinsics_.width > 0 && depth_intrinsics_.height > 0 &&
+      c.fx > 0 && c.fy > 0 && c.width > 0 && c.height > 0;
+  terms_width_ = terms_height_ = 0;
+}
+
+void DepthRegistration::SetStreamParams(const StreamIntrinsics& intrinsics) {
+  // the depth is of the rectified left, so rotate it back to the raw left,
+  // by R1^T, with the same center
+  const double* r = intrinsics.left.r;
+  bool has_r = false;
+  for (int i = 0; i < 9; i++) {
+    if (r[i] != 0) has_r = true;
+  }
+  Extrinsics depth_to_left{{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, {0, 0, 0}};
+  if (has_r) {
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        depth_to_left.rotation[i][j] = r[j * 3 + i];
+      }
+    }
+  }
+  SetParams(intrinsics.left, intrinsics.left, depth_to_left);
+}
+
+void DepthRegistration::UpdateTerms(int width, int height) {
+  if (terms_width_ == width && terms_height_ == height) return;
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / depth_intrinsics_.width;
+  double sy = static_cast<double>(height) / depth_intrinsics_.height;
+  double fx = depth_intrinsics_.fx * sx;
+  double fy = depth_intrinsics_.fy * sy;
+  double cx = (depth_intrinsics_.cx + 0.5) * sx - 0.5;
+  double cy = (depth_intrinsics_.cy + 0.5) * sy - 0.5;
+
+  // the edges of pixels, u - 0.5 for u in [0, width]
+  for (int k = 0; k < 3; k++) {
+    col_terms_[k].resize(width + 1);
+    for (int u = 0; u <= width; u++) {
+      col_terms_[k][u] = static_cast<float>(kr_[k][0] * (u - 0.5 - cx) / fx);
+    }
+    row_terms_[k].resize(height + 1);
+    for (int v = 0; v <= height; v++) {
+      row_terms_[k][v] = static_cast<float>(
+          kr_[k][1] * (v - 0.5 - cy) / fy + kr_[k][2]);
+    }
+  }
+
+  std::size_t n = static_cast<std::size_t>(width) * height;
+  rects_.resize(4 * n);
+  rect_z_.resize(n);
+  row_y0_.resize(height);
+  row_y1_.resize(height);
+  terms_width_ = width;
+  terms_height_ = height;
+}
+
+void DepthRegistration::ProjectRows(const std::uint16_t* depth,
+    std::size_t beg, std::size_t end) {
+  const std::size_t width = terms_width_;
+  const float* c0 = col_terms_[0].data();
+  const float* c1 = col_terms_[1].data();
+  const float* c2 = col_terms_[2].data();
+  const float t0 = static_cast<float>(kt_[0]);
+  const float t1 = static_cast<float>(kt_[1]);
+  const float t2 = static_cast<float>(kt_[2]);
+  const bool distorted = distorted_;
+  const CameraIntrinsics& c = color_intrinsics_;
+  const Distortion dist = {
+      static_cast<float>(c.coeffs[0]), static_cast<float>(c.coeffs[1]),
+      static_cast<float>(c.coeffs[2]), static_cast<float>(c.coeffs[3]),
+      static_cast<float>(c.coeffs[4]),
+      static_cast<float>(c.fx), static_cast<float>(c.fy),
+      static_cast<float>(c.cx), static_cast<float>(c.cy),
+      static_cast<float>(r2_max_)};
+
+  for (std::size_t v = beg; v < end; v++) {
+    const std::size_t offset = v * width;
+    const std::uint16_t* row = depth + offset;
+    // the top and bottom edges
+    const float a0 = row_terms_[0][v], b0 = row_terms_[0][v + 1];
+    const float a1 = row_terms_[1][v], b1 = row_terms_[1][v + 1];
+    const float a2 = row_terms_[2][v], b2 = row_terms_[2][v + 1];
+    std::size_t u = 0;
+
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128 va0 = _mm_set1_ps(a0), vb0 = _mm_set1_ps(b0);
+    const __m128 va1 = _mm_set1_ps(a1), vb1 = _mm_set1_ps(b1);
+    const __m128 va2 = _mm_set1_ps(a2), vb2 = _mm_set1_ps(b2);
+    const __m128 vt0 = _mm_set1_ps(t0);
+    const __m128 vt1 = _mm_set1_ps(t1);
+    const __m128 vt2 = _mm_set1_ps(t2);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 depth_max = _mm_set1_ps(65535.f);
+    const __m128 coord_min = _mm_set1_ps(-kCoordLimit);
+    const __m128 coord_max = _mm_set1_ps(kCoordLimit);
+    const __m128i rect_min = _mm_set1_epi32(kRectMin);
+    const __m128i rect_max = _mm_set1_epi32(kRectMax);
+    const __m128i zero = _mm_setzero_si128();
+    for (; u + 4 <= width; u += 4) {
+      __m128i d16 = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(row + u));
+      __m128i invalid16 = simd::depth_invalid_mask(d16);
+      __m128 z = _mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero));
+
+      // the top left and bottom right corners
+      __m128 q0_tl = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c0 + u), va0)), vt0);
+      __m128 q1_tl = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c1 + u), va1)), vt1);
+      __m128 q2_tl = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c2 + u), va2)), vt2);
+      __m128 q0_br = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c0 + u + 1), vb0)), vt0);
+      __m128 q1_br = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c1 + u + 1), vb1)), vt1);
+      __m128 q2_br = _mm_add_ps(_mm_mul_ps(z,
+          _mm_add_ps(_mm_loadu_ps(c2 + u + 1), vb2)), vt2);
+
+      // invalid, or behind the color camera
+      __m128 invalid = _mm_or_ps(
+          _mm_castsi128_ps(_mm_unpacklo_epi16(invalid16, invalid16)),
+          _mm_or_ps(_mm_cmplt_ps(q2_tl, one), _mm_cmplt_ps(q2_br, one)));
+      __m128i invalid_i = _mm_castps_si128(invalid);
+      if (_mm_movemask_ps(invalid) == 0xf) {
+        store_rects(rects_.data() + 4 * (offset + u),
+            rect_max, rect_min, rect_max, rect_min);
+        continue;
+      }
+      // avoid the division by 0 of the invalid lanes
+      q2_tl = _mm_max_ps(q2_tl, one);
+      q2_br = _mm_max_ps(q2_br, one);
+
+      __m128 inv_tl = _mm_div_ps(one, q2_tl);
+      __m128 inv_br = _mm_div_ps(one, q2_br);
+      __m128 x_tl = _mm_mul_ps(q0_tl, inv_tl);
+      __m128 y_tl = _mm_mul_ps(q1_tl, inv_tl);
+      __m128 x_br = _mm_mul_ps(q0_br, inv_br);
+      __m128 y_br = _mm_mul_ps(q1_br, inv_br);
+      __m128 x_lo = _mm_min_ps(x_tl, x_br), x_hi = _mm_max_ps(x_tl, x_br);
+      __m128 y_lo = _mm_min_ps(y_tl, y_br), y_hi = _mm_max_ps(y_tl, y_br);
+      if (distorted) {
+        // the edges are curved, so the bounds of all 4 corners, or holes
+        __m128 q2_tr = _mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c2 + u + 1), va2)), vt2);
+        __m128 q2_bl = _mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c2 + u), vb2)), vt2);
+        invalid = _mm_or_ps(invalid,
+            _mm_or_ps(_mm_cmplt_ps(q2_tr, one), _mm_cmplt_ps(q2_bl, one)));
+        __m128 inv_tr = _mm_div_ps(one, _mm_max_ps(q2_tr, one));
+        __m128 inv_bl = _mm_div_ps(one, _mm_max_ps(q2_bl, one));
+        __m128 x_tr = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c0 + u + 1), va0)), vt0), inv_tr);
+        __m128 y_tr = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c1 + u + 1), va1)), vt1), inv_tr);
+        __m128 x_bl = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c0 + u), vb0)), vt0), inv_bl);
+        __m128 y_bl = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(z,
+            _mm_add_ps(_mm_loadu_ps(c1 + u), vb1)), vt1), inv_bl);
+        invalid = _mm_or_ps(invalid, distort_ps(dist, &x_tl, &y_tl));
+        invalid = _mm_or_ps(invalid, distort_ps(dist, &x_br, &y_br));
+        invalid = _mm_or_ps(invalid, distort_ps(dist, &x_tr, &y_tr));
+        invalid = _mm_or_ps(invalid, distort_ps(dist, &x_bl, &y_bl));
+        invalid_i = _mm_castps_si128(invalid);
+        x_lo = _mm_min_ps(_mm_min_ps(x_tl, x_br), _mm_min_ps(x_tr, x_bl));
+        x_hi = _mm_max_ps(_mm_max_ps(x_tl, x_br), _mm_max_ps(x_tr, x_bl));
+        y_lo = _mm_min_ps(_mm_min_ps(y_tl, y_br), _mm_min_ps(y_tr, y_bl));
+        y_hi = _mm_max_ps(_mm_max_ps(y_tl, y_br), _mm_max_ps(y_tr, y_bl));
+      }
+      x_lo = _mm_max_ps(x_lo, coord_min);
+      x_hi = _mm_min_ps(x_hi, coord_max);
+      y_lo = _mm_max_ps(y_lo, coord_min);
+      y_hi = _mm_min_ps(y_hi, coord_max);
+
+      // the pixels whose centers in [lo, hi)
+      const __m128i minus_one = _mm_set1_epi32(-1);
+      __m128i x0 = ceil_epi32(x_lo);
+      __m128i x1 = _mm_add_epi32(ceil_epi32(x_hi), minus_one);
+      __m128i y0 = ceil_epi32(y_lo);
+      __m128i y1 = _mm_add_epi32(ceil_epi32(y_hi), minus_one);
+      store_rects(rects_.data() + 4 * (offset + u),
+          simd::select(invalid_i, rect_max, x0),
+          simd::select(invalid_i, rect_min, x1),
+          simd::select(invalid_i, rect_max, y0),
+          simd::select(invalid_i, rect_min, y1));
+
+      // the depth of center in color, rounded to [1, 65535] without invalid
+      __m128 zc = _mm_mul_ps(_mm_add_ps(q2_tl, q2_br), half);
+      zc = _mm_min_ps(_mm_max_ps(zc, one), depth_max);
+      __m128i zi = _mm_sub_epi32(_mm_cvtps_epi32(zc), _mm_set1_epi32(32768));
+      __m128i z16 = _mm_xor_si128(_mm_packs_epi32(zi, zi),
+          _mm_set1_epi16(static_cast<short>(0x8000)));  // NOLINT
+      z16 = _mm_add_epi16(z16, _mm_cmpeq_epi16(z16,
+          _mm_set1_epi16(DEPTH_RAW_INVALID)));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(rect_z_.data() + offset + u),
+          z16);
+    }
+#endif
+    for (; u < width; u++) {
+      const std::size_t i = offset + u;
+      std::int16_t* rect = rects_.data() + 4 * i;
+      float z = row[u];
+      float q2_tl = z * (c2[u] + a2) + t2;
+      float q2_br = z * (c2[u + 1] + b2) + t2;
+      if (!is_depth_valid(row[u]) || q2_tl < 1.f || q2_br < 1.f) {
+        rect[0] = rect[2] = kRectMax;
+        rect[1] = rect[3] = kRectMin;
+        continue;
+      }
+      float x_tl = (z * (c0[u] + a0) + t0) / q2_tl;
+      float y_tl = (z * (c1[u] + a1) + t1) / q2_tl;
+      float x_br = (z * (c0[u + 1] + b0) + t0) / q2_br;
+      float y_br = (z * (c1[u + 1] + b1) + t1) / q2_br;
+      float x_lo = std::min(x_tl, x_br), x_hi = std::max(x_tl, x_br);
+      float y_lo = std::min(y_tl, y_br), y_hi = std::max(y_tl, y_br);
+      if (distorted) {
+        // the edges are curved, so the bounds of all 4 corners, or holes
+        float q2_tr = z * (c2[u + 1] + a2) + t2;
+        float q2_bl = z * (c2[u] + b2) + t2;
+        bool ok = q2_tr >= 1.f && q2_bl >= 1.f;
+        float x_tr = 0, y_tr = 0, x_bl = 0, y_bl = 0;
+        if (ok) {
+          x_tr = (z * (c0[u + 1] + a0) + t0) / q2_tr;
+          y_tr = (z * (c1[u + 1] + a1) + t1) / q2_tr;
+          x_bl = (z * (c0[u] + b0) + t0) / q2_bl;
+          y_bl = (z * (c1[u] + b1) + t1) / q2_bl;
+          ok = distort(dist, &x_tl, &y_tl) && distort(dist, &x_br, &y_br) &&
+              distort(dist, &x_tr, &y_tr) && distort(dist, &x_bl, &y_bl);
+        }
+        if (!ok) {
+          rect[0] = rect[2] = kRectMax;
+          rect[1] = rect[3] = kRectMin;
+          continue;
+        }
+        x_lo = std::min(std::min(x_tl, x_br), std::min(x_tr, x_bl));
+        x_hi = std::max(std::max(x_tl, x_br), std::max(x_tr, x_bl));
+        y_lo = std::min(std::min(y_tl, y_br), std::min(y_tr, y_bl));
+        y_hi = std::max(std::max(y_tl, y_br), std::max(y_tr, y_bl));
+      }
+      rect[0] = to_coord(std::ceil(x_lo));
+      rect[1] = to_coord(std::ceil(x_hi) - 1);
+      rect[2] = to_coord(std::ceil(y_lo));
+      rect[3] = to_coord(std::ceil(y_hi) - 1);
+      rect_z_[i] = to_depth((q2_tl + q2_br) * 0.5f);
+    }
+
+    // the covered rows, the empty rects are out of it
+    std::int16_t y0 = kRectMax, y1 = kRectMin;
+    for (u = 0; u < width; u++) {
+      y0 = std::min(y0, rects_[4 * (offset + u) + 2]);
+      y1 = std::max(y1, rects_[4 * (offset + u) + 3]);
+    }
+    row_y0_[v] = y0;
+    row_y1_[v] = y1;
+  }
+}
+
+void DepthRegistration::SplatRows(std::uint16_t* aligned,
+    std::size_t beg, std::size_t end) {
+  // each band of color rows is only written by itself, so no race
+  const int color_width = color_intrinsics_.width;
+  const int band_y0 = static_cast<int>(beg);
+  const int band_y1 = static_cast<int>(end) - 1;
+  std::memset(aligned + beg * color_width, 0,
+      (end - beg) * color_width * sizeof(std::uint16_t));
+
+  const std::size_t width = terms_width_;
+  for (int v = 0; v < terms_height_; v++) {
+    if (row_y0_[v] > band_y1 || row_y1_[v] < band_y0) continue;
+    const std::size_t offset = v * width;
+    for (std::size_t u = 0; u < width; u++) {
+      const std::size_t i = offset + u;
+      const std::int16_t* rect = rects_.data() + 4 * i;
+      int y0 = std::max<int>(rect[2], band_y0);
+      int y1 = std::min<int>(rect[3], band_y1);
+      int x0 = std::max<int>(rect[0], 0);
+      int x1 = std::min<int>(rect[1], color_width - 1);
+      if (y0 > y1 || x0 > x1) continue;
+      const std::uint16_t z = rect_z_[i];
+      if (x0 == x1 && y0 == y1) {
+        std::uint16_t& dst = aligned[y0 * color_width + x0];
+        if (dst == 0 || z < dst) dst = z;
+        continue;
+      }
+      for (int y = y0; y <= y1; y++) {
+        std::uint16_t* dst = aligned + y * color_width;
+        for (int x = x0; x <= x1; x++) {
+          if (dst[x] == 0 || z < dst[x]) dst[x] = z;
+        }
+      }
+    }
+  }
+}
+
+bool DepthRegistration::Process(const Image::pointer& depth,
+    Image::pointer* aligned) {
+  if (!depth || !aligned || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!has_params_) {
+    LOGW("%s: params not set", __func__);
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  const int color_width = color_intrinsics_.width;
+  const int color_height = color_intrinsics_.height;
+  UpdateTerms(width, height);
+
+  auto&& out = *aligned;
+  if (!out || out == depth || out->format() != ImageFormat::DEPTH_RAW ||
+      out->width() != color_width || out->height() != color_height) {
+    out = ImageDepth::Create(ImageFormat::DEPTH_RAW, color_width,
+        color_height, false);
+  }
+  out->set_frame_id(depth->frame_id());
+  out->set_timestamp(depth->timestamp());
+
+  auto src = reinterpret_cast<const std::uint16_t*>(depth->data());
+  pool_->ParallelFor(height, [this, src](std::size_t beg, std::size_t end) {
+    ProjectRows(src, beg, end);
+  }, kBandMinRows);
+
+  auto dst = reinterpret_cast<std::uint16_t*>(out->data());
+  pool_->ParallelFor(color_height, [this, dst](
+      std::size_t beg, std::size_t end) {
+    SplatRows(dst, beg, end);
+  }, kBandMinRows);
+  return true;
+}
@@ -0,0 +1,210 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/laser_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The pixels of one band at least
+const std::size_t kBandMinPixels = 16384;
+// The depth as none while reducing, larger than valid ones
+const std::uint16_t kDepthNone = 0x7fff;
+
+}  // namespace
+
+LaserScan::LaserScan(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    scan_rows_(1),
+    scan_offset_(0),
+    range_min_(0.3f),
+    range_max_(10.f),
+    bins_(0),
+    columns_width_(0),
+    columns_height_(0),
+    first_row_(0),
+    angle_min_(0),
+    angle_max_(0),
+    angle_increment_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+LaserScan::~LaserScan() {
+}
+
+void LaserScan::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  intrinsics_ = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    intrinsics_.fx = intrinsics.p[0];
+    intrinsics_.cx = intrinsics.p[2];
+    intrinsics_.fy = intrinsics.p[5];
+    intrinsics_.cy = intrinsics.p[6];
+  }
+  has_intrinsics_ = intrinsics_.fx > 0 && intrinsics_.fy > 0 &&
+      intrinsics_.width > 0 && intrinsics_.height > 0;
+  columns_width_ = columns_height_ = 0;
+}
+
+void LaserScan::SetScanRows(int rows, int offset) {
+  std::lock_guard<std::mutex> _(mutex_);
+  scan_rows_ = std::max(rows, 1);
+  scan_offset_ = offset;
+  columns_width_ = columns_height_ = 0;
+}
+
+void LaserScan::SetRangeLimits(float range_min, float range_max) {
+  std::lock_guard<std::mutex> _(mutex_);
+  range_min_ = range_min;
+  range_max_ = range_max;
+  columns_width_ = columns_height_ = 0;
+}
+
+void LaserScan::SetBins(std::size_t bins) {
+  std::lock_guard<std::mutex> _(mutex_);
+  bins_ = bins;
+  columns_width_ = columns_height_ = 0;
+}
+
+void LaserScan::UpdateColumns(int width, int height) {
+  if (columns_width_ == width && columns_height_ == height) return;
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / intrinsics_.width;
+  double sy = static_cast<double>(height) / intrinsics_.height;
+  double fx = intrinsics_.fx * sx;
+  double cx = (intrinsics_.cx + 0.5) * sx - 0.5;
+  double cy = (intrinsics_.cy + 0.5) * sy - 0.5;
+
+  const int rows = std::min(scan_rows_, height);
+  first_row_ = static_cast<int>(std::lround(cy)) - rows / 2 + scan_offset_;
+  first_row_ = std::min(std::max(first_row_, 0), height - rows);
+
+  // the left of image is positive, so the angles decrease with columns
+  auto angle_of = [cx, fx](int u) { return -std::atan((u - cx) / fx); };
+  const std::size_t bins = bins_ > 0 ? bins_ : width;
+  const double angle_min = angle_of(width - 1);
+  const double angle_max = angle_of(0);
+  const double increment = bins > 1 ?
+      (angle_max - angle_min) / (bins - 1) : 0;
+  angle_min_ = static_cast<float>(angle_min);
+  angle_max_ = static_cast<float>(angle_max);
+  angle_increment_ = static_cast<float>(increment);
+
+  col_bins_.resize(width);
+  col_factors_.resize(width);
+  col_min_depths_.resize(width);
+  for (int u = 0; u < width; u++) {
+    double bin = increment > 0 ? (angle_of(u) - angle_min) / increment : 0;
+    col_bins_[u] = static_cast<std::uint32_t>(std::min<double>(
+        std::max<double>(std::lround(bin), 0), bins - 1));
+    // the range on the scan plane, of one millimeter depth
+    double ray_x = (u - cx) / fx;
+    double factor = 0.001 * std::sqrt(1 + ray_x * ray_x);
+    col_factors_[u] = static_cast<float>(factor);
+    col_min_depths_[u] = static_cast<std::uint16_t>(std::min<double>(
+        std::max<double>(std::ceil(range_min_ / factor), 1), kDepthNone));
+  }
+  columns_width_ = width;
+  columns_height_ = height;
+}
+
+void LaserScan::MinColumns(const std::uint16_t* band, std::size_t width,
+    std::size_t rows, std::size_t beg, std::size_t end) {
+  std::size_t u = beg;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128i none = _mm_set1_epi16(kDepthNone);
+  const __m128i zero = _mm_setzero_si128();
+  for (; u + 8 <= end; u += 8) {
+    const __m128i min_depth = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(col_min_depths_.data() + u));
+    __m128i m = none;
+    for (std::size_t r = 0; r < rows; r++) {
+      __m128i d = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(band + r * width + u));
+      // invalid, nearer than range_min, or beyond 0x7fff as negative
+      __m128i bad = _mm_or_si128(
+          _mm_cmpeq_epi16(d, _mm_set1_epi16(DEPTH_RAW_INVALID)),
+          _mm_or_si128(_mm_cmplt_epi16(d, min_depth),
+              _mm_cmplt_epi16(d, zero)));
+      m = simd::min_u15(m, simd::select(bad, none, d));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(col_mins_.data() + u),
+        _mm_andnot_si128(_mm_cmpeq_epi16(m, none), m));
+  }
+#endif
+  for (; u < end; u++) {
+    std::uint16_t m = kDepthNone;
+    for (std::size_t r = 0; r < rows; r++) {
+      std::uint16_t d = band[r * width + u];
+      if (is_depth_valid(d) && d >= col_min_depths_[u] && d < 0x8000) {
+        m = std::min(m, d);
+      }
+    }
+    col_mins_[u] = m == kDepthNone ? 0 : m;
+  }
+}
+
+bool LaserScan::Compute(const Image::pointer& depth, LaserScanData* scan) {
+  if (!scan) return false;
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  UpdateColumns(width, height);
+
+  const std::size_t rows = std::min(scan_rows_, height);
+  auto band = reinterpret_cast<const std::uint16_t*>(depth->data()) +
+      static_cast<std::size_t>(first_row_) * width;
+  col_mins_.resize(width);
+  pool_->ParallelFor(width, [this, band, width, rows](std::size_t beg,
+      std::size_t end) {
+    MinColumns(band, width, rows, beg, end);
+  }, std::max<std::size_t>(kBandMinPixels / rows, 8));
+
+  scan->angle_min = angle_min_;
+  scan->angle_max = angle_max_;
+  scan->angle_increment = angle_increment_;
+  scan->range_min = range_min_;
+  scan->range_max = range_max_;
+  scan->frame_id = depth->frame_id();
+  scan->timestamp = depth->timestamp();
+  const std::size_t bins = bins_ > 0 ? bins_ : width;
+  scan->ranges.assign(bins, std::numeric_limits<float>::infinity());
+  float* ranges = scan->ranges.data();
+  for (int u = 0; u < width; u++) {
+    if (col_mins_[u] == 0) continue;
+    const float range = col_mins_[u] * col_factors_[u];
+    if (range > range_max_) continue;
+    float& r = ranges[col_bins_[u]];
+    r = std::min(r, range);
+  }
+  return true;
+}
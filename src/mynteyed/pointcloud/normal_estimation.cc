@@ -0,0 +1,264 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/normal_estimation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least
+const std::size_t kBandMinRows = 16;
+
+inline void fill_nan(float* p, std::size_t count) {
+  std::fill(p, p + 3 * count, std::numeric_limits<float>::quiet_NaN());
+}
+
+}  // namespace
+
+NormalEstimation::NormalEstimation(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    radius_(2),
+    max_depth_change_(0.02f),
+    rays_width_(0),
+    rays_height_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+NormalEstimation::~NormalEstimation() {
+}
+
+void NormalEstimation::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  intrinsics_ = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    intrinsics_.fx = intrinsics.p[0];
+    intrinsics_.cx = intrinsics.p[2];
+    intrinsics_.fy = intrinsics.p[5];
+    intrinsics_.cy = intrinsics.p[6];
+  }
+  has_intrinsics_ = intrinsics_.fx > 0 && intrinsics_.fy > 0 &&
+      intrinsics_.width > 0 && intrinsics_.height > 0;
+  rays_width_ = rays_height_ = 0;
+}
+
+void NormalEstimation::SetRadius(int radius) {
+  std::lock_guard<std::mutex> _(mutex_);
+  radius_ = std::max(radius, 1);
+}
+
+void NormalEstimation::SetMaxDepthChange(float factor) {
+  std::lock_guard<std::mutex> _(mutex_);
+  max_depth_change_ = factor;
+}
+
+void NormalEstimation::UpdateRays(int width, int height) {
+  if (rays_width_ == width && rays_height_ == height) return;
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / intrinsics_.width;
+  double sy = static_cast<double>(height) / intrinsics_.height;
+  double fx = intrinsics_.fx * sx;
+  double fy = intrinsics_.fy * sy;
+  double cx = (intrinsics_.cx + 0.5) * sx - 0.5;
+  double cy = (intrinsics_.cy + 0.5) * sy - 0.5;
+
+  rays_x_.resize(width);
+  for (int u = 0; u < width; u++) {
+    rays_x_[u] = static_cast<float>((u - cx) / fx);
+  }
+  rays_y_.resize(height);
+  for (int v = 0; v < height; v++) {
+    rays_y_[v] = static_cast<float>((v - cy) / fy);
+  }
+  rays_width_ = width;
+  rays_height_ = height;
+}
+
+// The differences of points, the depth z is raw as the normal is scale free:
+//   dx = P(u + r) - P(u - r), dy = P(v + r) - P(v - r)
+// and the normal is dy x dx, towards the camera.
+void NormalEstimation::ComputeRows(const std::uint16_t* depth,
+    float* normals, std::size_t beg, std::size_t end) {
+  const std::size_t width = rays_width_;
+  const std::size_t height = rays_height_;
+  const std::size_t r = radius_;
+  const float max_change = max_depth_change_ * r;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float* rays_x = rays_x_.data();
+
+  for (std::size_t v = beg; v < end; v++) {
+    float* out = normals + 3 * v * width;
+    if (v < r || v + r >= height || width <= 2 * r) {
+      fill_nan(out, width);
+      continue;
+    }
+    fill_nan(out, r);
+    fill_nan(out + 3 * (width - r), r);
+
+    const std::uint16_t* row = depth + v * width;
+    const std::uint16_t* up = row - r * width;
+    const std::uint16_t* down = row + r * width;
+    const float ray_y = rays_y_[v];
+    const float ray_y_up = rays_y_[v - r];
+    const float ray_y_down = rays_y_[v + r];
+    std::size_t u = r;
+
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vmax_change = _mm_set1_ps(max_change);
+    const __m128 vray_y = _mm_set1_ps(ray_y);
+    const __m128 vray_y_up = _mm_set1_ps(ray_y_up);
+    const __m128 vray_y_down = _mm_set1_ps(ray_y_down);
+    const __m128 vnan = _mm_set1_ps(nan);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    auto load = [](const std::uint16_t* p) {
+      return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+    };
+    auto to_ps = [&zero](const __m128i& d) {
+      return _mm_cvtepi32_ps(_mm_unpacklo_epi16(d, zero));
+    };
+    auto far = [&abs_mask](const __m128& a, const __m128& z,
+        const __m128& limit) {
+      return _mm_cmpgt_ps(_mm_and_ps(_mm_sub_ps(a, z), abs_mask), limit);
+    };
+    for (; u + 4 + r <= width; u += 4) {
+      __m128i d = load(row + u);
+      __m128i dl = load(row + u - r);
+      __m128i dr = load(row + u + r);
+      __m128i du = load(up + u);
+      __m128i dd = load(down + u);
+      __m128i invalid16 = _mm_or_si128(
+          _mm_or_si128(simd::depth_invalid_mask(d),
+              simd::depth_invalid_mask(dl)),
+          _mm_or_si128(
+              _mm_or_si128(simd::depth_invalid_mask(dr),
+                  simd::depth_invalid_mask(du)),
+              simd::depth_invalid_mask(dd)));
+      __m128 invalid = _mm_castsi128_ps(
+          _mm_unpacklo_epi16(invalid16, invalid16));
+      if (_mm_movemask_ps(invalid) == 0xf) {
+        simd::store_xyz(out + 3 * u, vnan, vnan, vnan);
+        continue;
+      }
+
+      __m128 z = to_ps(d);
+      __m128 zl = to_ps(dl), zr = to_ps(dr), zu = to_ps(du), zd = to_ps(dd);
+      __m128 limit = _mm_mul_ps(z, vmax_change);
+      invalid = _mm_or_ps(invalid, _mm_or_ps(
+          _mm_or_ps(far(zl, z, limit), far(zr, z, limit)),
+          _mm_or_ps(far(zu, z, limit), far(zd, z, limit))));
+
+      __m128 dzx = _mm_sub_ps(zr, zl);
+      __m128 dxx = _mm_sub_ps(
+          _mm_mul_ps(zr, _mm_loadu_ps(rays_x + u + r)),
+          _mm_mul_ps(zl, _mm_loadu_ps(rays_x + u - r)));
+      __m128 dyx = _mm_mul_ps(dzx, vray_y);
+      __m128 dzy = _mm_sub_ps(zd, zu);
+      __m128 dxy = _mm_mul_ps(dzy, _mm_loadu_ps(rays_x + u));
+      __m128 dyy = _mm_sub_ps(_mm_mul_ps(zd, vray_y_down),
+          _mm_mul_ps(zu, vray_y_up));
+
+      __m128 nx = _mm_sub_ps(_mm_mul_ps(dyy, dzx), _mm_mul_ps(dzy, dyx));
+      __m128 ny = _mm_sub_ps(_mm_mul_ps(dzy, dxx), _mm_mul_ps(dxy, dzx));
+      __m128 nz = _mm_sub_ps(_mm_mul_ps(dxy, dyx), _mm_mul_ps(dyy, dxx));
+      __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx),
+          _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz));
+      invalid = _mm_or_ps(invalid, _mm_cmple_ps(len2, _mm_setzero_ps()));
+      __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(len2));
+      auto unit = [&invalid, &vnan, &inv](const __m128& n) {
+        return _mm_or_ps(_mm_and_ps(invalid, vnan),
+            _mm_andnot_ps(invalid, _mm_mul_ps(n, inv)));
+      };
+      simd::store_xyz(out + 3 * u, unit(nx), unit(ny), unit(nz));
+    }
+#endif
+    for (; u + r < width; u++) {
+      float* p = out + 3 * u;
+      std::uint16_t d = row[u], dl = row[u - r], dr = row[u + r],
+          du = up[u], dd = down[u];
+      if (!is_depth_valid(d) || !is_depth_valid(dl) || !is_depth_valid(dr) ||
+          !is_depth_valid(du) || !is_depth_valid(dd)) {
+        p[0] = p[1] = p[2] = nan;
+        continue;
+      }
+      const float z = d, zl = dl, zr = dr, zu = du, zd = dd;
+      const float limit = z * max_change;
+      if (std::abs(zl - z) > limit || std::abs(zr - z) > limit ||
+          std::abs(zu - z) > limit || std::abs(zd - z) > limit) {
+        p[0] = p[1] = p[2] = nan;
+        continue;
+      }
+      const float dzx = zr - zl;
+      const float dxx = zr * rays_x[u + r] - zl * rays_x[u - r];
+      const float dyx = dzx * ray_y;
+      const float dzy = zd - zu;
+      const float dxy = dzy * rays_x[u];
+      const float dyy = zd * ray_y_down - zu * ray_y_up;
+
+      const float nx = dyy * dzx - dzy * dyx;
+      const float ny = dzy * dxx - dxy * dzx;
+      const float nz = dxy * dyx - dyy * dxx;
+      const float len2 = nx * nx + ny * ny + nz * nz;
+      if (len2 <= 0) {
+        p[0] = p[1] = p[2] = nan;
+        continue;
+      }
+      const float inv = 1.f / std::sqrt(len2);
+      p[0] = nx * inv;
+      p[1] = ny * inv;
+      p[2] = nz * inv;
+    }
+  }
+}
+
+bool NormalEstimation::Compute(const Image::pointer& depth,
+    NormalMap* normals) {
+  if (!normals) return false;
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  UpdateRays(width, height);
+
+  normals->width = width;
+  normals->height = height;
+  normals->frame_id = depth->frame_id();
+  normals->timestamp = depth->timestamp();
+  // the capacity is kept among frames
+  normals->normals.resize(3 * static_cast<std::size_t>(width) * height);
+
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  float* out = normals->normals.data();
+  pool_->ParallelFor(height, [this, data, out](std::size_t beg,
+      std::size_t end) {
+    ComputeRows(data, out, beg, end);
+  }, kBandMinRows);
+  return true;
+}
@@ -0,0 +1,382 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/occupancy_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least
+const std::size_t kBandMinRows = 16;
+// The weight of new accelerometer datas, as low-pass
+const double kAccelWeight = 0.02;
+
+void mat_mul(const double a[3][3], const double b[3][3], double c[3][3]) {
+  double r[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+    }
+  }
+  std::copy(&r[0][0], &r[0][0] + 9, &c[0][0]);
+}
+
+void mat_identity(double m[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] = i == j ? 1 : 0;
+    }
+  }
+}
+
+// The min rotation from the unit vector a to z axis
+void align_to_z(const double a[3], double r[3][3]) {
+  mat_identity(r);
+  // v = a x z, c = a . z
+  const double v[3] = {a[1], -a[0], 0};
+  const double c = a[2];
+  if (c <= -1 + 1e-9) {
+    // upside down, flip around x
+    r[1][1] = r[2][2] = -1;
+    return;
+  }
+  // r = I + [v]x + [v]x^2 / (1 + c)
+  const double k = 1 / (1 + c);
+  const double vx[3][3] = {
+    {0, -v[2], v[1]},
+    {v[2], 0, -v[0]},
+    {-v[1], v[0], 0},
+  };
+  double vx2[3][3];
+  mat_mul(vx, vx, vx2);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] += vx[i][j] + vx2[i][j] * k;
+    }
+  }
+}
+
+}  // namespace
+
+OccupancyGrid::OccupancyGrid(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    // the optical frame, x right, y down and z forward, into base
+    camera_to_base_{{0, 0, 1}, {-1, 0, 0}, {0, -1, 0}},
+    translation_{0, 0, 0},
+    resolution_(0.05f),
+    grid_width_(100),
+    grid_height_(100),
+    origin_x_(0.f),
+    origin_y_(-2.5f),
+    min_height_(0.1f),
+    max_height_(1.5f),
+    min_points_(3),
+    gravity_aligned_(false),
+    accel_{0, 0, 0},
+    has_accel_(false),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+  mat_identity(imu_to_camera_);
+}
+
+OccupancyGrid::~OccupancyGrid() {
+}
+
+void OccupancyGrid::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  intrinsics_ = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    intrinsics_.fx = intrinsics.p[0];
+    intrinsics_.cx = intrinsics.p[2];
+    intrinsics_.fy = intrinsics.p[5];
+    intrinsics_.cy = intrinsics.p[6];
+  }
+  has_intrinsics_ = intrinsics_.fx > 0 && intrinsics_.fy > 0 &&
+      intrinsics_.width > 0 && intrinsics_.height > 0;
+}
+
+void OccupancyGrid::SetMountPose(const Extrinsics& camera_to_base) {
+  std::lock_guard<std::mutex> _(mutex_);
+  std::copy(&camera_to_base.rotation[0][0],
+      &camera_to_base.rotation[0][0] + 9, &camera_to_base_[0][0]);
+  for (int i = 0; i < 3; i++) {
+    translation_[i] = camera_to_base.translation[i] * 0.001;
+  }
+}
+
+void OccupancyGrid::SetGrid(float resolution, std::uint32_t width,
+    std::uint32_t height, float origin_x, float origin_y) {
+  std::lock_guard<std::mutex> _(mutex_);
+  resolution_ = resolution;
+  grid_width_ = width;
+  grid_height_ = height;
+  origin_x_ = origin_x;
+  origin_y_ = origin_y;
+}
+
+void OccupancyGrid::SetHeightRange(float min_height, float max_height) {
+  std::lock_guard<std::mutex> _(mutex_);
+  min_height_ = min_height;
+  max_height_ = max_height;
+}
+
+void OccupancyGrid::SetMinPoints(std::uint32_t min_points) {
+  std::lock_guard<std::mutex> _(mutex_);
+  min_points_ = std::max<std::uint32_t>(min_points, 1);
+}
+
+void OccupancyGrid::SetGravityAligned(bool enabled) {
+  std::lock_guard<std::mutex> _(mutex_);
+  gravity_aligned_ = enabled;
+}
+
+void OccupancyGrid::SetMotionExtrinsics(const MotionExtrinsics& extrinsics) {
+  std::lock_guard<std::mutex> _(motion_mutex_);
+  std::copy(&extrinsics.rotation[0][0], &extrinsics.rotation[0][0] + 9,
+      &imu_to_camera_[0][0]);
+}
+
+void OccupancyGrid::OnMotionData(const MotionData& data) {
+  if (!data.imu || data.imu->flag != MYNTEYE_IMU_ACCEL) return;
+  std::lock_guard<std::mutex> _(motion_mutex_);
+  const double w = has_accel_ ? kAccelWeight : 1;
+  for (int i = 0; i < 3; i++) {
+    accel_[i] += (data.imu->accel[i] - accel_[i]) * w;
+  }
+  has_accel_ = true;
+}
+
+void OccupancyGrid::UpdateTerms(int width, int height) {
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / intrinsics_.width;
+  double sy = static_cast<double>(height) / intrinsics_.height;
+  double fx = intrinsics_.fx * sx;
+  double fy = intrinsics_.fy * sy;
+  double cx = (intrinsics_.cx + 0.5) * sx - 0.5;
+  double cy = (intrinsics_.cy + 0.5) * sy - 0.5;
+
+  double rot[3][3];
+  std::copy(&camera_to_base_[0][0], &camera_to_base_[0][0] + 9, &rot[0][0]);
+  if (gravity_aligned_) {
+    std::lock_guard<std::mutex> _(motion_mutex_);
+    // the accelerometer points up at rest
+    double up[3] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        for (int k = 0; k < 3; k++) {
+          up[i] += camera_to_base_[i][j] * imu_to_camera_[j][k] * accel_[k];
+        }
+      }
+    }
+    double norm = std::sqrt(up[0] * up[0] + up[1] * up[1] + up[2] * up[2]);
+    if (has_accel_ && norm > 0) {
+      for (int i = 0; i < 3; i++) up[i] /= norm;
+      double align[3][3];
+      align_to_z(up, align);
+      mat_mul(align, camera_to_base_, rot);
+    }
+  }
+
+  // raw depth in millimeters
+  const double scale = 0.001;
+  for (int k = 0; k < 3; k++) {
+    col_terms_[k].resize(width);
+    for (int u = 0; u < width; u++) {
+      col_terms_[k][u] = static_cast<float>(
+          scale * rot[k][0] * (u - cx) / fx);
+    }
+    row_terms_[k].resize(height);
+    for (int v = 0; v < height; v++) {
+      row_terms_[k][v] = static_cast<float>(
+          scale * (rot[k][1] * (v - cy) / fy + rot[k][2]));
+    }
+  }
+}
+
+void OccupancyGrid::CountRows(const std::uint16_t* depth,
+    std::uint32_t* counts, std::size_t beg, std::size_t end) {
+  const std::size_t width = col_terms_[0].size();
+  const float inv_res = 1.f / resolution_;
+  const float grid_w = static_cast<float>(grid_width_);
+  const float grid_h = static_cast<float>(grid_height_);
+  // the cell coordinates of pixels are c = p * inv_res - origin / res
+  const float off_x = origin_x_ * inv_res;
+  const float off_y = origin_y_ * inv_res;
+  const float tx = static_cast<float>(translation_[0]);
+  const float ty = static_cast<float>(translation_[1]);
+  const float tz = static_cast<float>(translation_[2]);
+  const float* col_x = col_terms_[0].data();
+  const float* col_y = col_terms_[1].data();
+  const float* col_z = col_terms_[2].data();
+#ifdef MYNTEYE_SIMD_SSE2
+  const bool simd_bins = 2.0 * grid_width_ * grid_height_ < (1 << 24);
+#endif
+
+  auto count = [&](float x, float y, float z) {
+    if (z >= max_height_) return;
+    const float cx = x * inv_res - off_x, cy = y * inv_res - off_y;
+    if (!(cx >= 0 && cx < grid_w && cy >= 0 && cy < grid_h)) return;
+    const std::size_t cell = static_cast<std::size_t>(cy) * grid_width_ +
+        static_cast<std::size_t>(cx);
+    ++counts[2 * cell + (z >= min_height_ ? 1 : 0)];
+  };
+
+  for (std::size_t v = beg; v < end; v++) {
+    const std::uint16_t* row = depth + v * width;
+    const float row_x = row_terms_[0][v];
+    const float row_y = row_terms_[1][v];
+    const float row_z = row_terms_[2][v];
+    std::size_t u = 0;
+
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 vrow_x = _mm_set1_ps(row_x);
+    const __m128 vrow_y = _mm_set1_ps(row_y);
+    const __m128 vrow_z = _mm_set1_ps(row_z);
+    const __m128 vtx = _mm_set1_ps(tx);
+    const __m128 vty = _mm_set1_ps(ty);
+    const __m128 vtz = _mm_set1_ps(tz);
+    const __m128 vinv_res = _mm_set1_ps(inv_res);
+    const __m128 voff_x = _mm_set1_ps(off_x);
+    const __m128 voff_y = _mm_set1_ps(off_y);
+    const __m128 vgrid_w = _mm_set1_ps(grid_w);
+    const __m128 vgrid_h = _mm_set1_ps(grid_h);
+    const __m128 vmin_h = _mm_set1_ps(min_height_);
+    const __m128 vmax_h = _mm_set1_ps(max_height_);
+    const __m128 vzero = _mm_setzero_ps();
+    const __m128 vone = _mm_set1_ps(1.f);
+    const __m128 vtwo = _mm_set1_ps(2.f);
+    // the bins are exact in float, if less than 2^24
+    for (; simd_bins && u + 4 <= width; u += 4) {
+      __m128i d16 = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(row + u));
+      __m128i invalid16 = simd::depth_invalid_mask(d16);
+      __m128 invalid = _mm_castsi128_ps(
+          _mm_unpacklo_epi16(invalid16, invalid16));
+      if (_mm_movemask_ps(invalid) == 0xf) continue;
+      __m128 d = _mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero));
+      __m128 x = _mm_add_ps(_mm_mul_ps(d,
+          _mm_add_ps(_mm_loadu_ps(col_x + u), vrow_x)), vtx);
+      __m128 y = _mm_add_ps(_mm_mul_ps(d,
+          _mm_add_ps(_mm_loadu_ps(col_y + u), vrow_y)), vty);
+      __m128 z = _mm_add_ps(_mm_mul_ps(d,
+          _mm_add_ps(_mm_loadu_ps(col_z + u), vrow_z)), vtz);
+      __m128 cx = _mm_sub_ps(_mm_mul_ps(x, vinv_res), voff_x);
+      __m128 cy = _mm_sub_ps(_mm_mul_ps(y, vinv_res), voff_y);
+      __m128 inside = _mm_and_ps(
+          _mm_and_ps(_mm_cmpge_ps(cx, vzero), _mm_cmplt_ps(cx, vgrid_w)),
+          _mm_and_ps(_mm_cmpge_ps(cy, vzero), _mm_cmplt_ps(cy, vgrid_h)));
+      inside = _mm_andnot_ps(invalid,
+          _mm_and_ps(inside, _mm_cmplt_ps(z, vmax_h)));
+      int mask = _mm_movemask_ps(inside);
+      if (mask == 0) continue;
+      // bin = 2 * (floor(cy) * grid_w + floor(cx)) + obstacle
+      __m128 fx = _mm_cvtepi32_ps(_mm_cvttps_epi32(cx));
+      __m128 fy = _mm_cvtepi32_ps(_mm_cvttps_epi32(cy));
+      __m128 bin = _mm_add_ps(
+          _mm_mul_ps(_mm_add_ps(_mm_mul_ps(fy, vgrid_w), fx), vtwo),
+          _mm_and_ps(_mm_cmpge_ps(z, vmin_h), vone));
+      alignas(16) std::int32_t bins[4];
+      _mm_store_si128(reinterpret_cast<__m128i*>(bins),
+          _mm_cvttps_epi32(bin));
+      for (int k = 0; k < 4; k++) {
+        if (mask & (1 << k)) ++counts[bins[k]];
+      }
+    }
+#endif
+    for (; u < width; u++) {
+      const std::uint16_t d = row[u];
+      if (!is_depth_valid(d)) continue;
+      const float df = d;
+      count(df * (col_x[u] + row_x) + tx, df * (col_y[u] + row_y) + ty,
+          df * (col_z[u] + row_z) + tz);
+    }
+  }
+}
+
+bool OccupancyGrid::Compute(const Image::pointer& depth,
+    OccupancyGridData* grid) {
+  if (!grid) return false;
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  if (resolution_ <= 0 || grid_width_ == 0 || grid_height_ == 0) {
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  UpdateTerms(width, height);
+
+  // the rows are split into chunks, each counts into its own cells
+  const std::size_t cells = static_cast<std::size_t>(grid_width_) *
+      grid_height_;
+  const std::size_t chunks = std::max<std::size_t>(std::min(pool_->size(),
+      height / kBandMinRows), 1);
+  counts_.resize(chunks * 2 * cells);
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  pool_->ParallelFor(chunks, [this, data, chunks, cells, height](
+      std::size_t beg, std::size_t end) {
+    for (std::size_t c = beg; c < end; c++) {
+      std::uint32_t* counts = counts_.data() + c * 2 * cells;
+      std::fill(counts, counts + 2 * cells, 0);
+      CountRows(data, counts, c * height / chunks,
+          (c + 1) * height / chunks);
+    }
+  });
+
+  grid->width = grid_width_;
+  grid->height = grid_height_;
+  grid->resolution = resolution_;
+  grid->origin_x = origin_x_;
+  grid->origin_y = origin_y_;
+  grid->frame_id = depth->frame_id();
+  grid->timestamp = depth->timestamp();
+  // the capacity is kept among frames
+  grid->cells.resize(cells);
+  std::uint8_t* out = grid->cells.data();
+  pool_->ParallelFor(cells, [this, out, chunks, cells](std::size_t beg,
+      std::size_t end) {
+    for (std::size_t i = beg; i < end; i++) {
+      std::uint32_t floor = 0, obstacles = 0;
+      for (std::size_t c = 0; c < chunks; c++) {
+        const std::uint32_t* counts = counts_.data() + c * 2 * cells;
+        floor += counts[2 * i];
+        obstacles += counts[2 * i + 1];
+      }
+      if (obstacles >= min_points_) {
+        out[i] = MYNTEYE_OCCUPANCY_OCCUPIED;
+      } else if (floor + obstacles > 0) {
+        out[i] = MYNTEYE_OCCUPANCY_FREE;
+      } else {
+        out[i] = MYNTEYE_OCCUPANCY_UNKNOWN;
+      }
+    }
+  }, 4096);
+  return true;
+}
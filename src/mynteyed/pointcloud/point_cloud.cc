@@ -0,0 +1,471 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/point_cloud.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The rows of one band at least
+const std::size_t kBandMinRows = 16;
+
+inline std::size_t floats_of_point(const PointCloudLayout& layout) {
+  return layout == PointCloudLayout::XYZRGB ? 4 : 3;
+}
+
+// rgb as the float of PCL and ROS: 0x00RRGGBB
+inline float pack_rgb(const std::uint8_t* p, bool bgr) {
+  std::uint32_t r = p[bgr ? 2 : 0], g = p[1], b = p[bgr ? 0 : 2];
+  std::uint32_t rgb = (r << 16) | (g << 8) | b;
+  float f;
+  std::memcpy(&f, &rgb, sizeof(f));
+  return f;
+}
+
+inline void copy_rgb(std::uint8_t* dst, const std::uint8_t* src, bool bgr) {
+  dst[0] = src[bgr ? 2 : 0];
+  dst[1] = src[1];
+  dst[2] = src[bgr ? 0 : 2];
+}
+
+inline void store_point(float* xyz, std::size_t count,
+    const PointCloudLayout& layout, std::size_t i,
+    float x, float y, float z, float rgb) {
+  switch (layout) {
+    case PointCloudLayout::INTERLEAVED:
+      xyz[3 * i] = x;
+      xyz[3 * i + 1] = y;
+      xyz[3 * i + 2] = z;
+      break;
+    case PointCloudLayout::PLANAR:
+      xyz[i] = x;
+      xyz[count + i] = y;
+      xyz[2 * count + i] = z;
+      break;
+    case PointCloudLayout::XYZRGB:
+      xyz[4 * i] = x;
+      xyz[4 * i + 1] = y;
+      xyz[4 * i + 2] = z;
+      xyz[4 * i + 3] = rgb;
+      break;
+  }
+}
+
+#ifdef MYNTEYE_SIMD_SSE2
+// The valid of 4 lanes from the first, by the invalid mask of them
+alignas(16) const std::int32_t kValidLanes[16][4] = {
+  {0, 1, 2, 3}, {1, 2, 3, 0}, {0, 2, 3, 0}, {2, 3, 0, 0},
+  {0, 1, 3, 0}, {1, 3, 0, 0}, {0, 3, 0, 0}, {3, 0, 0, 0},
+  {0, 1, 2, 0}, {1, 2, 0, 0}, {0, 2, 0, 0}, {2, 0, 0, 0},
+  {0, 1, 0, 0}, {1, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0},
+};
+
+// rgb of 4 pixels as pack_rgb, reading their 12 bytes only
+inline __m128 pack_rgb4(const std::uint8_t* p, bool bgr) {
+  std::uint32_t w[4];
+  std::memcpy(&w[0], p, 4);
+  std::memcpy(&w[1], p + 3, 4);
+  std::memcpy(&w[2], p + 6, 4);
+  std::memcpy(&w[3], p + 8, 4);
+  __m128i v = _mm_setr_epi32(static_cast<int>(w[0]), static_cast<int>(w[1]),
+      static_cast<int>(w[2]), static_cast<int>(w[3] >> 8));
+  if (bgr) {
+    // b g r in the low bytes are 0x00RRGGBB already
+    return _mm_castsi128_ps(_mm_and_si128(v, _mm_set1_epi32(0xffffff)));
+  }
+  const __m128i byte = _mm_set1_epi32(0xff);
+  __m128i r = _mm_slli_epi32(_mm_and_si128(v, byte), 16);
+  __m128i g = _mm_and_si128(v, _mm_set1_epi32(0xff00));
+  __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), byte);
+  return _mm_castsi128_ps(_mm_or_si128(_mm_or_si128(r, g), b));
+}
+
+// The 4 lanes picked by lanes
+inline __m128 pick4(const __m128& v, const std::int32_t* lanes) {
+  alignas(16) float f[4];
+  _mm_store_ps(f, v);
+  return _mm_setr_ps(f[lanes[0]], f[lanes[1]], f[lanes[2]], f[lanes[3]]);
+}
+
+inline void store_points4(float* xyz, std::size_t count,
+    const PointCloudLayout& layout, std::size_t i,
+    const __m128& x, const __m128& y, const __m128& z, const __m128& rgb) {
+  switch (layout) {
+    case PointCloudLayout::INTERLEAVED:
+      simd::store_xyz(xyz + 3 * i, x, y, z);
+      break;
+    case PointCloudLayout::PLANAR:
+      _mm_storeu_ps(xyz + i, x);
+      _mm_storeu_ps(xyz + count + i, y);
+      _mm_storeu_ps(xyz + 2 * count + i, z);
+      break;
+    case PointCloudLayout::XYZRGB: {
+      __m128 p0 = x, p1 = y, p2 = z, p3 = rgb;
+      _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+      float* p = xyz + 4 * i;
+      _mm_storeu_ps(p, p0);
+      _mm_storeu_ps(p + 4, p1);
+      _mm_storeu_ps(p + 8, p2);
+      _mm_storeu_ps(p + 12, p3);
+    } break;
+  }
+}
+#endif
+
+}  // namespace
+
+PointCloud::PointCloud(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    depth_scale_(0.001f),
+    layout_(PointCloudLayout::INTERLEAVED),
+    organized_(true),
+    rays_width_(0),
+    rays_height_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+PointCloud::~PointCloud() {
+}
+void PointCloud::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  intrinsics_ = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    intrinsics_.fx = intrinsics.p[0];
+    intrinsics_.cx = intrinsics.p[2];
+    intrinsics_.fy = intrinsics.p[5];
+    intrinsics_.cy = intrinsics.p[6];
+  }
+  has_intrinsics_ = intrinsics_.fx > 0 && intrinsics_.fy > 0 &&
+      intrinsics_.width > 0 && intrinsics_.height > 0;
+  rays_width_ = rays_height_ = 0;
+}
+
+void PointCloud::SetDepthScale(float scale) {
+  std::lock_guard<std::mutex> _(mutex_);
+  depth_scale_ = scale;
+}
+
+void PointCloud::SetLayout(const PointCloudLayout& layout) {
+  std::lock_guard<std::mutex> _(mutex_);
+  layout_ = layout;
+}
+
+void PointCloud::SetOrganized(bool organized) {
+  std::lock_guard<std::mutex> _(mutex_);
+  organized_ = organized;
+}
+
+void PointCloud::UpdateRays(int width, int height) {
+  if (rays_width_ == width && rays_height_ == height) return;
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / intrinsics_.width;
+  double sy = static_cast<double>(height) / intrinsics_.height;
+  double fx = intrinsics_.fx * sx;
+  double fy = intrinsics_.fy * sy;
+  double cx = (intrinsics_.cx + 0.5) * sx - 0.5;
+  double cy = (intrinsics_.cy + 0.5) * sy - 0.5;
+
+  rays_x_.resize(width);
+  for (int u = 0; u < width; u++) {
+    rays_x_[u] = static_cast<float>((u - cx) / fx);
+  }
+  rays_y_.resize(height);
+  for (int v = 0; v < height; v++) {
+    rays_y_[v] = static_cast<float>((v - cy) / fy);
+  }
+  rays_width_ = width;
+  rays_height_ = height;
+}
+
+void PointCloud::GenerateRows(const std::uint16_t* depth,
+    const std::uint8_t* color, bool bgr, const Output& out,
+    std::size_t beg, std::size_t end) {
+  const std::size_t width = rays_width_;
+  const std::size_t count = out.count;
+  const PointCloudLayout layout = layout_;
+  const bool organized = organized_;
+  const bool packed = layout == PointCloudLayout::XYZRGB;
+  const float scale = depth_scale_;
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  float* xyz = out.xyz;
+  std::uint8_t* rgb = out.rgb;
+  std::uint32_t* indices = out.indices;
+
+  for (std::size_t v = beg; v < end; v++) {
+    const std::uint16_t* row = depth + v * width;
+    const std::uint8_t* row_color = color ? color + 3 * v * width : nullptr;
+    const float ray_y = rays_y_[v];
+    std::size_t i = organized ? v * width : row_offsets_[v];
+    std::size_t u = 0;
+
+    if (organized && rgb) {
+      if (bgr) {
+        for (std::size_t k = 0; k < width; k++) {
+          copy_rgb(rgb + 3 * (i + k), row_color + 3 * k, true);
+        }
+      } else {
+        std::memcpy(rgb + 3 * i, row_color, 3 * width);
+      }
+    }
+
+#ifdef MYNTEYE_SIMD_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vray_y = _mm_set1_ps(ray_y);
+    const __m128 vnan = _mm_set1_ps(nan);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i index_steps = _mm_setr_epi32(0, 1, 2, 3);
+    __m128 vrgb = _mm_setzero_ps();
+    for (; u + 4 <= width; u += 4) {
+      __m128i d16 = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i*>(row + u));
+      __m128i invalid16 = simd::depth_invalid_mask(d16);
+      __m128 invalid = _mm_castsi128_ps(
+          _mm_unpacklo_epi16(invalid16, invalid16));
+      int mask = _mm_movemask_ps(invalid);
+      if (!organized && mask == 0xf) continue;
+
+      __m128 z = _mm_mul_ps(
+          _mm_cvtepi32_ps(_mm_unpacklo_epi16(d16, zero)), vscale);
+      if (organized) {
+        // NaN for the invalid
+        z = _mm_or_ps(_mm_and_ps(invalid, vnan), _mm_andnot_ps(invalid, z));
+      }
+      __m128 x = _mm_mul_ps(z, _mm_loadu_ps(rays_x_.data() + u));
+      __m128 y = _mm_mul_ps(z, vray_y);
+      if (packed && row_color) {
+        vrgb = pack_rgb4(row_color + 3 * u, bgr);
+      }
+      if (organized || mask == 0) {
+        store_points4(xyz, count, layout, i, x, y, z, vrgb);
+        if (!organized) {
+          if (indices) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i),
+                _mm_add_epi32(_mm_set1_epi32(static_cast<int>(v * width + u)),
+                    index_steps));
+          }
+          if (rgb && !bgr) {
+            std::memcpy(rgb + 3 * i, row_color + 3 * u, 12);
+          } else if (rgb) {
+            for (int k = 0; k < 4; k++) {
+              copy_rgb(rgb + 3 * (i + k), row_color + 3 * (u + k), true);
+            }
+          }
+        }
+        i += 4;
+        continue;
+      }
+      const std::size_t valid = 4 - ((mask & 1) + ((mask >> 1) & 1) +
+          ((mask >> 2) & 1) + (mask >> 3));
+      if (i + 4 <= row_offsets_[v + 1]) {
+        // pack the valid to the first lanes, and store all 4 while in the
+        // row, as the rest are overwritten by the next valid
+        const std::int32_t* lanes = kValidLanes[mask];
+        store_points4(xyz, count, layout, i, pick4(x, lanes),
+            pick4(y, lanes), pick4(z, lanes), pick4(vrgb, lanes));
+        if (indices) {
+          _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i),
+              _mm_add_epi32(_mm_set1_epi32(static_cast<int>(v * width + u)),
+                  _mm_load_si128(reinterpret_cast<const __m128i*>(lanes))));
+        }
+        if (rgb) {
+          for (std::size_t k = 0; k < valid; k++) {
+            copy_rgb(rgb + 3 * (i + k), row_color + 3 * (u + lanes[k]), bgr);
+          }
+        }
+        i += valid;
+        continue;
+      }
+      alignas(16) float xs[4], ys[4], zs[4], cs[4];
+      _mm_store_ps(xs, x);
+      _mm_store_ps(ys, y);
+      _mm_store_ps(zs, z);
+      _mm_store_ps(cs, vrgb);
+      for (int k = 0; k < 4; k++) {
+        if (mask & (1 << k)) continue;
+        store_point(xyz, count, layout, i, xs[k], ys[k], zs[k], cs[k]);
+        if (indices) {
+          indices[i] = static_cast<std::uint32_t>(v * width + u + k);
+        }
+        if (rgb) {
+          copy_rgb(rgb + 3 * i, row_color + 3 * (u + k), bgr);
+        }
+        ++i;
+      }
+    }
+#endif
+    for (; u < width; u++) {
+      std::uint16_t d = row[u];
+      bool valid = is_depth_valid(d);
+      if (!organized && !valid) continue;
+      float z = valid ? d * scale : nan;
+      float c = packed && row_color ? pack_rgb(row_color + 3 * u, bgr) : 0.f;
+      store_point(xyz, count, layout, i, z * rays_x_[u], z * ray_y, z, c);
+      if (!organized) {
+        if (indices) {
+          indices[i] = static_cast<std::uint32_t>(v * width + u);
+        }
+        if (rgb) {
+          copy_rgb(rgb + 3 * i, row_color + 3 * u, bgr);
+        }
+      }
+      ++i;
+    }
+  }
+}
+
+bool PointCloud::Prepare(const Image::pointer& depth,
+    const Image::pointer& color, Image::pointer* rgb_image, bool* bgr,
+    std::size_t* count) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  UpdateRays(width, height);
+
+  rgb_image->reset();
+  *bgr = false;
+  if (color) {
+    if (color->width() != width || color->height() != height) {
+      LOGW("%s: color size is not of depth, ignored", __func__);
+    } else if (color->format() == ImageFormat::COLOR_RGB ||
+        color->format() == ImageFormat::COLOR_BGR) {
+      // read as is, as To() converts between them in place
+      *rgb_image = color;
+      *bgr = color->format() == ImageFormat::COLOR_BGR;
+    } else {
+      *rgb_image = color->To(ImageFormat::COLOR_RGB);
+    }
+  }
+
+  *count = static_cast<std::size_t>(width) * height;
+  if (organized_) return true;
+
+  // count the valid points of rows, then offsets
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  row_offsets_.resize(height + 1);
+  row_offsets_[0] = 0;
+  pool_->ParallelFor(height, [this, data, width](
+      std::size_t beg, std::size_t end) {
+    for (std::size_t v = beg; v < end; v++) {
+      const std::uint16_t* row = data + v * width;
+      std::uint32_t n = 0;
+      int u = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+      // the invalid mask is -1, so subtract it to count the invalid
+      __m128i invalid = _mm_setzero_si128();
+      for (; u + 8 <= width; u += 8) {
+        invalid = _mm_sub_epi16(invalid, simd::depth_invalid_mask(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + u))));
+      }
+      alignas(16) std::uint16_t lanes[8];
+      _mm_store_si128(reinterpret_cast<__m128i*>(lanes), invalid);
+      n = u;
+      for (int k = 0; k < 8; k++) n -= lanes[k];
+#endif
+      for (; u < width; u++) {
+        n += is_depth_valid(row[u]);
+      }
+      row_offsets_[v + 1] = n;
+    }
+  }, kBandMinRows);
+  for (int v = 0; v < height; v++) {
+    row_offsets_[v + 1] += row_offsets_[v];
+  }
+  *count = row_offsets_[height];
+  return true;
+}
+
+bool PointCloud::Generate(const Image::pointer& depth,
+    PointCloudData* points, const Image::pointer& color) {
+  if (!points) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  Image::pointer rgb_image;
+  bool bgr;
+  std::size_t count;
+  if (!Prepare(depth, color, &rgb_image, &bgr, &count)) {
+    return false;
+  }
+  const std::uint8_t* rgb = rgb_image ? rgb_image->data() : nullptr;
+  const bool packed = layout_ == PointCloudLayout::XYZRGB;
+
+  points->organized = organized_;
+  points->layout = layout_;
+  points->width = organized_ ? depth->width() :
+      static_cast<std::uint32_t>(count);
+  points->height = organized_ ? depth->height() : 1;
+  points->count = count;
+  points->frame_id = depth->frame_id();
+  points->timestamp = depth->timestamp();
+  // the capacity is kept among frames
+  points->xyz.resize(floats_of_point(layout_) * count);
+  if (rgb && !packed) {
+    points->rgb.resize(3 * count);
+  } else {
+    points->rgb.clear();
+  }
+  if (organized_) {
+    points->indices.clear();
+  } else {
+    points->indices.resize(count);
+  }
+
+  Output out{points->xyz.data(),
+      points->rgb.empty() ? nullptr : points->rgb.data(),
+      points->indices.empty() ? nullptr : points->indices.data(), count};
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  pool_->ParallelFor(depth->height(), [this, data, rgb, bgr, &out](
+      std::size_t beg, std::size_t end) {
+    GenerateRows(data, rgb, bgr, out, beg, end);
+  }, kBandMinRows);
+  return true;
+}
+
+bool PointCloud::Generate(const Image::pointer& depth, float* data,
+    std::size_t* count, const Image::pointer& color,
+    std::uint32_t* indices) {
+  if (!data || !count) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  Image::pointer rgb_image;
+  bool bgr;
+  if (!Prepare(depth, color, &rgb_image, &bgr, count)) {
+    return false;
+  }
+  // only the packed layout has color here
+  const std::uint8_t* rgb = rgb_image && layout_ == PointCloudLayout::XYZRGB ?
+      rgb_image->data() : nullptr;
+
+  Output out{data, nullptr, organized_ ? nullptr : indices, *count};
+  auto src = reinterpret_cast<const std::uint16_t*>(depth->data());
+  pool_->ParallelFor(depth->height(), [this, src, rgb, bgr, &out](
+      std::size_t beg, std::size_t end) {
+    GenerateRows(src, rgb, bgr, out, beg, end);
+  }, kBandMinRows);
+  return true;
+}
@@ -0,0 +1,492 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/point_cloud_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+const char kMagic[4] = {'M', 'P', 'C', '1'};
+const std::uint8_t kFlagOrganized = 1;
+const std::uint8_t kFlagColor = 2;
+// The max of quantized, and the min meters of one unit
+const float kQuantMax = 32767.f;
+const float kMinScale = 1e-6f;
+// The max width of organized, as the run lengths are uint16
+const std::size_t kMaxWidth = std::numeric_limits<std::uint16_t>::max();
+
+struct PacketHeader {
+  char magic[4];
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t count;  // the valid points
+  std::uint32_t runs;
+  std::uint8_t flags;
+  std::uint8_t reserved[3];
+  std::int32_t frame_id;
+  std::uint32_t reserved2;
+  std::uint64_t timestamp;
+  float origin[3];
+  float scale;
+};
+static_assert(sizeof(PacketHeader) == 56, "PacketHeader must be 56 bytes");
+
+inline std::int16_t quantize(float v, float origin, float inv_scale) {
+  // saturated and rounded half to even, the same as the SIMD path
+  const float f = std::min(std::max((v - origin) * inv_scale, -32768.f),
+      32767.f);
+  return static_cast<std::int16_t>(std::lrint(f));
+}
+
+inline std::uint16_t to_rgb565(std::uint8_t r, std::uint8_t g,
+    std::uint8_t b) {
+  return static_cast<std::uint16_t>(((r >> 3) << 11) | ((g >> 2) << 5) |
+      (b >> 3));
+}
+
+inline void from_rgb565(std::uint16_t c, std::uint8_t* rgb) {
+  const std::uint8_t r = (c >> 11) & 0x1f, g = (c >> 5) & 0x3f, b = c & 0x1f;
+  rgb[0] = static_cast<std::uint8_t>((r << 3) | (r >> 2));
+  rgb[1] = static_cast<std::uint8_t>((g << 2) | (g >> 4));
+  rgb[2] = static_cast<std::uint8_t>((b << 3) | (b >> 2));
+}
+
+// The bounds of the interleaved points, NaN skipped
+void bounds_interleaved(const float* p, std::size_t n, float mn[3],
+    float mx[3]) {
+  std::size_t i = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  // 4 points of 3 vectors, x y z x | y z x y | z x y z
+  __m128 mn0 = _mm_set_ps(mn[0], mn[2], mn[1], mn[0]);
+  __m128 mn1 = _mm_set_ps(mn[1], mn[0], mn[2], mn[1]);
+  __m128 mn2 = _mm_set_ps(mn[2], mn[1], mn[0], mn[2]);
+  __m128 mx0 = _mm_set_ps(mx[0], mx[2], mx[1], mx[0]);
+  __m128 mx1 = _mm_set_ps(mx[1], mx[0], mx[2], mx[1]);
+  __m128 mx2 = _mm_set_ps(mx[2], mx[1], mx[0], mx[2]);
+  for (; i + 4 <= n; i += 4) {
+    const __m128 a = _mm_loadu_ps(p + 3 * i);
+    const __m128 b = _mm_loadu_ps(p + 3 * i + 4);
+    const __m128 c = _mm_loadu_ps(p + 3 * i + 8);
+    // the second is returned if any NaN
+    mn0 = _mm_min_ps(a, mn0);
+    mn1 = _mm_min_ps(b, mn1);
+    mn2 = _mm_min_ps(c, mn2);
+    mx0 = _mm_max_ps(a, mx0);
+    mx1 = _mm_max_ps(b, mx1);
+    mx2 = _mm_max_ps(c, mx2);
+  }
+  alignas(16) float lanes[2][12];
+  _mm_store_ps(lanes[0], mn0);
+  _mm_store_ps(lanes[0] + 4, mn1);
+  _mm_store_ps(lanes[0] + 8, mn2);
+  _mm_store_ps(lanes[1], mx0);
+  _mm_store_ps(lanes[1] + 4, mx1);
+  _mm_store_ps(lanes[1] + 8, mx2);
+  for (int j = 0; j < 12; j++) {
+    mn[j % 3] = std::min(mn[j % 3], lanes[0][j]);
+    mx[j % 3] = std::max(mx[j % 3], lanes[1][j]);
+  }
+#endif
+  for (; i < n; i++) {
+    const float* q = p + 3 * i;
+    if (std::isnan(q[0]) || std::isnan(q[1]) || std::isnan(q[2])) continue;
+    for (int k = 0; k < 3; k++) {
+      mn[k] = std::min(mn[k], q[k]);
+      mx[k] = std::max(mx[k], q[k]);
+    }
+  }
+}
+
+void quantize_interleaved(const float* p, std::size_t n,
+    const float origin[3], float inv_scale, std::int16_t* q) {
+  std::size_t i = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128 o0 = _mm_set_ps(origin[0], origin[2], origin[1], origin[0]);
+  const __m128 o1 = _mm_set_ps(origin[1], origin[0], origin[2], origin[1]);
+  const __m128 o2 = _mm_set_ps(origin[2], origin[1], origin[0], origin[2]);
+  const __m128 inv = _mm_set1_ps(inv_scale);
+  for (; i + 4 <= n; i += 4) {
+    const float* s = p + 3 * i;
+    const __m128i a = _mm_cvtps_epi32(
+        _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s), o0), inv));
+    const __m128i b = _mm_cvtps_epi32(
+        _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s + 4), o1), inv));
+    const __m128i c = _mm_cvtps_epi32(
+        _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s + 8), o2), inv));
+    std::int16_t* d = q + 3 * i;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_packs_epi32(a, b));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(d + 8),
+        _mm_packs_epi32(c, c));
+  }
+#endif
+  for (; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      q[3 * i + k] = quantize(p[3 * i + k], origin[k], inv_scale);
+    }
+  }
+}
+
+// The bounds of the XYZRGB points, NaN skipped
+void bounds_xyzrgb(const float* p, std::size_t n, float mn[3], float mx[3]) {
+  std::size_t i = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  __m128 mn0 = _mm_set_ps(0, mn[2], mn[1], mn[0]);
+  __m128 mx0 = _mm_set_ps(0, mx[2], mx[1], mx[0]);
+  for (; i < n; i++) {
+    const __m128 a = _mm_loadu_ps(p + 4 * i);
+    mn0 = _mm_min_ps(a, mn0);
+    mx0 = _mm_max_ps(a, mx0);
+  }
+  alignas(16) float lanes[2][4];
+  _mm_store_ps(lanes[0], mn0);
+  _mm_store_ps(lanes[1], mx0);
+  std::copy(lanes[0], lanes[0] + 3, mn);
+  std::copy(lanes[1], lanes[1] + 3, mx);
+#endif
+  for (; i < n; i++) {
+    const float* q = p + 4 * i;
+    if (std::isnan(q[0]) || std::isnan(q[1]) || std::isnan(q[2])) continue;
+    for (int k = 0; k < 3; k++) {
+      mn[k] = std::min(mn[k], q[k]);
+      mx[k] = std::max(mx[k], q[k]);
+    }
+  }
+}
+
+void quantize_xyzrgb(const float* p, std::size_t n, const float origin[3],
+    float inv_scale, std::int16_t* q) {
+  std::size_t i = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  for (; i + 4 <= n; i += 4) {
+    // drop the rgb by transposing, then quantize as interleaved
+    __m128 a = _mm_loadu_ps(p + 4 * i);
+    __m128 b = _mm_loadu_ps(p + 4 * i + 4);
+    __m128 c = _mm_loadu_ps(p + 4 * i + 8);
+    __m128 d = _mm_loadu_ps(p + 4 * i + 12);
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    alignas(16) float xyz[12];
+    simd::store_xyz(xyz, a, b, c);
+    quantize_interleaved(xyz, 4, origin, inv_scale, q + 3 * i);
+  }
+#endif
+  for (; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      q[3 * i + k] = quantize(p[4 * i + k], origin[k], inv_scale);
+    }
+  }
+}
+
+void dequantize_interleaved(const std::int16_t* q, std::size_t n,
+    const float origin[3], float scale, float* p) {
+  std::size_t i = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+  const __m128 o0 = _mm_set_ps(origin[0], origin[2], origin[1], origin[0]);
+  const __m128 o1 = _mm_set_ps(origin[1], origin[0], origin[2], origin[1]);
+  const __m128 o2 = _mm_set_ps(origin[2], origin[1], origin[0], origin[2]);
+  const __m128 s = _mm_set1_ps(scale);
+  for (; i + 4 <= n; i += 4) {
+    const std::int16_t* src = q + 3 * i;
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i hi = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(src + 8));
+    // sign extend to 32 bits
+    const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16);
+    const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16);
+    const __m128i c = _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16);
+    float* d = p + 3 * i;
+    _mm_storeu_ps(d, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(a), s), o0));
+    _mm_storeu_ps(d + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(b), s), o1));
+    _mm_storeu_ps(d + 8, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(c), s), o2));
+  }
+#endif
+  for (; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      p[3 * i + k] = q[3 * i + k] * scale + origin[k];
+    }
+  }
+}
+
+}  // namespace
+
+PointCloudCodec::PointCloudCodec() : color_(true) {
+}
+
+PointCloudCodec::~PointCloudCodec() {
+}
+
+void PointCloudCodec::SetColor(bool enabled) {
+  color_ = enabled;
+}
+
+bool PointCloudCodec::Encode(const PointCloudData& points,
+    std::vector<std::uint8_t>* bytes) {
+  if (!bytes) return false;
+  const std::size_t count = points.count;
+  const bool organized = points.organized;
+  if (organized &&
+      count != static_cast<std::size_t>(points.width) * points.height) {
+    LOGW("%s: organized points not of width x height", __func__);
+    return false;
+  }
+  if (organized && points.width > kMaxWidth) {
+    LOGW("%s: organized points wider than %zu", __func__, kMaxWidth);
+    return false;
+  }
+  const PointCloudLayout layout = points.layout;
+  const bool packed = layout == PointCloudLayout::XYZRGB;
+  const bool color = color_ && (points.has_color() || packed);
+  const std::size_t stride = points.stride();
+  const float* xs = points.x();
+  const float* ys = points.y();
+  const float* zs = points.z();
+
+  // the runs of rows, alternate invalid and valid, starting with invalid
+  runs_.clear();
+  std::size_t valid = count;
+  if (organized) {
+    valid = 0;
+    const std::size_t width = points.width;
+    for (std::size_t v = 0; v < points.height; v++) {
+      std::size_t u = 0;
+      bool want = false;
+      while (u < width) {
+        const std::size_t beg = u;
+        const float* z = zs + v * width * stride;
+        while (u < width && std::isnan(z[u * stride]) != want) ++u;
+        runs_.push_back(static_cast<std::uint16_t>(u - beg));
+        if (want) valid += u - beg;
+        want = !want;
+      }
+    }
+  }
+
+  // the bounds, the center is the origin
+  float mn[3], mx[3];
+  std::fill(mn, mn + 3, std::numeric_limits<float>::infinity());
+  std::fill(mx, mx + 3, -std::numeric_limits<float>::infinity());
+  if (layout == PointCloudLayout::INTERLEAVED) {
+    bounds_interleaved(points.xyz.data(), count, mn, mx);
+  } else if (packed) {
+    bounds_xyzrgb(points.xyz.data(), count, mn, mx);
+  } else {
+    for (std::size_t i = 0; i < count; i++) {
+      const float p[3] = {xs[i * stride], ys[i * stride], zs[i * stride]};
+      if (std::isnan(p[0]) || std::isnan(p[1]) || std::isnan(p[2])) continue;
+      for (int k = 0; k < 3; k++) {
+        mn[k] = std::min(mn[k], p[k]);
+        mx[k] = std::max(mx[k], p[k]);
+      }
+    }
+  }
+  float origin[3] = {0, 0, 0};
+  float half = 0;
+  if (valid > 0) {
+    for (int k = 0; k < 3; k++) {
+      origin[k] = (mn[k] + mx[k]) * 0.5f;
+      half = std::max(half, (mx[k] - mn[k]) * 0.5f);
+    }
+  }
+  const float scale = std::max(half / kQuantMax, kMinScale);
+  const float inv_scale = 1.f / scale;
+
+  const std::size_t runs_bytes = runs_.size() * sizeof(std::uint16_t);
+  const std::size_t xyz_bytes = 3 * valid * sizeof(std::int16_t);
+  const std::size_t rgb_bytes = color ? valid * sizeof(std::uint16_t) : 0;
+  // the capacity is kept among frames
+  bytes->resize(sizeof(PacketHeader) + runs_bytes + xyz_bytes + rgb_bytes);
+
+  PacketHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.width = organized ? points.width : static_cast<std::uint32_t>(valid);
+  header.height = organized ? points.height : 1;
+  header.count = static_cast<std::uint32_t>(valid);
+  header.runs = static_cast<std::uint32_t>(runs_.size());
+  header.flags = (organized ? kFlagOrganized : 0) | (color ? kFlagColor : 0);
+  header.frame_id = points.frame_id;
+  header.timestamp = points.timestamp;
+  std::copy(origin, origin + 3, header.origin);
+  header.scale = scale;
+  std::uint8_t* data = bytes->data();
+  std::memcpy(data, &header, sizeof(header));
+  if (runs_bytes > 0) {
+    std::memcpy(data + sizeof(header), runs_.data(), runs_bytes);
+  }
+  auto q = reinterpret_cast<std::int16_t*>(data + sizeof(header) +
+      runs_bytes);
+  auto c = reinterpret_cast<std::uint16_t*>(data + sizeof(header) +
+      runs_bytes + xyz_bytes);
+
+  // the valid points from first
+  auto encode_span = [&](std::size_t first, std::size_t n) {
+    if (layout == PointCloudLayout::INTERLEAVED) {
+      quantize_interleaved(points.xyz.data() + 3 * first, n, origin,
+          inv_scale, q);
+    } else if (packed) {
+      quantize_xyzrgb(points.xyz.data() + 4 * first, n, origin, inv_scale, q);
+    } else {
+      for (std::size_t i = 0; i < n; i++) {
+        const std::size_t j = (first + i) * stride;
+        q[3 * i] = quantize(xs[j], origin[0], inv_scale);
+        q[3 * i + 1] = quantize(ys[j], origin[1], inv_scale);
+        q[3 * i + 2] = quantize(zs[j], origin[2], inv_scale);
+      }
+    }
+    q += 3 * n;
+    if (!color) return;
+    if (packed) {
+      for (std::size_t i = 0; i < n; i++) {
+        std::uint32_t bits;
+        std::memcpy(&bits, &points.xyz[4 * (first + i) + 3], sizeof(bits));
+        c[i] = static_cast<std::uint16_t>(((bits >> 8) & 0xf800) |
+            ((bits >> 5) & 0x07e0) | ((bits >> 3) & 0x001f));
+      }
+    } else {
+      const std::uint8_t* rgb = points.rgb.data() + 3 * first;
+      for (std::size_t i = 0; i < n; i++) {
+        c[i] = to_rgb565(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+      }
+    }
+    c += n;
+  };
+  if (!organized) {
+    encode_span(0, count);
+  } else {
+    std::size_t i = 0;
+    bool want = false;
+    for (auto&& run : runs_) {
+      const std::size_t row_end = (i / points.width + 1) * points.width;
+      if (want && run > 0) encode_span(i, run);
+      i += run;
+      // a new row starts with invalid
+      want = !want && i != row_end;
+    }
+  }
+  return true;
+}
+
+bool PointCloudCodec::Decode(const std::uint8_t* data, std::size_t size,
+    PointCloudData* points) {
+  if (!data || !points || size < sizeof(PacketHeader)) return false;
+  PacketHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    LOGW("%s: not encoded points", __func__);
+    return false;
+  }
+  const bool organized = (header.flags & kFlagOrganized) != 0;
+  const bool color = (header.flags & kFlagColor) != 0;
+  const std::size_t valid = header.count;
+  const std::size_t runs_bytes = header.runs * sizeof(std::uint16_t);
+  const std::size_t xyz_bytes = 3 * valid * sizeof(std::int16_t);
+  const std::size_t rgb_bytes = color ? valid * sizeof(std::uint16_t) : 0;
+  if (size != sizeof(header) + runs_bytes + xyz_bytes + rgb_bytes) {
+    LOGW("%s: encoded points of wrong size", __func__);
+    return false;
+  }
+  const std::size_t width = header.width;
+  std::size_t count = valid;
+  // the runs must cover width x height exactly, before allocating it
+  std::vector<std::uint16_t> runs;
+  if (organized) {
+    if (width == 0 || width > kMaxWidth) {
+      LOGW("%s: encoded width invalid", __func__);
+      return false;
+    }
+    runs.resize(header.runs);
+    if (runs_bytes > 0) {
+      std::memcpy(runs.data(), data + sizeof(header), runs_bytes);
+    }
+    std::size_t i = 0, decoded = 0;
+    bool want = false;
+    for (auto&& run : runs) {
+      const std::size_t row_end = (i / width + 1) * width;
+      if (i + run > row_end) {
+        LOGW("%s: encoded runs corrupted", __func__);
+        return false;
+      }
+      if (want) decoded += run;
+      i += run;
+      want = !want && i != row_end;
+    }
+    if (i % width != 0 || i / width != header.height || decoded != valid) {
+      LOGW("%s: encoded runs corrupted", __func__);
+      return false;
+    }
+    count = i;
+  }
+
+  points->organized = organized;
+  points->layout = PointCloudLayout::INTERLEAVED;
+  points->width = header.width;
+  points->height = header.height;
+  points->count = count;
+  points->frame_id = header.frame_id;
+  points->timestamp = header.timestamp;
+  points->xyz.resize(3 * count);
+  if (color) {
+    points->rgb.resize(3 * count);
+  } else {
+    points->rgb.clear();
+  }
+  points->indices.clear();
+
+  auto q = reinterpret_cast<const std::int16_t*>(data + sizeof(header) +
+      runs_bytes);
+  auto c = reinterpret_cast<const std::uint16_t*>(data + sizeof(header) +
+      runs_bytes + xyz_bytes);
+  auto decode_span = [&](std::size_t first, std::size_t n) {
+    dequantize_interleaved(q, n, header.origin, header.scale,
+        points->xyz.data() + 3 * first);
+    q += 3 * n;
+    if (!color) return;
+    std::uint8_t* rgb = points->rgb.data() + 3 * first;
+    for (std::size_t i = 0; i < n; i++) {
+      from_rgb565(c[i], rgb + 3 * i);
+    }
+    c += n;
+  };
+  if (!organized) {
+    decode_span(0, count);
+    return true;
+  }
+
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::size_t i = 0;
+  bool want = false;
+  for (auto&& run : runs) {
+    const std::size_t row_end = (i / width + 1) * width;
+    if (want) {
+      decode_span(i, run);
+    } else {
+      std::fill(points->xyz.begin() + 3 * i,
+          points->xyz.begin() + 3 * (i + run), nan);
+      if (color) {
+        std::fill(points->rgb.begin() + 3 * i,
+            points->rgb.begin() + 3 * (i + run), 0);
+      }
+    }
+    i += run;
+    want = !want && i != row_end;
+  }
+  return true;
+}
@@ -0,0 +1,285 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/point_cloud_writer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "mynteyed/util/log.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The points converted a time, then written by one call
+const std::size_t kChunkPoints = 65536;
+
+bool has_extension(const std::string& path, const char* ext) {
+  const std::size_t n = std::strlen(ext);
+  if (path.size() < n) return false;
+  for (std::size_t i = 0; i < n; i++) {
+    char c = static_cast<char>(
+        std::tolower(static_cast<unsigned char>(path[path.size() - n + i])));
+    if (c != ext[i]) return false;
+  }
+  return true;
+}
+
+// The r g b of point i, of the rgb or packed in XYZRGB
+inline void get_rgb(const PointCloudData& points, std::size_t i,
+    std::uint8_t rgb[3]) {
+  if (points.layout == PointCloudLayout::XYZRGB) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &points.xyz[4 * i + 3], sizeof(bits));
+    rgb[0] = (bits >> 16) & 0xff;
+    rgb[1] = (bits >> 8) & 0xff;
+    rgb[2] = bits & 0xff;
+  } else {
+    std::memcpy(rgb, &points.rgb[3 * i], 3);
+  }
+}
+
+std::size_t count_valid(const PointCloudData& points) {
+  if (!points.organized) return points.count;
+  const float* z = points.z();
+  const std::size_t stride = points.stride();
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < points.count; i++) {
+    if (!std::isnan(z[i * stride])) ++n;
+  }
+  return n;
+}
+
+std::string ply_header(std::size_t count, bool color) {
+  std::string s =
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "element vertex " + std::to_string(count) + "\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n";
+  if (color) {
+    s += "property uchar red\n"
+        "property uchar green\n"
+        "property uchar blue\n";
+  }
+  return s + "end_header\n";
+}
+
+std::string pcd_header(const PointCloudData& points, bool color) {
+  std::uint32_t width = points.width;
+  std::uint32_t height = points.height;
+  if (!points.organized || width * height != points.count) {
+    width = static_cast<std::uint32_t>(points.count);
+    height = 1;
+  }
+  return std::string("# .PCD v0.7 - Point Cloud Data file format\n"
+      "VERSION 0.7\n") +
+      (color ? "FIELDS x y z rgb\n"
+          "SIZE 4 4 4 4\n"
+          "TYPE F F F F\n"
+          "COUNT 1 1 1 1\n" :
+          "FIELDS x y z\n"
+          "SIZE 4 4 4\n"
+          "TYPE F F F\n"
+          "COUNT 1 1 1\n") +
+      "WIDTH " + std::to_string(width) + "\n"
+      "HEIGHT " + std::to_string(height) + "\n"
+      "VIEWPOINT 0 0 0 1 0 0 0\n"
+      "POINTS " + std::to_string(points.count) + "\n"
+      "DATA binary\n";
+}
+
+// Convert the points by chunks into the buffer, then write each
+bool write_points(std::FILE* file, const PointCloudData& points, bool ply,
+    bool color) {
+  const float* x = points.x();
+  const float* y = points.y();
+  const float* z = points.z();
+  const std::size_t stride = points.stride();
+  const std::size_t point_size = 12 + (color ? (ply ? 3 : 4) : 0);
+
+  std::vector<std::uint8_t> buffer(kChunkPoints * point_size);
+  std::size_t size = 0;
+  for (std::size_t i = 0; i < points.count; i++) {
+    const std::size_t k = i * stride;
+    // PLY is unorganized, so only the valid
+    if (ply && std::isnan(z[k])) continue;
+    std::uint8_t* p = buffer.data() + size;
+    std::memcpy(p, x + k, 4);
+    std::memcpy(p + 4, y + k, 4);
+    std::memcpy(p + 8, z + k, 4);
+    if (color) {
+      std::uint8_t rgb[3];
+      get_rgb(points, i, rgb);
+      if (ply) {
+        std::memcpy(p + 12, rgb, 3);
+      } else {
+        std::uint32_t bits = (static_cast<std::uint32_t>(rgb[0]) << 16) |
+            (static_cast<std::uint32_t>(rgb[1]) << 8) | rgb[2];
+        std::memcpy(p + 12, &bits, 4);
+      }
+    }
+    size += point_size;
+    if (size == buffer.size()) {
+      if (std::fwrite(buffer.data(), 1, size, file) != size) return false;
+      size = 0;
+    }
+  }
+  return size == 0 || std::fwrite(buffer.data(), 1, size, file) == size;
+}
+
+}  // namespace
+
+PointCloudWriter::PointCloudWriter(std::size_t max_queue)
+  : max_queue_(max_queue),
+    running_(true),
+    writing_(false),
+    written_count_(0),
+    failed_count_(0),
+    dropped_count_(0) {
+  thread_ = std::thread(&PointCloudWriter::Run, this);
+}
+
+PointCloudWriter::~PointCloudWriter() {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    running_ = false;
+  }
+  condition_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool PointCloudWriter::Write(const std::string& path,
+    const PointCloudData& points) {
+  const bool ply = has_extension(path, ".ply");
+  if (!ply && !has_extension(path, ".pcd")) {
+    LOGW("%s: unknown format of %s, should be .ply or .pcd", __func__,
+        path.c_str());
+    return false;
+  }
+  const std::size_t values = points.stride() * points.count;
+  const bool packed = points.layout == PointCloudLayout::XYZRGB;
+  const bool color = packed || points.has_color();
+  if (points.xyz.size() < (points.layout == PointCloudLayout::PLANAR ?
+      3 * points.count : values) ||
+      (color && !packed && points.rgb.size() < 3 * points.count)) {
+    LOGW("%s: points of %zu are not complete", __func__, points.count);
+    return false;
+  }
+
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    LOGW("%s: open %s failed", __func__, path.c_str());
+    return false;
+  }
+  // the headers are small, the data are written by large chunks
+  std::setvbuf(file, nullptr, _IONBF, 0);
+  std::string header = ply ? ply_header(count_valid(points), color) :
+      pcd_header(points, color);
+  bool ok = std::fwrite(header.data(), 1, header.size(), file) ==
+      header.size();
+  if (ok) {
+    if (!ply && (packed || (!color &&
+        points.layout == PointCloudLayout::INTERLEAVED))) {
+      // the same as PCD, so written at once
+      ok = std::fwrite(points.xyz.data(), sizeof(float), values, file) ==
+          values;
+    } else {
+      ok = write_points(file, points, ply, color);
+    }
+  }
+  ok = std::fclose(file) == 0 && ok;
+  if (!ok) {
+    LOGW("%s: write %s failed", __func__, path.c_str());
+  }
+  return ok;
+}
+
+PointCloudData PointCloudWriter::Acquire() {
+  std::lock_guard<std::mutex> _(mutex_);
+  if (free_.empty()) return PointCloudData();
+  PointCloudData points = std::move(free_.back());
+  free_.pop_back();
+  return points;
+}
+
+bool PointCloudWriter::Push(const std::string& path,
+    PointCloudData&& points) {
+  {
+    std::lock_guard<std::mutex> _(mutex_);
+    if (max_queue_ > 0 && queue_.size() >= max_queue_) {
+      ++dropped_count_;
+      if (free_.size() < std::max<std::size_t>(max_queue_, 1)) {
+        free_.push_back(std::move(points));
+      }
+      return false;
+    }
+    queue_.emplace_back(path, std::move(points));
+  }
+  condition_.notify_one();
+  return true;
+}
+
+void PointCloudWriter::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  flushed_.wait(lock, [this] { return queue_.empty() && !writing_; });
+}
+
+std::size_t PointCloudWriter::GetWrittenCount() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return written_count_;
+}
+
+std::size_t PointCloudWriter::GetFailedCount() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return failed_count_;
+}
+
+std::size_t PointCloudWriter::GetDroppedCount() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return dropped_count_;
+}
+
+void PointCloudWriter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    condition_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+    // the queued are still written if stopped
+    if (queue_.empty()) break;
+    auto job = std::move(queue_.front());
+    queue_.pop_front();
+    writing_ = true;
+
+    lock.unlock();
+    bool ok = Write(job.first, job.second);
+    lock.lock();
+
+    if (ok) {
+      ++written_count_;
+    } else {
+      ++failed_count_;
+    }
+    if (free_.size() < std::max<std::size_t>(max_queue_, 1)) {
+      free_.push_back(std::move(job.second));
+    }
+    writing_ = false;
+    if (queue_.empty()) flushed_.notify_all();
+  }
+}
@@ -0,0 +1,828 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/tsdf_volume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/internal/thread_pool.h"
+#include "mynteyed/util/log.h"
+#include "mynteyed/util/simd.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The voxels along one side of a block
+const int kBlockSide = 8;
+const int kBlockVoxels = kBlockSide * kBlockSide * kBlockSide;
+// The pixels step to allocate blocks, the blocks are much larger than the
+// footprint of pixels in the range
+const int kAllocStep = 4;
+// The rows of one chunk at least, to collect block keys
+const std::size_t kChunkMinRows = 64;
+// The blocks evicted at least, of the max, so not every frame
+const std::size_t kEvictDivisor = 16;
+// The max interval of gyroscope datas integrated, in seconds
+const double kGyroMaxInterval = 0.1;
+const double kDegToRad = 3.14159265358979323846 / 180;
+
+// 21 bits of each block coord
+const std::int64_t kCoordBits = 21;
+const std::int64_t kCoordOffset = std::int64_t(1) << (kCoordBits - 1);
+const std::int64_t kCoordMask = (std::int64_t(1) << kCoordBits) - 1;
+// 20 bits of each voxel coord of mesh edges, the low 3 bits are the axes
+const std::int64_t kEdgeBits = 20;
+const std::int64_t kEdgeMask = (std::int64_t(1) << kEdgeBits) - 1;
+
+inline std::uint64_t pack_coord(std::int32_t x, std::int32_t y,
+    std::int32_t z) {
+  return (static_cast<std::uint64_t>((x + kCoordOffset) & kCoordMask) <<
+          (2 * kCoordBits)) |
+      (static_cast<std::uint64_t>((y + kCoordOffset) & kCoordMask) <<
+          kCoordBits) |
+      static_cast<std::uint64_t>((z + kCoordOffset) & kCoordMask);
+}
+
+inline void unpack_coord(std::uint64_t key, std::int32_t coord[3]) {
+  coord[0] = static_cast<std::int32_t>(
+      ((key >> (2 * kCoordBits)) & kCoordMask) - kCoordOffset);
+  coord[1] = static_cast<std::int32_t>(
+      ((key >> kCoordBits) & kCoordMask) - kCoordOffset);
+  coord[2] = static_cast<std::int32_t>((key & kCoordMask) - kCoordOffset);
+}
+
+// The squared distance of the block center to p, in meters
+inline double center_distance2(const std::int32_t coord[3], double block_size,
+    const double p[3]) {
+  double dist = 0;
+  for (int i = 0; i < 3; i++) {
+    double d = (coord[i] + 0.5) * block_size - p[i];
+    dist += d * d;
+  }
+  return dist;
+}
+
+// The floor by truncation without the library call
+inline std::int32_t floor_int(float v) {
+  auto i = static_cast<std::int32_t>(v);
+  return i - (v < i);
+}
+
+void mat_mul(const double a[3][3], const double b[3][3], double c[3][3]) {
+  double r[3][3];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+    }
+  }
+  std::copy(&r[0][0], &r[0][0] + 9, &c[0][0]);
+}
+
+void mat_identity(double m[3][3]) {
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] = i == j ? 1 : 0;
+    }
+  }
+}
+
+// The rotation of the rotation vector w, by Rodrigues
+void mat_exp(const double w[3], double r[3][3]) {
+  mat_identity(r);
+  const double theta = std::sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+  if (theta < 1e-12) return;
+  const double k[3] = {w[0] / theta, w[1] / theta, w[2] / theta};
+  const double kx[3][3] = {
+    {0, -k[2], k[1]},
+    {k[2], 0, -k[0]},
+    {-k[1], k[0], 0},
+  };
+  double kx2[3][3];
+  mat_mul(kx, kx, kx2);
+  const double s = std::sin(theta), c = 1 - std::cos(theta);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] += kx[i][j] * s + kx2[i][j] * c;
+    }
+  }
+}
+
+// The pose of camera in world, translation in meters
+void copy_pose(const Extrinsics& pose, double rotation[3][3],
+    double translation[3]) {
+  std::copy(&pose.rotation[0][0], &pose.rotation[0][0] + 9, &rotation[0][0]);
+  for (int i = 0; i < 3; i++) {
+    translation[i] = pose.translation[i] * 0.001;
+  }
+}
+
+// The voxel of global coords (x, y, z) among the 2 x 2 x 2 blocks from one
+template <typename Block>
+inline bool neighbor_voxel(const Block* const blocks[8], int x, int y, int z,
+    float* tsdf) {
+  const Block* block = blocks[(x >> 3) | ((y >> 3) << 1) | ((z >> 3) << 2)];
+  if (!block) return false;
+  const int i = (x & 7) | ((y & 7) << 3) | ((z & 7) << 6);
+  // not seen, or far from surfaces that a crossing is of a jump
+  if (block->weight[i] <= 0 || std::fabs(block->tsdf[i]) >= 1) return false;
+  *tsdf = block->tsdf[i];
+  return true;
+}
+
+// The 6 tetrahedra of a cube along its main diagonal, by corner bits x y z
+const int kTetrahedra[6][4] = {
+  {0, 1, 3, 7}, {0, 1, 5, 7}, {0, 2, 3, 7},
+  {0, 2, 6, 7}, {0, 4, 5, 7}, {0, 4, 6, 7},
+};
+
+}  // namespace
+
+TsdfVolume::TsdfVolume(std::size_t threads)
+  : intrinsics_(),
+    has_intrinsics_(false),
+    voxel_size_(0.02f),
+    truncation_(0.08f),
+    min_depth_(0.3f),
+    max_depth_(4.f),
+    max_weight_(64.f),
+    max_blocks_(16384),
+    translation_{0, 0, 0},
+    gyro_timestamp_(0),
+    has_gyro_(false),
+    frame_id_(0),
+    timestamp_(0),
+    depth_width_(0),
+    depth_height_(0),
+    fx_(0), fy_(0), cx_(0), cy_(0),
+    frame_count_(0),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+  mat_identity(rotation_);
+  mat_identity(imu_to_camera_);
+  mat_identity(delta_);
+}
+
+TsdfVolume::~TsdfVolume() {
+}
+
+void TsdfVolume::SetIntrinsics(const CameraIntrinsics& intrinsics) {
+  std::lock_guard<std::mutex> _(mutex_);
+  intrinsics_ = intrinsics;
+  // the rectified one, if any
+  if (intrinsics.p[0] > 0) {
+    intrinsics_.fx = intrinsics.p[0];
+    intrinsics_.cx = intrinsics.p[2];
+    intrinsics_.fy = intrinsics.p[5];
+    intrinsics_.cy = intrinsics.p[6];
+  }
+  has_intrinsics_ = intrinsics_.fx > 0 && intrinsics_.fy > 0 &&
+      intrinsics_.width > 0 && intrinsics_.height > 0;
+  // recompute
+  depth_width_ = depth_height_ = 0;
+}
+
+void TsdfVolume::SetVoxelSize(float voxel_size, float truncation) {
+  if (voxel_size <= 0) return;
+  if (truncation <= 0) truncation = 4 * voxel_size;
+  std::lock_guard<std::mutex> _(mutex_);
+  if (voxel_size == voxel_size_ && truncation == truncation_) return;
+  voxel_size_ = voxel_size;
+  truncation_ = truncation;
+  blocks_.clear();
+  free_blocks_.clear();
+  block_map_.clear();
+}
+
+void TsdfVolume::SetDepthRange(float min_depth, float max_depth) {
+  std::lock_guard<std::mutex> _(mutex_);
+  min_depth_ = min_depth;
+  max_depth_ = max_depth;
+}
+
+void TsdfVolume::SetMaxWeight(float max_weight) {
+  std::lock_guard<std::mutex> _(mutex_);
+  max_weight_ = std::max(max_weight, 1.f);
+}
+
+void TsdfVolume::SetMaxBlocks(std::size_t max_blocks) {
+  std::lock_guard<std::mutex> _(mutex_);
+  max_blocks_ = std::max<std::size_t>(max_blocks, 1);
+}
+
+void TsdfVolume::SetPose(const Extrinsics& camera_to_world) {
+  std::lock_guard<std::mutex> _(mutex_);
+  copy_pose(camera_to_world, rotation_, translation_);
+  std::lock_guard<std::mutex> __(motion_mutex_);
+  mat_identity(delta_);
+}
+
+Extrinsics TsdfVolume::GetPose() {
+  std::lock_guard<std::mutex> _(mutex_);
+  Extrinsics pose;
+  {
+    std::lock_guard<std::mutex> __(motion_mutex_);
+    mat_mul(rotation_, delta_, pose.rotation);
+  }
+  for (int i = 0; i < 3; i++) {
+    pose.translation[i] = translation_[i] * 1000;
+  }
+  return pose;
+}
+
+void TsdfVolume::SetMotionExtrinsics(const MotionExtrinsics& extrinsics) {
+  std::lock_guard<std::mutex> _(motion_mutex_);
+  std::copy(&extrinsics.rotation[0][0], &extrinsics.rotation[0][0] + 9,
+      &imu_to_camera_[0][0]);
+}
+
+void TsdfVolume::OnMotionData(const MotionData& data) {
+  if (!data.imu || data.imu->flag != MYNTEYE_IMU_GYRO) return;
+  std::lock_guard<std::mutex> _(motion_mutex_);
+  // the timestamp is in 0.01 ms
+  const double dt = has_gyro_ ?
+      (static_cast<double>(data.imu->timestamp) -
+          static_cast<double>(gyro_timestamp_)) * 1e-5 : 0;
+  gyro_timestamp_ = data.imu->timestamp;
+  has_gyro_ = true;
+  if (dt <= 0 || dt > kGyroMaxInterval) return;
+  // the angular velocity in camera, degrees to radians
+  double w[3] = {0, 0, 0};
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      w[i] += imu_to_camera_[i][j] * data.imu->gyro[j] * kDegToRad * dt;
+    }
+  }
+  double r[3][3];
+  mat_exp(w, r);
+  mat_mul(delta_, r, delta_);
+}
+
+void TsdfVolume::PropagatePose() {
+  std::lock_guard<std::mutex> _(motion_mutex_);
+  mat_mul(rotation_, delta_, rotation_);
+  mat_identity(delta_);
+}
+
+bool TsdfVolume::Integrate(const Image::pointer& depth,
+    const Extrinsics& camera_to_world) {
+  std::lock_guard<std::mutex> _(mutex_);
+  copy_pose(camera_to_world, rotation_, translation_);
+  {
+    std::lock_guard<std::mutex> __(motion_mutex_);
+    mat_identity(delta_);
+  }
+  return IntegrateFrame(depth);
+}
+
+bool TsdfVolume::Integrate(const Image::pointer& depth) {
+  std::lock_guard<std::mutex> _(mutex_);
+  PropagatePose();
+  return IntegrateFrame(depth);
+}
+
+void TsdfVolume::Reset() {
+  std::lock_guard<std::mutex> _(mutex_);
+  blocks_.clear();
+  free_blocks_.clear();
+  block_map_.clear();
+}
+
+std::size_t TsdfVolume::GetBlockCount() {
+  std::lock_guard<std::mutex> _(mutex_);
+  return block_map_.size();
+}
+
+void TsdfVolume::UpdateIntrinsics(int width, int height) {
+  if (width == depth_width_ && height == depth_height_) return;
+  // scale to depth size, the pixel centers are kept
+  double sx = static_cast<double>(width) / intrinsics_.width;
+  double sy = static_cast<double>(height) / intrinsics_.height;
+  fx_ = static_cast<float>(intrinsics_.fx * sx);
+  fy_ = static_cast<float>(intrinsics_.fy * sy);
+  cx_ = static_cast<float>((intrinsics_.cx + 0.5) * sx - 0.5);
+  cy_ = static_cast<float>((intrinsics_.cy + 0.5) * sy - 0.5);
+  depth_width_ = width;
+  depth_height_ = height;
+}
+
+bool TsdfVolume::IntegrateFrame(const Image::pointer& depth) {
+  if (!depth || depth->format() != ImageFormat::DEPTH_RAW) {
+    return false;
+  }
+  if (!has_intrinsics_) {
+    LOGW("%s: intrinsics not set", __func__);
+    return false;
+  }
+  const int width = depth->width();
+  const int height = depth->height();
+  UpdateIntrinsics(width, height);
+  frame_id_ = depth->frame_id();
+  timestamp_ = depth->timestamp();
+  ++frame_count_;
+
+  // world to camera: R^T, -R^T * t
+  for (int i = 0; i < 3; i++) {
+    camera_to_world_[i][3] = static_cast<float>(translation_[i]);
+    world_to_camera_[i][3] = 0;
+    for (int j = 0; j < 3; j++) {
+      camera_to_world_[i][j] = static_cast<float>(rotation_[i][j]);
+      world_to_camera_[i][j] = static_cast<float>(rotation_[j][i]);
+      world_to_camera_[i][3] -= static_cast<float>(
+          rotation_[j][i] * translation_[j]);
+    }
+  }
+
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  const std::size_t rows = height;
+  const std::size_t chunks = std::min(pool_->size(),
+      std::max<std::size_t>(rows / kChunkMinRows, 1));
+  chunk_keys_.resize(chunks);
+  pool_->ParallelFor(chunks, [this, data, chunks, rows](
+      std::size_t beg, std::size_t end) {
+    for (std::size_t c = beg; c < end; c++) {
+      CollectKeys(data, c, c * rows / chunks, (c + 1) * rows / chunks);
+    }
+  });
+  AllocateBlocks();
+
+  pool_->ParallelFor(visible_.size(), [this, data](
+      std::size_t beg, std::size_t end) {
+    for (std::size_t i = beg; i < end; i++) {
+      IntegrateBlock(data, &blocks_[visible_[i]]);
+    }
+  }, 8);
+  return true;
+}
+
+void TsdfVolume::CollectKeys(const std::uint16_t* depth, std::size_t chunk,
+    std::size_t beg, std::size_t end) {
+  std::vector<std::uint64_t>& keys = chunk_keys_[chunk];
+  keys.clear();
+  const float block_size = voxel_size_ * kBlockSide;
+  const float inv_block = 1.f / block_size;
+  // sample the truncation band along the ray, at most half block apart
+  const int samples = static_cast<int>(
+      std::ceil(2 * truncation_ / (0.5f * block_size))) + 1;
+  const float sample_step = 2 * truncation_ / (samples - 1);
+  const float (*m)[4] = camera_to_world_;
+
+  std::uint64_t last_key = ~std::uint64_t(0);
+  const std::size_t width = depth_width_;
+  for (std::size_t v = (beg + kAllocStep - 1) / kAllocStep * kAllocStep;
+       v < end; v += kAllocStep) {
+    const float ry = (v - cy_) / fy_;
+    for (std::size_t u = 0; u < width; u += kAllocStep) {
+      const std::uint16_t d = depth[v * width + u];
+      if (!is_depth_valid(d)) continue;
+      const float z = d * 0.001f;
+      if (z < min_depth_ || z > max_depth_) continue;
+      const float rx = (u - cx_) / fx_;
+      // the ray in world, and the camera origin
+      const float dir[3] = {
+        m[0][0] * rx + m[0][1] * ry + m[0][2],
+        m[1][0] * rx + m[1][1] * ry + m[1][2],
+        m[2][0] * rx + m[2][1] * ry + m[2][2],
+      };
+      for (int s = 0; s < samples; s++) {
+        const float zs = z - truncation_ + s * sample_step;
+        if (zs <= 0) continue;
+        std::uint64_t key = pack_coord(
+            floor_int((m[0][3] + dir[0] * zs) * inv_block),
+            floor_int((m[1][3] + dir[1] * zs) * inv_block),
+            floor_int((m[2][3] + dir[2] * zs) * inv_block));
+        // the neighbor samples are mostly of the same block
+        if (key == last_key) continue;
+        keys.push_back(key);
+        last_key = key;
+      }
+    }
+  }
+}
+
+void TsdfVolume::AllocateBlocks() {
+  keys_.clear();
+  for (auto&& keys : chunk_keys_) {
+    keys_.insert(keys_.end(), keys.begin(), keys.end());
+  }
+  std::sort(keys_.begin(), keys_.end());
+  keys_.erase(std::unique(keys_.begin(), keys_.end()), keys_.end());
+
+  // mark the blocks seen first, so they are not evicted; keep the new keys
+  visible_.clear();
+  std::size_t news = 0;
+  for (auto&& key : keys_) {
+    auto it = block_map_.find(key);
+    if (it == block_map_.end()) {
+      keys_[news++] = key;
+      continue;
+    }
+    blocks_[it->second].last_frame = frame_count_;
+    visible_.push_back(it->second);
+  }
+  keys_.resize(news);
+  if (block_map_.size() + news > max_blocks_) {
+    EvictBlocks(std::max(block_map_.size() + news - max_blocks_,
+        max_blocks_ / kEvictDivisor));
+  }
+  // the visible are never evicted, so the farthest new are dropped if they
+  // alone exceed the max
+  const std::size_t budget =
+      max_blocks_ - std::min(block_map_.size(), max_blocks_);
+  if (news > budget) {
+    const double block_size = voxel_size_ * kBlockSide;
+    const double* origin = translation_;
+    std::nth_element(keys_.begin(), keys_.begin() + budget, keys_.end(),
+        [block_size, origin](std::uint64_t a, std::uint64_t b) {
+          std::int32_t ca[3], cb[3];
+          unpack_coord(a, ca);
+          unpack_coord(b, cb);
+          return center_distance2(ca, block_size, origin) <
+              center_distance2(cb, block_size, origin);
+        });
+    keys_.resize(budget);
+  }
+
+  for (auto&& key : keys_) {
+    std::uint32_t index;
+    if (free_blocks_.empty()) {
+      index = static_cast<std::uint32_t>(blocks_.size());
+      blocks_.emplace_back();
+    } else {
+      index = free_blocks_.back();
+      free_blocks_.pop_back();
+    }
+    Block& block = blocks_[index];
+    std::fill(block.tsdf, block.tsdf + kBlockVoxels, 1.f);
+    std::fill(block.weight, block.weight + kBlockVoxels, 0.f);
+    unpack_coord(key, block.coord);
+    block.last_frame = frame_count_;
+    block_map_.emplace(key, index);
+    visible_.push_back(index);
+  }
+}
+
+void TsdfVolume::EvictBlocks(std::size_t count) {
+  // the least recently seen first, then the farthest from camera
+  const double block_size = voxel_size_ * kBlockSide;
+  typedef std::pair<std::pair<std::uint32_t, float>,
+      decltype(block_map_)::iterator> candidate_t;
+  std::vector<candidate_t> candidates;
+  candidates.reserve(block_map_.size());
+  for (auto it = block_map_.begin(); it != block_map_.end(); ++it) {
+    const Block& block = blocks_[it->second];
+    if (block.last_frame == frame_count_) continue;
+    double dist = center_distance2(block.coord, block_size, translation_);
+    candidates.emplace_back(std::make_pair(block.last_frame,
+        -static_cast<float>(dist)), it);
+  }
+  count = std::min(count, candidates.size());
+  if (count == 0) return;
+  std::nth_element(candidates.begin(), candidates.begin() + (count - 1),
+      candidates.end(), [](const candidate_t& a, const candidate_t& b) {
+        return a.first < b.first;
+      });
+  for (std::size_t i = 0; i < count; i++) {
+    free_blocks_.push_back(candidates[i].second->second);
+    block_map_.erase(candidates[i].second);
+  }
+}
+
+void TsdfVolume::IntegrateBlock(const std::uint16_t* depth, Block* block) {
+  const float (*m)[4] = world_to_camera_;
+  const float vs = voxel_size_;
+  const float inv_trunc = 1.f / truncation_;
+  const int width = depth_width_, height = depth_height_;
+  // the center of voxel (0, 0, 0) in world
+  float origin[3];
+  for (int k = 0; k < 3; k++) {
+    origin[k] = (block->coord[k] * kBlockSide + 0.5f) * vs;
+  }
+  // the step of one voxel along x, in camera
+  const float step[3] = {m[0][0] * vs, m[1][0] * vs, m[2][0] * vs};
+
+  for (int z = 0; z < kBlockSide; z++) {
+    for (int y = 0; y < kBlockSide; y++) {
+      const float p[3] = {origin[0], origin[1] + y * vs, origin[2] + z * vs};
+      // the voxel (0, y, z) in camera
+      float c[3];
+      for (int k = 0; k < 3; k++) {
+        c[k] = m[k][0] * p[0] + m[k][1] * p[1] + m[k][2] * p[2] + m[k][3];
+      }
+      const int row = (z * kBlockSide + y) * kBlockSide;
+      float* tsdf = block->tsdf + row;
+      float* weight = block->weight + row;
+      int x = 0;
+#ifdef MYNTEYE_SIMD_SSE2
+      const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+      for (; x + 4 <= kBlockSide; x += 4) {
+        const __m128 xs = _mm_add_ps(lanes,
+            _mm_set1_ps(static_cast<float>(x)));
+        const __m128 cx = _mm_add_ps(_mm_set1_ps(c[0]),
+            _mm_mul_ps(xs, _mm_set1_ps(step[0])));
+        const __m128 cy = _mm_add_ps(_mm_set1_ps(c[1]),
+            _mm_mul_ps(xs, _mm_set1_ps(step[1])));
+        const __m128 cz = _mm_add_ps(_mm_set1_ps(c[2]),
+            _mm_mul_ps(xs, _mm_set1_ps(step[2])));
+        const __m128 front = _mm_cmpgt_ps(cz, _mm_set1_ps(1e-3f));
+        if (_mm_movemask_ps(front) == 0) continue;
+        const __m128 inv_z = _mm_div_ps(_mm_set1_ps(1.f),
+            _mm_max_ps(cz, _mm_set1_ps(1e-3f)));
+        // round to the nearest pixels
+        const __m128i u = _mm_cvtps_epi32(_mm_add_ps(_mm_set1_ps(cx_),
+            _mm_mul_ps(_mm_set1_ps(fx_), _mm_mul_ps(cx, inv_z))));
+        const __m128i v = _mm_cvtps_epi32(_mm_add_ps(_mm_set1_ps(cy_),
+            _mm_mul_ps(_mm_set1_ps(fy_), _mm_mul_ps(cy, inv_z))));
+        const __m128i inside = _mm_and_si128(
+            _mm_and_si128(_mm_cmpgt_epi32(u, _mm_set1_epi32(-1)),
+                _mm_cmplt_epi32(u, _mm_set1_epi32(width))),
+            _mm_and_si128(_mm_cmpgt_epi32(v, _mm_set1_epi32(-1)),
+                _mm_cmplt_epi32(v, _mm_set1_epi32(height))));
+        const int mask = _mm_movemask_ps(_mm_and_ps(front,
+            _mm_castsi128_ps(inside)));
+        if (mask == 0) continue;
+        // gather the depths, 0 if outside
+        alignas(16) std::int32_t pu[4], pv[4];
+        alignas(16) float ds[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(pu), u);
+        _mm_store_si128(reinterpret_cast<__m128i*>(pv), v);
+        for (int i = 0; i < 4; i++) {
+          std::uint16_t d = (mask >> i) & 1 ?
+              depth[pv[i] * width + pu[i]] : 0;
+          ds[i] = is_depth_valid(d) ? d * 0.001f : 0.f;
+        }
+        const __m128 dm = _mm_load_ps(ds);
+        const __m128 sdf = _mm_sub_ps(dm, cz);
+        const __m128 update = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(dm, _mm_set1_ps(min_depth_)),
+                _mm_cmple_ps(dm, _mm_set1_ps(max_depth_))),
+            _mm_and_ps(_mm_cmpgt_ps(dm, _mm_setzero_ps()),
+                _mm_cmpge_ps(sdf, _mm_set1_ps(-truncation_))));
+        if (_mm_movemask_ps(update) == 0) continue;
+        const __m128 t = _mm_min_ps(_mm_mul_ps(sdf, _mm_set1_ps(inv_trunc)),
+            _mm_set1_ps(1.f));
+        const __m128 w0 = _mm_loadu_ps(weight + x);
+        const __m128 t0 = _mm_loadu_ps(tsdf + x);
+        const __m128 w1 = _mm_add_ps(w0, _mm_set1_ps(1.f));
+        const __m128 t1 = _mm_div_ps(_mm_add_ps(_mm_mul_ps(t0, w0), t), w1);
+        _mm_storeu_ps(tsdf + x, simd::select(update, t1, t0));
+        _mm_storeu_ps(weight + x, simd::select(update,
+            _mm_min_ps(w1, _mm_set1_ps(max_weight_)), w0));
+      }
+#endif
+      for (; x < kBlockSide; x++) {
+        const float cx = c[0] + x * step[0];
+        const float cy = c[1] + x * step[1];
+        const float cz = c[2] + x * step[2];
+        if (cz <= 1e-3f) continue;
+        const float inv_z = 1.f / cz;
+        const int u = static_cast<int>(std::lround(cx_ + fx_ * cx * inv_z));
+        const int v = static_cast<int>(std::lround(cy_ + fy_ * cy * inv_z));
+        if (u < 0 || u >= width || v < 0 || v >= height) continue;
+        const std::uint16_t d = depth[v * width + u];
+        if (!is_depth_valid(d)) continue;
+        const float dm = d * 0.001f;
+        if (dm < min_depth_ || dm > max_depth_) continue;
+        const float sdf = dm - cz;
+        if (sdf < -truncation_) continue;
+        const float t = std::min(sdf * inv_trunc, 1.f);
+        const float w = weight[x];
+        tsdf[x] = (tsdf[x] * w + t) / (w + 1);
+        weight[x] = std::min(w + 1, max_weight_);
+      }
+    }
+  }
+}
+
+const TsdfVolume::Block* TsdfVolume::FindBlock(std::int32_t x,
+    std::int32_t y, std::int32_t z) const {
+  auto it = block_map_.find(pack_coord(x, y, z));
+  return it == block_map_.end() ? nullptr : &blocks_[it->second];
+}
+
+void TsdfVolume::ExtractBlockPoints(const Block& block,
+    std::vector<float>* xyz) const {
+  const Block* blocks[8] = {&block, nullptr, nullptr, nullptr,
+      nullptr, nullptr, nullptr, nullptr};
+  blocks[1] = FindBlock(block.coord[0] + 1, block.coord[1], block.coord[2]);
+  blocks[2] = FindBlock(block.coord[0], block.coord[1] + 1, block.coord[2]);
+  blocks[4] = FindBlock(block.coord[0], block.coord[1], block.coord[2] + 1);
+  const float vs = voxel_size_;
+  for (int z = 0; z < kBlockSide; z++) {
+    for (int y = 0; y < kBlockSide; y++) {
+      for (int x = 0; x < kBlockSide; x++) {
+        float t0;
+        if (!neighbor_voxel(blocks, x, y, z, &t0)) continue;
+        const float p[3] = {
+          (block.coord[0] * kBlockSide + x + 0.5f) * vs,
+          (block.coord[1] * kBlockSide + y + 0.5f) * vs,
+          (block.coord[2] * kBlockSide + z + 0.5f) * vs,
+        };
+        // the zero crossings to the next voxels along x, y and z
+        for (int k = 0; k < 3; k++) {
+          float t1;
+          if (!neighbor_voxel(blocks, x + (k == 0), y + (k == 1),
+              z + (k == 2), &t1)) {
+            continue;
+          }
+          if ((t0 < 0) == (t1 < 0)) continue;
+          const float f = t0 / (t0 - t1);
+          xyz->push_back(p[0] + (k == 0 ? f * vs : 0));
+          xyz->push_back(p[1] + (k == 1 ? f * vs : 0));
+          xyz->push_back(p[2] + (k == 2 ? f * vs : 0));
+        }
+      }
+    }
+  }
+}
+
+void TsdfVolume::ExtractBlockMesh(const Block& block,
+    std::vector<EdgeVertex>* vertices) const {
+  const Block* blocks[8];
+  for (int i = 0; i < 8; i++) {
+    blocks[i] = i == 0 ? &block : FindBlock(block.coord[0] + (i & 1),
+        block.coord[1] + ((i >> 1) & 1), block.coord[2] + ((i >> 2) & 1));
+  }
+  const float vs = voxel_size_;
+  for (int z = 0; z < kBlockSide; z++) {
+    for (int y = 0; y < kBlockSide; y++) {
+      for (int x = 0; x < kBlockSide; x++) {
+        // the corners of cube, skipped if any unknown
+        float t[8];
+        int inside = 0;
+        bool known = true;
+        for (int i = 0; i < 8 && known; i++) {
+          known = neighbor_voxel(blocks, x + (i & 1), y + ((i >> 1) & 1),
+              z + ((i >> 2) & 1), &t[i]);
+          inside += t[i] < 0;
+        }
+        if (!known || inside == 0 || inside == 8) continue;
+        // the global voxel coords of cube
+        const std::int64_t g[3] = {
+          std::int64_t(block.coord[0]) * kBlockSide + x,
+          std::int64_t(block.coord[1]) * kBlockSide + y,
+          std::int64_t(block.coord[2]) * kBlockSide + z,
+        };
+        // the vertex on the edge of corners a and b, keyed by the lower
+        // corner and the axes, so shared among tetrahedra and cubes
+        auto edge_vertex = [&](int a, int b) {
+          if ((a & b) != a) std::swap(a, b);
+          EdgeVertex vertex;
+          vertex.key = 0;
+          for (int k = 0; k < 3; k++) {
+            vertex.key = (vertex.key << kEdgeBits) |
+                static_cast<std::uint64_t>((g[k] + ((a >> k) & 1)) &
+                    kEdgeMask);
+          }
+          vertex.key = (vertex.key << 3) | static_cast<std::uint64_t>(a ^ b);
+          const float f = t[a] / (t[a] - t[b]);
+          for (int k = 0; k < 3; k++) {
+            const float pa = g[k] + ((a >> k) & 1) + 0.5f;
+            const float pb = g[k] + ((b >> k) & 1) + 0.5f;
+            vertex.p[k] = (pa + (pb - pa) * f) * vs;
+          }
+          return vertex;
+        };
+        // facing the outside, from the negative to the positive
+        auto add_triangle = [&](int a0, int b0, int a1, int b1, int a2,
+            int b2, const float out[3]) {
+          EdgeVertex v[3] = {edge_vertex(a0, b0), edge_vertex(a1, b1),
+              edge_vertex(a2, b2)};
+          float e1[3], e2[3];
+          for (int k = 0; k < 3; k++) {
+            e1[k] = v[1].p[k] - v[0].p[k];
+            e2[k] = v[2].p[k] - v[0].p[k];
+          }
+          const float n[3] = {
+            e1[1] * e2[2] - e1[2] * e2[1],
+            e1[2] * e2[0] - e1[0] * e2[2],
+            e1[0] * e2[1] - e1[1] * e2[0],
+          };
+          if (n[0] * out[0] + n[1] * out[1] + n[2] * out[2] < 0) {
+            std::swap(v[1], v[2]);
+          }
+          vertices->insert(vertices->end(), v, v + 3);
+        };
+        for (auto&& tet : kTetrahedra) {
+          int in[4], out[4], ins = 0, outs = 0;
+          for (int i = 0; i < 4; i++) {
+            if (t[tet[i]] < 0) {
+              in[ins++] = tet[i];
+            } else {
+              out[outs++] = tet[i];
+            }
+          }
+          if (ins == 0 || outs == 0) continue;
+          // the direction from the inside corners to the outside
+          float dir[3] = {0, 0, 0};
+          for (int k = 0; k < 3; k++) {
+            for (int i = 0; i < outs; i++) dir[k] += ((out[i] >> k) & 1);
+            dir[k] /= outs;
+            float d = 0;
+            for (int i = 0; i < ins; i++) d += ((in[i] >> k) & 1);
+            dir[k] -= d / ins;
+          }
+          if (ins == 1) {
+            add_triangle(in[0], out[0], in[0], out[1], in[0], out[2], dir);
+          } else if (outs == 1) {
+            add_triangle(out[0], in[0], out[0], in[1], out[0], in[2], dir);
+          } else {
+            // the quad of edges in0-out0, in0-out1, in1-out1, in1-out0
+            add_triangle(in[0], out[0], in[0], out[1], in[1], out[1], dir);
+            add_triangle(in[0], out[0], in[1], out[1], in[1], out[0], dir);
+          }
+        }
+      }
+    }
+  }
+}
+
+bool TsdfVolume::ExtractPoints(PointCloudData* points) {
+  if (!points) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  std::vector<const Block*> blocks;
+  blocks.reserve(block_map_.size());
+  for (auto&& entry : block_map_) blocks.push_back(&blocks_[entry.second]);
+
+  const std::size_t chunks = std::min(pool_->size(),
+      std::max<std::size_t>(blocks.size(), 1));
+  std::vector<std::vector<float>> chunk_xyz(chunks);
+  pool_->ParallelFor(chunks, [&](std::size_t beg, std::size_t end) {
+    for (std::size_t c = beg; c < end; c++) {
+      for (std::size_t i = c * blocks.size() / chunks;
+           i < (c + 1) * blocks.size() / chunks; i++) {
+        ExtractBlockPoints(*blocks[i], &chunk_xyz[c]);
+      }
+    }
+  });
+
+  std::size_t count = 0;
+  for (auto&& xyz : chunk_xyz) count += xyz.size() / 3;
+  points->organized = false;
+  points->layout = PointCloudLayout::INTERLEAVED;
+  points->width = static_cast<std::uint32_t>(count);
+  points->height = 1;
+  points->count = count;
+  points->frame_id = frame_id_;
+  points->timestamp = timestamp_;
+  points->xyz.clear();
+  points->xyz.reserve(3 * count);
+  for (auto&& xyz : chunk_xyz) {
+    points->xyz.insert(points->xyz.end(), xyz.begin(), xyz.end());
+  }
+  points->rgb.clear();
+  points->indices.clear();
+  return true;
+}
+
+bool TsdfVolume::ExtractMesh(TsdfMesh* mesh) {
+  if (!mesh) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  std::vector<const Block*> blocks;
+  blocks.reserve(block_map_.size());
+  for (auto&& entry : block_map_) blocks.push_back(&blocks_[entry.second]);
+
+  const std::size_t chunks = std::min(pool_->size(),
+      std::max<std::size_t>(blocks.size(), 1));
+  std::vector<std::vector<EdgeVertex>> chunk_vertices(chunks);
+  pool_->ParallelFor(chunks, [&](std::size_t beg, std::size_t end) {
+    for (std::size_t c = beg; c < end; c++) {
+      for (std::size_t i = c * blocks.size() / chunks;
+           i < (c + 1) * blocks.size() / chunks; i++) {
+        ExtractBlockMesh(*blocks[i], &chunk_vertices[c]);
+      }
+    }
+  });
+
+  // share the vertices of the same edges
+  std::size_t count = 0;
+  for (auto&& vertices : chunk_vertices) count += vertices.size();
+  std::unordered_map<std::uint64_t, std::uint32_t> indices;
+  indices.reserve(count / 2);
+  mesh->vertices.clear();
+  mesh->triangles.clear();
+  mesh->triangles.reserve(count);
+  for (auto&& vertices : chunk_vertices) {
+    for (auto&& vertex : vertices) {
+      auto result = indices.emplace(vertex.key,
+          static_cast<std::uint32_t>(mesh->vertices.size() / 3));
+      if (result.second) {
+        mesh->vertices.insert(mesh->vertices.end(), vertex.p, vertex.p + 3);
+      }
+      mesh->triangles.push_back(result.first->second);
+    }
+  }
+  return true;
+}
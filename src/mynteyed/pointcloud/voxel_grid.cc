@@ -0,0 +1,319 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include "mynteyed/pointcloud/voxel_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "mynteyed/internal/thread_pool.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The points of one chunk at least
+const std::size_t kChunkMinPoints = 16384;
+// The slots of one grid at least
+const std::size_t kGridMinSlots = 1024;
+
+// 21 bits of each quantized coordinate
+const std::int64_t kCoordBits = 21;
+const std::int64_t kCoordOffset = std::int64_t(1) << (kCoordBits - 1);
+const std::int64_t kCoordMask = (std::int64_t(1) << kCoordBits) - 1;
+
+inline std::uint64_t quantize(float v, float inv_leaf) {
+  // clamp first, then floor by truncation without the library call
+  float f = std::min(std::max(v * inv_leaf, -float(kCoordOffset)),
+      float(kCoordOffset - 1));
+  auto i = static_cast<std::int32_t>(f);
+  i -= f < i;
+  return static_cast<std::uint64_t>(i + kCoordOffset);
+}
+
+inline std::uint32_t hash(std::uint64_t key) {
+  return static_cast<std::uint32_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+inline void unpack_rgb(float v, std::uint8_t rgb[3]) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &v, sizeof(bits));
+  rgb[0] = (bits >> 16) & 0xff;
+  rgb[1] = (bits >> 8) & 0xff;
+  rgb[2] = bits & 0xff;
+}
+
+inline float pack_rgb(const std::uint8_t rgb[3]) {
+  std::uint32_t bits = (std::uint32_t(rgb[0]) << 16) |
+      (std::uint32_t(rgb[1]) << 8) | rgb[2];
+  float v;
+  std::memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+inline std::size_t floats_of_points(const PointCloudLayout& layout,
+    std::size_t count) {
+  return (layout == PointCloudLayout::XYZRGB ? 4 : 3) * count;
+}
+
+}  // namespace
+
+void VoxelGrid::Grid::Reset(std::size_t capacity) {
+  std::size_t size = kGridMinSlots;
+  while (size < 2 * capacity) size <<= 1;
+  slots.assign(size, -1);
+  mask = static_cast<std::uint32_t>(size - 1);
+  voxels.clear();
+}
+
+VoxelGrid::Voxel* VoxelGrid::Grid::Find(std::uint64_t key, bool* inserted) {
+  if (2 * (voxels.size() + 1) > slots.size()) {
+    // rehash, at most half full
+    slots.assign(2 * slots.size(), -1);
+    mask = static_cast<std::uint32_t>(slots.size() - 1);
+    for (std::size_t i = 0; i < voxels.size(); i++) {
+      std::uint32_t h = hash(voxels[i].key) & mask;
+      while (slots[h] >= 0) h = (h + 1) & mask;
+      slots[h] = static_cast<std::int32_t>(i);
+    }
+  }
+  std::uint32_t h = hash(key) & mask;
+  while (true) {
+    std::int32_t slot = slots[h];
+    if (slot < 0) {
+      slots[h] = static_cast<std::int32_t>(voxels.size());
+      voxels.push_back(Voxel{key, {0, 0, 0}, {0, 0, 0}, 0, 0});
+      *inserted = true;
+      return &voxels.back();
+    }
+    if (voxels[slot].key == key) {
+      *inserted = false;
+      return &voxels[slot];
+    }
+    h = (h + 1) & mask;
+  }
+}
+
+VoxelGrid::VoxelGrid(float leaf_size, const VoxelSelection& selection,
+    std::size_t threads)
+  : leaf_size_(leaf_size),
+    selection_(selection),
+    pool_(std::make_shared<ThreadPool>(threads)) {
+}
+
+VoxelGrid::~VoxelGrid() {
+}
+
+void VoxelGrid::SetLeafSize(float leaf_size) {
+  std::lock_guard<std::mutex> _(mutex_);
+  leaf_size_ = leaf_size;
+}
+
+void VoxelGrid::SetSelection(const VoxelSelection& selection) {
+  std::lock_guard<std::mutex> _(mutex_);
+  selection_ = selection;
+}
+
+void VoxelGrid::BuildChunk(const PointCloudData& in, Grid* grid,
+    std::size_t beg, std::size_t end) {
+  const float inv_leaf = 1.f / leaf_size_;
+  const bool centroid = selection_ == VoxelSelection::CENTROID;
+  const bool packed = in.layout == PointCloudLayout::XYZRGB;
+  const bool has_color = in.has_color() || packed;
+  const std::size_t stride = in.stride();
+  const float* xs = in.x();
+  const float* ys = in.y();
+  const float* zs = in.z();
+
+  grid->Reset(grid->voxels.size());
+  // the neighbor points are mostly of the same voxel or alternate between two
+  // by noise, so remember the last two to skip the probing
+  std::uint64_t last_key[2] = {~std::uint64_t(0), ~std::uint64_t(0)};
+  std::size_t last[2] = {0, 0};
+  for (std::size_t i = beg; i < end; i++) {
+    const float x = xs[i * stride], y = ys[i * stride], z = zs[i * stride];
+    // NaN of the organized
+    if (std::isnan(z)) continue;
+    std::uint64_t key = (quantize(x, inv_leaf) << (2 * kCoordBits)) |
+        (quantize(y, inv_leaf) << kCoordBits) | quantize(z, inv_leaf);
+    if (key == last_key[1]) {
+      std::swap(last_key[0], last_key[1]);
+      std::swap(last[0], last[1]);
+    } else if (key != last_key[0]) {
+      bool inserted;
+      Voxel* found = grid->Find(key, &inserted);
+      if (inserted) found->first = static_cast<std::uint32_t>(i);
+      last_key[1] = last_key[0];
+      last[1] = last[0];
+      last_key[0] = key;
+      last[0] = found - grid->voxels.data();
+    }
+    Voxel* voxel = &grid->voxels[last[0]];
+    ++voxel->count;
+    if (!centroid) continue;
+    voxel->sum[0] += x;
+    voxel->sum[1] += y;
+    voxel->sum[2] += z;
+    if (has_color) {
+      std::uint8_t rgb[3];
+      if (packed) {
+        unpack_rgb(in.xyz[4 * i + 3], rgb);
+      } else {
+        std::memcpy(rgb, &in.rgb[3 * i], 3);
+      }
+      voxel->rgb_sum[0] += rgb[0];
+      voxel->rgb_sum[1] += rgb[1];
+      voxel->rgb_sum[2] += rgb[2];
+    }
+  }
+}
+
+bool VoxelGrid::Build(const PointCloudData& in) {
+  if (leaf_size_ <= 0) return false;
+  const std::size_t count = in.count;
+  std::size_t chunks = std::min(pool_->size(),
+      std::max<std::size_t>(count / kChunkMinPoints, 1));
+  grids_.resize(chunks);
+  pool_->ParallelFor(chunks, [this, &in, chunks, count](
+      std::size_t beg, std::size_t end) {
+    for (std::size_t c = beg; c < end; c++) {
+      BuildChunk(in, &grids_[c], c * count / chunks,
+          (c + 1) * count / chunks);
+    }
+  });
+
+  if (chunks == 1) {
+    // keep the buffers of both
+    std::swap(merged_, grids_[0]);
+    return true;
+  }
+  // merge in the order of chunks, so the first points are kept first
+  std::size_t capacity = 0;
+  for (auto&& grid : grids_) {
+    capacity = std::max(capacity, grid.voxels.size());
+  }
+  merged_.Reset(std::max(capacity, merged_.voxels.size()));
+  for (auto&& grid : grids_) {
+    for (auto&& voxel : grid.voxels) {
+      bool inserted;
+      Voxel* dst = merged_.Find(voxel.key, &inserted);
+      if (inserted) {
+        *dst = voxel;
+        continue;
+      }
+      dst->count += voxel.count;
+      for (int k = 0; k < 3; k++) {
+        dst->sum[k] += voxel.sum[k];
+        dst->rgb_sum[k] += voxel.rgb_sum[k];
+      }
+    }
+  }
+  return true;
+}
+
+void VoxelGrid::Output(const PointCloudData& in, float* data,
+    std::uint8_t* rgb, std::uint32_t* indices) {
+  const std::size_t count = merged_.voxels.size();
+  const bool centroid = selection_ == VoxelSelection::CENTROID;
+  const PointCloudLayout layout = in.layout;
+  const std::size_t stride = in.stride();
+
+  pool_->ParallelFor(count, [&](std::size_t beg, std::size_t end) {
+    for (std::size_t j = beg; j < end; j++) {
+      const Voxel& voxel = merged_.voxels[j];
+      const std::size_t i = voxel.first;
+      float p[3];
+      std::uint8_t c[3] = {0, 0, 0};
+      if (centroid) {
+        const float inv = 1.f / voxel.count;
+        const std::uint32_t half = voxel.count / 2;
+        for (int k = 0; k < 3; k++) {
+          p[k] = voxel.sum[k] * inv;
+          c[k] = static_cast<std::uint8_t>(
+              (voxel.rgb_sum[k] + half) / voxel.count);
+        }
+      } else {
+        p[0] = in.x()[i * stride];
+        p[1] = in.y()[i * stride];
+        p[2] = in.z()[i * stride];
+        if (layout == PointCloudLayout::XYZRGB) {
+          unpack_rgb(in.xyz[4 * i + 3], c);
+        } else if (in.has_color()) {
+          std::memcpy(c, &in.rgb[3 * i], 3);
+        }
+      }
+
+      switch (layout) {
+        case PointCloudLayout::INTERLEAVED:
+          std::memcpy(data + 3 * j, p, sizeof(p));
+          break;
+        case PointCloudLayout::PLANAR:
+          data[j] = p[0];
+          data[count + j] = p[1];
+          data[2 * count + j] = p[2];
+          break;
+        case PointCloudLayout::XYZRGB:
+          std::memcpy(data + 4 * j, p, sizeof(p));
+          data[4 * j + 3] = pack_rgb(c);
+          break;
+      }
+      if (rgb) std::memcpy(rgb + 3 * j, c, 3);
+      if (indices) {
+        indices[j] = in.organized ? static_cast<std::uint32_t>(i) :
+            in.indices[i];
+      }
+    }
+  }, 1024);
+}
+
+bool VoxelGrid::Filter(const PointCloudData& in, PointCloudData* out) {
+  if (!out || out == &in) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!Build(in)) return false;
+
+  const std::size_t count = merged_.voxels.size();
+  out->organized = false;
+  out->layout = in.layout;
+  out->width = static_cast<std::uint32_t>(count);
+  out->height = 1;
+  out->count = count;
+  out->frame_id = in.frame_id;
+  out->timestamp = in.timestamp;
+  // the capacity is kept among frames
+  out->xyz.resize(floats_of_points(in.layout, count));
+  if (in.has_color()) {
+    out->rgb.resize(3 * count);
+  } else {
+    out->rgb.clear();
+  }
+  if (in.organized || !in.indices.empty()) {
+    out->indices.resize(count);
+  } else {
+    out->indices.clear();
+  }
+  Output(in, out->xyz.data(), out->rgb.empty() ? nullptr : out->rgb.data(),
+      out->indices.empty() ? nullptr : out->indices.data());
+  return true;
+}
+
+bool VoxelGrid::Filter(const PointCloudData& in, float* data,
+    std::size_t* count) {
+  if (!data || !count) return false;
+  std::lock_guard<std::mutex> _(mutex_);
+  if (!Build(in)) return false;
+  *count = merged_.voxels.size();
+  Output(in, data, nullptr, nullptr);
+  return true;
+}
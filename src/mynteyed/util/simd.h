@@ -0,0 +1,91 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_UTIL_SIMD_H_
+#define MYNTEYE_UTIL_SIMD_H_
+#pragma once
+
+/**
+ * <p>Macros:</p>
+ * <ul>
+ * <li>MYNTEYE_SIMD_SSE2: SSE2 is available, baseline of x86_64
+ * <li>MYNTEYE_SIMD_DISABLED: Force the scalar paths
+ * </ul>
+ *
+ * Other platforms, e.g. aarch64 and arm32, use the scalar paths which are
+ * written to be auto-vectorized.
+ */
+#if !defined(MYNTEYE_SIMD_DISABLED) && (defined(__SSE2__) || \
+    defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define MYNTEYE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+
+#include "mynteyed/stubs/global.h"
+
+MYNTEYE_BEGIN_NAMESPACE
+
+namespace simd {
+
+#ifdef MYNTEYE_SIMD_SSE2
+
+/** The mask of invalid raw depth lanes: 0 or 4096. */
+inline __m128i depth_invalid_mask(const __m128i& v) {
+  return _mm_or_si128(
+      _mm_cmpeq_epi16(v, _mm_setzero_si128()),
+      _mm_cmpeq_epi16(v, _mm_set1_epi16(4096)));
+}
+
+/** Select a where mask set, otherwise b. */
+inline __m128i select(const __m128i& mask, const __m128i& a,
+    const __m128i& b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/** Select a where mask set, otherwise b, of floats. */
+inline __m128 select(const __m128& mask, const __m128& a, const __m128& b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/** Unsigned 16-bit min/max for values < 0x8000. */
+inline __m128i min_u15(const __m128i& a, const __m128i& b) {
+  return _mm_min_epi16(a, b);
+}
+inline __m128i max_u15(const __m128i& a, const __m128i& b) {
+  return _mm_max_epi16(a, b);
+}
+
+/** Store the 4 lanes of x, y, z interleaved: x0 y0 z0 x1 ... z3. */
+inline void store_xyz(float* p, const __m128& x, const __m128& y,
+    const __m128& z) {
+  // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+  __m128 xy_lo = _mm_unpacklo_ps(x, y);  // x0 y0 x1 y1
+  __m128 xy_hi = _mm_unpackhi_ps(x, y);  // x2 y2 x3 y3
+  __m128 z0x1 = _mm_shuffle_ps(z, xy_lo, _MM_SHUFFLE(2, 2, 0, 0));
+  __m128 y1z1 = _mm_shuffle_ps(xy_lo, z, _MM_SHUFFLE(1, 1, 3, 3));
+  __m128 z2x3 = _mm_shuffle_ps(z, xy_hi, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 y3z3 = _mm_shuffle_ps(xy_hi, z, _MM_SHUFFLE(3, 3, 3, 3));
+  _mm_storeu_ps(p, _mm_shuffle_ps(xy_lo, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(p + 4, _mm_shuffle_ps(y1z1, xy_hi, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(p + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+#endif
+
+}  // namespace simd
+
+MYNTEYE_END_NAMESPACE
+
+#endif  // MYNTEYE_UTIL_SIMD_H_
@@ -0,0 +1,93 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#ifndef MYNTEYE_TOOLS_BENCHMARK_BENCH_H_
+#define MYNTEYE_TOOLS_BENCHMARK_BENCH_H_
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/stubs/types_calib.h"
+#include "mynteyed/util/times.h"
+
+namespace bench {
+
+/**
+ * The synthetic raw depth: a tilted plane with a box, some speckles and
+ * invalid pixels.
+ */
+inline MYNTEYE_NAMESPACE::Image::pointer make_depth(int width, int height,
+    std::uint32_t seed = 0) {
+  using namespace MYNTEYE_NAMESPACE;  // NOLINT
+  auto image = ImageDepth::Create(ImageFormat::DEPTH_RAW, width, height, false);
+  auto data = reinterpret_cast<std::uint16_t*>(image->data());
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> noise(-8, 8);
+  std::uniform_int_distribution<int> percent(0, 99);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      int depth = 1500 + y * 2 + x / 4;
+      if (x > width / 3 && x < width / 2 && y > height / 3 && y < height / 2) {
+        depth = 800;
+      }
+      int p = percent(rng);
+      if (p < 3) {
+        depth = 0;
+      } else if (p < 5) {
+        depth = 300 + percent(rng) * 50;  // speckle
+      } else {
+        depth += noise(rng);
+      }
+      data[y * width + x] = static_cast<std::uint16_t>(depth);
+    }
+  }
+  return image;
+}
+
+/** The pinhole intrinsics of the synthetic depth, no distortion. */
+inline MYNTEYE_NAMESPACE::CameraIntrinsics make_intrinsics(int width,
+    int height) {
+  MYNTEYE_NAMESPACE::CameraIntrinsics in{};
+  in.width = width;
+  in.height = height;
+  in.fx = in.fy = width * 0.55;
+  in.cx = width * 0.5;
+  in.cy = height * 0.5;
+  return in;
+}
+
+/** Run fn for warmup + count times, return the avg ms of the counted. */
+inline double measure(const std::string& name, int count,
+    const std::function<void()>& fn, int warmup = 3) {
+  using namespace MYNTEYE_NAMESPACE;  // NOLINT
+  for (int i = 0; i < warmup; i++) fn();
+  auto time_beg = times::now();
+  for (int i = 0; i < count; i++) fn();
+  auto time_end = times::now();
+  double ms = times::count<times::microseconds>(time_end - time_beg)
+      * 0.001 / count;
+  std::cout << std::left << std::setw(36) << name << std::right
+      << std::fixed << std::setprecision(3) << std::setw(10) << ms << " ms"
+      << std::endl;
+  return ms;
+}
+
+}  // namespace bench
+
+#endif  // MYNTEYE_TOOLS_BENCHMARK_BENCH_H_
@@ -0,0 +1,72 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/imgproc/change_gate.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "color, depth: " << width << "x" << height << ", count: "
+        << count << std::endl;
+
+    auto yuyv = ImageColor::Create(ImageFormat::COLOR_YUYV, width, height,
+        false);
+    for (int y = 0; y < height; y++) {
+      std::uint8_t* row = yuyv->data() + y * width * 2;
+      for (int x = 0; x < width; x++) {
+        row[2 * x] = static_cast<std::uint8_t>(
+            128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.04));
+        row[2 * x + 1] = static_cast<std::uint8_t>(x % 2 ?
+            128 + 60 * std::cos(x * 0.02) : 128 + 60 * std::sin(y * 0.03));
+      }
+    }
+    // the static scene of the noisy sensor, the speckles differ each frame
+    std::vector<Image::pointer> depths;
+    for (int i = 0; i < 4; i++) {
+      depths.push_back(bench::make_depth(width, height, i));
+    }
+
+    // the processing skipped of the unchanged, e.g. the conversion
+    bench::measure("  To(BGR)", count,
+        [&]() { yuyv->To(ImageFormat::COLOR_BGR); });
+
+    ChangeGate color_gate;
+    bench::measure("  ChangeGate, yuyv", count,
+        [&]() { color_gate.Process(yuyv); });
+
+    ChangeGate depth_gate;
+    int i = 0, passed = 0;
+    bench::measure("  ChangeGate, depth", count, [&]() {
+      passed += depth_gate.Process(depths[i++ % depths.size()]);
+    });
+    std::cout << "  depth passed: " << passed << " of " << i << std::endl;
+  }
+  return 0;
+}
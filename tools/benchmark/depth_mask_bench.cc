@@ -0,0 +1,99 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/depth_mask.h"
+#include "mynteyed/filter/edge_filter.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The scan of each consumer, e.g. to count or skip the invalid
+std::size_t count_valid(const std::uint16_t* depth, std::size_t size) {
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < size; i++) {
+    n += is_depth_valid(depth[i]);
+  }
+  return n;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto src = bench::make_depth(width, height);
+    auto data = reinterpret_cast<const std::uint16_t*>(src->data());
+    const std::size_t pixels = static_cast<std::size_t>(width) * height;
+
+    volatile std::size_t n = 0;
+    bench::measure("  scan depth, count valid", count,
+        [&]() { n = count_valid(data, pixels); });
+
+    DepthMask mask(true);
+    mask.Pack(src);
+    bench::measure("  DepthMask::Pack", count, [&]() { mask.Pack(src); });
+    bench::measure("  DepthMask::CountValid", count,
+        [&]() { n = mask.CountValid(); });
+    if (n != count_valid(data, pixels)) {
+      std::cerr << "  count mismatch" << std::endl;
+      return 1;
+    }
+
+    // the incremental cost of the mask, fused into the pass of a filter
+    auto depth = ImageDepth::Create(ImageFormat::DEPTH_RAW, width, height,
+        false);
+    EdgeFilter filter;
+    auto reset = [&]() {
+      std::copy(src->data(), src->data() + src->valid_size(), depth->data());
+    };
+    bench::measure("  EdgeFilter", count, [&]() {
+      reset();
+      filter.ProcessFrame(depth, depth);
+    });
+    bench::measure("  EdgeFilter + Pack pass", count, [&]() {
+      reset();
+      filter.ProcessFrame(depth, depth);
+      mask.Pack(depth);
+    });
+    mask.Clear(false);
+    bench::measure("  EdgeFilter, bits fused", count, [&]() {
+      reset();
+      filter.ProcessFrameMask(depth, depth, &mask, true);
+    });
+    mask.Clear(true);
+    bench::measure("  EdgeFilter, bits + edge fused", count, [&]() {
+      reset();
+      filter.ProcessFrameMask(depth, depth, &mask, true);
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/depth_registration.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The per pixel reprojection with division, splatted to the nearest pixel
+void naive_register(const Image::pointer& depth, const CameraIntrinsics& in,
+    const CameraIntrinsics& out_in, const Extrinsics& ex,
+    std::vector<std::uint16_t>* out) {
+  int width = depth->width(), height = depth->height();
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  out->assign(out_in.width * out_in.height, 0);
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      std::uint16_t d = data[v * width + u];
+      if (!is_depth_valid(d)) continue;
+      double p[3] = {(u - in.cx) * d / in.fx, (v - in.cy) * d / in.fy,
+          static_cast<double>(d)};
+      double q[3];
+      for (int k = 0; k < 3; k++) {
+        q[k] = ex.rotation[k][0] * p[0] + ex.rotation[k][1] * p[1] +
+            ex.rotation[k][2] * p[2] + ex.translation[k];
+      }
+      if (q[2] < 1) continue;
+      int x = static_cast<int>(std::lround(out_in.fx * q[0] / q[2] + out_in.cx));
+      int y = static_cast<int>(std::lround(out_in.fy * q[1] / q[2] + out_in.cy));
+      if (x < 0 || x >= out_in.width || y < 0 || y >= out_in.height) continue;
+      auto&& dst = (*out)[y * out_in.width + x];
+      auto z = static_cast<std::uint16_t>(std::min(q[2], 65535.0));
+      if (dst == 0 || z < dst) dst = z;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  // the right camera, 120 mm away and a little rotated
+  Extrinsics ex{{{1, 0, 0.01}, {0, 1, 0}, {-0.01, 0, 1}}, {-120, 0, 0}};
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+    auto depth = bench::make_depth(width, height);
+
+    std::vector<std::uint16_t> naive;
+    double naive_ms = bench::measure("  naive (per pixel division)", count,
+        [&]() { naive_register(depth, in, in, ex, &naive); });
+
+    DepthRegistration reg;
+    reg.SetParams(in, in, ex);
+    Image::pointer aligned;
+    double ms = bench::measure("  DepthRegistration", count,
+        [&]() { reg.Process(depth, &aligned); });
+    std::cout << "    speedup: " << naive_ms / ms << "x" << std::endl;
+
+    // to the color of double size, the naive one leaves holes
+    CameraIntrinsics color_in = in;
+    color_in.width = width * 2;
+    color_in.height = height * 2;
+    color_in.fx *= 2;
+    color_in.fy *= 2;
+    color_in.cx = color_in.cx * 2 + 0.5;
+    color_in.cy = color_in.cy * 2 + 0.5;
+    reg.SetParams(in, color_in, ex);
+    bench::measure("  DepthRegistration (to 2x color)", count,
+        [&]() { reg.Process(depth, &aligned); });
+
+    // to the distorted color, by the 4 corners of each pixel
+    CameraIntrinsics distorted_in = in;
+    distorted_in.coeffs[0] = -0.28;
+    distorted_in.coeffs[1] = 0.09;
+    reg.SetParams(in, distorted_in, ex);
+    bench::measure("  DepthRegistration (distorted)", count,
+        [&]() { reg.Process(depth, &aligned); });
+  }
+  return 0;
+}
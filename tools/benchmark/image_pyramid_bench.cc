@@ -0,0 +1,124 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/imgproc/image_pyramid.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The Y of YUYV, the same gray as the pyramid
+void yuyv_to_y(const std::uint8_t* yuyv, int count, std::uint8_t* gray) {
+  for (int i = 0; i < count; i++) {
+    gray[i] = yuyv[2 * i];
+  }
+}
+
+// The half size by the mean of 2 x 2, as pyrDown of a tracker without SIMD
+void resize_half(const std::uint8_t* src, int width, int height, int bpp,
+    std::uint8_t* dst) {
+  const int stride = width * bpp;
+  for (int y = 0; y < height / 2; y++) {
+    const std::uint8_t* p0 = src + 2 * y * stride;
+    const std::uint8_t* p1 = p0 + stride;
+    for (int x = 0; x < width / 2; x++) {
+      for (int c = 0; c < bpp; c++) {
+        const int i = 2 * x * bpp + c;
+        *dst++ = static_cast<std::uint8_t>((p0[i] + p0[i + bpp] + p1[i] +
+            p1[i + bpp] + 2) >> 2);
+      }
+    }
+  }
+}
+
+// Level 0 given, then each level by a pass
+void resize_passes(std::vector<std::vector<std::uint8_t>>* levels, int width,
+    int height, int bpp) {
+  for (std::size_t l = 1; l < levels->size(); l++) {
+    (*levels)[l].resize((width / 2) * (height / 2) * bpp);
+    resize_half((*levels)[l - 1].data(), width, height, bpp,
+        (*levels)[l].data());
+    width /= 2;
+    height /= 2;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+  const int levels = 3;
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "color: " << width << "x" << height << ", count: " << count
+        << ", levels: " << levels << std::endl;
+
+    auto yuyv = ImageColor::Create(ImageFormat::COLOR_YUYV, width, height,
+        false);
+    for (int y = 0; y < height; y++) {
+      std::uint8_t* row = yuyv->data() + y * width * 2;
+      for (int x = 0; x < width; x++) {
+        row[2 * x] = static_cast<std::uint8_t>(
+            128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.04));
+        row[2 * x + 1] = static_cast<std::uint8_t>(x % 2 ?
+            128 + 60 * std::cos(x * 0.02) : 128 + 60 * std::sin(y * 0.03));
+      }
+    }
+
+    // like for like, the same level 0 then each level by a pass: gray is the
+    // Y copied, bgr is converted by To()
+    std::vector<std::vector<std::uint8_t>> grays(levels + 1);
+    bench::measure("  Y copy + passes, gray", count, [&]() {
+      grays[0].resize(width * height);
+      yuyv_to_y(yuyv->data(), width * height, grays[0].data());
+      resize_passes(&grays, width, height, 1);
+    });
+    // on one thread as the passes, and on the pool
+    ImagePyramidBuilder builder(1);
+    ImagePyramidBuilder pooled;
+    builder.SetLevels(levels, ImageFormat::IMAGE_GRAY_8);
+    pooled.SetLevels(levels, ImageFormat::IMAGE_GRAY_8);
+    bench::measure("  ImagePyramidBuilder, gray", count,
+        [&]() { builder.Process(yuyv); });
+    bench::measure("  ImagePyramidBuilder, gray, pool", count,
+        [&]() { pooled.Process(yuyv); });
+
+    std::vector<std::vector<std::uint8_t>> bgrs(levels + 1);
+    bench::measure("  convert + passes, bgr", count, [&]() {
+      auto bgr = yuyv->To(ImageFormat::COLOR_BGR);
+      bgrs[0].assign(bgr->data(), bgr->data() + width * height * 3);
+      resize_passes(&bgrs, width, height, 3);
+    });
+    builder.SetLevels(levels, ImageFormat::COLOR_BGR);
+    pooled.SetLevels(levels, ImageFormat::COLOR_BGR);
+    bench::measure("  ImagePyramidBuilder, bgr", count,
+        [&]() { builder.Process(yuyv); });
+    bench::measure("  ImagePyramidBuilder, bgr, pool", count,
+        [&]() { pooled.Process(yuyv); });
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/device/image.h"
+#include "mynteyed/device/image_stats.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The histogram and mean of the gray of BGR, as a pass of an exposure control
+double gray_histogram(const std::uint8_t* bgr, int count,
+    std::array<std::uint32_t, 256>* hist) {
+  hist->fill(0);
+  std::uint64_t sum = 0;
+  for (int i = 0; i < count; i++, bgr += 3) {
+    int v = (bgr[2] * 77 + bgr[1] * 150 + bgr[0] * 29 + 128) >> 8;
+    ++(*hist)[v];
+    sum += v;
+  }
+  return count > 0 ? static_cast<double>(sum) / count : 0;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  ImageStatsParams params;
+  params.tiles_x = 4;
+  params.tiles_y = 4;
+  auto stats_params = std::make_shared<const ImageStatsParams>(params);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "color: " << width << "x" << height << ", count: " << count
+        << ", tiles: " << params.tiles_x << "x" << params.tiles_y
+        << std::endl;
+
+    auto yuyv = ImageColor::Create(ImageFormat::COLOR_YUYV, width, height,
+        false);
+    for (int y = 0; y < height; y++) {
+      std::uint8_t* row = yuyv->data() + y * width * 2;
+      for (int x = 0; x < width; x++) {
+        row[2 * x] = static_cast<std::uint8_t>(
+            128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.04));
+        row[2 * x + 1] = static_cast<std::uint8_t>(x % 2 ?
+            128 + 60 * std::cos(x * 0.02) : 128 + 60 * std::sin(y * 0.03));
+      }
+    }
+
+    // the capture copy, without and with the stats
+    bench::measure("  Clone", count, [&]() { yuyv->Clone(); });
+    yuyv->set_stats_params(stats_params);
+    bench::measure("  Clone, stats", count, [&]() { yuyv->Clone(); });
+    yuyv->set_stats_params(nullptr);
+
+    // the common path: convert, then a pass of the gray histogram
+    std::array<std::uint32_t, 256> hist;
+    bench::measure("  To(BGR) + histogram pass", count, [&]() {
+      auto bgr = yuyv->To(ImageFormat::COLOR_BGR);
+      gray_histogram(bgr->data(), width * height, &hist);
+    });
+
+    bench::measure("  To(BGR)", count,
+        [&]() { yuyv->To(ImageFormat::COLOR_BGR); });
+    yuyv->set_stats_params(stats_params);
+    bench::measure("  To(BGR), stats", count, [&]() {
+      yuyv->set_stats(nullptr);
+      yuyv->To(ImageFormat::COLOR_BGR);
+    });
+    yuyv->set_stats_params(nullptr);
+  }
+  return 0;
+}
@@ -0,0 +1,103 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/laser_scan.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The angle and range of each pixel in the band, as the former way of
+// depthimage_to_laserscan
+void naive_scan(const Image::pointer& depth, const CameraIntrinsics& in,
+    int first_row, int rows, float range_min, float range_max,
+    std::vector<float>* ranges) {
+  int width = depth->width();
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  const double angle_min = -std::atan2(width - 1 - in.cx, in.fx);
+  const double angle_max = -std::atan2(-in.cx, in.fx);
+  const double increment = (angle_max - angle_min) / (width - 1);
+  ranges->assign(width, std::numeric_limits<float>::infinity());
+  for (int v = first_row; v < first_row + rows; v++) {
+    for (int u = 0; u < width; u++) {
+      std::uint16_t d = data[v * width + u];
+      if (!is_depth_valid(d)) continue;
+      double z = d * 0.001;
+      double x = (u - in.cx) * z / in.fx;
+      double range = std::hypot(x, z);
+      if (range < range_min || range > range_max) continue;
+      double angle = -std::atan2(x, z);
+      int bin = static_cast<int>(std::lround((angle - angle_min) / increment));
+      float& r = (*ranges)[bin];
+      r = std::min(r, static_cast<float>(range));
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+
+    for (int rows : {1, 32}) {
+      std::cout << "depth: " << width << "x" << height << ", rows: " << rows
+          << ", count: " << count << std::endl;
+      int first_row = static_cast<int>(std::lround(in.cy)) - rows / 2;
+
+      std::vector<float> naive;
+      double naive_ms = bench::measure("  naive (atan, sqrt per pixel)", count,
+          [&]() {
+            naive_scan(depth, in, first_row, rows, 0.3f, 10.f, &naive);
+          });
+
+      LaserScan laser_scan;
+      laser_scan.SetIntrinsics(in);
+      laser_scan.SetScanRows(rows);
+      LaserScanData scan;
+      double ms = bench::measure("  LaserScan", count,
+          [&]() { laser_scan.Compute(depth, &scan); });
+      std::size_t diff = 0;
+      for (std::size_t i = 0; i < naive.size(); i++) {
+        if (std::isinf(naive[i]) != std::isinf(scan.ranges[i]) ||
+            std::fabs(naive[i] - scan.ranges[i]) > 1e-4f) {
+          ++diff;
+        }
+      }
+      std::cout << "    speedup: " << naive_ms / ms << "x, ranges differ: "
+          << diff << std::endl;
+    }
+  }
+  return 0;
+}
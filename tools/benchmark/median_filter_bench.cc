@@ -0,0 +1,75 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "mynteyed/filter/median_filter.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+int main(int argc, char const* argv[]) {
+  int width = 1280, height = 720, count = 100;
+  if (argc >= 3) {
+    width = std::atoi(argv[1]);
+    height = std::atoi(argv[2]);
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+  std::cout << "depth: " << width << "x" << height << ", count: " << count
+      << std::endl;
+
+  auto depth = bench::make_depth(width, height);
+  auto image = ImageDepth::Create(ImageFormat::DEPTH_RAW, width, height, false);
+  auto reset = [&depth, &image]() {
+    std::copy(depth->data(), depth->data() + depth->valid_size(),
+        image->data());
+  };
+
+  for (int ksize : {3, 5}) {
+    std::cout << "ksize: " << ksize << std::endl;
+
+    // OpenCV: copy to cv::Mat, medianBlur, copy back
+    cv::Mat mat_out;
+    double cv_ms = bench::measure("  cv::medianBlur (with copies)", count,
+        [&]() {
+          reset();
+          cv::Mat mat(height, width, CV_16UC1, image->data());
+          cv::medianBlur(mat.clone(), mat_out, ksize);
+          mat_out.copyTo(mat);
+        });
+
+    for (bool ignore_invalid : {false, true}) {
+      MedianFilter filter(ksize, ignore_invalid);
+      double ms = bench::measure(ignore_invalid ?
+          "  MedianFilter (ignore invalid)" : "  MedianFilter", count,
+          [&]() {
+            reset();
+            filter.ProcessFrame(image, image);
+          });
+      std::cout << "    speedup: " << cv_ms / ms << "x" << std::endl;
+
+      if (!ignore_invalid) {
+        // should be same as cv::medianBlur, as both replicate the border
+        cv::Mat mat(height, width, CV_16UC1, image->data());
+        std::cout << "    diff pixels to cv: "
+            << cv::countNonZero(mat != mat_out) << std::endl;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/normal_estimation.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The organized points first, then the central differences of them, as the
+// former way by PCL after copying the cloud
+void naive_normals(const Image::pointer& depth, const CameraIntrinsics& in,
+    int r, std::vector<float>* xyz, std::vector<float>* normals) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  int width = depth->width(), height = depth->height();
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  xyz->resize(3 * width * height);
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      float* p = &(*xyz)[3 * (v * width + u)];
+      std::uint16_t d = data[v * width + u];
+      if (!is_depth_valid(d)) {
+        p[0] = p[1] = p[2] = nan;
+      } else {
+        p[2] = d * 0.001f;
+        p[0] = (u - in.cx) * p[2] / in.fx;
+        p[1] = (v - in.cy) * p[2] / in.fy;
+      }
+    }
+  }
+  normals->assign(3 * width * height, nan);
+  for (int v = r; v < height - r; v++) {
+    for (int u = r; u < width - r; u++) {
+      auto at = [&](int x, int y) { return &(*xyz)[3 * (y * width + x)]; };
+      const float *c = at(u, v), *l = at(u - r, v), *rt = at(u + r, v),
+          *up = at(u, v - r), *dn = at(u, v + r);
+      if (std::isnan(c[2]) || std::isnan(l[2]) || std::isnan(rt[2]) ||
+          std::isnan(up[2]) || std::isnan(dn[2])) {
+        continue;
+      }
+      float limit = 0.02f * r * c[2];
+      if (std::abs(l[2] - c[2]) > limit || std::abs(rt[2] - c[2]) > limit ||
+          std::abs(up[2] - c[2]) > limit || std::abs(dn[2] - c[2]) > limit) {
+        continue;
+      }
+      float dx[3] = {rt[0] - l[0], rt[1] - l[1], rt[2] - l[2]};
+      float dy[3] = {dn[0] - up[0], dn[1] - up[1], dn[2] - up[2]};
+      float n[3] = {dy[1] * dx[2] - dy[2] * dx[1],
+          dy[2] * dx[0] - dy[0] * dx[2], dy[0] * dx[1] - dy[1] * dx[0]};
+      float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (len <= 0) continue;
+      float* o = &(*normals)[3 * (v * width + u)];
+      o[0] = n[0] / len;
+      o[1] = n[1] / len;
+      o[2] = n[2] / len;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+
+    std::vector<float> xyz, naive;
+    double naive_ms = bench::measure("  naive (points, then normals)", count,
+        [&]() { naive_normals(depth, in, 2, &xyz, &naive); });
+
+    NormalEstimation ne;
+    ne.SetIntrinsics(in);
+    NormalMap normals;
+    double ms = bench::measure("  NormalEstimation", count,
+        [&]() { ne.Compute(depth, &normals); });
+    std::cout << "    speedup: " << naive_ms / ms << "x" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/occupancy_grid.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The full point cloud first, then transformed and projected, as the former
+// way of ROS nodes
+void naive_grid(const Image::pointer& depth, const CameraIntrinsics& in,
+    const double rot[3][3], double height, std::vector<float>* xyz,
+    std::vector<std::uint32_t>* counts, std::vector<std::uint8_t>* cells) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  int width = depth->width(), rows = depth->height();
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  xyz->resize(3 * width * rows);
+  for (int v = 0; v < rows; v++) {
+    for (int u = 0; u < width; u++) {
+      float* p = &(*xyz)[3 * (v * width + u)];
+      std::uint16_t d = data[v * width + u];
+      if (!is_depth_valid(d)) {
+        p[0] = p[1] = p[2] = nan;
+      } else {
+        p[2] = d * 0.001f;
+        p[0] = (u - in.cx) * p[2] / in.fx;
+        p[1] = (v - in.cy) * p[2] / in.fy;
+      }
+    }
+  }
+  counts->assign(2 * 100 * 100, 0);
+  for (std::size_t i = 0; i < xyz->size(); i += 3) {
+    const float* p = &(*xyz)[i];
+    if (std::isnan(p[2])) continue;
+    double b[3];
+    for (int k = 0; k < 3; k++) {
+      b[k] = rot[k][0] * p[0] + rot[k][1] * p[1] + rot[k][2] * p[2];
+    }
+    b[2] += height;
+    if (b[2] >= 1.5) continue;
+    int x = static_cast<int>(std::floor(b[0] / 0.05));
+    int y = static_cast<int>(std::floor((b[1] + 2.5) / 0.05));
+    if (x < 0 || x >= 100 || y < 0 || y >= 100) continue;
+    ++(*counts)[2 * (y * 100 + x) + (b[2] >= 0.1 ? 1 : 0)];
+  }
+  cells->resize(100 * 100);
+  for (std::size_t i = 0; i < cells->size(); i++) {
+    std::uint32_t floor = (*counts)[2 * i], obstacles = (*counts)[2 * i + 1];
+    (*cells)[i] = obstacles >= 3 ? MYNTEYE_OCCUPANCY_OCCUPIED :
+        (floor + obstacles > 0 ? MYNTEYE_OCCUPANCY_FREE :
+            MYNTEYE_OCCUPANCY_UNKNOWN);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  // level at 1 m height, the synthetic depth is of 1.5 ~ 3 m
+  const double height = 1.0;
+  Extrinsics mount{{{0, 0, 1}, {-1, 0, 0}, {0, -1, 0}},
+      {0, 0, height * 1000}};
+
+  for (auto&& size : sizes) {
+    int width = size.first, rows = size.second;
+    std::cout << "depth: " << width << "x" << rows << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, rows);
+
+    auto depth = bench::make_depth(width, rows);
+
+    std::vector<float> xyz;
+    std::vector<std::uint32_t> counts;
+    std::vector<std::uint8_t> naive;
+    double naive_ms = bench::measure("  naive (points, then project)", count,
+        [&]() {
+          naive_grid(depth, in, mount.rotation, height, &xyz, &counts,
+              &naive);
+        });
+
+    OccupancyGrid occupancy;
+    occupancy.SetIntrinsics(in);
+    occupancy.SetMountPose(mount);
+    OccupancyGridData grid;
+    double ms = bench::measure("  OccupancyGrid", count,
+        [&]() { occupancy.Compute(depth, &grid); });
+    std::size_t diff = 0;
+    for (std::size_t i = 0; i < naive.size(); i++) {
+      diff += naive[i] != grid.cells[i];
+    }
+    std::cout << "    speedup: " << naive_ms / ms << "x, cells differ: "
+        << diff << std::endl;
+  }
+  return 0;
+}
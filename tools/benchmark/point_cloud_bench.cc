@@ -0,0 +1,100 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/point_cloud.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The per pixel division, as the former generators
+void naive_points(const Image::pointer& depth, const CameraIntrinsics& in,
+    std::vector<float>* xyz) {
+  int width = depth->width(), height = depth->height();
+  auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+  xyz->resize(3 * width * height);
+  float* p = xyz->data();
+  for (int v = 0; v < height; v++) {
+    for (int u = 0; u < width; u++) {
+      std::uint16_t d = data[v * width + u];
+      if (!is_depth_valid(d)) {
+        p[0] = p[1] = p[2] = std::numeric_limits<float>::quiet_NaN();
+      } else {
+        p[2] = d * 0.001f;
+        p[0] = (u - in.cx) * p[2] / in.fx;
+        p[1] = (v - in.cy) * p[2] / in.fy;
+      }
+      p += 3;
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+    auto color = ImageColor::Create(ImageFormat::COLOR_RGB, width, height,
+        false);
+
+    std::vector<float> naive;
+    double naive_ms = bench::measure("  naive (per pixel division)", count,
+        [&]() { naive_points(depth, in, &naive); });
+
+    PointCloud pc;
+    pc.SetIntrinsics(in);
+    PointCloudData points;
+    for (bool organized : {true, false}) {
+      for (auto layout : {PointCloudLayout::INTERLEAVED,
+          PointCloudLayout::PLANAR, PointCloudLayout::XYZRGB}) {
+        for (bool with_color : {false, true}) {
+          pc.SetOrganized(organized);
+          pc.SetLayout(layout);
+          std::string name = std::string("  PointCloud ") +
+              (organized ? "organized" : "compacted") +
+              (layout == PointCloudLayout::PLANAR ? " planar" : "") +
+              (layout == PointCloudLayout::XYZRGB ? " xyzrgb" : "") +
+              (with_color ? " rgb" : "");
+          double ms = bench::measure(name, count, [&]() {
+            pc.Generate(depth, &points, with_color ? color : nullptr);
+          });
+          std::cout << "    speedup: " << naive_ms / ms << "x, "
+              << points.count / ms / 1000 << " Mpts/s" << std::endl;
+        }
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+#include "mynteyed/pointcloud/point_cloud_codec.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+    auto color = ImageColor::Create(ImageFormat::COLOR_RGB, width, height,
+        false);
+
+    PointCloud pc;
+    pc.SetIntrinsics(in);
+    pc.SetLayout(PointCloudLayout::XYZRGB);
+    PointCloudCodec codec;
+    for (bool organized : {true, false}) {
+      pc.SetOrganized(organized);
+      PointCloudData points;
+      pc.Generate(depth, &points, color);
+      std::string kind = organized ? "organized" : "compacted";
+
+      // the float path, XYZRGB copied into and out of a message
+      std::vector<std::uint8_t> raw;
+      PointCloudData copied;
+      double raw_ms = bench::measure("  float " + kind + " copy", count,
+          [&]() {
+            raw.resize(points.xyz.size() * sizeof(float));
+            std::memcpy(raw.data(), points.xyz.data(), raw.size());
+            copied.xyz.resize(points.xyz.size());
+            std::memcpy(copied.xyz.data(), raw.data(), raw.size());
+          });
+
+      std::vector<std::uint8_t> bytes;
+      double encode_ms = bench::measure("  PointCloudCodec " + kind +
+          " encode", count, [&]() { codec.Encode(points, &bytes); });
+      PointCloudData decoded;
+      double decode_ms = bench::measure("  PointCloudCodec " + kind +
+          " decode", count, [&]() { codec.Decode(bytes, &decoded); });
+
+      float max_error = 0;
+      for (std::size_t i = 0; i < points.count; i++) {
+        for (int k = 0; k < 3; k++) {
+          float a = points.xyz[4 * i + k], b = decoded.xyz[3 * i + k];
+          if (std::isnan(a) || std::isnan(b)) continue;
+          max_error = std::max(max_error, std::fabs(a - b));
+        }
+      }
+      std::cout << "    bytes: " << raw.size() << " -> " << bytes.size()
+          << " (" << static_cast<double>(raw.size()) / bytes.size()
+          << "x), at 30 fps: " << raw.size() * 30 / 1e6 << " -> "
+          << bytes.size() * 30 / 1e6 << " MB/s" << std::endl;
+      std::cout << "    encode + decode: " << encode_ms + decode_ms
+          << " ms vs " << raw_ms << " ms, max error: " << max_error * 1000
+          << " mm" << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+#include "mynteyed/pointcloud/point_cloud_writer.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The iostream path, one write call per value, as PCL's PLY writer
+void write_ply_iostream(const std::string& path, const PointCloudData& points) {
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < points.count; i++) {
+    if (!std::isnan(points.xyz[4 * i + 2])) ++count;
+  }
+  std::ofstream out(path, std::ios::binary);
+  out << "ply\nformat binary_little_endian 1.0\nelement vertex " << count
+      << "\nproperty float x\nproperty float y\nproperty float z\n"
+      << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+      << "end_header\n";
+  for (std::size_t i = 0; i < points.count; i++) {
+    const float* p = &points.xyz[4 * i];
+    if (std::isnan(p[2])) continue;
+    for (int k = 0; k < 3; k++) {
+      out.write(reinterpret_cast<const char*>(p + k), sizeof(float));
+    }
+    const char* rgb = reinterpret_cast<const char*>(p + 3);
+    for (int k = 2; k >= 0; k--) {
+      out.write(rgb + k, 1);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 30;
+  std::string dir = ".";
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+  if (argc >= 5) dir = argv[4];
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << ", dir: " << dir << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+    auto color = ImageColor::Create(ImageFormat::COLOR_RGB, width, height,
+        false);
+
+    PointCloud pc;
+    pc.SetIntrinsics(in);
+    pc.SetLayout(PointCloudLayout::XYZRGB);
+    pc.SetOrganized(true);
+    PointCloudData points;
+    pc.Generate(depth, &points, color);
+
+    const std::string ply = dir + "/point_cloud_writer_bench.ply";
+    const std::string pcd = dir + "/point_cloud_writer_bench.pcd";
+    bench::measure("  iostream per value, ply", count,
+        [&]() { write_ply_iostream(ply, points); });
+    bench::measure("  PointCloudWriter::Write, ply", count,
+        [&]() { PointCloudWriter::Write(ply, points); });
+    bench::measure("  PointCloudWriter::Write, pcd", count,
+        [&]() { PointCloudWriter::Write(pcd, points); });
+
+    // the cost of the caller, pushing as fast as generated, so may drop
+    {
+      PointCloudWriter writer;
+      bench::measure("  generate + Push, pcd", count,
+          [&]() {
+            PointCloudData queued = writer.Acquire();
+            pc.Generate(depth, &queued, color);
+            writer.Push(pcd, std::move(queued));
+          }, 0);
+      writer.Flush();
+      std::cout << "    written: " << writer.GetWrittenCount()
+          << ", dropped: " << writer.GetDroppedCount() << std::endl;
+    }
+    std::remove(ply.c_str());
+    std::remove(pcd.c_str());
+  }
+  return 0;
+}
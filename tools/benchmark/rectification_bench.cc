@@ -0,0 +1,195 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/imgproc/rectification.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The float maps, as initUndistortRectifyMap of OpenCV
+void build_float_maps(const CameraIntrinsics& in, std::vector<float>* map_x,
+    std::vector<float>* map_y) {
+  map_x->resize(in.width * in.height);
+  map_y->resize(in.width * in.height);
+  const double* k = in.coeffs;
+  for (int v = 0; v < in.height; v++) {
+    for (int u = 0; u < in.width; u++) {
+      const double xn = (u - in.p[2]) / in.p[0];
+      const double yn = (v - in.p[6]) / in.p[5];
+      const double w = in.r[2] * xn + in.r[5] * yn + in.r[8];
+      const double x = (in.r[0] * xn + in.r[3] * yn + in.r[6]) / w;
+      const double y = (in.r[1] * xn + in.r[4] * yn + in.r[7]) / w;
+      const double r2 = x * x + y * y;
+      const double radial = 1 + r2 * (k[0] + r2 * (k[1] + r2 * k[4]));
+      (*map_x)[v * in.width + u] = static_cast<float>(in.fx * (x * radial +
+          2 * k[2] * x * y + k[3] * (r2 + 2 * x * x)) + in.cx);
+      (*map_y)[v * in.width + u] = static_cast<float>(in.fy * (y * radial +
+          k[2] * (r2 + 2 * y * y) + 2 * k[3] * x * y) + in.cy);
+    }
+  }
+}
+
+// The float bilinear remap, as remap of OpenCV without SIMD
+void remap_float(const std::uint8_t* src, int channels,
+    const std::vector<float>& map_x, const std::vector<float>& map_y,
+    int width, int height, std::uint8_t* dst) {
+  const int n = channels;
+  for (int i = 0; i < width * height; i++) {
+    const float sx = map_x[i], sy = map_y[i];
+    const int x0 = static_cast<int>(std::floor(sx));
+    const int y0 = static_cast<int>(std::floor(sy));
+    if (x0 < 0 || y0 < 0 || x0 >= width - 1 || y0 >= height - 1) {
+      std::fill(dst + n * i, dst + n * i + n, 0);
+      continue;
+    }
+    const float fx = sx - x0, fy = sy - y0;
+    const std::uint8_t* p0 = src + n * (y0 * width + x0);
+    const std::uint8_t* p1 = p0 + n * width;
+    for (int c = 0; c < n; c++) {
+      const float top = p0[c] + (p0[c + n] - p0[c]) * fx;
+      const float bottom = p1[c] + (p1[c + n] - p1[c]) * fx;
+      dst[n * i + c] = static_cast<std::uint8_t>(
+          top + (bottom - top) * fy + 0.5f);
+    }
+  }
+}
+
+// The gray of BGR, as cvtColor of OpenCV
+void bgr_to_gray(const std::uint8_t* bgr, int count, std::uint8_t* gray) {
+  for (int i = 0; i < count; i++, bgr += 3) {
+    gray[i] = static_cast<std::uint8_t>(
+        (bgr[2] * 77 + bgr[1] * 150 + bgr[0] * 29 + 128) >> 8);
+  }
+}
+
+// The half size by the mean of 2 x 2, as resize of OpenCV with INTER_AREA
+void resize_half(const std::uint8_t* src, int width, int height,
+    std::uint8_t* dst) {
+  for (int y = 0; y < height / 2; y++) {
+    const std::uint8_t* p0 = src + 2 * y * width;
+    const std::uint8_t* p1 = p0 + width;
+    for (int x = 0; x < width / 2; x++) {
+      *dst++ = static_cast<std::uint8_t>((p0[2 * x] + p0[2 * x + 1] +
+          p1[2 * x] + p1[2 * x + 1] + 2) >> 2);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 100;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "color: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    // a wide angle camera, slightly rotated
+    auto in = bench::make_intrinsics(width, height);
+    in.fx = in.fy = width * 0.56;
+    in.cx += 3;
+    in.cy -= 2;
+    const double coeffs[5] = {-0.28, 0.08, 0.0004, -0.0003, -0.01};
+    std::copy(coeffs, coeffs + 5, in.coeffs);
+    const double a = 0.02;
+    const double r[9] = {std::cos(a), 0, std::sin(a), 0, 1, 0,
+        -std::sin(a), 0, std::cos(a)};
+    std::copy(r, r + 9, in.r);
+    in.p[0] = in.p[5] = width * 0.52;
+    in.p[2] = width * 0.5;
+    in.p[6] = height * 0.5;
+    in.p[10] = 1;
+
+    auto yuyv = ImageColor::Create(ImageFormat::COLOR_YUYV, width, height,
+        false);
+    // smooth, as the bilinear of YUV and of converted are close then
+    for (int y = 0; y < height; y++) {
+      std::uint8_t* row = yuyv->data() + y * width * 2;
+      for (int x = 0; x < width; x++) {
+        row[2 * x] = static_cast<std::uint8_t>(
+            128 + 100 * std::sin(x * 0.05) * std::cos(y * 0.04));
+        row[2 * x + 1] = static_cast<std::uint8_t>(x % 2 ?
+            128 + 60 * std::cos(x * 0.02) : 128 + 60 * std::sin(y * 0.03));
+      }
+    }
+
+    // the common path: convert, then remap by float maps
+    std::vector<float> map_x, map_y;
+    bench::measure("  float maps build", 1,
+        [&]() { build_float_maps(in, &map_x, &map_y); }, 0);
+    std::vector<std::uint8_t> remapped(width * height * 3);
+    bench::measure("  convert + float remap, bgr", count, [&]() {
+      auto bgr = yuyv->To(ImageFormat::COLOR_BGR);
+      remap_float(bgr->data(), 3, map_x, map_y, width, height,
+          remapped.data());
+    });
+
+    Rectification rectification;
+    bench::measure("  Rectification maps build", 1,
+        [&]() { rectification.SetIntrinsics(in); }, 0);
+    Image::pointer rectified;
+    bench::measure("  Rectification fused, bgr", count,
+        [&]() { rectification.Process(yuyv, ImageFormat::COLOR_BGR,
+            &rectified); });
+    bench::measure("  Rectification fused, gray", count,
+        [&]() { rectification.Process(yuyv, ImageFormat::IMAGE_GRAY_8,
+            &rectified); });
+
+    // the difference to the common path, mostly of the convertor rounding,
+    // except the edges of source, which may be 0 of either
+    rectification.Process(yuyv, ImageFormat::COLOR_BGR, &rectified);
+    int max_diff = 0;
+    for (std::size_t i = 0; i < remapped.size(); i++) {
+      if (remapped[i] == 0 || rectified->data()[i] == 0) continue;
+      max_diff = std::max(max_diff,
+          std::abs(remapped[i] - rectified->data()[i]));
+    }
+    std::cout << "    max diff: " << max_diff << std::endl;
+
+    // the front-end eye, gray rectified of half size: by three passes with
+    // two intermediate images, or fused
+    std::vector<std::uint8_t> gray(width * height);
+    std::vector<std::uint8_t> gray_remapped(width * height);
+    std::vector<std::uint8_t> half(width * height / 4);
+    bench::measure("  3 passes, half gray", count, [&]() {
+      auto bgr = yuyv->To(ImageFormat::COLOR_BGR);
+      bgr_to_gray(bgr->data(), width * height, gray.data());
+      remap_float(gray.data(), 1, map_x, map_y, width, height,
+          gray_remapped.data());
+      resize_half(gray_remapped.data(), width, height, half.data());
+    });
+    bench::measure("  Rectification maps build, half", 1,
+        [&]() { rectification.SetOutputSize(width / 2, height / 2); }, 0);
+    bench::measure("  Rectification fused, half gray", count,
+        [&]() { rectification.Process(yuyv, ImageFormat::IMAGE_GRAY_8,
+            &rectified); });
+    rectification.SetOutputSize(0, 0);
+  }
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/imgproc/stereo_matcher.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+const int kDisparities = 64;
+const int kBlockSize = 9;
+
+// The disparity of the synthetic pair: a tilted plane with a box
+double disparity(int x, int y, int width, int height) {
+  double d = 12 + 30.0 * y / height;
+  if (x > width / 2 && x < width * 2 / 3 && y > height / 4 &&
+      y < height / 2) {
+    d += 15;
+  }
+  return d;
+}
+
+// The left and right of a random texture, right is brighter
+void make_pair(int width, int height, Image::pointer* left,
+    Image::pointer* right) {
+  const int margin = 2 * kDisparities;
+  const int w = width + margin;
+  std::mt19937 rng(0);
+  std::vector<float> texture(w * height);
+  for (int y = 0; y < height; y++) {
+    float prev = 128;
+    for (int x = 0; x < w; x++) {
+      prev = 0.5f * prev + 0.5f * (rng() % 256);
+      texture[y * w + x] = prev;
+    }
+  }
+  *left = Image::Create(ImageType::IMAGE_LEFT_COLOR,
+      ImageFormat::IMAGE_GRAY_8, width, height, false);
+  *right = Image::Create(ImageType::IMAGE_RIGHT_COLOR,
+      ImageFormat::IMAGE_GRAY_8, width, height, false);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      (*left)->data()[y * width + x] =
+          static_cast<std::uint8_t>(texture[y * w + x + margin / 2]);
+      // the right of xr is the left of xr + d
+      double d = disparity(x, y, width, height);
+      d = disparity(x + static_cast<int>(d), y, width, height);
+      const double sx = x + d + margin / 2;
+      const int i = static_cast<int>(sx);
+      const double f = sx - i;
+      (*right)->data()[y * width + x] = static_cast<std::uint8_t>(std::min(
+          texture[y * w + i] * (1 - f) + texture[y * w + i + 1] * f + 4.5,
+          255.0));
+    }
+  }
+}
+
+// The block matching of SAD, summing each block again, without SIMD
+void match_naive(const Image::pointer& left, const Image::pointer& right,
+    std::vector<std::uint8_t>* disparities) {
+  const int w = left->width(), h = left->height(), r = kBlockSize / 2;
+  const std::uint8_t* l = left->data();
+  const std::uint8_t* rr = right->data();
+  disparities->assign(w * h, 0);
+  for (int y = r; y < h - r; y++) {
+    for (int x = r; x < w - r; x++) {
+      int best = 0, best_cost = -1;
+      for (int d = 0; d < kDisparities && x - d - r >= 0; d++) {
+        int cost = 0;
+        for (int dy = -r; dy <= r; dy++) {
+          for (int dx = -r; dx <= r; dx++) {
+            cost += std::abs(l[(y + dy) * w + x + dx] -
+                rr[(y + dy) * w + x + dx - d]);
+          }
+        }
+        if (best_cost < 0 || cost < best_cost) {
+          best_cost = cost;
+          best = d;
+        }
+      }
+      (*disparities)[y * w + x] = static_cast<std::uint8_t>(best);
+    }
+  }
+}
+
+// The percent of depth valid, and of which within 1 disparity
+void check(const Image::pointer& depth, double focal, double baseline) {
+  const int w = depth->width(), h = depth->height();
+  auto z = reinterpret_cast<const std::uint16_t*>(depth->data());
+  int valid = 0, good = 0;
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+      if (z[y * w + x] == 0) continue;
+      ++valid;
+      const double d = focal * baseline / z[y * w + x];
+      if (std::abs(d - disparity(x, y, w, h)) <= 1) ++good;
+    }
+  }
+  std::cout << "    valid: " << 100.0 * valid / (w * h) << "%, within 1: "
+      << 100.0 * good / std::max(valid, 1) << "%" << std::endl;
+}
+
+void print_fps(double ms) {
+  std::cout << "    fps: " << 1000 / ms << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 360}, {1280, 720}};
+  int count = 20;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+  const double focal = 500, baseline = 120;
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "gray: " << width << "x" << height << ", count: " << count
+        << ", disparities: " << kDisparities << ", block: " << kBlockSize
+        << std::endl;
+
+    Image::pointer left, right;
+    make_pair(width, height, &left, &right);
+
+    std::vector<std::uint8_t> disparities;
+    print_fps(bench::measure("  naive SAD", 1,
+        [&]() { match_naive(left, right, &disparities); }, 0));
+
+    StereoMatcher matcher;
+    matcher.SetCamera(focal, baseline);
+    matcher.SetDisparities(kDisparities);
+    matcher.SetBlockSize(kBlockSize);
+    Image::pointer depth;
+    matcher.SetCost(StereoMatchCost::SAD);
+    print_fps(bench::measure("  StereoMatcher SAD", count,
+        [&]() { matcher.Process(left, right, &depth); }));
+    check(depth, focal, baseline);
+    matcher.SetCost(StereoMatchCost::CENSUS);
+    print_fps(bench::measure("  StereoMatcher census", count,
+        [&]() { matcher.Process(left, right, &depth); }));
+    check(depth, focal, baseline);
+  }
+  return 0;
+}
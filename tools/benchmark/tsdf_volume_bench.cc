@@ -0,0 +1,118 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/filter/base_filter.h"
+#include "mynteyed/pointcloud/tsdf_volume.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The dense volume in front of camera, as the former way of KinectFusion:
+// every voxel is projected each frame, seen or not
+class DenseVolume {
+ public:
+  DenseVolume(int nx, int ny, int nz, float voxel_size)
+    : nx_(nx), ny_(ny), nz_(nz), voxel_size_(voxel_size),
+      tsdf_(nx * ny * nz, 1.f), weight_(nx * ny * nz, 0.f) {
+  }
+
+  void Integrate(const Image::pointer& depth, const CameraIntrinsics& in,
+      float tx) {
+    const float trunc = 4 * voxel_size_;
+    int width = depth->width(), height = depth->height();
+    auto data = reinterpret_cast<const std::uint16_t*>(depth->data());
+    for (int z = 0; z < nz_; z++) {
+      for (int y = 0; y < ny_; y++) {
+        for (int x = 0; x < nx_; x++) {
+          // centered on x and y, from 0.3 m on z
+          float px = (x - nx_ / 2 + 0.5f) * voxel_size_ - tx;
+          float py = (y - ny_ / 2 + 0.5f) * voxel_size_;
+          float pz = 0.3f + (z + 0.5f) * voxel_size_;
+          int u = static_cast<int>(std::lround(px / pz * in.fx + in.cx));
+          int v = static_cast<int>(std::lround(py / pz * in.fy + in.cy));
+          if (u < 0 || u >= width || v < 0 || v >= height) continue;
+          std::uint16_t d = data[v * width + u];
+          if (!is_depth_valid(d) || d > 4000) continue;
+          float sdf = d * 0.001f - pz;
+          if (sdf < -trunc) continue;
+          std::size_t i = (z * ny_ + y) * nx_ + x;
+          float t = std::min(sdf / trunc, 1.f);
+          tsdf_[i] = (tsdf_[i] * weight_[i] + t) / (weight_[i] + 1);
+          weight_[i] = std::min(weight_[i] + 1, 64.f);
+        }
+      }
+    }
+  }
+
+ private:
+  int nx_, ny_, nz_;
+  float voxel_size_;
+  std::vector<float> tsdf_;
+  std::vector<float> weight_;
+};
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 30;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+    std::cout << "depth: " << width << "x" << height << ", count: " << count
+        << std::endl;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    auto depth = bench::make_depth(width, height);
+
+    // moving 5 mm along x each frame
+    int frame = 0;
+    DenseVolume dense(256, 192, 160, 0.02f);
+    double dense_ms = bench::measure("  naive (dense 256x192x160)", count,
+        [&]() { dense.Integrate(depth, in, 0.005f * frame++); }, 1);
+
+    frame = 0;
+    TsdfVolume volume;
+    volume.SetIntrinsics(in);
+    Extrinsics pose{{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, {0, 0, 0}};
+    double ms = bench::measure("  TsdfVolume::Integrate", count, [&]() {
+      pose.translation[0] = 5.0 * frame++;
+      volume.Integrate(depth, pose);
+    }, 1);
+    std::cout << "    speedup: " << dense_ms / ms << "x, fps: " << 1000 / ms
+        << (ms <= 1000.0 / 30 ? " (>= 30)" : " (< 30)") << ", blocks: "
+        << volume.GetBlockCount() << std::endl;
+
+    TsdfMesh mesh;
+    bench::measure("  TsdfVolume::ExtractMesh", 1,
+        [&]() { volume.ExtractMesh(&mesh); }, 0);
+    std::cout << "    vertices: " << mesh.vertices.size() / 3
+        << ", triangles: " << mesh.triangles.size() / 3 << std::endl;
+  }
+  return 0;
+}
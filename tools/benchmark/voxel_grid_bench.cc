@@ -0,0 +1,112 @@
+// Copyright 2018 Slightech Co., Ltd. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mynteyed/pointcloud/point_cloud.h"
+#include "mynteyed/pointcloud/voxel_grid.h"
+
+#include "bench.h"
+
+MYNTEYE_USE_NAMESPACE
+
+namespace {
+
+// The single thread std::unordered_map, as downsampling in PCL after ROS
+void naive_voxels(const PointCloudData& in, float leaf,
+    std::vector<float>* xyz) {
+  struct Sum {
+    float x, y, z;
+    std::size_t n;
+  };
+  std::unordered_map<std::uint64_t, Sum> voxels;
+  std::vector<std::uint64_t> order;
+  const float inv = 1.f / leaf;
+  for (std::size_t i = 0; i < in.count; i++) {
+    const float* p = &in.xyz[3 * i];
+    auto key = [inv](float v) {
+      return static_cast<std::uint64_t>(
+          static_cast<std::int64_t>(std::floor(v * inv)) + (1 << 20));
+    };
+    std::uint64_t k = (key(p[0]) << 42) | (key(p[1]) << 21) | key(p[2]);
+    auto it = voxels.find(k);
+    if (it == voxels.end()) {
+      voxels.emplace(k, Sum{p[0], p[1], p[2], 1});
+      order.push_back(k);
+    } else {
+      it->second.x += p[0];
+      it->second.y += p[1];
+      it->second.z += p[2];
+      ++it->second.n;
+    }
+  }
+  xyz->resize(3 * order.size());
+  for (std::size_t j = 0; j < order.size(); j++) {
+    const Sum& s = voxels[order[j]];
+    (*xyz)[3 * j] = s.x / s.n;
+    (*xyz)[3 * j + 1] = s.y / s.n;
+    (*xyz)[3 * j + 2] = s.z / s.n;
+  }
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::pair<int, int>> sizes{{640, 480}, {1280, 720}};
+  int count = 50;
+  if (argc >= 3) {
+    sizes = {{std::atoi(argv[1]), std::atoi(argv[2])}};
+  }
+  if (argc >= 4) count = std::atoi(argv[3]);
+
+  for (auto&& size : sizes) {
+    int width = size.first, height = size.second;
+
+    auto in = bench::make_intrinsics(width, height);
+
+    PointCloud pc;
+    pc.SetOrganized(false);
+    pc.SetIntrinsics(in);
+    PointCloudData points;
+    pc.Generate(bench::make_depth(width, height), &points);
+    std::cout << "depth: " << width << "x" << height << ", points: "
+        << points.count << ", count: " << count << std::endl;
+
+    for (float leaf : {0.01f, 0.05f}) {
+      std::vector<float> naive;
+      double naive_ms = bench::measure("  naive leaf " + std::to_string(leaf),
+          count, [&]() { naive_voxels(points, leaf, &naive); });
+
+      PointCloudData reduced;
+      for (auto selection : {VoxelSelection::CENTROID,
+          VoxelSelection::FIRST}) {
+        VoxelGrid grid(leaf, selection);
+        std::string name = std::string("  VoxelGrid ") +
+            (selection == VoxelSelection::CENTROID ? "centroid" : "first");
+        double ms = bench::measure(name, count, [&]() {
+          grid.Filter(points, &reduced);
+        });
+        std::cout << "    speedup: " << naive_ms / ms << "x, voxels: "
+            << reduced.count << " (naive " << naive.size() / 3 << ")"
+            << std::endl;
+      }
+    }
+  }
+  return 0;
+}
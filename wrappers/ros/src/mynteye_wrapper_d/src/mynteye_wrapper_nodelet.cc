@@ -18,6 +18,7 @@
 #include <image_transport/image_transport.h>
 #include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Imu.h>
+#include <sensor_msgs/LaserScan.h>
 #include <visualization_msgs/Marker.h>
 #include <tf/tf.h>
 #include <tf2_ros/static_transform_broadcaster.h>
@@ -35,10 +36,12 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <mynteye_wrapper_d/CompactPoints.h> // NOLINT
 #include <mynteye_wrapper_d/Temp.h> // NOLINT
 
 #include "mynteyed/camera.h"
 #include "mynteyed/utils.h"
+#include "mynteyed/pointcloud/laser_scan.h"
 
 #include "pointcloud_generator.h" // NOLINT
 
@@ -93,6 +96,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   image_transport::CameraPublisher pub_right_color;
   image_transport::CameraPublisher pub_depth;
   ros::Publisher pub_points;
+  ros::Publisher pub_points_compact;
+  ros::Publisher pub_scan;
   ros::Publisher pub_imu;
   ros::Publisher pub_temp;
   ros::Publisher pub_imu_processed;
@@ -109,6 +114,14 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
 
   std::int32_t points_frequency;
   double points_factor;
+  bool points_organized;
+  double points_report_period;
+  double points_voxel_size;
+  bool points_compact;
+  int scan_rows;
+  int scan_offset;
+  double scan_range_min;
+  double scan_range_max;
   double gravity;
 
   std::string base_frame_id;
@@ -118,6 +131,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   std::string right_color_frame_id;
   std::string depth_frame_id;
   std::string points_frame_id;
+  std::string scan_frame_id;
   std::string imu_frame_id;
   std::string temp_frame_id;
   std::string imu_frame_processed_id;
@@ -131,6 +145,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   // Others
 
   std::unique_ptr<PointCloudGenerator> pointcloud_generator;
+  std::unique_ptr<LaserScan> laser_scan;
+  LaserScanData scan_data;
 
   std::shared_ptr<MotionIntrinsics> motion_intrinsics;
   bool motion_intrinsics_enabled;
@@ -138,8 +154,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
   std::shared_ptr<ImuData> imu_accel;
   std::shared_ptr<ImuData> imu_gyro;
 
-  cv::Mat points_color;
-  cv::Mat points_depth;
+  Image::pointer points_color;
+  Image::pointer points_depth;
 
   typedef struct SubResult {
     bool left_mono;
@@ -148,6 +164,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     bool right_color;
     bool depth;
     bool points;
+    bool scan;
     bool imu;
     bool temp;
     bool imu_processed;
@@ -212,12 +229,28 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
 
     points_frequency = DEFAULT_POINTS_FREQUENCE;
     points_factor = DEFAULT_POINTS_FACTOR;
+    points_organized = DEFAULT_POINTS_ORGANIZED;
+    points_report_period = DEFAULT_POINTS_REPORT_PERIOD;
+    points_voxel_size = DEFAULT_POINTS_VOXEL_SIZE;
+    points_compact = false;
+    scan_rows = 1;
+    scan_offset = 0;
+    scan_range_min = 0.3;
+    scan_range_max = 10.0;
     gravity = 9.8;
     if (ros_output_framerate > 0 && ros_output_framerate < 7) {
       skip_tag = ros_output_framerate;
     }
     nh_ns.getParamCached("points_frequency", points_frequency);
     nh_ns.getParamCached("points_factor", points_factor);
+    nh_ns.getParamCached("points_organized", points_organized);
+    nh_ns.getParamCached("points_report_period", points_report_period);
+    nh_ns.getParamCached("points_voxel_size", points_voxel_size);
+    nh_ns.getParamCached("points_compact", points_compact);
+    nh_ns.getParamCached("scan_rows", scan_rows);
+    nh_ns.getParamCached("scan_offset", scan_offset);
+    nh_ns.getParamCached("scan_range_min", scan_range_min);
+    nh_ns.getParamCached("scan_range_max", scan_range_max);
     nh_ns.getParamCached("gravity", gravity);
 
     base_frame_id = "mynteye_link";
@@ -237,6 +270,9 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     nh_ns.getParamCached("right_color_frame", right_color_frame_id);
     nh_ns.getParamCached("depth_frame", depth_frame_id);
     nh_ns.getParamCached("points_frame", points_frame_id);
+    // x forward, as the angles of scan
+    scan_frame_id = base_frame_id;
+    nh_ns.getParamCached("scan_frame", scan_frame_id);
     nh_ns.getParamCached("imu_frame", imu_frame_id);
     nh_ns.getParamCached("temp_frame", temp_frame_id);
     nh_ns.getParamCached("imu_frame_processed", imu_frame_processed_id);
@@ -247,6 +283,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     NODELET_INFO_STREAM("right_color_frame: " << right_color_frame_id);
     NODELET_INFO_STREAM("depth_frame: " << depth_frame_id);
     NODELET_INFO_STREAM("points_frame: " << points_frame_id);
+    NODELET_INFO_STREAM("scan_frame: " << scan_frame_id);
     NODELET_INFO_STREAM("imu_frame: " << imu_frame_id);
     NODELET_INFO_STREAM("temp_frame: " << temp_frame_id);
     NODELET_INFO_STREAM("imu_frame_processed: " << imu_frame_processed_id);
@@ -257,6 +294,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     std::string right_color_topic = "mynteye/right/image_color";
     std::string depth_topic = "mynteye/depth";
     std::string points_topic = "mynteye/points";
+    std::string points_compact_topic = "mynteye/points/compact";
+    std::string scan_topic = "mynteye/scan";
     std::string imu_topic = "mynteye/imu";
     std::string temp_topic = "mynteye/temp";
     std::string imu_processed_topic = "mynteye/imu_processed";
@@ -266,6 +305,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     nh_ns.getParamCached("right_color_topic", right_color_topic);
     nh_ns.getParamCached("depth_topic", depth_topic);
     nh_ns.getParamCached("points_topic", points_topic);
+    nh_ns.getParamCached("points_compact_topic", points_compact_topic);
+    nh_ns.getParamCached("scan_topic", scan_topic);
     nh_ns.getParamCached("imu_topic", imu_topic);
     nh_ns.getParamCached("temp_topic", temp_topic);
     nh_ns.getParamCached("imu_processed_topic", imu_processed_topic);
@@ -360,6 +401,14 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     // points
     pub_points = nh.advertise<sensor_msgs::PointCloud2>(points_topic, 1);
     NODELET_INFO_STREAM("Advertized on topic " << points_topic);
+    if (points_compact) {
+      pub_points_compact = nh.advertise<mynteye_wrapper_d::CompactPoints>(
+          points_compact_topic, 1);
+      NODELET_INFO_STREAM("Advertized on topic " << points_compact_topic);
+    }
+
+    pub_scan = nh.advertise<sensor_msgs::LaserScan>(scan_topic, 1);
+    NODELET_INFO_STREAM("Advertized on topic " << scan_topic);
     // imu
     pub_imu = nh.advertise<sensor_msgs::Imu>(imu_topic, 100);
     NODELET_INFO_STREAM("Advertized on topic " << imu_topic);
@@ -389,7 +438,11 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     bool right_mono_sub = pub_right_mono.getNumSubscribers() > 0;
     bool right_color_sub = pub_right_color.getNumSubscribers() > 0;
     bool depth_sub = pub_depth.getNumSubscribers() > 0;
-    bool points_sub = pub_points.getNumSubscribers() > 0;
+    // the points are only encoded if compact
+    bool points_sub = points_compact ?
+        pub_points_compact.getNumSubscribers() > 0 :
+        pub_points.getNumSubscribers() > 0;
+    bool scan_sub = pub_scan.getNumSubscribers() > 0;
     bool imu_sub = pub_imu.getNumSubscribers() > 0;
     bool temp_sub = pub_temp.getNumSubscribers() > 0;
     bool imu_processed_sub = pub_imu_processed.getNumSubscribers() > 0;
@@ -401,8 +454,9 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     if (left_sub != sub_result.left ||
         right_sub != sub_result.right ||
         depth_sub != sub_result.depth ||
-        points_sub != sub_result.points) {
-      if (left_sub || right_sub || depth_sub || points_sub) {
+        points_sub != sub_result.points ||
+        scan_sub != sub_result.scan) {
+      if (left_sub || right_sub || depth_sub || points_sub || scan_sub) {
         if (mynteye->IsImageInfoSupported()) {
           mynteye->EnableImageInfo(true);
         }
@@ -424,7 +478,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
 
     sub_result = {
       left_mono_sub, left_color_sub, right_mono_sub, right_color_sub,
-      depth_sub, points_sub, imu_sub, temp_sub,
+      depth_sub, points_sub, scan_sub, imu_sub, temp_sub,
       imu_processed_sub, left_sub, right_sub,
     };
     pthread_mutex_unlock(&mutex_sub_result);
@@ -461,6 +515,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
         bool sub_result_right_color = sub_result.right_color;
         bool sub_result_right_mono = sub_result.right_mono;
         bool sub_result_right_depth = sub_result.depth;
+        bool sub_result_scan = sub_result.scan;
         pthread_mutex_unlock(&mutex_sub_result);
 
         auto timestamp = data.img_info
@@ -481,7 +536,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
             }
           } break;
           case ImageType::IMAGE_DEPTH: {
-            if (sub_result_right_depth || sub_result_points) {
+            if (sub_result_right_depth || sub_result_points ||
+                sub_result_scan) {
               publishDepth(data, timestamp);
             }
           } break;
@@ -551,11 +607,26 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     }
 
     // pointcloud generator
+    PointCloudGenerator::CompactCallback compact_callback = nullptr;
+    if (points_compact) {
+      compact_callback =
+          [this](const mynteye_wrapper_d::CompactPointsPtr& msg) {
+            msg->header.frame_id = points_frame_id;
+            pub_points_compact.publish(msg);
+          };
+    }
     pointcloud_generator.reset(new PointCloudGenerator(in.left,
-        [this](sensor_msgs::PointCloud2 msg) {
-          msg.header.frame_id = points_frame_id;
+        [this](const sensor_msgs::PointCloud2Ptr& msg) {
+          msg->header.frame_id = points_frame_id;
           pub_points.publish(msg);
-        }, points_factor, points_frequency));
+        }, points_factor, points_frequency, points_organized,
+        points_report_period, points_voxel_size, compact_callback));
+
+    // laser scan
+    laser_scan.reset(new LaserScan);
+    laser_scan->SetIntrinsics(in.left);
+    laser_scan->SetScanRows(scan_rows, scan_offset);
+    laser_scan->SetRangeLimits(scan_range_min, scan_range_max);
   }
 
   void closeDevice() {
@@ -602,7 +673,8 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
       const image_transport::Publisher& pub_mono, bool mono_sub,
       const std::string mono_frame_id, bool is_left) {
 
-    auto&& mat = data.img->To(ImageFormat::COLOR_BGR)->ToMat();
+    auto&& image = data.img->To(ImageFormat::COLOR_BGR);
+    auto&& mat = image->ToMat();
 
     if (color_sub) {
       std_msgs::Header header;
@@ -631,7 +703,7 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     pthread_mutex_unlock(&mutex_sub_result);
     if (is_left && sub_result_points) {
       pthread_mutex_lock(&mutex_color);
-      points_color = mat;
+      points_color = image;
       publishPoints(timestamp);
       pthread_mutex_unlock(&mutex_color);
     }
@@ -645,21 +717,29 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     auto&& info = depth_info_ptr;
     if (info) info->header.stamp = header.stamp;
     if (info) info->header.frame_id = depth_frame_id;
+    pthread_mutex_lock(&mutex_sub_result);
+    bool sub_result_points = sub_result.points;
+    bool sub_result_scan = sub_result.scan;
+    pthread_mutex_unlock(&mutex_sub_result);
     if (params.depth_mode == DepthMode::DEPTH_RAW) {
-      auto&& mat = data.img->To(ImageFormat::DEPTH_RAW)->ToMat();
+      auto&& image = data.img->To(ImageFormat::DEPTH_RAW);
+      auto&& mat = image->ToMat();
       if (depth_type == 0) {
         pub_depth.publish(
             cv_bridge::CvImage(header, enc::MONO16, mat).toImageMsg(), info);
       } else if (depth_type == 1) {
         pub_depth.publish(
-            cv_bridge::CvImage(header, enc::TYPE_16UC1, mat).toImageMsg(), info);
+            cv_bridge::CvImage(header, enc::TYPE_16UC1, mat).toImageMsg(),
+            info);
+      }
+      // the same scan and points as the last, if unchanged by the change gate
+      if (data.unchanged) return;
+      if (sub_result_scan) {
+        publishScan(image, timestamp);
       }
-      pthread_mutex_lock(&mutex_sub_result);
-      bool sub_result_points = sub_result.points;
-      pthread_mutex_unlock(&mutex_sub_result);
       if (sub_result_points) {
         pthread_mutex_lock(&mutex_color);
-        points_depth = mat;
+        points_depth = image;
         // publishPoints(header.stamp);
         pthread_mutex_unlock(&mutex_color);
       }
@@ -676,13 +756,29 @@ class MYNTEYEWrapperNodelet : public nodelet::Nodelet {
     }
   }
 
+  void publishScan(const Image::pointer& depth, const ros::Time& stamp) {
+    if (!laser_scan->Compute(depth, &scan_data)) return;
+    sensor_msgs::LaserScanPtr msg(new sensor_msgs::LaserScan);
+    msg->header.stamp = stamp;
+    msg->header.frame_id = scan_frame_id;
+    msg->angle_min = scan_data.angle_min;
+    msg->angle_max = scan_data.angle_max;
+    msg->angle_increment = scan_data.angle_increment;
+    msg->time_increment = 0;
+    msg->scan_time = 0;
+    msg->range_min = scan_data.range_min;
+    msg->range_max = scan_data.range_max;
+    msg->ranges = scan_data.ranges;
+    pub_scan.publish(msg);
+  }
+
   void publishPoints(ros::Time stamp) {
-    if (points_color.empty() || points_depth.empty()) {
+    if (!points_color || !points_depth) {
       return;
     }
     pointcloud_generator->Push(points_color, points_depth, stamp);
-    points_color.release();
-    points_depth.release();
+    points_color = nullptr;
+    points_depth = nullptr;
   }
 
   void timestampAlign() {
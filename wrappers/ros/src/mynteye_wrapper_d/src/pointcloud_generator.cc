@@ -13,21 +13,53 @@
 // limitations under the License.
 #include "pointcloud_generator.h"
 
+#include <algorithm>
 #include <utility>
 
+#include <ros/console.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+
+// The messages kept for reuse, more are created if subscribers hold them all
+#define POINTS_MESSAGES_POOL_SIZE 4
+
 MYNTEYE_USE_NAMESPACE
 
-PointCloudGenerator::PointCloudGenerator(CameraIntrinsics in, Callback callback,
-    double factor, std::int32_t frequency)
+namespace {
+
+double to_ms(const std::chrono::steady_clock::duration& d) {
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+}  // namespace
+
+PointCloudGenerator::PointCloudGenerator(CameraIntrinsics in,
+    Callback callback, double factor, std::int32_t frequency,
+    bool organized, double report_period, double voxel_size,
+    CompactCallback compact_callback)
   : in_(std::move(in)),
     callback_(std::move(callback)),
+    compact_callback_(std::move(compact_callback)),
     rate_(nullptr),
     running_(false),
+    factor_(factor),
+    organized_(organized && voxel_size <= 0),
     generating_(false),
-    factor_(factor) {
+    voxel_size_(voxel_size),
+    voxel_(static_cast<float>(voxel_size)),
+    report_period_(report_period),
+    report_time_(std::chrono::steady_clock::now()),
+    report_clock_(std::clock()),
+    report_count_(0),
+    generate_ms_sum_(0),
+    latency_ms_sum_(0),
+    latency_ms_max_(0) {
   if (frequency > 0) {
     rate_.reset(new MYNTEYE_NAMESPACE::Rate(frequency));
   }
+  points_.SetIntrinsics(in_);
+  points_.SetDepthScale(1.0 / factor_);
+  points_.SetLayout(PointCloudLayout::XYZRGB);
+  points_.SetOrganized(organized_);
   Start();
 }
 
@@ -35,8 +67,8 @@ PointCloudGenerator::~PointCloudGenerator() {
   Stop();
 }
 
-bool PointCloudGenerator::Push(const cv::Mat& color, const cv::Mat& depth,
-    ros::Time stamp) {
+bool PointCloudGenerator::Push(const Image::pointer& color,
+    const Image::pointer& depth, ros::Time stamp) {
   if (!running_) {
     throw new std::runtime_error("Start first!");
   }
@@ -45,9 +77,10 @@ bool PointCloudGenerator::Push(const cv::Mat& color, const cv::Mat& depth,
     std::lock_guard<std::mutex> _(mutex_);
     if (generating_) return false;
     generating_ = true;
-    color_ = color.clone();
-    depth_ = depth.clone();
+    color_ = color;
+    depth_ = depth;
     stamp_ = stamp;
+    push_time_ = std::chrono::steady_clock::now();
   }
   condition_.notify_one();
   return true;
@@ -77,61 +110,116 @@ void PointCloudGenerator::Stop() {
   }
 }
 
+sensor_msgs::PointCloud2Ptr PointCloudGenerator::GetMessage() {
+  for (auto&& msg : msgs_) {
+    if (msg.unique()) return msg;
+  }
+  sensor_msgs::PointCloud2Ptr msg(new sensor_msgs::PointCloud2);
+  sensor_msgs::PointCloud2Modifier modifier(*msg);
+  // the same as PointCloudLayout::XYZRGB
+  modifier.setPointCloud2Fields(4,
+      "x", 1, sensor_msgs::PointField::FLOAT32,
+      "y", 1, sensor_msgs::PointField::FLOAT32,
+      "z", 1, sensor_msgs::PointField::FLOAT32,
+      "rgb", 1, sensor_msgs::PointField::FLOAT32);
+  if (msgs_.size() < POINTS_MESSAGES_POOL_SIZE) {
+    msgs_.push_back(msg);
+  }
+  return msg;
+}
+
+void PointCloudGenerator::Generate(const sensor_msgs::PointCloud2Ptr& msg,
+    const Image::pointer& color, const Image::pointer& depth) {
+  const std::size_t width = depth->width();
+  const std::size_t height = depth->height();
+  // the capacity is kept, so only the first frames allocate
+  msg->data.resize(width * height * msg->point_step);
+  std::size_t count = 0;
+  auto data = reinterpret_cast<float*>(msg->data.data());
+  if (voxel_size_ > 0) {
+    // only the downsampled are copied into the message
+    points_.Generate(depth, &cloud_, color);
+    voxel_.Filter(cloud_, data, &count);
+  } else {
+    points_.Generate(depth, data, &count, color);
+  }
+  msg->data.resize(count * msg->point_step);
+
+  if (organized_) {
+    msg->width = width;
+    msg->height = height;
+    msg->is_dense = false;
+  } else {
+    msg->width = count;
+    msg->height = 1;
+    msg->is_dense = true;
+  }
+  msg->row_step = msg->width * msg->point_step;
+}
+
+mynteye_wrapper_d::CompactPointsPtr PointCloudGenerator::GetCompactMessage() {
+  for (auto&& msg : compact_msgs_) {
+    if (msg.unique()) return msg;
+  }
+  mynteye_wrapper_d::CompactPointsPtr msg(new mynteye_wrapper_d::CompactPoints);
+  if (compact_msgs_.size() < POINTS_MESSAGES_POOL_SIZE) {
+    compact_msgs_.push_back(msg);
+  }
+  return msg;
+}
+
+void PointCloudGenerator::GenerateCompact(
+    const mynteye_wrapper_d::CompactPointsPtr& msg,
+    const Image::pointer& color, const Image::pointer& depth) {
+  points_.Generate(depth, &cloud_, color);
+  const PointCloudData* points = &cloud_;
+  if (voxel_size_ > 0) {
+    voxel_.Filter(cloud_, &downsampled_);
+    points = &downsampled_;
+  }
+  // the capacity is kept, so only the first frames allocate
+  codec_.Encode(*points, &msg->data);
+}
+
 void PointCloudGenerator::Run() {
   while (running_) {
+    Image::pointer color, depth;
+    ros::Time stamp;
+    std::chrono::steady_clock::time_point push_time;
     {
       std::unique_lock<std::mutex> lock(mutex_);
       condition_.wait(lock, [this] { return generating_; });
       if (!running_) break;
+      color = std::move(color_);
+      depth = std::move(depth_);
+      stamp = stamp_;
+      push_time = push_time_;
     }
 
-    sensor_msgs::PointCloud2 msg;
-    msg.header.stamp = stamp_;
-    msg.width = depth_.cols;
-    msg.height = depth_.rows;
-    msg.is_dense = true;
-
-    sensor_msgs::PointCloud2Modifier modifier(msg);
-
-    modifier.setPointCloud2Fields(4,
-        "x", 1, sensor_msgs::PointField::FLOAT32,
-        "y", 1, sensor_msgs::PointField::FLOAT32,
-        "z", 1, sensor_msgs::PointField::FLOAT32,
-        "rgb", 1, sensor_msgs::PointField::FLOAT32);
-    modifier.setPointCloud2FieldsByString(2, "xyz", "rgb");
-
-    sensor_msgs::PointCloud2Iterator<float> iter_x(msg, "x");
-    sensor_msgs::PointCloud2Iterator<float> iter_y(msg, "y");
-    sensor_msgs::PointCloud2Iterator<float> iter_z(msg, "z");
-
-    sensor_msgs::PointCloud2Iterator<uchar> iter_r(msg, "r");
-    sensor_msgs::PointCloud2Iterator<uchar> iter_g(msg, "g");
-    sensor_msgs::PointCloud2Iterator<uchar> iter_b(msg, "b");
-
-    for (int m = 0; m < depth_.rows; m++) {
-      for (int n = 0; n < depth_.cols; n++) {
-        // get depth value at (m, n)
-        ushort d = depth_.ptr<ushort>(m)[n];
-        // when d is equal 0 or 4096 means no depth
-        if (d == 0 || d == 4096)
-          continue;
-
-        *iter_z = d / factor_;
-        *iter_x = (n - in_.cx) * *iter_z / in_.fx;
-        *iter_y = (m - in_.cy) * *iter_z / in_.fy;
-
-        *iter_r = color_.ptr<uchar>(m)[n * 3 + 2];
-        *iter_g = color_.ptr<uchar>(m)[n * 3 + 1];
-        *iter_b = color_.ptr<uchar>(m)[n * 3];
-
-        ++iter_x; ++iter_y; ++iter_z;  // NOLINT
-        ++iter_r; ++iter_g; ++iter_b;  // NOLINT
-      }
+    auto time_beg = std::chrono::steady_clock::now();
+    sensor_msgs::PointCloud2Ptr msg;
+    mynteye_wrapper_d::CompactPointsPtr compact_msg;
+    if (compact_callback_) {
+      compact_msg = GetCompactMessage();
+      compact_msg->header.stamp = stamp;
+      GenerateCompact(compact_msg, color, depth);
+    } else {
+      msg = GetMessage();
+      msg->header.stamp = stamp;
+      Generate(msg, color, depth);
     }
+    // release the frames to the caches of SDK
+    color.reset();
+    depth.reset();
+    auto time_end = std::chrono::steady_clock::now();
 
-    if (callback_) {
-      callback_(std::move(msg));
+    if (compact_msg) {
+      compact_callback_(compact_msg);
+    } else if (callback_) {
+      callback_(msg);
     }
+    Report(to_ms(time_end - time_beg),
+        to_ms(std::chrono::steady_clock::now() - push_time));
 
     if (rate_) {
       rate_->Sleep();
@@ -142,3 +230,27 @@ void PointCloudGenerator::Run() {
     }
   }
 }
+
+void PointCloudGenerator::Report(double generate_ms, double latency_ms) {
+  if (report_period_ <= 0) return;
+  ++report_count_;
+  generate_ms_sum_ += generate_ms;
+  latency_ms_sum_ += latency_ms;
+  latency_ms_max_ = std::max(latency_ms_max_, latency_ms);
+
+  auto now = std::chrono::steady_clock::now();
+  double elapsed_ms = to_ms(now - report_time_);
+  if (elapsed_ms < report_period_ * 1000) return;
+  // the cpu time of the process, over all cores
+  std::clock_t clock = std::clock();
+  double cpu_ms = 1000.0 * (clock - report_clock_) / CLOCKS_PER_SEC;
+  ROS_INFO("points: %.1f Hz, generate %.2f ms, latency %.2f ms (max %.2f),"
+      " process cpu %.0f%%", report_count_ * 1000 / elapsed_ms,
+      generate_ms_sum_ / report_count_, latency_ms_sum_ / report_count_,
+      latency_ms_max_, 100 * cpu_ms / elapsed_ms);
+
+  report_time_ = now;
+  report_clock_ = clock;
+  report_count_ = 0;
+  generate_ms_sum_ = latency_ms_sum_ = latency_ms_max_ = 0;
+}
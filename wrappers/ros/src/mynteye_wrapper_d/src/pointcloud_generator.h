@@ -15,17 +15,22 @@
 #define MYNTEYE_WRAPPER_POINTCLOUD_GENERATOR_H_
 #pragma once
 
+#include <chrono>
 #include <condition_variable>
+#include <ctime>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
-
-#include <opencv2/core/core.hpp>
+#include <vector>
 
 #include <sensor_msgs/PointCloud2.h>
-#include <sensor_msgs/point_cloud2_iterator.h>
+#include <mynteye_wrapper_d/CompactPoints.h> // NOLINT
 
+#include "mynteyed/device/image.h"
+#include "mynteyed/pointcloud/point_cloud.h"
+#include "mynteyed/pointcloud/point_cloud_codec.h"
+#include "mynteyed/pointcloud/voxel_grid.h"
 #include "mynteyed/util/rate.h"
 #include "mynteyed/stubs/types_calib.h"
 
@@ -33,20 +38,42 @@ MYNTEYE_BEGIN_NAMESPACE
 
 #define DEFAULT_POINTS_FREQUENCE (0)
 #define DEFAULT_POINTS_FACTOR (1000.0)
+#define DEFAULT_POINTS_ORGANIZED (false)
+#define DEFAULT_POINTS_REPORT_PERIOD (0.0)
+#define DEFAULT_POINTS_VOXEL_SIZE (0.0)
 
 class PointCloudGenerator {
  public:
-  using Callback = std::function<void(sensor_msgs::PointCloud2)>;
-
+  using Callback = std::function<void(const sensor_msgs::PointCloud2Ptr&)>;
+  using CompactCallback =
+      std::function<void(const mynteye_wrapper_d::CompactPointsPtr&)>;
+
+  /**
+   * organized: width x height with NaN for invalid, otherwise only the valid.
+   * report_period: report the latency and cpu every seconds, 0 means not.
+   * voxel_size: downsample by the voxel size in meters, 0 means not. The
+   *   points are always compacted if downsampled.
+   * compact_callback: if set, the points are encoded by PointCloudCodec into
+   *   it, instead of the callback.
+   */
   PointCloudGenerator(CameraIntrinsics in, Callback callback,
       double factor = DEFAULT_POINTS_FACTOR,
-      std::int32_t frequency = DEFAULT_POINTS_FREQUENCE);
+      std::int32_t frequency = DEFAULT_POINTS_FREQUENCE,
+      bool organized = DEFAULT_POINTS_ORGANIZED,
+      double report_period = DEFAULT_POINTS_REPORT_PERIOD,
+      double voxel_size = DEFAULT_POINTS_VOXEL_SIZE,
+      CompactCallback compact_callback = nullptr);
   ~PointCloudGenerator();
 
-  bool Push(const cv::Mat& color, const cv::Mat& depth, ros::Time stamp);
+  /** Push the frames, shared not cloned, so do not modify them later. */
+  bool Push(const Image::pointer& color, const Image::pointer& depth,
+      ros::Time stamp);
 
   double factor() { return factor_; }
-  void set_factor(double factor) { factor_ = factor; }
+  void set_factor(double factor) {
+    factor_ = factor;
+    points_.SetDepthScale(1.0 / factor);
+  }
 
  private:
   void Start();
@@ -54,8 +81,18 @@ class PointCloudGenerator {
 
   void Run();
 
+  // the message not in use by subscribers, from the pool
+  sensor_msgs::PointCloud2Ptr GetMessage();
+  void Generate(const sensor_msgs::PointCloud2Ptr& msg,
+      const Image::pointer& color, const Image::pointer& depth);
+  mynteye_wrapper_d::CompactPointsPtr GetCompactMessage();
+  void GenerateCompact(const mynteye_wrapper_d::CompactPointsPtr& msg,
+      const Image::pointer& color, const Image::pointer& depth);
+  void Report(double generate_ms, double latency_ms);
+
   CameraIntrinsics in_;
   Callback callback_;
+  CompactCallback compact_callback_;
 
   std::unique_ptr<MYNTEYE_NAMESPACE::Rate> rate_;
 
@@ -65,13 +102,36 @@ class PointCloudGenerator {
   bool running_;
   std::thread thread_;
 
-  cv::Mat color_;
-  cv::Mat depth_;
+  Image::pointer color_;
+  Image::pointer depth_;
   ros::Time stamp_;
+  std::chrono::steady_clock::time_point push_time_;
 
   double factor_;
+  bool organized_;
 
   bool generating_;
+
+  PointCloud points_;
+  // the full points before downsampling, if voxel_size_ > 0
+  double voxel_size_;
+  PointCloudData cloud_;
+  VoxelGrid voxel_;
+  std::vector<sensor_msgs::PointCloud2Ptr> msgs_;
+
+  // the points encoded, if compact_callback_
+  PointCloudData downsampled_;
+  PointCloudCodec codec_;
+  std::vector<mynteye_wrapper_d::CompactPointsPtr> compact_msgs_;
+
+  // the stats since last report
+  double report_period_;
+  std::chrono::steady_clock::time_point report_time_;
+  std::clock_t report_clock_;
+  std::size_t report_count_;
+  double generate_ms_sum_;
+  double latency_ms_sum_;
+  double latency_ms_max_;
 };
 
 MYNTEYE_END_NAMESPACE